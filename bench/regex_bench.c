@@ -0,0 +1,86 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Benchmarks grep-like regexec scans over a large generated text for vlibc.
+ *
+ * Copyright (c) 2025
+ */
+
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LINE_COUNT 200000
+#define LINE_LEN   80
+
+/* Monotonic time in microseconds; vlibc's printf has no %f. */
+static long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Fill buf with LINE_COUNT lines of lowercase words; a few carry a token. */
+static char *make_text(void)
+{
+    char *buf = malloc((size_t)LINE_COUNT * LINE_LEN + 1);
+    if (!buf)
+        return NULL;
+    unsigned seed = 12345;
+    char *p = buf;
+    for (int i = 0; i < LINE_COUNT; i++) {
+        for (int j = 0; j < LINE_LEN - 1; j++) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned r = (seed >> 16) % 27;
+            *p++ = r == 26 ? ' ' : (char)('a' + r);
+        }
+        *p++ = '\n';
+    }
+    *p = '\0';
+    for (int i = 0; i < LINE_COUNT; i += 997)
+        memcpy(buf + (size_t)i * LINE_LEN + 20, "ERROR 42: disk", 14);
+    return buf;
+}
+
+/* Count matching lines the way grep would: one regexec per line. */
+static void run(const char *name, const char *pattern, char *text)
+{
+    regex_t re;
+    if (regcomp(&re, pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+        printf("%-12s compile failed\n", name);
+        return;
+    }
+    long long start = now_us();
+    size_t hits = 0;
+    char *line = text;
+    while (*line) {
+        char *nl = strchr(line, '\n');
+        *nl = '\0';
+        if (regexec(&re, line, 0, NULL, 0) == 0)
+            hits++;
+        *nl = '\n';
+        line = nl + 1;
+    }
+    long long elapsed = now_us() - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+    regfree(&re);
+    printf("%-12s %-22s %6zu lines %8lld us %6lld MB/s\n", name, pattern,
+           hits, elapsed, (long long)LINE_COUNT * LINE_LEN / elapsed);
+}
+
+int main(void)
+{
+    char *text = make_text();
+    if (!text)
+        return 1;
+    run("prefix", "ERROR [0-9]+", text);
+    run("required", "[A-Z]+ 42: disk", text);
+    run("first-byte", "(ERROR|WARN) [0-9]+", text);
+    run("no-literal", "[A-Z][0-9]", text);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Benchmarks per-message and batched UDP I/O over loopback for vlibc.
+ *
+ * Copyright (c) 2025
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MESSAGES 200000
+#define BATCH    32
+#define PAYLOAD  64
+
+static long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static char out[BATCH][PAYLOAD];
+static char in[BATCH][PAYLOAD];
+static struct iovec oiov[BATCH], iiov[BATCH];
+static struct mmsghdr omsg[BATCH], imsg[BATCH];
+
+static void report(const char *name, long long start, long received)
+{
+    long long elapsed = now_us() - start;
+    if (elapsed <= 0)
+        elapsed = 1;
+    printf("%-10s %7ld msgs %8lld us %8lld msgs/s\n", name, received,
+           elapsed, (long long)received * 1000000 / elapsed);
+}
+
+/* One sendto and one recv per datagram. */
+static void single(int tx, int rx)
+{
+    long n = 0;
+    long long start = now_us();
+    for (long i = 0; i < MESSAGES; i += BATCH) {
+        for (int j = 0; j < BATCH; j++)
+            send(tx, out[j], PAYLOAD, 0);
+        for (int j = 0; j < BATCH; j++)
+            if (recv(rx, in[j], PAYLOAD, 0) == PAYLOAD)
+                n++;
+    }
+    report("single", start, n);
+}
+
+/* One sendmmsg and usually one recvmmsg per BATCH datagrams. */
+static void batched(int tx, int rx)
+{
+    long n = 0;
+    long long start = now_us();
+    for (long i = 0; i < MESSAGES; i += BATCH) {
+        sendmmsg(tx, omsg, BATCH, 0);
+        int got = 0;
+        while (got < BATCH) {
+            int r = recvmmsg(rx, imsg + got, BATCH - got, MSG_WAITFORONE,
+                             NULL);
+            if (r <= 0)
+                break;
+            got += r;
+        }
+        n += got;
+    }
+    report("mmsg", start, n);
+}
+
+/* The kernel splits one GSO buffer into BATCH datagrams. */
+static void gso(int tx, int rx)
+{
+    static char buf[BATCH * PAYLOAD];
+    long n = 0;
+    long long start = now_us();
+    for (long i = 0; i < MESSAGES; i += BATCH) {
+        if (vlibc_udp_send_gso(tx, buf, sizeof(buf), PAYLOAD, NULL, 0) < 0) {
+            printf("gso        unsupported\n");
+            return;
+        }
+        int got = 0;
+        while (got < BATCH) {
+            int r = recvmmsg(rx, imsg + got, BATCH - got, MSG_WAITFORONE,
+                             NULL);
+            if (r <= 0)
+                break;
+            got += r;
+        }
+        n += got;
+    }
+    report("gso+mmsg", start, n);
+}
+
+int main(void)
+{
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(a);
+    if (tx < 0 || rx < 0 || bind(rx, (struct sockaddr *)&a, sizeof(a)) != 0 ||
+        getsockname(rx, (struct sockaddr *)&a, &alen) != 0 ||
+        connect(tx, (struct sockaddr *)&a, sizeof(a)) != 0) {
+        printf("socket setup failed\n");
+        return 1;
+    }
+    int rcvbuf = 4 << 20;
+    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    for (int i = 0; i < BATCH; i++) {
+        memset(out[i], 'a' + i % 26, PAYLOAD);
+        oiov[i].iov_base = out[i];
+        oiov[i].iov_len = PAYLOAD;
+        omsg[i].msg_hdr.msg_iov = &oiov[i];
+        omsg[i].msg_hdr.msg_iovlen = 1;
+        iiov[i].iov_base = in[i];
+        iiov[i].iov_len = PAYLOAD;
+        imsg[i].msg_hdr.msg_iov = &iiov[i];
+        imsg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    single(tx, rx);
+    batched(tx, rx);
+    gso(tx, rx);
+    close(tx);
+    close(rx);
+    return 0;
+}
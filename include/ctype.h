@@ -18,10 +18,10 @@
 
 /* Macro helpers */
 #define __ctype_isflag(c, flag) \
-    (((unsigned char)(c)) < 128 && ((__ctype_table[(unsigned char)(c)] & (flag)) != 0))
+    ((__ctype_table[(unsigned char)(c)] & (flag)) != 0)
 
 /* Classification table defined in ctype.c */
-extern const unsigned char __ctype_table[128];
+extern const unsigned char __ctype_table[256];
 
 #define isalpha(c)  (__ctype_isflag(c, __CTYPE_UPPER | __CTYPE_LOWER))
 #define isdigit(c)  (__ctype_isflag(c, __CTYPE_DIGIT))
@@ -16,10 +16,20 @@
  */
 #include_next <dirent.h>
 
-/* Wrapper prototypes for the system directory functions. */
+/*
+ * Native directory streams over getdents64. DIR is only used as an
+ * opaque handle, so every stream function is replaced below.
+ */
 DIR *vlibc_opendir(const char *name);
+DIR *vlibc_fdopendir(int fd);
 struct dirent *vlibc_readdir(DIR *dirp);
 int vlibc_closedir(DIR *dirp);
+int vlibc_dirfd(DIR *dirp);
+long vlibc_telldir(DIR *dirp);
+void vlibc_seekdir(DIR *dirp, long loc);
+void vlibc_rewinddir(DIR *dirp);
+/* Size the getdents64 buffer (default 32 KiB) before the first readdir. */
+int vlibc_setdirbuf(DIR *dirp, size_t size);
 
 /* Directory scanning helpers */
 int scandir(const char *dirp, struct dirent ***namelist,
@@ -27,8 +37,17 @@ int scandir(const char *dirp, struct dirent ***namelist,
             int (*compar)(const struct dirent **, const struct dirent **));
 int alphasort(const struct dirent **a, const struct dirent **b);
 
-#define opendir  vlibc_opendir
-#define readdir  vlibc_readdir
-#define closedir vlibc_closedir
+/* Raw directory records in the layout of struct vlibc_dirent64. */
+ssize_t getdents64(int fd, void *buf, size_t count);
+
+#undef dirfd
+#define opendir   vlibc_opendir
+#define fdopendir vlibc_fdopendir
+#define readdir   vlibc_readdir
+#define closedir  vlibc_closedir
+#define dirfd     vlibc_dirfd
+#define telldir   vlibc_telldir
+#define seekdir   vlibc_seekdir
+#define rewinddir vlibc_rewinddir
 
 #endif /* DIRENT_H */
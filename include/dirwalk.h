@@ -0,0 +1,129 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Purpose: Directory traversal core shared by nftw, fts and vlibc_pwalk.
+ */
+#ifndef DIRWALK_H
+#define DIRWALK_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Record layout returned by getdents64(2). */
+struct vlibc_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/*
+ * Buffered reader over an open directory descriptor. Each refill is one
+ * getdents64 call into buf; the "." and ".." entries are skipped.
+ */
+struct vlibc_dirreader {
+    int fd;
+    char *buf;
+    size_t size;
+    size_t pos;
+    size_t len;
+};
+
+#define VLIBC_DIRBUF_SIZE (32 * 1024)
+/* descriptor budget for callers without an fdlimit argument */
+#define VLIBC_WALK_FDLIMIT 64
+
+void vlibc_dirreader_init(struct vlibc_dirreader *r, int fd, char *buf,
+                          size_t size);
+/* Next entry, or NULL at the end (*error = 0) or on failure (*error set). */
+struct vlibc_dirent64 *vlibc_dirreader_next(struct vlibc_dirreader *r,
+                                            int *error);
+
+/* Walk options */
+#define VLIBC_WALK_PHYS   0x01  /* report symbolic links, never follow */
+#define VLIBC_WALK_NOSTAT 0x02  /* classify by d_type; stat only if unknown */
+#define VLIBC_WALK_XDEV   0x04  /* skip entries on other filesystems */
+#define VLIBC_WALK_POST   0x08  /* report directories again when left */
+
+/* Entry types, matching the FTW_* values. */
+#define VLIBC_WALK_F    0
+#define VLIBC_WALK_D    1
+#define VLIBC_WALK_DNR  2
+#define VLIBC_WALK_NS   3
+#define VLIBC_WALK_SL   4
+#define VLIBC_WALK_DP   5
+#define VLIBC_WALK_SLN  6
+
+struct vlibc_walkent {
+    const char *path;           /* full path, valid until the next call */
+    size_t pathlen;
+    size_t base;                /* offset of the last component */
+    int level;
+    int type;
+    int error;                  /* errno behind DNR and NS entries */
+    int nostat;                 /* only st_mode type bits and st_ino set */
+    struct stat st;
+};
+
+struct vlibc_walkframe;
+
+/*
+ * Depth-first walker. Directories are opened with openat() relative to
+ * their parent and entries are examined with fstatat() on the parent
+ * descriptor, so no full path is resolved below the root. At most
+ * fdlimit directory descriptors stay open; deeper directories are read
+ * completely and closed before their entries are returned. A directory
+ * is entered as soon as it is returned, unless vlibc_walk_skip() follows.
+ */
+struct vlibc_walk {
+    int flags;
+    int fdlimit;
+    int nfds;
+    int state;
+    dev_t dev;
+    struct vlibc_walkframe *frames;
+    size_t depth;
+    size_t cap;
+    char *path;
+    size_t pathcap;
+    int entered;                /* top frame belongs to the last entry */
+    struct vlibc_walkent ent;
+};
+
+int vlibc_walk_open(struct vlibc_walk *w, const char *root, int flags,
+                    int fdlimit);
+/* Returns 1 with *ent filled, 0 when done or -1 with errno set. */
+int vlibc_walk_next(struct vlibc_walk *w, struct vlibc_walkent **ent);
+/* Do not descend into the directory just returned. */
+void vlibc_walk_skip(struct vlibc_walk *w);
+void vlibc_walk_close(struct vlibc_walk *w);
+
+/* Parallel walk option: deliver each directory's entries sorted by name */
+#define VLIBC_PWALK_SORTED 0x10
+
+/* Return non-zero to stop the walk; worker is in [0, nthreads). */
+typedef int (*vlibc_pwalk_fn)(const struct vlibc_walkent *ent, int worker,
+                              void *arg);
+
+/*
+ * Walk root with nthreads workers (0 = one per CPU) that call fn
+ * concurrently. Each directory is listed by one worker; subdirectories
+ * go to that worker's deque and idle workers steal from the others.
+ * A directory is reported before its entries, and with VLIBC_WALK_POST
+ * again after everything below it. Entries of one directory are
+ * delivered in order by a single thread. At most fdlimit directory
+ * descriptors wait in the queues. Returns 0, the first non-zero value
+ * from fn, or -1 with errno set.
+ */
+int vlibc_pwalk(const char *root, int flags, int nthreads, int fdlimit,
+                vlibc_pwalk_fn fn, void *arg);
+
+/* Classify one entry; shared by the serial and parallel walkers. */
+int __vlibc_walk_classify(int flags, int root, dev_t dev, int dirfd,
+                          const char *name, unsigned char dtype,
+                          uint64_t ino, struct vlibc_walkent *e, int *fdout);
+
+#endif /* DIRWALK_H */
@@ -11,6 +11,9 @@
 #define RTLD_LOCAL  0
 #define RTLD_GLOBAL 0x100
 
+/* Search the global namespace in dlsym(). */
+#define RTLD_DEFAULT ((void *)0)
+
 void *dlopen(const char *filename, int flag);
 void *dlsym(void *handle, const char *symbol);
 int dlclose(void *handle);
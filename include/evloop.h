@@ -0,0 +1,52 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Purpose: Declarations for the vlibc event loop.
+ */
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include "sys/epoll.h"
+
+/*
+ * A single threaded readiness loop over epoll. Descriptors are watched
+ * with EPOLLIN/EPOLLOUT masks and timers live on a millisecond timing
+ * wheel, so each iteration costs time proportional to the ready events.
+ */
+typedef struct evloop evloop_t;
+typedef struct evloop_timer evloop_timer_t;
+
+typedef void (*evloop_fd_cb)(evloop_t *loop, int fd, unsigned events,
+                             void *arg);
+typedef void (*evloop_timer_cb)(evloop_t *loop, evloop_timer_t *timer,
+                                void *arg);
+
+evloop_t *evloop_new(void);
+void evloop_free(evloop_t *loop);
+
+/* Watch fd for the given EPOLL* events; one callback per descriptor. */
+int evloop_add_fd(evloop_t *loop, int fd, unsigned events, evloop_fd_cb cb,
+                  void *arg);
+int evloop_mod_fd(evloop_t *loop, int fd, unsigned events);
+int evloop_del_fd(evloop_t *loop, int fd);
+
+/*
+ * Call cb after ms milliseconds and then every repeat_ms milliseconds
+ * when repeat_ms is non-zero. One-shot timers are released after their
+ * callback; evloop_cancel_timer() releases a pending or repeating one
+ * and may be called from any callback.
+ */
+evloop_timer_t *evloop_add_timer(evloop_t *loop, unsigned ms,
+                                 unsigned repeat_ms, evloop_timer_cb cb,
+                                 void *arg);
+void evloop_cancel_timer(evloop_t *loop, evloop_timer_t *timer);
+
+/* Wait up to timeout_ms (-1 = until something happens) and dispatch.
+ * Returns the number of callbacks run or -1 on error. */
+int evloop_run_once(evloop_t *loop, int timeout_ms);
+
+/* Dispatch until evloop_stop() or until nothing is left to watch. */
+int evloop_run(evloop_t *loop);
+void evloop_stop(evloop_t *loop);
+
+#endif /* EVLOOP_H */
@@ -41,6 +41,29 @@ int fcntl(int fd, int cmd, ...);
 #ifndef O_CLOEXEC
 #define O_CLOEXEC       02000000
 #endif
+#if defined(__arm__) || defined(__aarch64__)
+#ifndef O_DIRECTORY
+#define O_DIRECTORY     00040000
+#endif
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW      00100000
+#endif
+#else
+#ifndef O_DIRECTORY
+#define O_DIRECTORY     00200000
+#endif
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW      00400000
+#endif
+#endif
+
+/* *at() directory and flag arguments */
+#ifndef AT_FDCWD
+#define AT_FDCWD            -100
+#endif
+#ifndef AT_SYMLINK_NOFOLLOW
+#define AT_SYMLINK_NOFOLLOW 0x100
+#endif
 
 /* fcntl(2) commands */
 #ifndef F_DUPFD
@@ -89,4 +112,28 @@ int fcntl(int fd, int cmd, ...);
 
 int posix_fadvise(int fd, off_t offset, off_t len, int advice);
 
+/* flags for splice(2), tee(2) and vmsplice(2) */
+#ifndef SPLICE_F_MOVE
+#define SPLICE_F_MOVE     1
+#endif
+#ifndef SPLICE_F_NONBLOCK
+#define SPLICE_F_NONBLOCK 2
+#endif
+#ifndef SPLICE_F_MORE
+#define SPLICE_F_MORE     4
+#endif
+#ifndef SPLICE_F_GIFT
+#define SPLICE_F_GIFT     8
+#endif
+
+struct iovec;
+/* Move data between a pipe and another descriptor inside the kernel. */
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+               size_t len, unsigned int flags);
+/* Duplicate pipe contents into another pipe without consuming them. */
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned int flags);
+/* Map user pages into a pipe. */
+ssize_t vmsplice(int fd, const struct iovec *iov, size_t nr_segs,
+                 unsigned int flags);
+
 #endif /* FCNTL_H */
@@ -36,9 +36,12 @@ struct _ftsent {
 #define FTS_NS 4
 #define FTS_SL 5
 #define FTS_DP 6
+#define FTS_NSOK 7
 
 /* options */
 #define FTS_PHYSICAL 0x01
+#define FTS_NOSTAT   0x08   /* non-directories get FTS_NSOK, no stat */
+#define FTS_XDEV     0x40
 
 FTS *fts_open(char * const *paths, int options,
               int (*compar)(const FTSENT **, const FTSENT **));
@@ -27,6 +27,8 @@ extern "C" {
 #define FTW_MOUNT 2
 #define FTW_CHDIR 4
 #define FTW_DEPTH 8
+/* vlibc extension: classify by d_type, st holds only the type bits */
+#define FTW_NOSTAT 0x100
 
 struct FTW {
     int base;
@@ -39,6 +41,9 @@ typedef int (*nftw_func_t)(const char *, const struct stat *, int, struct FTW *)
 
 int ftw(const char *dir, ftw_func_t fn, int fdlimit);
 int nftw(const char *dir, nftw_func_t fn, int fdlimit, int flags);
+/* vlibc extension: nftw with concurrent, thread-safe callbacks */
+int nftw_parallel(const char *dir, nftw_func_t fn, int fdlimit, int flags,
+                  int nthreads);
 
 #ifdef __cplusplus
 }
@@ -15,16 +15,16 @@
 static inline int futex_wait(atomic_int *addr, int val,
                              const struct timespec *ts)
 {
-    return (int)vlibc_syscall(SYS_futex, (long)addr,
-                              FUTEX_WAIT | FUTEX_PRIVATE_FLAG,
-                              val, (long)ts, 0, 0);
+    return (int)vlibc_syscall4(SYS_futex, (long)addr,
+                               FUTEX_WAIT | FUTEX_PRIVATE_FLAG,
+                               val, (long)ts);
 }
 
 static inline int futex_wake(atomic_int *addr, int count)
 {
-    return (int)vlibc_syscall(SYS_futex, (long)addr,
-                              FUTEX_WAKE | FUTEX_PRIVATE_FLAG,
-                              count, 0, 0, 0);
+    return (int)vlibc_syscall3(SYS_futex, (long)addr,
+                               FUTEX_WAKE | FUTEX_PRIVATE_FLAG,
+                               count);
 }
 #else
 static inline int futex_wait(atomic_int *addr, int val,
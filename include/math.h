@@ -6,6 +6,8 @@
 #ifndef MATH_H
 #define MATH_H
 
+#include <stddef.h>
+
 double sin(double x);
 double cos(double x);
 double tan(double x);
@@ -39,6 +41,13 @@ float atanhf(float x);
 float exp2f(float x);
 float expm1f(float x);
 float log1pf(float x);
+float sinf(float x);
+float cosf(float x);
+float tanf(float x);
+float sqrtf(float x);
+float powf(float x, float y);
+float logf(float x);
+float expf(float x);
 long double asinl(long double x);
 long double acosl(long double x);
 long double atanl(long double x);
@@ -61,6 +70,23 @@ double fmin(double a, double b);
 double fmax(double a, double b);
 double copysign(double x, double y);
 
+/*
+ * Array variants: out[i] = f(in[i]) (or f(x[i], y[i])) for i < n. They
+ * use SIMD kernels chosen for the running CPU.
+ */
+void vlibc_vexp(double *out, const double *in, size_t n);
+void vlibc_vlog(double *out, const double *in, size_t n);
+void vlibc_vsin(double *out, const double *in, size_t n);
+void vlibc_vcos(double *out, const double *in, size_t n);
+void vlibc_vsqrt(double *out, const double *in, size_t n);
+void vlibc_vpow(double *out, const double *x, const double *y, size_t n);
+void vlibc_vexpf(float *out, const float *in, size_t n);
+void vlibc_vlogf(float *out, const float *in, size_t n);
+void vlibc_vsinf(float *out, const float *in, size_t n);
+void vlibc_vcosf(float *out, const float *in, size_t n);
+void vlibc_vsqrtf(float *out, const float *in, size_t n);
+void vlibc_vpowf(float *out, const float *x, const float *y, size_t n);
+
 /* Floating-point classification */
 #if defined(__has_builtin)
 #  if !defined(isnan) && __has_builtin(__builtin_isnan)
@@ -28,6 +28,22 @@ int posix_memalign(void **memptr, size_t alignment, size_t size);
 /* Allocate memory with a given alignment. Returns NULL on failure. */
 void *aligned_alloc(size_t alignment, size_t size);
 
+/*
+ * Shared blocks hold many objects that callers release one by one with
+ * free(), like the entries scandir() returns. A malloc'd block starts
+ * with VLIBC_SHARED_HDR bytes and each piece is preceded by
+ * VLIBC_PIECE_HDR bytes at an 8-byte aligned offset. The block is freed
+ * together with the last of its pieces.
+ */
+#define VLIBC_SHARED_HDR 16
+#define VLIBC_PIECE_HDR  16
+void vlibc_shared_init(void *block, size_t pieces);
+/*
+ * Write the header of a piece of size bytes at offset and return the
+ * piece behind it. realloc() copies at most size bytes out of it.
+ */
+void *vlibc_shared_piece(void *block, size_t offset, size_t size);
+
 /*
  * Unit tests can set this variable to N to fail the Nth allocation call.
  * Set to -1 to disable the failure mechanism.
@@ -20,6 +20,16 @@ typedef struct {
     int rm_eo; /* end offset */
 } regmatch_t;
 
+/* regcomp() flags */
+#define REG_EXTENDED 0x1 /* accepted; extended syntax is always used */
+#define REG_ICASE    0x2 /* ignore case */
+#define REG_NOSUB    0x4 /* only report match or no match */
+#define REG_NEWLINE  0x8 /* '.' and [^...] skip '\n'; ^ and $ match at lines */
+
+/* regexec() flags */
+#define REG_NOTBOL   0x1 /* start of string is not a line start */
+#define REG_NOTEOL   0x2 /* end of string is not a line end */
+
 /* compile pattern into preg. Supported syntax includes:
  *  - literals and '.' wildcard
  *  - character classes with [] and POSIX classes like [:digit:]
@@ -28,6 +38,7 @@ typedef struct {
  *  - grouping via parentheses which also create numbered
  *    capture groups referenced as \1, \2, ...
  *  - anchors ^ and $
+ * Returns 0 on success or one of the REG_* error codes below.
  */
 int regcomp(regex_t *preg, const char *pattern, int cflags);
 
@@ -43,4 +54,15 @@ void regfree(regex_t *preg);
 /* error code when no match was found */
 #define REG_NOMATCH 1
 
+/* regcomp() error codes */
+#define REG_BADPAT   2  /* invalid pattern */
+#define REG_ECTYPE   4  /* unknown character class name */
+#define REG_EESCAPE  5  /* trailing backslash */
+#define REG_ESUBREG  6  /* backreference to an undefined group */
+#define REG_EBRACK   7  /* unmatched [ */
+#define REG_EPAREN   8  /* unmatched ( */
+#define REG_BADBR    10 /* invalid repetition count */
+#define REG_ERANGE   11 /* invalid range in bracket expression */
+#define REG_ESPACE   12 /* out of memory or pattern too large */
+
 #endif /* REGEX_H */
@@ -97,15 +97,27 @@ int sigdelset(sigset_t *set, int signo);
 int sigismember(const sigset_t *set, int signo);
 char *strsignal(int signum);
 
-#ifdef VLIBC_HAS_SYS_UCONTEXT
+/*
+ * vlibc switches user contexts itself on these targets and defines its
+ * own ucontext_t; elsewhere the host <ucontext.h> is used when present.
+ */
+#if defined(__x86_64__) || defined(__aarch64__) || defined(__arm__)
+#define VLIBC_NATIVE_UCONTEXT 1
+#endif
+
+#if defined(VLIBC_HAS_SYS_UCONTEXT) && !defined(VLIBC_NATIVE_UCONTEXT)
 #include <sys/ucontext.h>
 #else
+#ifndef __stack_t_defined
+#define __stack_t_defined 1
+/* same layout as the kernel's, which sigaltstack() is handed directly */
 typedef struct {
     void  *ss_sp;
-    size_t ss_size;
     int    ss_flags;
+    size_t ss_size;
 } stack_t;
 #endif
+#endif
 
 #define SS_ONSTACK  1
 #define SS_DISABLE  2
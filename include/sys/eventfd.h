@@ -0,0 +1,21 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Purpose: Declarations for event notification descriptors.
+ */
+#ifndef SYS_EVENTFD_H
+#define SYS_EVENTFD_H
+
+#include <stdint.h>
+
+typedef uint64_t eventfd_t;
+
+#define EFD_SEMAPHORE 1
+#define EFD_CLOEXEC   02000000
+#define EFD_NONBLOCK  00004000
+
+int eventfd(unsigned int initval, int flags);
+int eventfd_read(int fd, eventfd_t *value);
+int eventfd_write(int fd, eventfd_t value);
+
+#endif /* SYS_EVENTFD_H */
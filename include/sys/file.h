@@ -59,4 +59,20 @@ struct sf_hdtr {
 int sendfile(int fd, int s, off_t offset, size_t nbytes,
              struct sf_hdtr *hdtr, off_t *sbytes, int flags);
 
+/* Transfer paths reported by vlibc_copy_fd(). */
+#define VLIBC_COPY_RANGE    1   /* copy_file_range(2) */
+#define VLIBC_COPY_SENDFILE 2   /* Linux sendfile(2) */
+#define VLIBC_COPY_SPLICE   3   /* splice(2), through a pipe if needed */
+#define VLIBC_COPY_BUFFER   4   /* read/write through a user buffer */
+
+/*
+ * Copy up to len bytes from in to out, starting at and advancing both
+ * file positions, and stop early at end of file. The cheapest working
+ * kernel path is tried first: copy_file_range, then sendfile, then
+ * splice, then a buffered loop. The one that moved the data is stored
+ * in *method when it is not NULL. Returns the bytes copied, or -1 with
+ * errno set when nothing could be copied.
+ */
+ssize_t vlibc_copy_fd(int in, int out, size_t len, int *method);
+
 #endif /* SYS_FILE_H */
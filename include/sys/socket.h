@@ -58,6 +58,43 @@ static inline struct cmsghdr *CMSG_NXTHDR(struct msghdr *mhdr, struct cmsghdr *c
 }
 #endif
 
+/*
+ * glibc only exposes struct mmsghdr to _GNU_SOURCE builds. The BSD
+ * headers declare it and sendmmsg/recvmmsg with their own signatures,
+ * so those hosts keep their definitions.
+ */
+#if !defined(VLIBC_SYS_SOCKET_NATIVE) || \
+    (defined(__linux__) && !defined(__USE_GNU))
+#define VLIBC_SOCKET_MMSG 1
+struct mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+#endif
+
+/* Zero-copy transmit and UDP segmentation offload (Linux). */
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef MSG_WAITFORONE
+#define MSG_WAITFORONE 0x10000
+#endif
+#ifndef MSG_ERRQUEUE
+#define MSG_ERRQUEUE 0x2000
+#endif
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
 /* Socket API wrappers */
 int socket(int domain, int type, int protocol);
 /* Create a new endpoint for communication. */
@@ -99,5 +136,45 @@ ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags);
 /* Send a message with ancillary data. */
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags);
 /* Receive a message along with ancillary data. */
+#ifdef VLIBC_SOCKET_MMSG
+struct timespec;
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+/* Send up to vlen messages with one call; msg_len receives each count. */
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+             struct timespec *timeout);
+/* Receive up to vlen messages with one call. */
+#endif
+
+/*
+ * vlibc extensions for high rate datagram and stream sockets.
+ *
+ * vlibc_zerocopy_enable() sets SO_ZEROCOPY so later sends may pass
+ * MSG_ZEROCOPY. The kernel then pins the user pages instead of copying
+ * them and reports on the error queue once a range of sends no longer
+ * references them. vlibc_zerocopy_reap() collects one such notification
+ * without blocking: it returns 1 and stores the inclusive range of send
+ * sequence numbers (counted from 0 per socket) in *lo and *hi, 0 when
+ * nothing is pending, or -1 on error. *copied is set when the kernel
+ * fell back to copying, as it does on loopback.
+ */
+int vlibc_zerocopy_enable(int sockfd);
+int vlibc_zerocopy_reap(int sockfd, unsigned int *lo, unsigned int *hi,
+                        int *copied);
+
+/*
+ * UDP generic segmentation offload. vlibc_udp_send_gso() hands len bytes
+ * to the kernel in one call, which emits datagrams of seg_size bytes (the
+ * last may be shorter). With vlibc_udp_enable_gro() set on a receiving
+ * socket, vlibc_udp_recv_gro() may return several coalesced datagrams at
+ * once and stores their common size in *seg_size (the received length
+ * when the kernel did not coalesce).
+ */
+ssize_t vlibc_udp_send_gso(int sockfd, const void *buf, size_t len,
+                           unsigned short seg_size,
+                           const struct sockaddr *dest, socklen_t addrlen);
+int vlibc_udp_enable_gro(int sockfd);
+ssize_t vlibc_udp_recv_gro(int sockfd, void *buf, size_t len,
+                           unsigned short *seg_size,
+                           struct sockaddr *src, socklen_t *addrlen);
 
 #endif /* SYS_SOCKET_H */
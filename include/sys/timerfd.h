@@ -0,0 +1,21 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Purpose: Declarations for timers that notify through a descriptor.
+ */
+#ifndef SYS_TIMERFD_H
+#define SYS_TIMERFD_H
+
+#include "../time.h"
+
+#define TFD_CLOEXEC             02000000
+#define TFD_NONBLOCK            00004000
+#define TFD_TIMER_ABSTIME       1
+#define TFD_TIMER_CANCEL_ON_SET 2
+
+int timerfd_create(int clockid, int flags);
+int timerfd_settime(int fd, int flags, const struct itimerspec *new_value,
+                    struct itimerspec *old_value);
+int timerfd_gettime(int fd, struct itimerspec *curr_value);
+
+#endif /* SYS_TIMERFD_H */
@@ -6,4 +6,203 @@
 #ifndef VLIBC_SYSCALL_H
 #define VLIBC_SYSCALL_H
 long vlibc_syscall(long number, ...);
+
+/*
+ * Fixed-arity syscall helpers. On Linux for x86_64, aarch64 and armv7
+ * they expand to the trap instruction with only the needed argument
+ * registers loaded. Like vlibc_syscall() they return the raw kernel
+ * result, a negative errno value on failure. Other targets route them
+ * through vlibc_syscall().
+ */
+#if defined(__linux__) && defined(__x86_64__)
+#define VLIBC_INLINE_SYSCALL 1
+
+static inline long vlibc_syscall0(long n)
+{
+    long ret;
+    __asm__ volatile ("syscall" : "=a" (ret) : "a" (n)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline long vlibc_syscall1(long n, long a1)
+{
+    long ret;
+    __asm__ volatile ("syscall" : "=a" (ret) : "a" (n), "D" (a1)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline long vlibc_syscall2(long n, long a1, long a2)
+{
+    long ret;
+    __asm__ volatile ("syscall" : "=a" (ret) : "a" (n), "D" (a1), "S" (a2)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline long vlibc_syscall3(long n, long a1, long a2, long a3)
+{
+    long ret;
+    __asm__ volatile ("syscall" : "=a" (ret)
+                      : "a" (n), "D" (a1), "S" (a2), "d" (a3)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline long vlibc_syscall4(long n, long a1, long a2, long a3, long a4)
+{
+    register long r10 __asm__("r10") = a4;
+    long ret;
+    __asm__ volatile ("syscall" : "=a" (ret)
+                      : "a" (n), "D" (a1), "S" (a2), "d" (a3), "r" (r10)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline long vlibc_syscall5(long n, long a1, long a2, long a3, long a4,
+                                  long a5)
+{
+    register long r10 __asm__("r10") = a4;
+    register long r8 __asm__("r8") = a5;
+    long ret;
+    __asm__ volatile ("syscall" : "=a" (ret)
+                      : "a" (n), "D" (a1), "S" (a2), "d" (a3), "r" (r10),
+                        "r" (r8)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline long vlibc_syscall6(long n, long a1, long a2, long a3, long a4,
+                                  long a5, long a6)
+{
+    register long r10 __asm__("r10") = a4;
+    register long r8 __asm__("r8") = a5;
+    register long r9 __asm__("r9") = a6;
+    long ret;
+    __asm__ volatile ("syscall" : "=a" (ret)
+                      : "a" (n), "D" (a1), "S" (a2), "d" (a3), "r" (r10),
+                        "r" (r8), "r" (r9)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+#elif defined(__linux__) && (defined(__aarch64__) || defined(__arm__))
+#define VLIBC_INLINE_SYSCALL 1
+
+/*
+ * aarch64 passes the number in x8 and arguments in x0-x5; armv7 (EABI)
+ * uses r7 and r0-r5. The result comes back in the first argument
+ * register.
+ */
+#ifdef __aarch64__
+#define VLIBC_SC_NR "x8"
+#define VLIBC_SC_A(i) "x" #i
+#define VLIBC_SC_INSN "svc 0"
+#else
+#define VLIBC_SC_NR "r7"
+#define VLIBC_SC_A(i) "r" #i
+#define VLIBC_SC_INSN "svc 0"
+#endif
+
+static inline long vlibc_syscall0(long n)
+{
+    register long nr __asm__(VLIBC_SC_NR) = n;
+    register long r0 __asm__(VLIBC_SC_A(0));
+    __asm__ volatile (VLIBC_SC_INSN : "=r" (r0) : "r" (nr) : "memory");
+    return r0;
+}
+
+static inline long vlibc_syscall1(long n, long a1)
+{
+    register long nr __asm__(VLIBC_SC_NR) = n;
+    register long r0 __asm__(VLIBC_SC_A(0)) = a1;
+    __asm__ volatile (VLIBC_SC_INSN : "+r" (r0) : "r" (nr) : "memory");
+    return r0;
+}
+
+static inline long vlibc_syscall2(long n, long a1, long a2)
+{
+    register long nr __asm__(VLIBC_SC_NR) = n;
+    register long r0 __asm__(VLIBC_SC_A(0)) = a1;
+    register long r1 __asm__(VLIBC_SC_A(1)) = a2;
+    __asm__ volatile (VLIBC_SC_INSN : "+r" (r0) : "r" (nr), "r" (r1)
+                      : "memory");
+    return r0;
+}
+
+static inline long vlibc_syscall3(long n, long a1, long a2, long a3)
+{
+    register long nr __asm__(VLIBC_SC_NR) = n;
+    register long r0 __asm__(VLIBC_SC_A(0)) = a1;
+    register long r1 __asm__(VLIBC_SC_A(1)) = a2;
+    register long r2 __asm__(VLIBC_SC_A(2)) = a3;
+    __asm__ volatile (VLIBC_SC_INSN : "+r" (r0)
+                      : "r" (nr), "r" (r1), "r" (r2) : "memory");
+    return r0;
+}
+
+static inline long vlibc_syscall4(long n, long a1, long a2, long a3, long a4)
+{
+    register long nr __asm__(VLIBC_SC_NR) = n;
+    register long r0 __asm__(VLIBC_SC_A(0)) = a1;
+    register long r1 __asm__(VLIBC_SC_A(1)) = a2;
+    register long r2 __asm__(VLIBC_SC_A(2)) = a3;
+    register long r3 __asm__(VLIBC_SC_A(3)) = a4;
+    __asm__ volatile (VLIBC_SC_INSN : "+r" (r0)
+                      : "r" (nr), "r" (r1), "r" (r2), "r" (r3) : "memory");
+    return r0;
+}
+
+static inline long vlibc_syscall5(long n, long a1, long a2, long a3, long a4,
+                                  long a5)
+{
+    register long nr __asm__(VLIBC_SC_NR) = n;
+    register long r0 __asm__(VLIBC_SC_A(0)) = a1;
+    register long r1 __asm__(VLIBC_SC_A(1)) = a2;
+    register long r2 __asm__(VLIBC_SC_A(2)) = a3;
+    register long r3 __asm__(VLIBC_SC_A(3)) = a4;
+    register long r4 __asm__(VLIBC_SC_A(4)) = a5;
+    __asm__ volatile (VLIBC_SC_INSN : "+r" (r0)
+                      : "r" (nr), "r" (r1), "r" (r2), "r" (r3), "r" (r4)
+                      : "memory");
+    return r0;
+}
+
+static inline long vlibc_syscall6(long n, long a1, long a2, long a3, long a4,
+                                  long a5, long a6)
+{
+    register long nr __asm__(VLIBC_SC_NR) = n;
+    register long r0 __asm__(VLIBC_SC_A(0)) = a1;
+    register long r1 __asm__(VLIBC_SC_A(1)) = a2;
+    register long r2 __asm__(VLIBC_SC_A(2)) = a3;
+    register long r3 __asm__(VLIBC_SC_A(3)) = a4;
+    register long r4 __asm__(VLIBC_SC_A(4)) = a5;
+    register long r5 __asm__(VLIBC_SC_A(5)) = a6;
+    __asm__ volatile (VLIBC_SC_INSN : "+r" (r0)
+                      : "r" (nr), "r" (r1), "r" (r2), "r" (r3), "r" (r4),
+                        "r" (r5)
+                      : "memory");
+    return r0;
+}
+
+#undef VLIBC_SC_NR
+#undef VLIBC_SC_A
+#undef VLIBC_SC_INSN
+
+#else
+
+#define vlibc_syscall0(n) vlibc_syscall((n), 0, 0, 0, 0, 0, 0)
+#define vlibc_syscall1(n, a) vlibc_syscall((n), (a), 0, 0, 0, 0, 0)
+#define vlibc_syscall2(n, a, b) vlibc_syscall((n), (a), (b), 0, 0, 0, 0)
+#define vlibc_syscall3(n, a, b, c) vlibc_syscall((n), (a), (b), (c), 0, 0, 0)
+#define vlibc_syscall4(n, a, b, c, d) \
+    vlibc_syscall((n), (a), (b), (c), (d), 0, 0)
+#define vlibc_syscall5(n, a, b, c, d, e) \
+    vlibc_syscall((n), (a), (b), (c), (d), (e), 0)
+#define vlibc_syscall6(n, a, b, c, d, e, f) \
+    vlibc_syscall((n), (a), (b), (c), (d), (e), (f))
+
+#endif
+
 #endif
@@ -7,6 +7,7 @@
 #define SYSLOG_H
 
 #include <stdarg.h>
+#include <stddef.h>
 
 /* syslog priorities */
 #define LOG_EMERG   0
@@ -41,4 +42,32 @@ void vsyslog(int priority, const char *format, va_list ap);
 void syslog(int priority, const char *format, ...);
 void closelog(void);
 
+/*
+ * Asynchronous logging (vlibc extension). After vlibc_syslog_async()
+ * messages are queued in a ring buffer and sent in batches by a
+ * background thread. The policy decides what happens when the ring
+ * is full.
+ */
+#define VLIBC_SYSLOG_DROP  0   /* discard the message and count it */
+#define VLIBC_SYSLOG_BLOCK 1   /* wait for the sender to make room */
+#define VLIBC_SYSLOG_SYNC  2   /* send it directly from the caller */
+
+struct vlibc_syslog_config {
+    size_t ring_size;          /* bytes, rounded up to a power of two; 0 for 256 KiB */
+    int policy;                /* VLIBC_SYSLOG_* */
+    const char *path;          /* logger socket, NULL for /dev/log */
+};
+
+struct vlibc_syslog_stats {
+    unsigned long long queued;     /* accepted into the ring */
+    unsigned long long sent;       /* handed to the socket */
+    unsigned long long dropped;    /* discarded while the ring was full */
+    unsigned long long failed;     /* rejected by the socket */
+    unsigned long long truncated;  /* cut to the maximum record size */
+};
+
+int vlibc_syslog_async(const struct vlibc_syslog_config *cfg);
+int vlibc_syslog_flush(void);
+void vlibc_syslog_stats(struct vlibc_syslog_stats *st);
+
 #endif /* SYSLOG_H */
@@ -59,6 +59,8 @@ struct tm {
     int tm_wday;  /* days since Sunday [0,6] */
     int tm_yday;  /* days since January 1 [0,365] */
 int tm_isdst; /* daylight savings time flag */
+    long tm_gmtoff;       /* seconds east of UTC */
+    const char *tm_zone;  /* time zone abbreviation */
 };
 
 #ifndef __clock_t_defined
@@ -203,6 +205,17 @@ int timer_gettime(timer_t timerid, struct itimerspec *curr_value);
 size_t strftime(char *s, size_t max, const char *format, const struct tm *tm);
 char *strptime(const char *s, const char *format, struct tm *tm);
 
+/*
+ * Precompiled strftime formats. A compiled program skips parsing the
+ * format and reuses the unchanged fields of the previous result in the
+ * calling thread, which suits log prefixes formatted once per line.
+ */
+typedef struct vlibc_strftime_fmt vlibc_strftime_fmt;
+vlibc_strftime_fmt *vlibc_strftime_compile(const char *format);
+size_t vlibc_strftime_exec(char *s, size_t max, const vlibc_strftime_fmt *f,
+                           const struct tm *tm);
+void vlibc_strftime_free(vlibc_strftime_fmt *f);
+
 /* basic time conversion helpers */
 struct tm *gmtime(const time_t *timep);
 /*
@@ -221,11 +234,11 @@ struct tm *gmtime_r(const time_t *timep, struct tm *result);
 struct tm *localtime_r(const time_t *timep, struct tm *result);
 /*
  * Reload timezone information from the TZ environment variable or
- * /etc/localtime and apply the configured offset when converting
- * times.
+ * /etc/localtime. TZ may name a zoneinfo file or hold a POSIX TZ
+ * string such as "CET-1CEST,M3.5.0,M10.5.0/3".
  */
 void tzset(void);
-/* Current timezone offset in seconds east of UTC. */
+/* Offset in seconds east of UTC in effect when the zone was loaded. */
 extern int __vlibc_tzoff;
 time_t mktime(struct tm *tm);
 /* Convert a broken-down UTC time to seconds since the epoch. */
@@ -8,32 +8,78 @@
 
 #include "signal.h"
 #include <stdarg.h>
+#include <stddef.h>
 
-#ifdef VLIBC_HAS_SYS_UCONTEXT
+#if defined(VLIBC_HAS_SYS_UCONTEXT) && !defined(VLIBC_NATIVE_UCONTEXT)
 #include_next <ucontext.h>
 #else
 #include <setjmp.h>
 
+/*
+ * Machine state kept by vlibc's context switch: the callee-saved
+ * registers, the resume address and the floating-point control word.
+ * The assembly in src/ucontext.c relies on this layout.
+ */
+#if defined(__x86_64__)
+typedef struct {
+    unsigned long    rbx, rbp, r12, r13, r14, r15;
+    unsigned long    rsp, rip;
+    unsigned int     mxcsr;
+    unsigned short   fpcw;
+} mcontext_t;
+#define VLIBC_HAVE_MCONTEXT 1
+#elif defined(__aarch64__)
+typedef struct {
+    unsigned long    x[11];     /* x19-x29 */
+    unsigned long    sp, pc;
+    double           d[8];      /* d8-d15 */
+    unsigned long    fpcr;
+} mcontext_t;
+#define VLIBC_HAVE_MCONTEXT 1
+#elif defined(__arm__)
+typedef struct {
+    unsigned long    r[8];      /* r4-r11 */
+    unsigned long    sp, pc;
+    double           d[8];      /* d8-d15 */
+    unsigned long    fpscr;
+} mcontext_t;
+#define VLIBC_HAVE_MCONTEXT 1
+#endif
+
 typedef struct ucontext {
+#ifdef VLIBC_HAVE_MCONTEXT
+    mcontext_t       uc_mcontext;
+#endif
+    sigset_t         uc_sigmask;
     struct ucontext *uc_link;
     stack_t          uc_stack;
-    sigset_t         uc_sigmask;
     void (*uc_func)(void);
     int              uc_argc;
     long             uc_args[6];
-#if defined(__x86_64__)
-    unsigned long    rbx, rbp, r12, r13, r14, r15;
-    unsigned long    rsp, rip;
-#else
+#ifndef VLIBC_HAVE_MCONTEXT
     jmp_buf          __jmpbuf;
 #endif
 } ucontext_t;
 #endif
-#ifndef VLIBC_HAS_SYS_UCONTEXT
+#if !defined(VLIBC_HAS_SYS_UCONTEXT) || defined(VLIBC_NATIVE_UCONTEXT)
 int getcontext(ucontext_t *ucp);
 int setcontext(const ucontext_t *ucp);
 void makecontext(ucontext_t *ucp, void (*func)(void), int argc, ...);
 int swapcontext(ucontext_t *oucp, const ucontext_t *ucp);
 #endif
 
+/*
+ * vlibc_swapcontext_nosig() behaves like swapcontext() but leaves the
+ * signal mask alone, so a switch costs no system call. Both contexts
+ * must use the same mask.
+ */
+int vlibc_swapcontext_nosig(ucontext_t *oucp, const ucontext_t *ucp);
+
+/*
+ * Allocate a stack for makecontext() with an inaccessible guard page
+ * below it, filling in ss_sp and ss_size. vlibc_stack_free() releases it.
+ */
+int vlibc_stack_alloc(stack_t *ss, size_t size);
+void vlibc_stack_free(stack_t *ss);
+
 #endif /* UCONTEXT_H */
@@ -53,6 +53,13 @@ char *crypt(const char *key, const char *salt);
 char *ttyname(int fd);
 int ttyname_r(int fd, char *buf, size_t len);
 void sync(void);
+/*
+ * Copy len bytes between two files inside the kernel, sharing extents
+ * when the filesystem supports it. NULL offsets use and advance the
+ * file positions. Returns bytes copied, 0 at end of file, or -1.
+ */
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out,
+                        off_t *off_out, size_t len, unsigned int flags);
 
 #ifndef STDIN_FILENO
 #define STDIN_FILENO 0
@@ -0,0 +1,54 @@
+/*
+ * BSD 2-Clause License
+ *
+ * Purpose: Declarations for the vlibc coroutine runtime.
+ */
+#ifndef VCO_H
+#define VCO_H
+
+#include <stddef.h>
+
+/*
+ * Stackful coroutines multiplexed over a pool of worker threads. Each
+ * worker keeps its own run queue and idle workers steal from the others.
+ * A coroutine may resume on a different thread after any switch point
+ * (vco_yield, vco_join, vco_wait_fd or a read/write that would block).
+ */
+typedef struct vco vco_t;
+
+/* Start nworkers threads (0 = one per CPU) using stacks of stack_size
+ * bytes (0 = 64 KiB). Called implicitly by the first vco_spawn(). */
+int vco_init(int nworkers, size_t stack_size);
+
+/* Wait for every coroutine to finish, then stop the workers. */
+void vco_shutdown(void);
+
+/* Create a coroutine running fn(arg). Every coroutine must be joined. */
+vco_t *vco_spawn(void *(*fn)(void *), void *arg);
+
+/* Let other coroutines run. Outside a coroutine this is sched_yield(). */
+void vco_yield(void);
+
+/* Wait for co to finish, store its return value and release it. */
+int vco_join(vco_t *co, void **retval);
+
+/* Return the running coroutine or NULL when called from a plain thread. */
+vco_t *vco_self(void);
+
+/*
+ * Park the running coroutine until fd reports one of the POLLIN/POLLOUT
+ * events. read() and write() call this automatically when a descriptor
+ * attached with vco_fd_attach() returns EAGAIN inside a coroutine.
+ */
+int vco_wait_fd(int fd, int events);
+
+/*
+ * Put fd in non-blocking mode and let read() and write() inside
+ * coroutines park on it instead of failing with EAGAIN. Descriptors the
+ * program made non-blocking itself still report EAGAIN unless attached.
+ * vco_fd_detach() restores the previous flags; call it before close().
+ */
+int vco_fd_attach(int fd);
+int vco_fd_detach(int fd);
+
+#endif /* VCO_H */
@@ -78,6 +78,20 @@ wint_t btowc(int c);
 /* Convert wide character to single byte */
 int wctob(wchar_t wc);
 
+/* Bulk UTF-8 conversion (vlibc extensions) */
+/* Length of the longest valid UTF-8 prefix of s */
+size_t vlibc_utf8_valid(const char *s, size_t n);
+/* Number of code points in valid UTF-8 */
+size_t vlibc_utf8_count(const char *s, size_t n);
+/* UTF-8 to native-endian UTF-16; dst holds n units */
+size_t vlibc_utf8_to_utf16(uint16_t *dst, const char *src, size_t n);
+/* UTF-8 to UTF-32; dst holds n units */
+size_t vlibc_utf8_to_utf32(uint32_t *dst, const char *src, size_t n);
+/* UTF-16 to UTF-8; dst holds 3 * n bytes */
+size_t vlibc_utf16_to_utf8(char *dst, const uint16_t *src, size_t n);
+/* UTF-32 to UTF-8; dst holds 4 * n bytes */
+size_t vlibc_utf32_to_utf8(char *dst, const uint32_t *src, size_t n);
+
 /* Wide-string to number conversions */
 long wcstol(const wchar_t *nptr, wchar_t **endptr, int base);
 unsigned long wcstoul(const wchar_t *nptr, wchar_t **endptr, int base);
@@ -16,6 +16,35 @@ typedef int wint_t;
 
 typedef int wctype_t;
 
+/*
+ * Unicode properties of a code point. Stage 1 picks a block of 128
+ * code points by the high bits, stage 2 gives the record index for
+ * each code point in the block. Tables live in wctype_tables.c.
+ */
+#define __WCTYPE_ALPHA 0x100
+#define __WCTYPE_PRINT 0x200
+#define __WCTYPE_GRAPH 0x400
+
+struct __vlibc_wprop {
+    unsigned short flags;       /* __CTYPE_* and __WCTYPE_* bits */
+    signed char width;          /* wcwidth() result */
+    int lower;                  /* towlower() delta */
+    int upper;                  /* towupper() delta */
+};
+
+extern const struct __vlibc_wprop __vlibc_wprops[];
+extern const unsigned char __vlibc_wstage1[];
+extern const unsigned char __vlibc_wstage2[];
+
+static inline const struct __vlibc_wprop *__vlibc_wprop(wint_t wc)
+{
+    unsigned c = (unsigned)wc;
+    if (c >= 0x110000)
+        return &__vlibc_wprops[0];
+    return &__vlibc_wprops[__vlibc_wstage2[__vlibc_wstage1[c >> 7] * 128 +
+                                           (c & 127)]];
+}
+
 /* Test for alphabetic wide character */
 int iswalpha(wint_t wc);
 /* Test for decimal digit wide character */
@@ -0,0 +1,57 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the aux vector lookup for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "io.h"
+#include <fcntl.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <elf.h>
+#endif
+
+/*
+ * __vlibc_auxval() - return the value of aux vector entry type, or 0 when
+ * it is absent. vlibc does not keep the vector handed over at process
+ * start, so it is read back from /proc/self/auxv. Callers cache what
+ * they need.
+ */
+unsigned long __vlibc_auxval(unsigned long type)
+{
+#ifdef __linux__
+#ifdef O_CLOEXEC
+    int fd = open("/proc/self/auxv", O_RDONLY | O_CLOEXEC);
+#else
+    int fd = open("/proc/self/auxv", O_RDONLY);
+#endif
+    if (fd < 0)
+        return 0;
+
+    unsigned long val = 0;
+    int found = 0;
+    uintptr_t aux[2 * 16];
+    ssize_t n;
+    while (!found && (n = read(fd, aux, sizeof(aux))) > 0) {
+        /* /proc reads return whole entries */
+        for (size_t i = 0; i + 1 < (size_t)n / sizeof(uintptr_t); i += 2) {
+            if (aux[i] == AT_NULL) {
+                found = 1;
+                break;
+            }
+            if (aux[i] == type) {
+                val = aux[i + 1];
+                found = 1;
+                break;
+            }
+        }
+    }
+    close(fd);
+    return val;
+#else
+    (void)type;
+    return 0;
+#endif
+}
@@ -21,7 +21,7 @@
 int clock_getres(int clk_id, struct timespec *res)
 {
 #ifdef SYS_clock_getres
-    long ret = vlibc_syscall(SYS_clock_getres, clk_id, (long)res, 0, 0, 0, 0);
+    long ret = vlibc_syscall2(SYS_clock_getres, clk_id, (long)res);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -12,16 +12,26 @@
 #include <unistd.h>
 #include "syscall.h"
 
+extern int __vlibc_vdso_clock_gettime(int clk_id, struct timespec *ts);
+
 /*
- * Fetch the current time for the provided clock ID. When
- * SYS_clock_gettime is present the syscall is invoked. If not
- * available the function falls back to gettimeofday() which
- * only supplies CLOCK_REALTIME.
+ * Fetch the current time for the provided clock ID. The vDSO routine is
+ * used when the kernel provides one, otherwise SYS_clock_gettime is
+ * invoked. If neither is available the function falls back to
+ * gettimeofday() which only supplies CLOCK_REALTIME.
  */
 int clock_gettime(int clk_id, struct timespec *ts)
 {
+    int vret = __vlibc_vdso_clock_gettime(clk_id, ts);
+    if (vret != -ENOSYS) {
+        if (vret < 0) {
+            errno = -vret;
+            return -1;
+        }
+        return 0;
+    }
 #ifdef SYS_clock_gettime
-    long ret = vlibc_syscall(SYS_clock_gettime, clk_id, (long)ts, 0, 0, 0, 0);
+    long ret = vlibc_syscall2(SYS_clock_gettime, clk_id, (long)ts);
     if (ret < 0) {
         errno = -ret;
         return -1;
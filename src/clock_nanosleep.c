@@ -16,8 +16,8 @@ int clock_nanosleep(clockid_t clk_id, int flags,
                     const struct timespec *req, struct timespec *rem)
 {
 #ifdef SYS_clock_nanosleep
-    long ret = vlibc_syscall(SYS_clock_nanosleep, clk_id, flags,
-                             (long)req, (long)rem, 0);
+    long ret = vlibc_syscall4(SYS_clock_nanosleep, clk_id, flags,
+                              (long)req, (long)rem);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -13,7 +13,7 @@
 int clock_settime(int clk_id, const struct timespec *ts)
 {
 #ifdef SYS_clock_settime
-    long ret = vlibc_syscall(SYS_clock_settime, clk_id, (long)ts, 0, 0, 0, 0);
+    long ret = vlibc_syscall2(SYS_clock_settime, clk_id, (long)ts);
     if (ret < 0) {
         errno = -ret;
         return -1;
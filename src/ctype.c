@@ -8,7 +8,11 @@
 
 #include "ctype.h"
 
-const unsigned char __ctype_table[128] = {
+/*
+ * Bytes 0x80-0xFF have no class in the C locale; their entries are
+ * zero so the macros index the table without a range check.
+ */
+const unsigned char __ctype_table[256] = {
     /* 0x00-0x07 */ __CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,
     /* 0x08-0x0F */ __CTYPE_CNTRL,__CTYPE_CNTRL|__CTYPE_SPACE|__CTYPE_BLANK,__CTYPE_CNTRL|__CTYPE_SPACE,__CTYPE_CNTRL|__CTYPE_SPACE,__CTYPE_CNTRL|__CTYPE_SPACE,__CTYPE_CNTRL|__CTYPE_SPACE,__CTYPE_CNTRL,__CTYPE_CNTRL,
     /* 0x10-0x17 */ __CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,__CTYPE_CNTRL,
@@ -25,5 +29,6 @@ const unsigned char __ctype_table[128] = {
     /* 0x68-0x6F */ __CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,
     /* 0x70-0x77 */ __CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,
     /* 0x78-0x7F */ __CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_LOWER,__CTYPE_PUNCT,__CTYPE_PUNCT,__CTYPE_PUNCT,__CTYPE_PUNCT,__CTYPE_CNTRL
+    /* 0x80-0xFF are zero */
 };
 
@@ -6,27 +6,172 @@
  * Copyright (c) 2025
  */
 
-#define _GNU_SOURCE
-#include <dirent.h>
 #include "dirent.h"
-#undef opendir
-#undef readdir
-#undef closedir
+#include "dirwalk.h"
+#include "fcntl.h"
+#include "io.h"
+#include "memory.h"
+#include "string.h"
+#include "errno.h"
+#include "unistd.h"
+#include "sys/stat.h"
+#include <stdint.h>
+
+/*
+ * Native directory streams. The system DIR type is only used as an
+ * opaque handle; entries come from getdents64 into a buffer of
+ * VLIBC_DIRBUF_SIZE bytes unless vlibc_setdirbuf() picks another size.
+ * Where struct dirent has the getdents64 layout, readdir() returns the
+ * records in place, otherwise they are copied into ent.
+ */
+struct vlibc_dir {
+    int fd;
+    char *buf;
+    size_t size;
+    size_t pos;
+    size_t len;
+    long off;                   /* position after the last entry */
+    struct dirent ent;
+};
+
+#define DIRENT_IN_PLACE                                                   \
+    (sizeof(((struct dirent *)0)->d_ino) == 8 &&                          \
+     offsetof(struct dirent, d_reclen) ==                                 \
+         offsetof(struct vlibc_dirent64, d_reclen) &&                     \
+     offsetof(struct dirent, d_type) ==                                   \
+         offsetof(struct vlibc_dirent64, d_type) &&                       \
+     offsetof(struct dirent, d_name) ==                                   \
+         offsetof(struct vlibc_dirent64, d_name))
+
+/* Wrap an open directory descriptor in a stream. */
+DIR *vlibc_fdopendir(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return NULL;
+    if (!S_ISDIR(st.st_mode)) {
+        errno = ENOTDIR;
+        return NULL;
+    }
+    struct vlibc_dir *d = malloc(sizeof(*d));
+    if (!d) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    d->fd = fd;
+    d->buf = NULL;
+    d->size = VLIBC_DIRBUF_SIZE;
+    d->pos = 0;
+    d->len = 0;
+    d->off = 0;
+    return (DIR *)d;
+}
 
 /* Open a directory stream, returning a DIR handle. */
 DIR *vlibc_opendir(const char *name)
 {
-    return opendir(name);
+    int fd = open(name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    DIR *d = vlibc_fdopendir(fd);
+    if (!d) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+    }
+    return d;
+}
+
+/* Use a getdents64 buffer of size bytes; only before the first read. */
+int vlibc_setdirbuf(DIR *dirp, size_t size)
+{
+    struct vlibc_dir *d = (struct vlibc_dir *)dirp;
+    if (!d || d->buf || size < 1024) {
+        errno = EINVAL;
+        return -1;
+    }
+    d->size = size;
+    return 0;
 }
 
 /* Read the next directory entry from the stream. */
 struct dirent *vlibc_readdir(DIR *dirp)
 {
-    return readdir(dirp);
+    struct vlibc_dir *d = (struct vlibc_dir *)dirp;
+    if (d->pos >= d->len) {
+        if (!d->buf) {
+            d->buf = malloc(d->size);
+            if (!d->buf) {
+                errno = ENOMEM;
+                return NULL;
+            }
+        }
+        ssize_t n = getdents64(d->fd, d->buf, d->size);
+        if (n <= 0)
+            return NULL;
+        d->pos = 0;
+        d->len = (size_t)n;
+    }
+    struct vlibc_dirent64 *r = (struct vlibc_dirent64 *)(d->buf + d->pos);
+    d->pos += r->d_reclen;
+    d->off = (long)r->d_off;
+    if (DIRENT_IN_PLACE)
+        return (struct dirent *)r;
+
+    size_t nlen = strlen(r->d_name);
+    if (nlen >= sizeof(d->ent.d_name))
+        nlen = sizeof(d->ent.d_name) - 1;
+    d->ent.d_ino = (ino_t)r->d_ino;
+    d->ent.d_reclen = (unsigned short)sizeof(d->ent);
+    d->ent.d_type = r->d_type;
+#if defined(__FreeBSD__) || defined(__NetBSD__) || \
+    defined(__OpenBSD__) || defined(__DragonFly__)
+    d->ent.d_namlen = (uint16_t)nlen;
+#endif
+    memcpy(d->ent.d_name, r->d_name, nlen);
+    d->ent.d_name[nlen] = '\0';
+    return &d->ent;
 }
 
 /* Close a directory stream opened with vlibc_opendir(). */
 int vlibc_closedir(DIR *dirp)
 {
-    return closedir(dirp);
+    struct vlibc_dir *d = (struct vlibc_dir *)dirp;
+    if (!d) {
+        errno = EBADF;
+        return -1;
+    }
+    int r = close(d->fd);
+    free(d->buf);
+    free(d);
+    return r;
+}
+
+/* Return the descriptor behind a directory stream. */
+int vlibc_dirfd(DIR *dirp)
+{
+    return ((struct vlibc_dir *)dirp)->fd;
+}
+
+/* Current position, suitable for vlibc_seekdir(). */
+long vlibc_telldir(DIR *dirp)
+{
+    return ((struct vlibc_dir *)dirp)->off;
+}
+
+/* Continue reading at a position returned by vlibc_telldir(). */
+void vlibc_seekdir(DIR *dirp, long loc)
+{
+    struct vlibc_dir *d = (struct vlibc_dir *)dirp;
+    if (lseek(d->fd, (off_t)loc, SEEK_SET) < 0)
+        return;
+    d->pos = 0;
+    d->len = 0;
+    d->off = loc;
+}
+
+/* Restart reading from the first entry. */
+void vlibc_rewinddir(DIR *dirp)
+{
+    vlibc_seekdir(dirp, 0);
 }
@@ -0,0 +1,449 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the directory traversal core for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "dirwalk.h"
+#include "dirent.h"
+#include "fcntl.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "io.h"
+#include "unistd.h"
+#include <sys/syscall.h>
+#include "syscall.h"
+
+/* d_type values; identical on Linux and the BSDs */
+#define WALK_DT_UNKNOWN 0
+#define WALK_DT_DIR     4
+#define WALK_DT_LNK     10
+
+#define WALK_ROOT 0
+#define WALK_RUN  1
+#define WALK_DONE 2
+
+/*
+ * One open (or fully read) directory on the current path. Buffers stay
+ * with their depth and are reused by every sibling directory below it.
+ */
+struct vlibc_walkframe {
+    struct vlibc_dirreader rd;  /* rd.fd is -1 once the listing is slurped */
+    char *buf;
+    size_t bufsize;
+    size_t pathlen;
+    size_t base;
+    int level;
+    int nostat;
+    struct stat st;
+};
+
+#if defined(__FreeBSD__) || defined(__NetBSD__) || \
+    defined(__OpenBSD__) || defined(__DragonFly__)
+/*
+ * BSD: read native records with getdirentries() and repack them in place
+ * into the getdents64 layout, which is never larger.
+ */
+static long read_dirents(int fd, char *buf, size_t len)
+{
+    extern int host_getdirentries(int, char *, int, long *)
+        __asm__("getdirentries");
+    long base = 0;
+    int n = host_getdirentries(fd, buf, (int)len, &base);
+    if (n < 0)
+        return -errno;
+    size_t in = 0, out = 0;
+    while (in < (size_t)n) {
+        struct dirent *h = (struct dirent *)(buf + in);
+        size_t hreclen = h->d_reclen;
+        uint64_t ino = h->d_fileno;
+        unsigned char type = h->d_type;
+        size_t nlen = strlen(h->d_name);
+        size_t reclen = (offsetof(struct vlibc_dirent64, d_name) + nlen + 8)
+                        & ~(size_t)7;
+        struct vlibc_dirent64 *d = (struct vlibc_dirent64 *)(buf + out);
+        memmove(d->d_name, h->d_name, nlen + 1);
+        d->d_ino = ino;
+        d->d_off = 0;
+        d->d_reclen = (unsigned short)reclen;
+        d->d_type = type;
+        in += hreclen;
+        out += reclen;
+    }
+    return (long)out;
+}
+#else
+static long read_dirents(int fd, char *buf, size_t len)
+{
+#ifdef SYS_getdents64
+    return vlibc_syscall3(SYS_getdents64, fd, (long)buf, (long)len);
+#else
+    (void)fd; (void)buf; (void)len;
+    return -ENOSYS;
+#endif
+}
+#endif
+
+ssize_t getdents64(int fd, void *buf, size_t count)
+{
+    long ret = read_dirents(fd, buf, count);
+    if (ret < 0) {
+        errno = (int)-ret;
+        return -1;
+    }
+    return (ssize_t)ret;
+}
+
+void vlibc_dirreader_init(struct vlibc_dirreader *r, int fd, char *buf,
+                          size_t size)
+{
+    r->fd = fd;
+    r->buf = buf;
+    r->size = size;
+    r->pos = 0;
+    r->len = 0;
+}
+
+struct vlibc_dirent64 *vlibc_dirreader_next(struct vlibc_dirreader *r,
+                                            int *error)
+{
+    *error = 0;
+    for (;;) {
+        if (r->pos >= r->len) {
+            if (r->fd < 0)
+                return NULL;
+            long n = read_dirents(r->fd, r->buf, r->size);
+            if (n <= 0) {
+                if (n < 0)
+                    *error = (int)-n;
+                return NULL;
+            }
+            r->pos = 0;
+            r->len = (size_t)n;
+        }
+        struct vlibc_dirent64 *d = (struct vlibc_dirent64 *)(r->buf + r->pos);
+        r->pos += d->d_reclen;
+        const char *nm = d->d_name;
+        if (nm[0] == '.' && (!nm[1] || (nm[1] == '.' && !nm[2])))
+            continue;
+        return d;
+    }
+}
+
+static int path_reserve(struct vlibc_walk *w, size_t len)
+{
+    if (len < w->pathcap)
+        return 0;
+    size_t ncap = w->pathcap ? w->pathcap : 256;
+    while (ncap <= len)
+        ncap *= 2;
+    char *p = realloc(w->path, ncap);
+    if (!p)
+        return -1;
+    w->path = p;
+    w->pathcap = ncap;
+    return 0;
+}
+
+/* Read the rest of fd into f->buf, growing it, so fd can be closed. */
+static int frame_slurp(struct vlibc_walkframe *f, int fd)
+{
+    size_t len = 0;
+    for (;;) {
+        if (f->bufsize - len < 4096) {
+            char *nb = realloc(f->buf, f->bufsize * 2);
+            if (!nb)
+                return -1;
+            f->buf = nb;
+            f->bufsize *= 2;
+        }
+        long n = read_dirents(fd, f->buf + len, f->bufsize - len);
+        if (n < 0) {
+            errno = (int)-n;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        len += (size_t)n;
+    }
+    vlibc_dirreader_init(&f->rd, -1, f->buf, f->bufsize);
+    f->rd.len = len;
+    return 0;
+}
+
+/* Enter the directory w->ent describes, taking ownership of fd. */
+static int frame_push(struct vlibc_walk *w, int fd)
+{
+    if (w->depth == w->cap) {
+        size_t ncap = w->cap ? w->cap * 2 : 16;
+        struct vlibc_walkframe *nf = realloc(w->frames, ncap * sizeof(*nf));
+        if (!nf)
+            goto fail;
+        memset(nf + w->cap, 0, (ncap - w->cap) * sizeof(*nf));
+        w->frames = nf;
+        w->cap = ncap;
+    }
+    struct vlibc_walkframe *f = &w->frames[w->depth];
+    if (!f->buf) {
+        f->buf = malloc(VLIBC_DIRBUF_SIZE);
+        if (!f->buf)
+            goto fail;
+        f->bufsize = VLIBC_DIRBUF_SIZE;
+    }
+    if (w->nfds >= w->fdlimit) {
+        int r = frame_slurp(f, fd);
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        if (r < 0)
+            return -1;
+    } else {
+        vlibc_dirreader_init(&f->rd, fd, f->buf, f->bufsize);
+        w->nfds++;
+    }
+    f->pathlen = w->ent.pathlen;
+    f->base = w->ent.base;
+    f->level = w->ent.level;
+    f->nostat = w->ent.nostat;
+    f->st = w->ent.st;
+    w->depth++;
+    w->entered = 1;
+    return 0;
+fail:
+    close(fd);
+    errno = ENOMEM;
+    return -1;
+}
+
+static void frame_pop(struct vlibc_walk *w)
+{
+    struct vlibc_walkframe *f = &w->frames[--w->depth];
+    if (f->rd.fd >= 0) {
+        close(f->rd.fd);
+        f->rd.fd = -1;
+        w->nfds--;
+    }
+}
+
+static int open_dir(int flags, int root, int dirfd, const char *name)
+{
+    int fl = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    /* the root may be a symlink to follow; below it PHYS never follows */
+    if ((flags & VLIBC_WALK_PHYS) && !root)
+        fl |= O_NOFOLLOW;
+    return openat(dirfd, name, fl);
+}
+
+/*
+ * Fill type and stat data for NAME relative to DIRFD. Directories are
+ * opened and their descriptor stored in *fdout. Returns 0, or 1 when
+ * the entry lies on another filesystem than DEV and must be skipped.
+ */
+int __vlibc_walk_classify(int flags, int root, dev_t dev, int dirfd,
+                          const char *name, unsigned char dtype,
+                          uint64_t ino, struct vlibc_walkent *e, int *fdout)
+{
+    int phys = flags & VLIBC_WALK_PHYS;
+    int xdev = (flags & VLIBC_WALK_XDEV) && !root;
+    *fdout = -1;
+    e->error = 0;
+    e->nostat = 0;
+
+    /* d_type is enough unless a followed link or a device check needs more */
+    if ((flags & VLIBC_WALK_NOSTAT) && dtype != WALK_DT_UNKNOWN &&
+        (dtype != WALK_DT_LNK || phys) && !(xdev && dtype == WALK_DT_DIR)) {
+        memset(&e->st, 0, sizeof(e->st));
+        e->st.st_mode = (mode_t)dtype << 12;
+        e->st.st_ino = (ino_t)ino;
+        e->nostat = 1;
+        if (dtype == WALK_DT_LNK) {
+            e->type = VLIBC_WALK_SL;
+        } else if (dtype == WALK_DT_DIR) {
+            int fd = open_dir(flags, root, dirfd, name);
+            if (fd < 0) {
+                e->type = VLIBC_WALK_DNR;
+                e->error = errno;
+            } else {
+                e->type = VLIBC_WALK_D;
+                *fdout = fd;
+            }
+        } else {
+            e->type = VLIBC_WALK_F;
+        }
+        return 0;
+    }
+
+    /* known directories: open first and fstat the descriptor */
+    if (dtype == WALK_DT_DIR) {
+        int fd = open_dir(flags, root, dirfd, name);
+        if (fd >= 0) {
+            if (fstat(fd, &e->st) == 0) {
+                if (xdev && e->st.st_dev != dev) {
+                    close(fd);
+                    return 1;
+                }
+                e->type = VLIBC_WALK_D;
+                *fdout = fd;
+                return 0;
+            }
+            close(fd);
+        }
+    }
+
+    if (fstatat(dirfd, name, &e->st, phys ? AT_SYMLINK_NOFOLLOW : 0) < 0) {
+        int err = errno;
+        if (!phys && err == ENOENT &&
+            fstatat(dirfd, name, &e->st, AT_SYMLINK_NOFOLLOW) == 0 &&
+            S_ISLNK(e->st.st_mode)) {
+            e->type = VLIBC_WALK_SLN;
+            return 0;
+        }
+        memset(&e->st, 0, sizeof(e->st));
+        e->type = VLIBC_WALK_NS;
+        e->error = err;
+        errno = err;
+        return 0;
+    }
+    if (xdev && e->st.st_dev != dev)
+        return 1;
+    if (S_ISDIR(e->st.st_mode)) {
+        int fd = open_dir(flags, root, dirfd, name);
+        if (fd < 0) {
+            e->type = VLIBC_WALK_DNR;
+            e->error = errno;
+        } else {
+            e->type = VLIBC_WALK_D;
+            *fdout = fd;
+        }
+    } else if (S_ISLNK(e->st.st_mode)) {
+        struct stat sb;
+        e->type = fstatat(dirfd, name, &sb, 0) < 0 ? VLIBC_WALK_SLN
+                                                   : VLIBC_WALK_SL;
+    } else {
+        e->type = VLIBC_WALK_F;
+    }
+    return 0;
+}
+
+int vlibc_walk_open(struct vlibc_walk *w, const char *root, int flags,
+                    int fdlimit)
+{
+    memset(w, 0, sizeof(*w));
+    if (!root) {
+        errno = EINVAL;
+        return -1;
+    }
+    w->flags = flags;
+    w->fdlimit = fdlimit > 0 ? fdlimit : 1;
+    w->state = WALK_ROOT;
+    size_t len = strlen(root);
+    if (path_reserve(w, len) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(w->path, root, len + 1);
+    w->ent.pathlen = len;
+    return 0;
+}
+
+int vlibc_walk_next(struct vlibc_walk *w, struct vlibc_walkent **ent)
+{
+    struct vlibc_walkent *e = &w->ent;
+    int fd;
+
+    w->entered = 0;
+    if (w->state == WALK_DONE)
+        return 0;
+    if (w->state == WALK_ROOT) {
+        const char *slash = strrchr(w->path, '/');
+        e->path = w->path;
+        e->base = slash ? (size_t)(slash + 1 - w->path) : 0;
+        e->level = 0;
+        __vlibc_walk_classify(w->flags, 1, 0, AT_FDCWD, w->path,
+                              WALK_DT_UNKNOWN, 0, e, &fd);
+        w->state = WALK_RUN;
+        w->dev = e->st.st_dev;
+        if (fd >= 0 && frame_push(w, fd) < 0)
+            return -1;
+        *ent = e;
+        return 1;
+    }
+
+    while (w->depth) {
+        struct vlibc_walkframe *f = &w->frames[w->depth - 1];
+        int err;
+        struct vlibc_dirent64 *d = vlibc_dirreader_next(&f->rd, &err);
+        if (!d) {
+            if (err) {
+                errno = err;
+                return -1;
+            }
+            frame_pop(w);
+            if (!(w->flags & VLIBC_WALK_POST))
+                continue;
+            w->path[f->pathlen] = '\0';
+            e->pathlen = f->pathlen;
+            e->base = f->base;
+            e->level = f->level;
+            e->type = VLIBC_WALK_DP;
+            e->error = 0;
+            e->nostat = f->nostat;
+            e->st = f->st;
+            *ent = e;
+            return 1;
+        }
+
+        size_t plen = f->pathlen;
+        size_t add = plen && w->path[plen - 1] != '/' ? 1 : 0;
+        size_t nlen = strlen(d->d_name);
+        if (path_reserve(w, plen + add + nlen) < 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+        if (add)
+            w->path[plen] = '/';
+        memcpy(w->path + plen + add, d->d_name, nlen + 1);
+        e->path = w->path;
+        e->pathlen = plen + add + nlen;
+        e->base = plen + add;
+        e->level = f->level + 1;
+
+        /* slurped listings no longer have a descriptor: use the full path */
+        int dirfd = f->rd.fd >= 0 ? f->rd.fd : AT_FDCWD;
+        const char *name = f->rd.fd >= 0 ? d->d_name : w->path;
+        if (__vlibc_walk_classify(w->flags, 0, w->dev, dirfd, name,
+                                  d->d_type, d->d_ino, e, &fd))
+            continue;
+        if (fd >= 0 && frame_push(w, fd) < 0)
+            return -1;
+        *ent = e;
+        return 1;
+    }
+    w->state = WALK_DONE;
+    return 0;
+}
+
+void vlibc_walk_skip(struct vlibc_walk *w)
+{
+    if (w->entered) {
+        frame_pop(w);
+        w->entered = 0;
+    }
+}
+
+void vlibc_walk_close(struct vlibc_walk *w)
+{
+    int saved = errno;
+    while (w->depth)
+        frame_pop(w);
+    for (size_t i = 0; i < w->cap; i++)
+        free(w->frames[i].buf);
+    free(w->frames);
+    free(w->path);
+    memset(w, 0, sizeof(*w));
+    w->state = WALK_DONE;
+    errno = saved;
+}
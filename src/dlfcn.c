@@ -11,8 +11,12 @@
 #include "string.h"
 #include "io.h"
 #include "errno.h"
+#include "pthread.h"
+#include "stdlib.h"
+#include "sys/stat.h"
 #include <elf.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <sys/mman.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -24,59 +28,566 @@ struct dl_handle {
     Elf64_Sym *symtab;
     const char *strtab;
     size_t nsyms;
+    const uint32_t *sysv_hash;  /* DT_HASH table or NULL */
+    const uint32_t *gnu_hash;   /* DT_GNU_HASH table or NULL */
+    const Elf64_Rela *jmprel;   /* PLT relocations (DT_JMPREL) */
+    const uint16_t *versym;     /* DT_VERSYM table or NULL */
+    int global;                 /* opened with RTLD_GLOBAL */
     char *path;
     struct dl_handle *next;
 };
 
+/*
+ * Cache of symbols resolved through the global namespace. Entries point
+ * into the string table of the defining object, so the cache is flushed
+ * whenever the set of global objects changes.
+ */
+struct dl_cache_ent {
+    const char *name;
+    uint32_t hash;
+    void *addr;
+};
+
+#define DL_CACHE_SIZE 1024
+#define DL_PAGE_SIZE 4096
+
 static char dl_err[128];
 static struct dl_handle *dl_list;
+static struct dl_cache_ent dl_cache[DL_CACHE_SIZE];
+/* protects dl_list and dl_cache */
+static pthread_mutex_t dl_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void set_error(const char *msg);
 
-/* Apply relocation entries to the mapped object. */
-static int apply_relocs(struct dl_handle *h, Elf64_Rela *rela, size_t relasz)
+/* Hash function used by DT_GNU_HASH (Bernstein, h * 33 + c). */
+static uint32_t gnu_hash(const char *name)
+{
+    uint32_t h = 5381;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+        h = h * 33 + *p;
+    return h;
+}
+
+/* Hash function used by the System V DT_HASH table. */
+static uint32_t sysv_hash(const char *name)
+{
+    uint32_t h = 0;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        h = (h << 4) + *p;
+        uint32_t g = h & 0xf0000000u;
+        if (g)
+            h ^= g >> 24;
+        h &= ~g;
+    }
+    return h;
+}
+
+/*
+ * Return non-zero when symbol i of h is a definition that may satisfy a
+ * lookup. Versions marked hidden, such as the compatibility copies in
+ * the system C library, are skipped.
+ */
+static int sym_defined(const struct dl_handle *h, size_t i)
+{
+    const Elf64_Sym *sym = &h->symtab[i];
+    if (sym->st_shndx == SHN_UNDEF)
+        return 0;
+    if (h->versym && (h->versym[i] & 0x8000))
+        return 0;
+    unsigned char bind = ELF64_ST_BIND(sym->st_info);
+    return bind == STB_GLOBAL || bind == STB_WEAK || bind == STB_GNU_UNIQUE;
+}
+
+/*
+ * Count the symbols covered by a DT_GNU_HASH table. The count is one past
+ * the last chain entry reachable from the highest populated bucket.
+ */
+static size_t gnu_hash_nsyms(const uint32_t *ht)
+{
+    uint32_t nbuckets = ht[0];
+    uint32_t symoffset = ht[1];
+    uint32_t bloom_size = ht[2];
+    const uint32_t *buckets = ht + 4 + bloom_size * 2;
+    const uint32_t *chain = buckets + nbuckets;
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < nbuckets; i++)
+        if (buckets[i] > last)
+            last = buckets[i];
+    if (last < symoffset)
+        return symoffset;
+    while (!(chain[last - symoffset] & 1))
+        last++;
+    return (size_t)last + 1;
+}
+
+/*
+ * Find a defined symbol in h using its hash tables. gh is the GNU hash of
+ * name; the System V hash is only computed when the object lacks
+ * DT_GNU_HASH. Objects without either table are searched linearly.
+ */
+static const Elf64_Sym *find_sym(const struct dl_handle *h,
+                                 const char *name, uint32_t gh)
+{
+    if (!h->symtab || !h->strtab)
+        return NULL;
+
+    if (h->gnu_hash) {
+        const uint32_t *ht = h->gnu_hash;
+        uint32_t nbuckets = ht[0];
+        uint32_t symoffset = ht[1];
+        uint32_t bloom_size = ht[2];
+        uint32_t bloom_shift = ht[3];
+        const uint64_t *bloom = (const uint64_t *)(ht + 4);
+        const uint32_t *buckets = ht + 4 + bloom_size * 2;
+        const uint32_t *chain = buckets + nbuckets;
+        if (nbuckets == 0 || bloom_size == 0)
+            return NULL;
+
+        uint64_t word = bloom[(gh / 64) % bloom_size];
+        uint64_t mask = ((uint64_t)1 << (gh % 64)) |
+                        ((uint64_t)1 << ((gh >> bloom_shift) % 64));
+        if ((word & mask) != mask)
+            return NULL;
+
+        uint32_t idx = buckets[gh % nbuckets];
+        if (idx < symoffset)
+            return NULL;
+        for (;; idx++) {
+            uint32_t ch = chain[idx - symoffset];
+            if ((ch | 1) == (gh | 1)) {
+                const Elf64_Sym *sym = &h->symtab[idx];
+                if (sym_defined(h, idx) &&
+                    strcmp(h->strtab + sym->st_name, name) == 0)
+                    return sym;
+            }
+            if (ch & 1)
+                break;
+        }
+        return NULL;
+    }
+
+    if (h->sysv_hash) {
+        const uint32_t *ht = h->sysv_hash;
+        uint32_t nbucket = ht[0];
+        const uint32_t *bucket = ht + 2;
+        const uint32_t *chain = bucket + nbucket;
+        if (nbucket == 0)
+            return NULL;
+        for (uint32_t i = bucket[sysv_hash(name) % nbucket]; i != STN_UNDEF;
+             i = chain[i]) {
+            const Elf64_Sym *sym = &h->symtab[i];
+            if (sym_defined(h, i) &&
+                strcmp(h->strtab + sym->st_name, name) == 0)
+                return sym;
+        }
+        return NULL;
+    }
+
+    for (size_t i = 0; i < h->nsyms; i++) {
+        const Elf64_Sym *sym = &h->symtab[i];
+        if (sym_defined(h, i) && strcmp(h->strtab + sym->st_name, name) == 0)
+            return sym;
+    }
+    return NULL;
+}
+
+/*
+ * Fill h with the symbol tables of an image whose dynamic section is
+ * already mapped at bias. The system loader rewrites the addresses in
+ * the dynamic sections it processes, so entries below bias are taken as
+ * unrelocated offsets and others as absolute addresses.
+ */
+static void image_tables(struct dl_handle *h, const Elf64_Dyn *dyn,
+                         char *bias)
 {
+    memset(h, 0, sizeof(*h));
+    h->base = bias;
+    for (; dyn->d_tag != DT_NULL; dyn++) {
+        uintptr_t p = dyn->d_un.d_ptr;
+        if (p < (uintptr_t)bias)
+            p += (uintptr_t)bias;
+        if (dyn->d_tag == DT_SYMTAB)
+            h->symtab = (Elf64_Sym *)p;
+        else if (dyn->d_tag == DT_STRTAB)
+            h->strtab = (const char *)p;
+        else if (dyn->d_tag == DT_HASH)
+            h->sysv_hash = (const uint32_t *)p;
+        else if (dyn->d_tag == DT_GNU_HASH)
+            h->gnu_hash = (const uint32_t *)p;
+        else if (dyn->d_tag == DT_VERSYM)
+            h->versym = (const uint16_t *)p;
+    }
+    if (h->sysv_hash)
+        h->nsyms = h->sysv_hash[1];
+    else if (h->gnu_hash)
+        h->nsyms = gnu_hash_nsyms(h->gnu_hash);
+}
+
+/*
+ * The program's own dynamic section. DT_DEBUG in it points at the
+ * r_debug record where the system loader lists every object it mapped,
+ * the program first.
+ */
+extern Elf64_Dyn _DYNAMIC[] __attribute__((weak));
+
+struct dl_link_map {
+    Elf64_Addr l_addr;
+    char *l_name;
+    Elf64_Dyn *l_ld;
+    struct dl_link_map *l_next, *l_prev;
+};
+
+struct dl_r_debug {
+    int r_version;
+    struct dl_link_map *r_map;
+};
+
+/*
+ * Resolve name against the program and the libraries the system loader
+ * mapped for it, so objects we load can use the C library and symbols
+ * the program exports. *def receives the symbol name for the cache.
+ */
+static void *host_lookup(const char *name, uint32_t gh, const char **def)
+{
+    if (!_DYNAMIC)
+        return NULL;
+    const struct dl_r_debug *dbg = NULL;
+    for (const Elf64_Dyn *d = _DYNAMIC; d->d_tag != DT_NULL; d++)
+        if (d->d_tag == DT_DEBUG)
+            dbg = (const struct dl_r_debug *)d->d_un.d_ptr;
+
+    struct dl_link_map self = { 0, NULL, _DYNAMIC, NULL, NULL };
+    const struct dl_link_map *m = dbg && dbg->r_map ? dbg->r_map : &self;
+    for (; m; m = m->l_next) {
+        if (!m->l_ld)
+            continue;
+        struct dl_handle img;
+        image_tables(&img, m->l_ld, (char *)m->l_addr);
+        const Elf64_Sym *sym = find_sym(&img, name, gh);
+        if (!sym)
+            continue;
+        void *addr = (char *)img.base + sym->st_value;
+        if (ELF64_ST_TYPE(sym->st_info) == STT_GNU_IFUNC)
+            addr = ((void *(*)(void))addr)();
+        *def = img.strtab + sym->st_name;
+        return addr;
+    }
+    return NULL;
+}
+
+/*
+ * Resolve name in the global namespace (objects opened with RTLD_GLOBAL,
+ * in load order, then the program and its libraries). Results are
+ * remembered in dl_cache.
+ */
+static void *global_lookup(const char *name)
+{
+    uint32_t gh = gnu_hash(name);
+    size_t slot = gh & (DL_CACHE_SIZE - 1);
+
+    pthread_mutex_lock(&dl_lock);
+    struct dl_cache_ent *e = &dl_cache[slot];
+    if (e->name && e->hash == gh && strcmp(e->name, name) == 0) {
+        void *addr = e->addr;
+        pthread_mutex_unlock(&dl_lock);
+        return addr;
+    }
+
+    void *addr = NULL;
+    const char *def = NULL;
+    for (struct dl_handle *h = dl_list; h; h = h->next) {
+        if (!h->global)
+            continue;
+        const Elf64_Sym *sym = find_sym(h, name, gh);
+        if (sym) {
+            addr = (char *)h->base + sym->st_value;
+            def = h->strtab + sym->st_name;
+            break;
+        }
+    }
+    if (!addr)
+        addr = host_lookup(name, gh, &def);
+    if (addr) {
+        e->name = def;
+        e->hash = gh;
+        e->addr = addr;
+    }
+    pthread_mutex_unlock(&dl_lock);
+    return addr;
+}
+
+/* Drop every cached global lookup. Called with dl_lock held. */
+static void flush_cache(void)
+{
+    memset(dl_cache, 0, sizeof(dl_cache));
+}
+
+/*
+ * Address a relocation against symbol sym_index should use. Symbols
+ * defined by the object bind locally; undefined ones are looked up in
+ * the global namespace.
+ */
+static void *sym_address(struct dl_handle *h, Elf64_Xword sym_index)
+{
+    if (!h->symtab || sym_index >= h->nsyms)
+        return NULL;
+    Elf64_Sym *sym = &h->symtab[sym_index];
+    if (sym->st_shndx != SHN_UNDEF)
+        return (char *)h->base + sym->st_value;
+    return global_lookup(h->strtab + sym->st_name);
+}
+
+/*
+ * Relocation tables with at least this many entries are split across
+ * worker threads when relocating eagerly.
+ */
+#define DL_PARALLEL_MIN 65536
+#define DL_MAX_THREADS 8
+
 #ifdef __x86_64__
-    size_t n = relasz / sizeof(Elf64_Rela);
-    for (size_t i = 0; i < n; i++) {
-        Elf64_Addr *where = (Elf64_Addr *)((char *)h->base + rela[i].r_offset);
+/*
+ * Apply n relocations starting at rela. The first nrel entries are known
+ * to be R_X86_64_RELATIVE (they come from the DT_RELACOUNT prefix) and are
+ * handled in a tight loop. Returns NULL or a static error message.
+ */
+static const char *relocate_chunk(struct dl_handle *h, const Elf64_Rela *rela,
+                                  size_t n, size_t nrel)
+{
+    char *base = h->base;
+    for (size_t i = 0; i < nrel; i++)
+        *(Elf64_Addr *)(base + rela[i].r_offset) =
+            (Elf64_Addr)(base + rela[i].r_addend);
+
+    for (size_t i = nrel; i < n; i++) {
+        Elf64_Addr *where = (Elf64_Addr *)(base + rela[i].r_offset);
         Elf64_Xword type = ELF64_R_TYPE(rela[i].r_info);
         Elf64_Xword sym_index = ELF64_R_SYM(rela[i].r_info);
         switch (type) {
+        case R_X86_64_NONE:
+            break;
         case R_X86_64_RELATIVE:
-            *where = (Elf64_Addr)((char *)h->base + rela[i].r_addend);
+            *where = (Elf64_Addr)(base + rela[i].r_addend);
             break;
         case R_X86_64_64:
         case R_X86_64_GLOB_DAT:
         case R_X86_64_JUMP_SLOT:
             if (h->symtab && sym_index < h->nsyms) {
-                Elf64_Sym *sym = &h->symtab[sym_index];
-                *where = (Elf64_Addr)((char *)h->base + sym->st_value +
-                                      rela[i].r_addend);
+                char *addr = sym_address(h, sym_index);
+                if (!addr && ELF64_ST_BIND(h->symtab[sym_index].st_info) !=
+                             STB_WEAK)
+                    return "undefined symbol";
+                *where = (Elf64_Addr)(addr ? addr + rela[i].r_addend : 0);
             }
             break;
         default:
-            set_error("bad relocation");
-            return -1;
+            return "bad relocation";
+        }
+    }
+    return NULL;
+}
+
+struct reloc_job {
+    struct dl_handle *h;
+    const Elf64_Rela *rela;
+    size_t n;
+    size_t nrel;
+    const char *err;
+};
+
+static void *reloc_worker(void *arg)
+{
+    struct reloc_job *job = arg;
+    job->err = relocate_chunk(job->h, job->rela, job->n, job->nrel);
+    return NULL;
+}
+
+extern long __vlibc_usable_cpus(void);
+
+/* Number of threads to use for a table of n relocations. */
+static int reloc_threads(size_t n)
+{
+    if (n < DL_PARALLEL_MIN)
+        return 1;
+    long cpus = __vlibc_usable_cpus();
+    if (cpus < 1)
+        cpus = 1;
+    if (cpus > DL_MAX_THREADS)
+        cpus = DL_MAX_THREADS;
+    if ((size_t)cpus > n / (DL_PARALLEL_MIN / 4))
+        cpus = (long)(n / (DL_PARALLEL_MIN / 4));
+    return (int)cpus;
+}
+#endif
+
+/*
+ * Apply relocation entries to the mapped object. relacount is the number
+ * of leading RELATIVE entries advertised by DT_RELACOUNT. Large tables are
+ * divided into contiguous slices processed by worker threads; each entry
+ * writes a distinct location so the slices are independent.
+ */
+static int apply_relocs(struct dl_handle *h, Elf64_Rela *rela, size_t relasz,
+                        size_t relacount)
+{
+#ifdef __x86_64__
+    size_t n = relasz / sizeof(Elf64_Rela);
+    if (relacount > n)
+        relacount = n;
+
+    int nthreads = reloc_threads(n);
+    const char *err = NULL;
+    if (nthreads <= 1) {
+        err = relocate_chunk(h, rela, n, relacount);
+    } else {
+        struct reloc_job jobs[DL_MAX_THREADS];
+        pthread_t tids[DL_MAX_THREADS];
+        int started[DL_MAX_THREADS];
+        size_t per = (n + (size_t)nthreads - 1) / (size_t)nthreads;
+        for (int t = 0; t < nthreads; t++) {
+            size_t start = (size_t)t * per;
+            size_t end = start + per > n ? n : start + per;
+            jobs[t].h = h;
+            jobs[t].rela = rela + start;
+            jobs[t].n = end > start ? end - start : 0;
+            jobs[t].nrel = relacount > start ? relacount - start : 0;
+            if (jobs[t].nrel > jobs[t].n)
+                jobs[t].nrel = jobs[t].n;
+            jobs[t].err = NULL;
+            /* the calling thread handles slice 0 itself */
+            started[t] = t > 0 &&
+                         pthread_create(&tids[t], NULL, reloc_worker,
+                                        &jobs[t]) == 0;
+            if (t > 0 && !started[t])
+                reloc_worker(&jobs[t]);
         }
+        reloc_worker(&jobs[0]);
+        for (int t = 0; t < nthreads; t++) {
+            if (started[t])
+                pthread_join(tids[t], NULL);
+            if (!err)
+                err = jobs[t].err;
+        }
+    }
+    if (err) {
+        set_error(err);
+        return -1;
     }
     return 0;
 #else
     (void)h;
     (void)rela;
     (void)relasz;
+    (void)relacount;
     set_error("unsupported architecture");
     return -1;
 #endif
 }
 
-/* Simple pread replacement using lseek and read. */
-static ssize_t pread_fd(int fd, void *buf, size_t count, off_t offset)
+#ifdef __x86_64__
+/*
+ * Lazy PLT resolver. PLT0 pushes GOT[1] (the handle) after the PLT entry
+ * pushed the relocation index, then jumps through GOT[2] to this stub. It
+ * preserves the argument registers, asks __vlibc_dl_fixup() for the target
+ * and tail-jumps to it with the original arguments.
+ */
+__asm__(".text\n"
+        ".globl vlibc_dl_runtime_resolve\n"
+        ".type vlibc_dl_runtime_resolve,@function\n"
+        "vlibc_dl_runtime_resolve:\n"
+        "push %rbp\n"
+        "mov %rsp, %rbp\n"
+        "and $-16, %rsp\n"
+        "sub $192, %rsp\n"
+        "mov %rax, 0(%rsp)\n"
+        "mov %rcx, 8(%rsp)\n"
+        "mov %rdx, 16(%rsp)\n"
+        "mov %rsi, 24(%rsp)\n"
+        "mov %rdi, 32(%rsp)\n"
+        "mov %r8, 40(%rsp)\n"
+        "mov %r9, 48(%rsp)\n"
+        "movaps %xmm0, 64(%rsp)\n"
+        "movaps %xmm1, 80(%rsp)\n"
+        "movaps %xmm2, 96(%rsp)\n"
+        "movaps %xmm3, 112(%rsp)\n"
+        "movaps %xmm4, 128(%rsp)\n"
+        "movaps %xmm5, 144(%rsp)\n"
+        "movaps %xmm6, 160(%rsp)\n"
+        "movaps %xmm7, 176(%rsp)\n"
+        "mov 8(%rbp), %rdi\n"
+        "mov 16(%rbp), %rsi\n"
+        "call __vlibc_dl_fixup\n"
+        "mov %rax, %r11\n"
+        "mov 0(%rsp), %rax\n"
+        "mov 8(%rsp), %rcx\n"
+        "mov 16(%rsp), %rdx\n"
+        "mov 24(%rsp), %rsi\n"
+        "mov 32(%rsp), %rdi\n"
+        "mov 40(%rsp), %r8\n"
+        "mov 48(%rsp), %r9\n"
+        "movaps 64(%rsp), %xmm0\n"
+        "movaps 80(%rsp), %xmm1\n"
+        "movaps 96(%rsp), %xmm2\n"
+        "movaps 112(%rsp), %xmm3\n"
+        "movaps 128(%rsp), %xmm4\n"
+        "movaps 144(%rsp), %xmm5\n"
+        "movaps 160(%rsp), %xmm6\n"
+        "movaps 176(%rsp), %xmm7\n"
+        "mov %rbp, %rsp\n"
+        "pop %rbp\n"
+        "add $16, %rsp\n"
+        "jmp *%r11\n"
+        ".size vlibc_dl_runtime_resolve, .-vlibc_dl_runtime_resolve\n");
+extern void vlibc_dl_runtime_resolve(void);
+
+void *__vlibc_dl_fixup(struct dl_handle *h, size_t index);
+
+/*
+ * __vlibc_dl_fixup() - bind the JUMP_SLOT relocation at index in h's PLT
+ * relocation table on first call and return the resolved address. An
+ * unresolvable symbol is fatal, as there is no caller to report it to.
+ */
+void *__vlibc_dl_fixup(struct dl_handle *h, size_t index)
+{
+    const Elf64_Rela *r = &h->jmprel[index];
+    Elf64_Xword sym_index = ELF64_R_SYM(r->r_info);
+    char *addr = sym_address(h, sym_index);
+    if (!addr) {
+        static const char msg[] = "vlibc: lazy symbol lookup failed: ";
+        const char *name = h->strtab + h->symtab[sym_index].st_name;
+        write(2, msg, sizeof(msg) - 1);
+        write(2, name, strlen(name));
+        write(2, "\n", 1);
+        abort();
+    }
+    addr += r->r_addend;
+    *(Elf64_Addr *)((char *)h->base + r->r_offset) = (Elf64_Addr)addr;
+    return addr;
+}
+
+/*
+ * Prepare the PLT for lazy binding: point GOT[1]/GOT[2] at the handle and
+ * resolver and rebase each JUMP_SLOT so it initially targets its PLT
+ * stub. Any other relocation type in the table is applied immediately.
+ */
+static int setup_lazy(struct dl_handle *h, Elf64_Addr *got, size_t n)
 {
-    if (lseek(fd, offset, SEEK_SET) < 0)
-        return -1;
-    return read(fd, buf, count);
+    got[1] = (Elf64_Addr)h;
+    got[2] = (Elf64_Addr)vlibc_dl_runtime_resolve;
+    for (size_t i = 0; i < n; i++) {
+        const Elf64_Rela *r = &h->jmprel[i];
+        if (ELF64_R_TYPE(r->r_info) == R_X86_64_JUMP_SLOT) {
+            *(Elf64_Addr *)((char *)h->base + r->r_offset) +=
+                (Elf64_Addr)h->base;
+        } else {
+            const char *err = relocate_chunk(h, r, 1, 0);
+            if (err) {
+                set_error(err);
+                return -1;
+            }
+        }
+    }
+    return 0;
 }
+#endif
 
 /* Store an error message for retrieval by dlerror(). */
 static void set_error(const char *msg)
@@ -96,10 +607,13 @@ const char *dlerror(void)
     return dl_err;
 }
 
-/* Map the shared object located at filename into memory and return a handle. */
+/*
+ * Map the shared object located at filename into memory and return a handle.
+ * The file is mapped read-only once; headers are parsed in place and the
+ * loadable segments are copied into a private anonymous image.
+ */
 void *dlopen(const char *filename, int flag)
 {
-    (void)flag;
     dl_err[0] = '\0';
 
 #ifdef O_CLOEXEC
@@ -113,57 +627,56 @@ void *dlopen(const char *filename, int flag)
         return NULL;
     }
 
-    Elf64_Ehdr eh;
-    if (read(fd, &eh, sizeof(eh)) != sizeof(eh)) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Elf64_Ehdr)) {
         set_error("read header");
         close(fd);
         return NULL;
     }
-    if (eh.e_ident[EI_MAG0] != ELFMAG0 ||
-        eh.e_ident[EI_MAG1] != ELFMAG1 ||
-        eh.e_ident[EI_MAG2] != ELFMAG2 ||
-        eh.e_ident[EI_MAG3] != ELFMAG3 ||
-        eh.e_ident[EI_CLASS] != ELFCLASS64 ||
-        eh.e_type != ET_DYN) {
+    size_t file_size = (size_t)st.st_size;
+    char *file = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        set_error("mmap");
+        return NULL;
+    }
+
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr *)file;
+    if (eh->e_ident[EI_MAG0] != ELFMAG0 ||
+        eh->e_ident[EI_MAG1] != ELFMAG1 ||
+        eh->e_ident[EI_MAG2] != ELFMAG2 ||
+        eh->e_ident[EI_MAG3] != ELFMAG3 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+        eh->e_type != ET_DYN) {
         set_error("not a shared object");
-        close(fd);
+        munmap(file, file_size);
         return NULL;
     }
 #ifdef __x86_64__
-    if (eh.e_machine != EM_X86_64) {
+    if (eh->e_machine != EM_X86_64) {
         set_error("wrong architecture");
-        close(fd);
+        munmap(file, file_size);
         return NULL;
     }
 #else
     set_error("unsupported architecture");
-    close(fd);
+    munmap(file, file_size);
     return NULL;
 #endif
 
-    if (lseek(fd, eh.e_phoff, SEEK_SET) < 0) {
-        set_error("seek phdr");
-        close(fd);
-        return NULL;
-    }
-
-    Elf64_Phdr phdrs[16];
-    if (eh.e_phnum > 16) {
-        set_error("too many phdrs");
-        close(fd);
-        return NULL;
-    }
-
-    if (read(fd, phdrs, eh.e_phnum * sizeof(Elf64_Phdr)) != (ssize_t)(eh.e_phnum * sizeof(Elf64_Phdr))) {
+    if (eh->e_phentsize != sizeof(Elf64_Phdr) ||
+        eh->e_phoff > file_size ||
+        (size_t)eh->e_phnum * sizeof(Elf64_Phdr) > file_size - eh->e_phoff) {
         set_error("read phdrs");
-        close(fd);
+        munmap(file, file_size);
         return NULL;
     }
+    const Elf64_Phdr *phdrs = (const Elf64_Phdr *)(file + eh->e_phoff);
 
     Elf64_Addr min_vaddr = ~0ULL;
     Elf64_Addr max_vaddr = 0;
     Elf64_Addr dyn_vaddr = 0;
-    for (int i = 0; i < eh.e_phnum; i++) {
+    for (int i = 0; i < eh->e_phnum; i++) {
         if (phdrs[i].p_type == PT_LOAD) {
             if (phdrs[i].p_vaddr < min_vaddr)
                 min_vaddr = phdrs[i].p_vaddr;
@@ -173,41 +686,43 @@ void *dlopen(const char *filename, int flag)
             dyn_vaddr = phdrs[i].p_vaddr;
         }
     }
+    if (min_vaddr >= max_vaddr) {
+        set_error("no loadable segments");
+        munmap(file, file_size);
+        return NULL;
+    }
 
     size_t map_size = max_vaddr - min_vaddr;
     void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE | PROT_EXEC,
                      MAP_PRIVATE | MAP_ANON, -1, 0);
     if (map == MAP_FAILED) {
         set_error("mmap");
-        close(fd);
+        munmap(file, file_size);
         return NULL;
     }
 
     void *base = (char *)map - min_vaddr;
-    for (int i = 0; i < eh.e_phnum; i++) {
+    for (int i = 0; i < eh->e_phnum; i++) {
         if (phdrs[i].p_type != PT_LOAD)
             continue;
-        int prot = 0;
-        if (phdrs[i].p_flags & PF_R) prot |= PROT_READ;
-        if (phdrs[i].p_flags & PF_W) prot |= PROT_WRITE;
-        if (phdrs[i].p_flags & PF_X) prot |= PROT_EXEC;
-        void *seg_addr = (char *)base + phdrs[i].p_vaddr;
-        if (pread_fd(fd, seg_addr, phdrs[i].p_filesz, phdrs[i].p_offset) != (ssize_t)phdrs[i].p_filesz) {
+        if (phdrs[i].p_offset > file_size ||
+            phdrs[i].p_filesz > file_size - phdrs[i].p_offset ||
+            phdrs[i].p_filesz > phdrs[i].p_memsz) {
             munmap(map, map_size);
+            munmap(file, file_size);
             set_error("read segment");
-            close(fd);
             return NULL;
         }
-        if (phdrs[i].p_memsz > phdrs[i].p_filesz)
-            memset((char *)seg_addr + phdrs[i].p_filesz, 0, phdrs[i].p_memsz - phdrs[i].p_filesz);
-        mprotect(seg_addr, phdrs[i].p_memsz, prot);
+        /* the anonymous mapping is already zeroed, covering .bss */
+        void *seg_addr = (char *)base + phdrs[i].p_vaddr;
+        memcpy(seg_addr, file + phdrs[i].p_offset, phdrs[i].p_filesz);
     }
 
     struct dl_handle *h = malloc(sizeof(struct dl_handle));
     if (!h) {
         munmap(map, map_size);
+        munmap(file, file_size);
         set_error("nomem");
-        close(fd);
         return NULL;
     }
     h->mapping = map;
@@ -216,6 +731,11 @@ void *dlopen(const char *filename, int flag)
     h->symtab = NULL;
     h->strtab = NULL;
     h->nsyms = 0;
+    h->sysv_hash = NULL;
+    h->gnu_hash = NULL;
+    h->jmprel = NULL;
+    h->versym = NULL;
+    h->global = (flag & RTLD_GLOBAL) != 0;
     h->path = strdup(filename);
     h->next = NULL;
 
@@ -223,55 +743,118 @@ void *dlopen(const char *filename, int flag)
         Elf64_Dyn *dyn = (Elf64_Dyn *)((char *)base + dyn_vaddr);
         Elf64_Rela *rela = NULL;
         size_t relasz = 0;
+        size_t relacount = 0;
+        size_t pltrelsz = 0;
+        Elf64_Addr *got = NULL;
+        int bind_now = 0;
         size_t syment = sizeof(Elf64_Sym);
         for (; dyn->d_tag != DT_NULL; dyn++) {
             if (dyn->d_tag == DT_SYMTAB)
                 h->symtab = (Elf64_Sym *)((char *)base + dyn->d_un.d_ptr);
             else if (dyn->d_tag == DT_STRTAB)
                 h->strtab = (const char *)((char *)base + dyn->d_un.d_ptr);
-            else if (dyn->d_tag == DT_HASH) {
-                uint32_t *hash = (uint32_t *)((char *)base + dyn->d_un.d_ptr);
-                h->nsyms = hash[1];
-            } else if (dyn->d_tag == DT_SYMENT) {
+            else if (dyn->d_tag == DT_HASH)
+                h->sysv_hash = (const uint32_t *)((char *)base + dyn->d_un.d_ptr);
+            else if (dyn->d_tag == DT_GNU_HASH)
+                h->gnu_hash = (const uint32_t *)((char *)base + dyn->d_un.d_ptr);
+            else if (dyn->d_tag == DT_VERSYM)
+                h->versym = (const uint16_t *)((char *)base + dyn->d_un.d_ptr);
+            else if (dyn->d_tag == DT_SYMENT) {
                 syment = dyn->d_un.d_val;
             } else if (dyn->d_tag == DT_RELA) {
                 rela = (Elf64_Rela *)((char *)base + dyn->d_un.d_ptr);
             } else if (dyn->d_tag == DT_RELASZ) {
                 relasz = dyn->d_un.d_val;
+            } else if (dyn->d_tag == DT_RELACOUNT) {
+                relacount = dyn->d_un.d_val;
+            } else if (dyn->d_tag == DT_JMPREL) {
+                h->jmprel = (Elf64_Rela *)((char *)base + dyn->d_un.d_ptr);
+            } else if (dyn->d_tag == DT_PLTRELSZ) {
+                pltrelsz = dyn->d_un.d_val;
+            } else if (dyn->d_tag == DT_PLTGOT) {
+                got = (Elf64_Addr *)((char *)base + dyn->d_un.d_ptr);
+            } else if (dyn->d_tag == DT_BIND_NOW) {
+                bind_now = 1;
+            } else if (dyn->d_tag == DT_FLAGS) {
+                if (dyn->d_un.d_val & DF_BIND_NOW)
+                    bind_now = 1;
+            } else if (dyn->d_tag == DT_FLAGS_1) {
+                if (dyn->d_un.d_val & DF_1_NOW)
+                    bind_now = 1;
             }
         }
+        if (h->sysv_hash)
+            h->nsyms = h->sysv_hash[1];
+        else if (h->gnu_hash)
+            h->nsyms = gnu_hash_nsyms(h->gnu_hash);
         if (h->nsyms == 0 && h->symtab && h->strtab && syment)
             h->nsyms = ((char *)h->strtab - (char *)h->symtab) / syment;
-        if (rela && relasz) {
-            if (apply_relocs(h, rela, relasz) != 0) {
-                munmap(map, map_size);
-                free(h);
-                close(fd);
-                return NULL;
-            }
+        int err = 0;
+        if (rela && relasz)
+            err = apply_relocs(h, rela, relasz, relacount);
+        if (!err && h->jmprel && pltrelsz) {
+#ifdef __x86_64__
+            /* RTLD_NOW wins when both are given, as with glibc */
+            int lazy = (flag & RTLD_LAZY) && !(flag & RTLD_NOW) &&
+                       !bind_now && got;
+            if (lazy)
+                err = setup_lazy(h, got, pltrelsz / sizeof(Elf64_Rela));
+            else
+#endif
+                err = apply_relocs(h, (Elf64_Rela *)h->jmprel, pltrelsz, 0);
+        }
+        if (err) {
+            munmap(map, map_size);
+            munmap(file, file_size);
+            free(h->path);
+            free(h);
+            return NULL;
         }
     }
 
-    close(fd);
+    for (int i = 0; i < eh->e_phnum; i++) {
+        if (phdrs[i].p_type != PT_LOAD)
+            continue;
+        int prot = 0;
+        if (phdrs[i].p_flags & PF_R) prot |= PROT_READ;
+        if (phdrs[i].p_flags & PF_W) prot |= PROT_WRITE;
+        if (phdrs[i].p_flags & PF_X) prot |= PROT_EXEC;
+        uintptr_t start = (uintptr_t)base + phdrs[i].p_vaddr;
+        uintptr_t end = start + phdrs[i].p_memsz;
+        start &= ~(uintptr_t)(DL_PAGE_SIZE - 1);
+        mprotect((void *)start, end - start, prot);
+    }
+    munmap(file, file_size);
 
-    h->next = dl_list;
-    dl_list = h;
+    /* append so the global namespace is searched in load order */
+    pthread_mutex_lock(&dl_lock);
+    struct dl_handle **pp = &dl_list;
+    while (*pp)
+        pp = &(*pp)->next;
+    *pp = h;
+    if (h->global)
+        flush_cache();
+    pthread_mutex_unlock(&dl_lock);
 
     return h;
 }
 
-/* Look up the address of the named symbol in the given handle. */
+/*
+ * Look up the address of the named symbol in the given handle. Passing
+ * RTLD_DEFAULT searches every object opened with RTLD_GLOBAL, then the
+ * program and the libraries loaded with it.
+ */
 void *dlsym(void *handle, const char *symbol)
 {
+    if (!symbol)
+        return NULL;
+    if (handle == RTLD_DEFAULT)
+        return global_lookup(symbol);
     struct dl_handle *h = handle;
-    if (!h || !h->symtab || !h->strtab)
+    const Elf64_Sym *sym = find_sym(h, symbol, gnu_hash(symbol));
+    if (!sym)
         return NULL;
-    for (size_t i = 0; i < h->nsyms; i++) {
-        const char *name = h->strtab + h->symtab[i].st_name;
-        if (strcmp(name, symbol) == 0)
-            return (char *)h->base + h->symtab[i].st_value;
-    }
-    return NULL;
+    return (char *)h->base + sym->st_value;
 }
 
 /* Unload the shared object referenced by handle. */
@@ -280,11 +863,14 @@ int dlclose(void *handle)
     struct dl_handle *h = handle;
     if (!h)
         return -1;
+    pthread_mutex_lock(&dl_lock);
     struct dl_handle **pp = &dl_list;
     while (*pp && *pp != h)
         pp = &(*pp)->next;
     if (*pp == h)
         *pp = h->next;
+    flush_cache();
+    pthread_mutex_unlock(&dl_lock);
     munmap(h->mapping, h->map_size);
     free(h->path);
     free(h);
@@ -297,7 +883,9 @@ int dladdr(void *addr, Dl_info *info)
     if (!info)
         return 0;
 
-    for (struct dl_handle *h = dl_list; h; h = h->next) {
+    int found = 0;
+    pthread_mutex_lock(&dl_lock);
+    for (struct dl_handle *h = dl_list; h && !found; h = h->next) {
         char *start = h->base;
         char *end = (char *)h->base + h->map_size;
         if ((char *)addr >= start && (char *)addr < end) {
@@ -318,8 +906,50 @@ int dladdr(void *addr, Dl_info *info)
                     }
                 }
             }
-            return 1;
+            found = 1;
         }
     }
-    return 0;
+    pthread_mutex_unlock(&dl_lock);
+    return found;
+}
+
+/*
+ * Look up name in an ELF image that is already mapped, such as the vDSO
+ * the kernel places in every process. ehdr points at the image's ELF
+ * header; the load bias is derived from its first PT_LOAD segment.
+ */
+void *__vlibc_dl_image_sym(const void *ehdr, const char *name)
+{
+    const Elf64_Ehdr *eh = ehdr;
+    if (!eh || !name ||
+        memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+        eh->e_phentsize != sizeof(Elf64_Phdr))
+        return NULL;
+
+    const Elf64_Phdr *phdrs =
+        (const Elf64_Phdr *)((const char *)ehdr + eh->e_phoff);
+    const char *bias = NULL;
+    int have_load = 0;
+    Elf64_Addr dyn_vaddr = 0;
+    for (int i = 0; i < eh->e_phnum; i++) {
+        if (phdrs[i].p_type == PT_LOAD && !have_load) {
+            bias = (const char *)ehdr + phdrs[i].p_offset - phdrs[i].p_vaddr;
+            have_load = 1;
+        } else if (phdrs[i].p_type == PT_DYNAMIC) {
+            dyn_vaddr = phdrs[i].p_vaddr;
+        }
+    }
+    if (!have_load || !dyn_vaddr)
+        return NULL;
+
+    struct dl_handle h;
+    image_tables(&h, (const Elf64_Dyn *)(bias + dyn_vaddr), (char *)bias);
+    if (!h.sysv_hash && !h.gnu_hash)
+        return NULL;
+
+    const Elf64_Sym *sym = find_sym(&h, name, gnu_hash(name));
+    if (!sym || ELF64_ST_TYPE(sym->st_info) != STT_FUNC)
+        return NULL;
+    return (char *)h.base + sym->st_value;
 }
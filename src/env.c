@@ -9,7 +9,9 @@
 #include "env.h"
 #include "memory.h"
 #include "string.h"
+#include "pthread.h"
 #include <errno.h>
+#include <stdint.h>
 
 /* pointer to current environment */
 char **environ = 0;
@@ -17,6 +19,179 @@ char **environ = 0;
 static int environ_owned = 0;
 /* per-entry ownership flags when environ_owned */
 static unsigned char *environ_flags = 0;
+/* the array environ_owned refers to */
+static char **environ_array = 0;
+
+/*
+ * Hash index over environ, built by the first getenv() and kept in step
+ * by setenv(), putenv(), unsetenv() and clearenv(). Slots hold positions
+ * in environ and every hit is confirmed against the entry itself. The
+ * index also records the array and the count it was built from, so
+ * assigning environ directly or truncating it makes getenv() rebuild.
+ */
+struct env_slot {
+    uint32_t hash;
+    int32_t pos;           /* -1 when empty */
+};
+
+struct env_index {
+    char **env;            /* environ the index describes */
+    size_t count;          /* variables in env */
+    size_t mask;           /* slots - 1 */
+    struct env_slot slots[];
+};
+
+static struct env_index *env_idx;
+/*
+ * Index replaced by a getenv() rebuild, kept until the next one so a
+ * concurrent getenv() still probing it stays valid. The mutators below
+ * free the index outright: as with environ itself, getenv() is not safe
+ * against a concurrent setenv(), putenv(), unsetenv() or clearenv().
+ */
+static struct env_index *env_idx_retired;
+static pthread_mutex_t env_idx_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a over the name up to '=' or the end; *len receives its length */
+static uint32_t env_hash(const char *s, size_t *len)
+{
+    uint32_t h = 2166136261u;
+    const char *p = s;
+    while (*p && *p != '=')
+        h = (h ^ (unsigned char)*p++) * 16777619u;
+    *len = (size_t)(p - s);
+    return h;
+}
+
+static int env_index_valid(const struct env_index *x)
+{
+    if (!x || x->env != environ || !environ)
+        return 0;
+    if (x->count == 0)
+        return environ[0] == NULL;
+    return environ[x->count - 1] != NULL && environ[x->count] == NULL;
+}
+
+/* Slot holding NAME, or the empty slot where it would go. */
+static struct env_slot *env_index_probe(struct env_index *x, const char *name,
+                                        size_t len, uint32_t h)
+{
+    for (size_t i = h & x->mask;; i = (i + 1) & x->mask) {
+        struct env_slot *sl = &x->slots[i];
+        if (sl->pos < 0)
+            return sl;
+        if (sl->hash == h) {
+            /* entries cleared in place no longer match */
+            const char *e = x->env[sl->pos];
+            if (e && strncmp(e, name, len) == 0 && e[len] == '=')
+                return sl;
+        }
+    }
+}
+
+/* Record position POS; the first of duplicate names wins as in a scan. */
+static void env_index_add(struct env_index *x, int pos)
+{
+    size_t len;
+    uint32_t h = env_hash(x->env[pos], &len);
+    if (x->env[pos][len] != '=')
+        return;
+    struct env_slot *sl = env_index_probe(x, x->env[pos], len, h);
+    if (sl->pos < 0) {
+        sl->hash = h;
+        sl->pos = pos;
+    }
+}
+
+static struct env_index *env_index_build(char **env, size_t count)
+{
+    size_t n = 16;
+    while (n < count * 2)
+        n <<= 1;
+    struct env_index *x = malloc(sizeof(*x) + n * sizeof(struct env_slot));
+    if (!x)
+        return NULL;
+    x->env = env;
+    x->count = count;
+    x->mask = n - 1;
+    for (size_t i = 0; i < n; i++)
+        x->slots[i].pos = -1;
+    for (size_t i = 0; i < count; i++)
+        env_index_add(x, (int)i);
+    return x;
+}
+
+/* Drop the index; the environment functions call this while they own it. */
+static void env_index_reset(void)
+{
+    free(env_idx);
+    free(env_idx_retired);
+    env_idx = NULL;
+    env_idx_retired = NULL;
+}
+
+/*
+ * Follow an append of one variable to the array now in environ. The
+ * index is dropped when it no longer matched the old array.
+ */
+static void env_index_append(char **oldenv, int pos)
+{
+    struct env_index *x = env_idx;
+    if (!x || x->env != oldenv || x->count != (size_t)pos) {
+        env_index_reset();
+        return;
+    }
+    x->env = environ;
+    x->count++;
+    if (x->count * 2 > x->mask + 1) {
+        struct env_index *nx = env_index_build(environ, x->count);
+        env_index_reset();
+        env_idx = nx;
+        return;
+    }
+    env_index_add(x, pos);
+}
+
+/*
+ * Follow the removal of position POS, called before later entries move
+ * down. The index is dropped when environ repeats the name further on.
+ */
+static void env_index_remove(int pos, const char *name, size_t len)
+{
+    struct env_index *x = env_idx;
+    if (!env_index_valid(x)) {
+        env_index_reset();
+        return;
+    }
+    for (int k = pos + 1; environ[k]; ++k) {
+        if (strncmp(environ[k], name, len) == 0 && environ[k][len] == '=') {
+            env_index_reset();
+            return;
+        }
+    }
+    size_t hl;
+    uint32_t h = env_hash(name, &hl);
+    struct env_slot *sl = env_index_probe(x, name, len, h);
+    if (sl->pos == pos) {
+        /* backward-shift deletion keeps probe chains intact */
+        size_t i = (size_t)(sl - x->slots), j = i;
+        for (;;) {
+            j = (j + 1) & x->mask;
+            if (x->slots[j].pos < 0)
+                break;
+            size_t home = x->slots[j].hash & x->mask;
+            if ((j > i && (home <= i || home > j)) ||
+                (j < i && home <= i && home > j)) {
+                x->slots[i] = x->slots[j];
+                i = j;
+            }
+        }
+        x->slots[i].pos = -1;
+    }
+    for (size_t k = 0; k <= x->mask; k++)
+        if (x->slots[k].pos > pos)
+            x->slots[k].pos--;
+    x->count--;
+}
 
 /*
  * env_init() - set the global environ pointer used by vlibc.
@@ -28,22 +203,22 @@ void env_init(char **envp)
     environ = envp;
     environ_owned = 0;
     environ_flags = 0;
+    environ_array = 0;
+    env_index_reset();
 }
 
 /*
- * getenv() - return the value associated with NAME or NULL
- * if the variable is not present.
+ * env_adopt() - forget ownership when the program assigned environ
+ * directly. The old array is leaked since its strings may still be in
+ * use.
  */
-char *getenv(const char *name)
+static void env_adopt(void)
 {
-    if (!environ || !name)
-        return NULL;
-    size_t len = strlen(name);
-    for (char **e = environ; *e; ++e) {
-        if (strncmp(*e, name, len) == 0 && (*e)[len] == '=')
-            return *e + len + 1;
+    if (environ_owned && environ != environ_array) {
+        environ_owned = 0;
+        environ_flags = 0;
+        environ_array = 0;
     }
-    return NULL;
 }
 
 /*
@@ -54,6 +229,14 @@ static int find_env_index(const char *name, size_t len)
 {
     if (!environ)
         return -1;
+    struct env_index *x = __atomic_load_n(&env_idx, __ATOMIC_ACQUIRE);
+    if (env_index_valid(x)) {
+        size_t hl;
+        uint32_t h = env_hash(name, &hl);
+        if (hl != len)
+            return -1;
+        return env_index_probe(x, name, len, h)->pos;
+    }
     for (int i = 0; environ[i]; ++i) {
         if (strncmp(environ[i], name, len) == 0 && environ[i][len] == '=')
             return i;
@@ -61,12 +244,56 @@ static int find_env_index(const char *name, size_t len)
     return -1;
 }
 
+/*
+ * getenv() - return the value associated with NAME or NULL
+ * if the variable is not present. The first call builds the hash
+ * index, after which lookups neither scan nor allocate.
+ */
+char *getenv(const char *name)
+{
+    if (!environ || !name)
+        return NULL;
+    struct env_index *x = __atomic_load_n(&env_idx, __ATOMIC_ACQUIRE);
+    if (!env_index_valid(x)) {
+        pthread_mutex_lock(&env_idx_lock);
+        x = env_idx;
+        if (!env_index_valid(x)) {
+            size_t count = 0;
+            while (environ[count])
+                count++;
+            struct env_index *nx = env_index_build(environ, count);
+            if (nx) {
+                free(env_idx_retired);
+                env_idx_retired = x;
+                __atomic_store_n(&env_idx, nx, __ATOMIC_RELEASE);
+            }
+            x = nx;
+        }
+        pthread_mutex_unlock(&env_idx_lock);
+    }
+    size_t len;
+    if (!x) {
+        len = strlen(name);
+        for (char **e = environ; *e; ++e) {
+            if (strncmp(*e, name, len) == 0 && (*e)[len] == '=')
+                return *e + len + 1;
+        }
+        return NULL;
+    }
+    uint32_t h = env_hash(name, &len);
+    if (name[len])
+        return NULL;
+    int pos = env_index_probe(x, name, len, h)->pos;
+    return pos < 0 ? NULL : x->env[pos] + len + 1;
+}
+
 /*
  * setenv() - add or update NAME with VALUE. If OVERWRITE is
  * zero, an existing variable is left unchanged.
  */
 int setenv(const char *name, const char *value, int overwrite)
 {
+    env_adopt();
     if (!name || strchr(name, '=')) {
         errno = EINVAL;
         return -1;
@@ -89,8 +316,11 @@ int setenv(const char *name, const char *value, int overwrite)
     entry[nlen + 1 + vlen] = '\0';
 
     if (idx >= 0) {
-        if (environ_owned)
-            free(environ[idx]);
+        if (environ_owned && environ_flags) {
+            if (environ_flags[idx])
+                free(environ[idx]);
+            environ_flags[idx] = 1;
+        }
         environ[idx] = entry;
         return 0;
     }
@@ -141,7 +371,9 @@ int setenv(const char *name, const char *value, int overwrite)
     }
     environ_owned = 1;
     environ = newenv;
+    environ_array = newenv;
     environ_flags = newflags;
+    env_index_append(oldenv, count);
     return 0;
 }
 
@@ -152,6 +384,7 @@ int setenv(const char *name, const char *value, int overwrite)
  */
 int putenv(const char *str)
 {
+    env_adopt();
     if (!str) {
         errno = EINVAL;
         return -1;
@@ -166,6 +399,11 @@ int putenv(const char *str)
 
     int idx = find_env_index(str, nlen);
     if (idx >= 0) {
+        if (environ_owned && environ_flags) {
+            if (environ_flags[idx])
+                free(environ[idx]);
+            environ_flags[idx] = 0;
+        }
         environ[idx] = (char *)str;
         return 0;
     }
@@ -213,7 +451,9 @@ int putenv(const char *str)
     }
     environ_owned = 1;
     environ = newenv;
+    environ_array = newenv;
     environ_flags = newflags;
+    env_index_append(oldenv, count);
     return 0;
 }
 
@@ -222,12 +462,14 @@ int putenv(const char *str)
  */
 int unsetenv(const char *name)
 {
+    env_adopt();
     if (!environ || !name || strchr(name, '='))
         return -1;
     size_t len = strlen(name);
     int idx = find_env_index(name, len);
     if (idx < 0)
         return 0;
+    env_index_remove(idx, name, len);
     if (environ_owned && environ_flags && environ_flags[idx])
         free(environ[idx]);
     int i;
@@ -247,9 +489,11 @@ int unsetenv(const char *name)
  */
 int clearenv(void)
 {
+    env_adopt();
     if (!environ)
         return 0;
     if (!environ_owned) {
+        env_index_reset();
         for (int i = 0; environ[i]; ++i)
             environ[i] = NULL;
         errno = 0;
@@ -266,6 +510,7 @@ int clearenv(void)
         return -1;
     }
 
+    env_index_reset();
     for (int i = 0; oldenv[i]; ++i) {
         if (oldflags && oldflags[i])
             free(oldenv[i]);
@@ -275,6 +520,7 @@ int clearenv(void)
 
     environ_owned = 1;
     environ = newenv;
+    environ_array = newenv;
     environ_flags = newflags;
     environ[0] = NULL;
     environ_flags[0] = 0;
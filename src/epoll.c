@@ -0,0 +1,106 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the epoll, eventfd, signalfd and timerfd functions for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "sys/epoll.h"
+#include "sys/eventfd.h"
+#include "sys/signalfd.h"
+#include "sys/timerfd.h"
+#include "errno.h"
+#include "io.h"
+#include <sys/syscall.h>
+#include "syscall.h"
+
+/*
+ * Linux wrappers. Newer architectures such as aarch64 only provide
+ * epoll_create1 and epoll_pwait, so the older calls are built on them.
+ * The kernel expects the size of its own signal set, not sizeof(sigset_t).
+ */
+#define KERNEL_SIGSET_SIZE 8
+
+static int sys_result(long ret)
+{
+    if (ret < 0) {
+        errno = (int)-ret;
+        return -1;
+    }
+    return (int)ret;
+}
+
+int epoll_create(int size)
+{
+    if (size <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return epoll_create1(0);
+}
+
+int epoll_create1(int flags)
+{
+    return sys_result(vlibc_syscall1(SYS_epoll_create1, flags));
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+    return sys_result(vlibc_syscall4(SYS_epoll_ctl, epfd, op, fd,
+                                     (long)event));
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+               int timeout)
+{
+    return epoll_pwait(epfd, events, maxevents, timeout, NULL);
+}
+
+int epoll_pwait(int epfd, struct epoll_event *events, int maxevents,
+                int timeout, const sigset_t *sigmask)
+{
+    return sys_result(vlibc_syscall6(SYS_epoll_pwait, epfd, (long)events,
+                                     maxevents, timeout, (long)sigmask,
+                                     KERNEL_SIGSET_SIZE));
+}
+
+int eventfd(unsigned int initval, int flags)
+{
+    return sys_result(vlibc_syscall2(SYS_eventfd2, initval, flags));
+}
+
+/* Read and reset the counter (or take one unit with EFD_SEMAPHORE). */
+int eventfd_read(int fd, eventfd_t *value)
+{
+    return read(fd, value, sizeof(*value)) == sizeof(*value) ? 0 : -1;
+}
+
+int eventfd_write(int fd, eventfd_t value)
+{
+    return write(fd, &value, sizeof(value)) == sizeof(value) ? 0 : -1;
+}
+
+int signalfd(int fd, const sigset_t *mask, int flags)
+{
+    return sys_result(vlibc_syscall4(SYS_signalfd4, fd, (long)mask,
+                                     KERNEL_SIGSET_SIZE, flags));
+}
+
+int timerfd_create(int clockid, int flags)
+{
+    return sys_result(vlibc_syscall2(SYS_timerfd_create, clockid, flags));
+}
+
+int timerfd_settime(int fd, int flags, const struct itimerspec *new_value,
+                    struct itimerspec *old_value)
+{
+    return sys_result(vlibc_syscall4(SYS_timerfd_settime, fd, flags,
+                                     (long)new_value, (long)old_value));
+}
+
+int timerfd_gettime(int fd, struct itimerspec *curr_value)
+{
+    return sys_result(vlibc_syscall2(SYS_timerfd_gettime, fd,
+                                     (long)curr_value));
+}
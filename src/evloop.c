@@ -0,0 +1,345 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the event loop for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "evloop.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "io.h"
+#include "time.h"
+#include <stdint.h>
+
+/*
+ * Descriptor watches are kept in an array indexed by fd. The epoll
+ * payload carries the fd and a generation count, so events that were
+ * already fetched for a descriptor removed by an earlier callback in the
+ * same batch are dropped.
+ *
+ * Timers hang off a hashed timing wheel of WHEEL_SLOTS one-millisecond
+ * buckets. Adding and cancelling are O(1). Each tick scans one bucket,
+ * whose timers more than a revolution away are skipped until due.
+ */
+
+#define WHEEL_SLOTS 256
+#define MAX_EVENTS  64
+
+struct fd_watch {
+    evloop_fd_cb cb;
+    void *arg;
+    uint32_t gen;
+    int active;
+};
+
+struct evloop_timer {
+    struct evloop_timer *prev, *next;
+    uint64_t expires;           /* absolute tick */
+    unsigned repeat;
+    evloop_timer_cb cb;
+    void *arg;
+    int due;                    /* taken off the wheel for dispatch */
+    int cancelled;
+};
+
+struct evloop {
+    int epfd;
+    struct fd_watch *fds;
+    size_t nfds_cap;
+    size_t nwatch;
+    struct evloop_timer *wheel[WHEEL_SLOTS];
+    size_t ntimers;
+    uint64_t tick;              /* last processed tick */
+    int stop;
+};
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+evloop_t *evloop_new(void)
+{
+    evloop_t *loop = calloc(1, sizeof(*loop));
+    if (!loop)
+        return NULL;
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        free(loop);
+        return NULL;
+    }
+    loop->tick = now_ms();
+    return loop;
+}
+
+void evloop_free(evloop_t *loop)
+{
+    if (!loop)
+        return;
+    for (size_t i = 0; i < WHEEL_SLOTS; i++) {
+        struct evloop_timer *t = loop->wheel[i];
+        while (t) {
+            struct evloop_timer *next = t->next;
+            free(t);
+            t = next;
+        }
+    }
+    close(loop->epfd);
+    free(loop->fds);
+    free(loop);
+}
+
+static struct fd_watch *watch_slot(evloop_t *loop, int fd)
+{
+    if (fd < 0) {
+        errno = EBADF;
+        return NULL;
+    }
+    if ((size_t)fd >= loop->nfds_cap) {
+        size_t ncap = loop->nfds_cap ? loop->nfds_cap : 64;
+        while (ncap <= (size_t)fd)
+            ncap *= 2;
+        struct fd_watch *n = realloc(loop->fds, ncap * sizeof(*n));
+        if (!n)
+            return NULL;
+        memset(n + loop->nfds_cap, 0,
+               (ncap - loop->nfds_cap) * sizeof(*n));
+        loop->fds = n;
+        loop->nfds_cap = ncap;
+    }
+    return &loop->fds[fd];
+}
+
+static int watch_ctl(evloop_t *loop, int op, int fd, unsigned events,
+                     uint32_t gen)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = (uint64_t)(uint32_t)fd | ((uint64_t)gen << 32);
+    return epoll_ctl(loop->epfd, op, fd, &ev);
+}
+
+int evloop_add_fd(evloop_t *loop, int fd, unsigned events, evloop_fd_cb cb,
+                  void *arg)
+{
+    if (!loop || !cb) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct fd_watch *w = watch_slot(loop, fd);
+    if (!w)
+        return -1;
+    if (w->active) {
+        errno = EEXIST;
+        return -1;
+    }
+    if (watch_ctl(loop, EPOLL_CTL_ADD, fd, events, w->gen + 1) != 0)
+        return -1;
+    w->gen++;
+    w->cb = cb;
+    w->arg = arg;
+    w->active = 1;
+    loop->nwatch++;
+    return 0;
+}
+
+int evloop_mod_fd(evloop_t *loop, int fd, unsigned events)
+{
+    if (!loop || fd < 0 || (size_t)fd >= loop->nfds_cap ||
+        !loop->fds[fd].active) {
+        errno = ENOENT;
+        return -1;
+    }
+    return watch_ctl(loop, EPOLL_CTL_MOD, fd, events, loop->fds[fd].gen);
+}
+
+int evloop_del_fd(evloop_t *loop, int fd)
+{
+    if (!loop || fd < 0 || (size_t)fd >= loop->nfds_cap ||
+        !loop->fds[fd].active) {
+        errno = ENOENT;
+        return -1;
+    }
+    /* the descriptor may already be closed; drop the watch regardless */
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+    loop->fds[fd].active = 0;
+    loop->fds[fd].gen++;
+    loop->nwatch--;
+    return 0;
+}
+
+static void wheel_insert(evloop_t *loop, struct evloop_timer *t)
+{
+    if (t->expires <= loop->tick)
+        t->expires = loop->tick + 1;
+    struct evloop_timer **slot = &loop->wheel[t->expires % WHEEL_SLOTS];
+    t->prev = NULL;
+    t->next = *slot;
+    if (*slot)
+        (*slot)->prev = t;
+    *slot = t;
+}
+
+static void wheel_remove(evloop_t *loop, struct evloop_timer *t)
+{
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        loop->wheel[t->expires % WHEEL_SLOTS] = t->next;
+    if (t->next)
+        t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+}
+
+evloop_timer_t *evloop_add_timer(evloop_t *loop, unsigned ms,
+                                 unsigned repeat_ms, evloop_timer_cb cb,
+                                 void *arg)
+{
+    if (!loop || !cb) {
+        errno = EINVAL;
+        return NULL;
+    }
+    struct evloop_timer *t = calloc(1, sizeof(*t));
+    if (!t)
+        return NULL;
+    t->expires = now_ms() + ms;
+    t->repeat = repeat_ms;
+    t->cb = cb;
+    t->arg = arg;
+    wheel_insert(loop, t);
+    loop->ntimers++;
+    return t;
+}
+
+void evloop_cancel_timer(evloop_t *loop, evloop_timer_t *t)
+{
+    if (!loop || !t || t->cancelled)
+        return;
+    if (t->due) {
+        /* released by the dispatcher, after its callback if running */
+        t->cancelled = 1;
+        return;
+    }
+    wheel_remove(loop, t);
+    loop->ntimers--;
+    free(t);
+}
+
+/* Milliseconds until the next timer is due, or -1 without timers. */
+static int next_timeout(evloop_t *loop, uint64_t now)
+{
+    if (!loop->ntimers)
+        return -1;
+    for (uint64_t k = loop->tick + 1; k <= loop->tick + WHEEL_SLOTS; k++) {
+        for (struct evloop_timer *t = loop->wheel[k % WHEEL_SLOTS]; t;
+             t = t->next)
+            if (t->expires <= k)
+                return k > now ? (int)(k - now) : 0;
+    }
+    /* nothing within one revolution: check back after it */
+    return WHEEL_SLOTS;
+}
+
+/* Run the timers whose ticks passed since the last call. */
+static int run_timers(evloop_t *loop, uint64_t now)
+{
+    int ran = 0;
+    if (now <= loop->tick)
+        return 0;
+    uint64_t first = loop->tick + 1;
+    if (now - loop->tick > WHEEL_SLOTS)
+        first = now - WHEEL_SLOTS + 1;
+
+    /* collect first so callbacks may add timers to these slots */
+    struct evloop_timer *due = NULL;
+    for (uint64_t k = first; k <= now; k++) {
+        struct evloop_timer *t = loop->wheel[k % WHEEL_SLOTS];
+        while (t) {
+            struct evloop_timer *next = t->next;
+            if (t->expires <= now) {
+                wheel_remove(loop, t);
+                t->due = 1;
+                t->next = due;
+                due = t;
+            }
+            t = next;
+        }
+    }
+    loop->tick = now;
+
+    while (due) {
+        struct evloop_timer *t = due;
+        due = t->next;
+        t->next = NULL;
+        if (!t->cancelled) {
+            t->cb(loop, t, t->arg);
+            ran++;
+        }
+        if (t->repeat && !t->cancelled) {
+            t->due = 0;
+            t->expires = now + t->repeat;
+            wheel_insert(loop, t);
+        } else {
+            loop->ntimers--;
+            free(t);
+        }
+    }
+    return ran;
+}
+
+int evloop_run_once(evloop_t *loop, int timeout_ms)
+{
+    if (!loop) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t now = now_ms();
+    int tmo = next_timeout(loop, now);
+    if (tmo < 0 || (timeout_ms >= 0 && timeout_ms < tmo))
+        tmo = timeout_ms;
+
+    struct epoll_event ev[MAX_EVENTS];
+    int n = epoll_wait(loop->epfd, ev, MAX_EVENTS, tmo);
+    if (n < 0 && errno != EINTR)
+        return -1;
+
+    int ran = 0;
+    for (int i = 0; i < n; i++) {
+        int fd = (int)(uint32_t)ev[i].data.u64;
+        uint32_t gen = (uint32_t)(ev[i].data.u64 >> 32);
+        if ((size_t)fd >= loop->nfds_cap)
+            continue;
+        struct fd_watch *w = &loop->fds[fd];
+        if (!w->active || w->gen != gen)
+            continue;
+        w->cb(loop, fd, ev[i].events, w->arg);
+        ran++;
+    }
+    return ran + run_timers(loop, now_ms());
+}
+
+int evloop_run(evloop_t *loop)
+{
+    if (!loop) {
+        errno = EINVAL;
+        return -1;
+    }
+    loop->stop = 0;
+    while (!loop->stop && (loop->nwatch || loop->ntimers)) {
+        if (evloop_run_once(loop, -1) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+void evloop_stop(evloop_t *loop)
+{
+    if (loop)
+        loop->stop = 1;
+}
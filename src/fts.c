@@ -7,79 +7,34 @@
  */
 
 #include "fts.h"
-#include "dirent.h"
+#include "dirwalk.h"
 #include "memory.h"
 #include "string.h"
 #include "errno.h"
-#include "unistd.h"
-#include <stdint.h>
-
-struct node {
-    struct node *next;
-    char *path;
-    int level;
-};
 
+/*
+ * Roots are walked one after another with the shared dirwalk core. The
+ * returned FTSENT lives in the handle and points into the walker's path
+ * buffer, so fts_read() allocates nothing per entry.
+ */
 struct _fts {
-    struct node *head;
-    struct node *tail;
-    FTSENT *cur;
+    char **roots;
+    size_t nroots;
+    size_t next;
+    int active;
+    struct vlibc_walk walk;
+    FTSENT ent;
     int options;
     int (*compar)(const FTSENT **, const FTSENT **);
 };
 
-/*
- * queue_push() - append a new path node to the internal traversal queue.
- *
- * PATH is duplicated and stored along with LEVEL indicating depth in the
- * hierarchy.  Returns 0 on success or -1 if memory allocation fails.
- */
-static int queue_push(FTS *fts, const char *path, int level)
-{
-    struct node *n = malloc(sizeof(*n));
-    if (!n) {
-        errno = ENOMEM;
-        return -1;
-    }
-    n->path = strdup(path);
-    if (!n->path) {
-        free(n);
-        errno = ENOMEM;
-        return -1;
-    }
-    n->level = level;
-    n->next = NULL;
-    if (fts->tail)
-        fts->tail->next = n;
-    else
-        fts->head = n;
-    fts->tail = n;
-    return 0;
-}
-
-/*
- * queue_pop() - remove and return the next queued path node.
- *
- * Returns a pointer to the node or NULL if the queue is empty.
- */
-static struct node *queue_pop(FTS *fts)
-{
-    struct node *n = fts->head;
-    if (n) {
-        fts->head = n->next;
-        if (!fts->head)
-            fts->tail = NULL;
-    }
-    return n;
-}
-
 /*
  * fts_open() - start a file hierarchy traversal.
  *
  * PATHS is a NULL terminated list of root paths to traverse. OPTIONS
  * controls traversal behaviour and COMPAR is an optional sorting
  * callback.  Returns a new FTS handle or NULL on allocation failure.
- * Paths are queued and returned incrementally by fts_read().
+ * Paths are copied and walked in order by fts_read().
  */
 FTS *fts_open(char * const *paths, int options,
               int (*compar)(const FTSENT **, const FTSENT **))
@@ -91,133 +46,99 @@ FTS *fts_open(char * const *paths, int options,
         return NULL;
     fts->options = options;
     fts->compar = compar;
-    for (size_t i = 0; paths[i]; i++) {
-        if (queue_push(fts, paths[i], 0) < 0) {
+    size_t n = 0;
+    while (paths[n])
+        n++;
+    fts->roots = calloc(n + 1, sizeof(char *));
+    if (!fts->roots) {
+        free(fts);
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        fts->roots[i] = strdup(paths[i]);
+        if (!fts->roots[i]) {
+            fts->nroots = i;
             fts_close(fts);
             errno = ENOMEM;
             return NULL;
         }
     }
+    fts->nroots = n;
     return fts;
 }
 
-/*
- * free_entry - release memory for one traversal entry.
- */
-static void free_entry(FTSENT *e)
+static int fts_info(const struct vlibc_walkent *e)
 {
-    if (!e)
-        return;
-    free(e->fts_path);
-    free(e);
+    switch (e->type) {
+    case VLIBC_WALK_D:
+        return FTS_D;
+    case VLIBC_WALK_DNR:
+        return FTS_DNR;
+    case VLIBC_WALK_NS:
+        return FTS_NS;
+    case VLIBC_WALK_SL:
+    case VLIBC_WALK_SLN:
+        return e->nostat ? FTS_NSOK : FTS_SL;
+    case VLIBC_WALK_DP:
+        return FTS_DP;
+    default:
+        return e->nostat ? FTS_NSOK : FTS_F;
+    }
 }
 
 /*
- * fts_read() - return the next entry from the traversal queue.
+ * fts_read() - return the next entry of the traversal.
  *
- * The returned FTSENT describes the next path in the hierarchy.  If a
- * directory is encountered its children are queued for later processing.
- * NULL is returned when traversal is complete or on allocation failure.
+ * Directories are entered right after they are returned, so the tree
+ * is visited depth first in directory order. NULL is returned when
+ * traversal is complete or on error with errno set.
  */
 FTSENT *fts_read(FTS *fts)
 {
     if (!fts)
         return NULL;
-    free_entry(fts->cur);
-    fts->cur = NULL;
-
-    struct node *n = queue_pop(fts);
-    if (!n)
-        return NULL;
-
-    struct stat st;
-    memset(&st, 0, sizeof(st));
-    int r;
-    if (fts->options & FTS_PHYSICAL)
-        r = lstat(n->path, &st);
-    else
-        r = stat(n->path, &st);
-
-    FTSENT *ent = calloc(1, sizeof(*ent));
-    if (!ent) {
-        free(n->path);
-        free(n);
-        return NULL;
-    }
-    ent->fts_path = n->path;
-    ent->fts_accpath = ent->fts_path;
-    char *name = strrchr(ent->fts_path, '/');
-    ent->fts_name = name ? name + 1 : ent->fts_path;
-    ent->fts_namelen = strlen(ent->fts_name);
-    ent->fts_level = n->level;
-    if (r < 0) {
-        ent->fts_info = FTS_NS;
-    } else if (S_ISDIR(st.st_mode)) {
-        ent->fts_info = FTS_D;
-    } else if (S_ISLNK(st.st_mode)) {
-        ent->fts_info = FTS_SL;
-    } else {
-        ent->fts_info = FTS_F;
-    }
-    if (r == 0)
-        ent->fts_stat = st;
-    else
-        memset(&ent->fts_stat, 0, sizeof(ent->fts_stat));
-
-    if (ent->fts_info == FTS_D) {
-        DIR *d = opendir(ent->fts_path);
-        if (!d) {
-            ent->fts_info = FTS_DNR;
-        } else {
-            struct dirent *e;
-            while ((e = readdir(d))) {
-                if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
-                    continue;
-                size_t len = strlen(ent->fts_path);
-                size_t add = len && ent->fts_path[len-1] != '/' ? 1 : 0;
-                size_t name_len = strlen(e->d_name);
-                if (len > SIZE_MAX - add - name_len - 1) {
-                    closedir(d);
-                    free_entry(ent);
-                    free(n);
-                    errno = ENAMETOOLONG;
-                    return NULL;
-                }
-                char *child = malloc(len + add + name_len + 1);
-                if (!child) {
-                    closedir(d);
-                    free_entry(ent);
-                    free(n);
-                    errno = ENOMEM;
-                    return NULL;
-                }
-                memcpy(child, ent->fts_path, len);
-                if (add)
-                    child[len] = '/';
-                memcpy(child + len + add, e->d_name, name_len + 1);
-                if (queue_push(fts, child, n->level + 1) < 0) {
-                    closedir(d);
-                    free(child);
-                    free_entry(ent);
-                    free(n);
-                    errno = ENOMEM;
-                    return NULL;
-                }
-                free(child);
-            }
-            closedir(d);
+    for (;;) {
+        if (!fts->active) {
+            if (fts->next == fts->nroots)
+                return NULL;
+            int wflags = 0;
+            if (fts->options & FTS_PHYSICAL)
+                wflags |= VLIBC_WALK_PHYS;
+            if (fts->options & FTS_NOSTAT)
+                wflags |= VLIBC_WALK_NOSTAT;
+            if (fts->options & FTS_XDEV)
+                wflags |= VLIBC_WALK_XDEV;
+            if (vlibc_walk_open(&fts->walk, fts->roots[fts->next++], wflags,
+                                VLIBC_WALK_FDLIMIT) < 0)
+                return NULL;
+            fts->active = 1;
         }
+        struct vlibc_walkent *e;
+        int r = vlibc_walk_next(&fts->walk, &e);
+        if (r < 0)
+            return NULL;
+        if (r == 0) {
+            vlibc_walk_close(&fts->walk);
+            fts->active = 0;
+            continue;
+        }
+        FTSENT *ent = &fts->ent;
+        ent->fts_path = (char *)e->path;
+        ent->fts_accpath = ent->fts_path;
+        ent->fts_name = ent->fts_path + e->base;
+        ent->fts_namelen = e->pathlen - e->base;
+        ent->fts_level = e->level;
+        ent->fts_info = fts_info(e);
+        ent->fts_stat = e->st;
+        return ent;
     }
-
-    free(n);
-    fts->cur = ent;
-    return ent;
 }
 
 /*
  * fts_close() - free all resources used by an FTS handle.
  *
- * Releases any queued paths and the current entry.  Returns 0 on
+ * Releases the walker state and the copied roots.  Returns 0 on
  * success or -1 if the provided handle is NULL.
  */
 int fts_close(FTS *fts)
@@ -226,13 +147,11 @@ int fts_close(FTS *fts)
         errno = EINVAL;
         return -1;
     }
-    free_entry(fts->cur);
-    struct node *n;
-    while ((n = queue_pop(fts))) {
-        free(n->path);
-        free(n);
-    }
+    if (fts->active)
+        vlibc_walk_close(&fts->walk);
+    for (size_t i = 0; i < fts->nroots; i++)
+        free(fts->roots[i]);
+    free(fts->roots);
     free(fts);
     return 0;
 }
-
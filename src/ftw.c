@@ -7,99 +7,8 @@
  */
 
 #include "ftw.h"
-#include "dirent.h"
-#include "string.h"
-#include "stdlib.h"
-#include "memory.h"
+#include "dirwalk.h"
 #include "errno.h"
-#include "unistd.h"
-#include "sys/stat.h"
-
-static int do_nftw(const char *path,
-                   nftw_func_t fn,
-                   int fdlimit, int flags, int level)
-{
-    struct stat st;
-    int r;
-
-    if (flags & FTW_PHYS)
-        r = lstat(path, &st);
-    else
-        r = stat(path, &st);
-
-    int type;
-    if (r < 0) {
-        type = FTW_NS;
-    } else if (S_ISDIR(st.st_mode)) {
-        type = FTW_D;
-    } else if (S_ISLNK(st.st_mode)) {
-        if (flags & FTW_PHYS) {
-            struct stat sb;
-            if (stat(path, &sb) < 0)
-                type = FTW_SLN;
-            else
-                type = FTW_SL;
-        } else {
-            type = FTW_SL;
-        }
-    } else {
-        type = FTW_F;
-    }
-
-    struct FTW info;
-    const char *base = strrchr(path, '/');
-    info.base = base ? (int)(base + 1 - path) : 0;
-    info.level = level;
-
-    if (!(flags & FTW_DEPTH) || type != FTW_D || level == 0) {
-        r = fn(path, &st, type, &info);
-        if (r != 0)
-            return r;
-    }
-
-    if (type == FTW_D) {
-        DIR *d = opendir(path);
-        if (!d)
-            return fn(path, &st, FTW_DNR, &info);
-        struct dirent *e;
-        while ((e = readdir(d))) {
-            if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
-                continue;
-            size_t len = strlen(path);
-            size_t add = len && path[len-1] != '/' ? 1 : 0;
-            size_t name_len = strlen(e->d_name);
-            if (len > SIZE_MAX - add - name_len - 1) {
-                closedir(d);
-                errno = ENAMETOOLONG;
-                return -1;
-            }
-            char *child = malloc(len + add + name_len + 1);
-            if (!child) {
-                closedir(d);
-                errno = ENOMEM;
-                return -1;
-            }
-            memcpy(child, path, len);
-            if (add)
-                child[len] = '/';
-            memcpy(child + len + add, e->d_name, name_len + 1);
-            r = do_nftw(child, fn, fdlimit, flags, level + 1);
-            free(child);
-            if (r != 0) {
-                closedir(d);
-                return r;
-            }
-        }
-        closedir(d);
-    }
-
-    if ((flags & FTW_DEPTH) && type == FTW_D) {
-        r = fn(path, &st, FTW_DP, &info);
-        if (r != 0)
-            return r;
-    }
-    return 0;
-}
 
 static ftw_func_t ftw_cb;
 
@@ -115,10 +24,26 @@ static int ftw_wrapper(const char *fpath, const struct stat *sb, int typeflag,
     return ftw_cb(fpath, sb, typeflag);
 }
 
+static int walk_flags(int flags)
+{
+    int wflags = 0;
+    if (flags & FTW_PHYS)
+        wflags |= VLIBC_WALK_PHYS;
+    if (flags & FTW_MOUNT)
+        wflags |= VLIBC_WALK_XDEV;
+    if (flags & FTW_DEPTH)
+        wflags |= VLIBC_WALK_POST;
+    if (flags & FTW_NOSTAT)
+        wflags |= VLIBC_WALK_NOSTAT;
+    return wflags;
+}
+
 /*
  * nftw() - walk a directory tree calling fn for each encountered file.
- * The fdlimit argument is ignored in this implementation.  Traversal is
- * performed by the internal do_nftw() helper which handles FTW_* flags.
+ * Traversal runs on the shared dirwalk core, which keeps at most fdlimit
+ * directories open and examines entries relative to their parent
+ * descriptor. FTW_MOUNT skips other filesystems and FTW_NOSTAT lets
+ * callbacks receive d_type-only stat data. FTW_CHDIR is ignored.
  */
 int nftw(const char *path, nftw_func_t fn, int fdlimit, int flags)
 {
@@ -126,8 +51,59 @@ int nftw(const char *path, nftw_func_t fn, int fdlimit, int flags)
         errno = EINVAL;
         return -1;
     }
-    (void)fdlimit;
-    return do_nftw(path, fn, fdlimit, flags, 0);
+    struct vlibc_walk w;
+    if (vlibc_walk_open(&w, path, walk_flags(flags), fdlimit) < 0)
+        return -1;
+    struct vlibc_walkent *e;
+    int r;
+    while ((r = vlibc_walk_next(&w, &e)) > 0) {
+        /* with FTW_DEPTH subdirectories are reported only as FTW_DP */
+        if ((flags & FTW_DEPTH) && e->type == VLIBC_WALK_D && e->level)
+            continue;
+        struct FTW info;
+        info.base = (int)e->base;
+        info.level = e->level;
+        r = fn(e->path, &e->st, e->type, &info);
+        if (r != 0)
+            break;
+    }
+    vlibc_walk_close(&w);
+    return r < 0 ? -1 : r;
+}
+
+struct nftw_par {
+    nftw_func_t fn;
+    int flags;
+};
+
+static int nftw_par_cb(const struct vlibc_walkent *e, int worker, void *arg)
+{
+    struct nftw_par *p = arg;
+    (void)worker;
+    if ((p->flags & FTW_DEPTH) && e->type == VLIBC_WALK_D && e->level)
+        return 0;
+    struct FTW info;
+    info.base = (int)e->base;
+    info.level = e->level;
+    return p->fn(e->path, &e->st, e->type, &info);
+}
+
+/*
+ * nftw_parallel() - nftw() spread over nthreads workers (0 = one per
+ * CPU). fn runs concurrently and must be thread safe; entries of one
+ * directory arrive in order, each directory before its contents and,
+ * with FTW_DEPTH, its FTW_DP after them.
+ */
+int nftw_parallel(const char *path, nftw_func_t fn, int fdlimit, int flags,
+                  int nthreads)
+{
+    if (!path || !fn) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct nftw_par p = { fn, flags };
+    return vlibc_pwalk(path, walk_flags(flags), nthreads, fdlimit,
+                       nftw_par_cb, &p);
 }
 
 /*
@@ -44,18 +44,51 @@
 
 static pthread_mutex_t gr_lock = { ATOMIC_VAR_INIT(0), PTHREAD_MUTEX_RECURSIVE, 0, 0 };
 
-#if defined(__FreeBSD__) || defined(__NetBSD__) || \
-    defined(__OpenBSD__) || defined(__DragonFly__)
+static __thread struct group gr_ent;
+static __thread char *gr_buf;
+static __thread size_t gr_cap;
 
-/* group_path() - return location of the group file */
-static const char *group_path(void)
+/*
+ * fetch() - run a reentrant lookup into a per-thread buffer, growing it
+ * until the entry fits.
+ */
+static struct group *fetch(const char *name, gid_t gid, int by_name)
 {
-    const char *p = getenv("VLIBC_GROUP");
-    if (p && *p)
-        return p;
-    return "/etc/group";
+    struct group *res = NULL;
+    for (;;) {
+        if (!gr_buf) {
+            gr_buf = malloc(1024);
+            if (!gr_buf)
+                return NULL;
+            gr_cap = 1024;
+        }
+        int r = by_name ? getgrnam_r(name, &gr_ent, gr_buf, gr_cap, &res)
+                        : getgrgid_r(gid, &gr_ent, gr_buf, gr_cap, &res);
+        if (r != ERANGE)
+            return r == 0 ? res : NULL;
+        char *tmp = realloc(gr_buf, gr_cap * 2);
+        if (!tmp)
+            return NULL;
+        gr_buf = tmp;
+        gr_cap *= 2;
+    }
+}
+
+/* getgrgid() - retrieve group entry by gid */
+struct group *getgrgid(gid_t gid)
+{
+    return fetch(NULL, gid, 0);
 }
 
+/* getgrnam() - retrieve group entry by name */
+struct group *getgrnam(const char *name)
+{
+    return fetch(name, 0, 1);
+}
+
+#if defined(__FreeBSD__) || defined(__NetBSD__) || \
+    defined(__OpenBSD__) || defined(__DragonFly__)
+
 static __thread struct group gr;
 static __thread char *members[64];
 static __thread char linebuf[256];
@@ -92,53 +125,6 @@ static struct group *parse_line(const char *line)
     return &gr;
 }
 
-/* lookup() - search the group file by name or gid */
-static struct group *lookup(const char *name, gid_t gid, int by_name)
-{
-#ifdef O_CLOEXEC
-    int flags = O_RDONLY | O_CLOEXEC;
-#else
-    int flags = O_RDONLY;
-#endif
-    int fd = open(group_path(), flags, 0);
-    if (fd < 0)
-        return NULL;
-    char buf[4096];
-    ssize_t n = read(fd, buf, sizeof(buf) - 1);
-    close(fd);
-    if (n <= 0)
-        return NULL;
-    buf[n] = '\0';
-
-    char *save_line;
-    for (char *line = strtok_r(buf, "\n", &save_line); line;
-         line = strtok_r(NULL, "\n", &save_line)) {
-        struct group *g = parse_line(line);
-        if (!g)
-            continue;
-        if (by_name) {
-            if (strcmp(g->gr_name, name) == 0)
-                return g;
-        } else {
-            if (g->gr_gid == gid)
-                return g;
-        }
-    }
-    return NULL;
-}
-
-/* getgrgid() - retrieve group entry by gid */
-struct group *getgrgid(gid_t gid)
-{
-    return lookup(NULL, gid, 0);
-}
-
-/* getgrnam() - retrieve group entry by name */
-struct group *getgrnam(const char *name)
-{
-    return lookup(name, 0, 1);
-}
-
 extern void host_setgrent(void) __asm("setgrent");
 extern struct group *host_getgrent(void) __asm("getgrent");
 extern void host_endgrent(void) __asm("endgrent");
@@ -216,19 +202,6 @@ void endgrent(void)
 
 #else
 
-extern struct group *host_getgrgid(gid_t) __asm("getgrgid");
-extern struct group *host_getgrnam(const char *) __asm("getgrnam");
-
-struct group *getgrgid(gid_t gid)
-{
-    return host_getgrgid(gid);
-}
-
-struct group *getgrnam(const char *name)
-{
-    return host_getgrnam(name);
-}
-
 /* group_path() - return location of the group file */
 static const char *group_path(void)
 {
@@ -367,63 +340,15 @@ static int do_setgroups(int n, const gid_t *groups)
     return host_setgroups(n, groups);
 #endif
 }
-/* getgrouplist() - parse group file for user */
+extern int __vlibc_pwdb_grouplist(const char *path, const char *user,
+                                  gid_t group, gid_t *groups, int *ngroups);
 
+/* getgrouplist() - look up the user's groups in the cached index */
 int getgrouplist(const char *user, gid_t group, gid_t *groups, int *ngroups)
 {
     if (!user || !groups || !ngroups || *ngroups <= 0)
         return -1;
-
-    int limit = *ngroups;
-    int count = 0;
-    groups[count++] = group;
-
-#ifdef O_CLOEXEC
-    int flags = O_RDONLY | O_CLOEXEC;
-#else
-    int flags = O_RDONLY;
-#endif
-    int fd = open(group_path(), flags, 0);
-    if (fd < 0)
-        return -1;
-    char buf[4096];
-    ssize_t n = read(fd, buf, sizeof(buf) - 1);
-    close(fd);
-    if (n <= 0)
-        return -1;
-    buf[n] = '\0';
-
-    char *save_line;
-    for (char *line = strtok_r(buf, "\n", &save_line); line;
-         line = strtok_r(NULL, "\n", &save_line)) {
-        struct group *g = parse_line(line);
-        if (!g)
-            continue;
-        for (char **m = g->gr_mem; m && *m; m++) {
-            if (strcmp(*m, user) == 0) {
-                int dup = 0;
-                for (int i = 0; i < count; i++) {
-                    if (groups[i] == g->gr_gid) {
-                        dup = 1;
-                        break;
-                    }
-                }
-                if (!dup) {
-                    if (count < limit)
-                        groups[count] = g->gr_gid;
-                    count++;
-                }
-                break;
-            }
-        }
-    }
-
-    if (count > limit) {
-        *ngroups = count;
-        return -1;
-    }
-    *ngroups = count;
-    return count;
+    return __vlibc_pwdb_grouplist(group_path(), user, group, groups, ngroups);
 }
 /* initgroups() - apply groups parsed from file */
 
@@ -10,6 +10,9 @@
 #include "string.h"
 #include "stdlib.h"
 #include "errno.h"
+#include "ctype.h"
+#include "wchar.h"
+#include <stdint.h>
 
 #if defined(__FreeBSD__) || defined(__NetBSD__) || \
     defined(__OpenBSD__) || defined(__DragonFly__)
@@ -25,155 +28,591 @@ extern size_t host_iconv(iconv_t, char **, size_t *, char **, size_t *);
 extern int host_iconv_close(iconv_t);
 #endif
 
+/*
+ * Every conversion decodes one character of the source charset to a
+ * UCS-4 code point and encodes it in the target charset. Single- and
+ * double-byte charsets decode through the tables in iconv_tables.c;
+ * the reverse maps used to encode are built the first time a charset
+ * is opened as a target. Bulk steps skip the per-character loop for
+ * ASCII runs, UTF-8/UTF-16 pairs and pairs of single-byte charsets,
+ * which get a direct byte-to-byte table.
+ */
+
 enum {
-    CD_ASCII_ASCII,
-    CD_ASCII_UTF8,
-    CD_UTF8_ASCII,
-    CD_UTF8_UTF8,
-    CD_ASCII_8859_1,
-    CD_8859_1_ASCII,
-    CD_8859_1_8859_1,
-    CD_8859_1_UTF8,
-    CD_UTF8_8859_1,
-    CD_ASCII_UTF16,
-    CD_UTF16_ASCII,
-    CD_UTF8_UTF16,
-    CD_UTF16_UTF8,
-    CD_8859_1_UTF16,
-    CD_UTF16_8859_1,
-    CD_UTF16_UTF16,
-    CD_HOST
+    CS_ASCII,
+    CS_UTF8,
+    CS_UTF16LE,
+    CS_UTF16BE,
+    CS_UTF32LE,
+    CS_UTF32BE,
+    CS_SBCS,                    /* ASCII plus a table for 0x80-0xFF */
+    CS_GBK,
+    CS_EUCCN,                   /* GB2312 part of the GBK table */
+    CS_SJIS,
+    CS_EUCJP,
+    CS_EUCKR
+};
+
+extern const uint16_t __vlibc_cs_iso8859_1[128], __vlibc_cs_iso8859_2[128],
+    __vlibc_cs_iso8859_3[128], __vlibc_cs_iso8859_4[128],
+    __vlibc_cs_iso8859_5[128], __vlibc_cs_iso8859_6[128],
+    __vlibc_cs_iso8859_7[128], __vlibc_cs_iso8859_8[128],
+    __vlibc_cs_iso8859_9[128], __vlibc_cs_iso8859_10[128],
+    __vlibc_cs_iso8859_11[128], __vlibc_cs_iso8859_13[128],
+    __vlibc_cs_iso8859_14[128], __vlibc_cs_iso8859_15[128],
+    __vlibc_cs_iso8859_16[128], __vlibc_cs_cp1250[128],
+    __vlibc_cs_cp1251[128], __vlibc_cs_cp1252[128], __vlibc_cs_cp1253[128],
+    __vlibc_cs_cp1254[128], __vlibc_cs_cp1255[128], __vlibc_cs_cp1256[128],
+    __vlibc_cs_cp1257[128], __vlibc_cs_cp1258[128], __vlibc_cs_koi8_r[128],
+    __vlibc_cs_koi8_u[128], __vlibc_cs_gbk[126 * 191],
+    __vlibc_cs_jisx0208[94 * 94], __vlibc_cs_ksc5601[94 * 94];
+
+struct cstable {
+    const uint16_t *map;        /* code points, 0 where unassigned */
+    unsigned size;
+};
+
+static const struct cstable tables[] = {
+    { __vlibc_cs_iso8859_1, 128 },  { __vlibc_cs_iso8859_2, 128 },
+    { __vlibc_cs_iso8859_3, 128 },  { __vlibc_cs_iso8859_4, 128 },
+    { __vlibc_cs_iso8859_5, 128 },  { __vlibc_cs_iso8859_6, 128 },
+    { __vlibc_cs_iso8859_7, 128 },  { __vlibc_cs_iso8859_8, 128 },
+    { __vlibc_cs_iso8859_9, 128 },  { __vlibc_cs_iso8859_10, 128 },
+    { __vlibc_cs_iso8859_11, 128 }, { __vlibc_cs_iso8859_13, 128 },
+    { __vlibc_cs_iso8859_14, 128 }, { __vlibc_cs_iso8859_15, 128 },
+    { __vlibc_cs_iso8859_16, 128 }, { __vlibc_cs_cp1250, 128 },
+    { __vlibc_cs_cp1251, 128 },     { __vlibc_cs_cp1252, 128 },
+    { __vlibc_cs_cp1253, 128 },     { __vlibc_cs_cp1254, 128 },
+    { __vlibc_cs_cp1255, 128 },     { __vlibc_cs_cp1256, 128 },
+    { __vlibc_cs_cp1257, 128 },     { __vlibc_cs_cp1258, 128 },
+    { __vlibc_cs_koi8_r, 128 },     { __vlibc_cs_koi8_u, 128 },
+    { __vlibc_cs_gbk, 126 * 191 },  { __vlibc_cs_jisx0208, 94 * 94 },
+    { __vlibc_cs_ksc5601, 94 * 94 },
+};
+
+#define NTABLES (sizeof(tables) / sizeof(tables[0]))
+#define T_GBK   26
+#define T_JIS   27
+#define T_KSC   28
+
+struct charset {
+    const char *names;          /* aliases, each NUL-terminated */
+    unsigned char kind;
+    signed char table;
+};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CS_UTF32NATIVE CS_UTF32LE
+#define UTF16_BULK 1            /* UTF-16 is little-endian like the kernels */
+#else
+#define CS_UTF32NATIVE CS_UTF32BE
+#define UTF16_BULK 0
+#endif
+
+static const struct charset charsets[] = {
+    { "ASCII\0US-ASCII\0ANSI_X3.4-1968\0", CS_ASCII, -1 },
+    { "UTF-8\0", CS_UTF8, -1 },
+    { "UTF-16\0UTF-16LE\0", CS_UTF16LE, -1 },
+    { "UTF-16BE\0", CS_UTF16BE, -1 },
+    { "UTF-32\0UTF-32LE\0UCS-4LE\0", CS_UTF32LE, -1 },
+    { "UTF-32BE\0UCS-4\0UCS-4BE\0", CS_UTF32BE, -1 },
+    { "WCHAR_T\0", CS_UTF32NATIVE, -1 },
+    { "ISO-8859-1\0LATIN1\0", CS_SBCS, 0 },
+    { "ISO-8859-2\0LATIN2\0", CS_SBCS, 1 },
+    { "ISO-8859-3\0LATIN3\0", CS_SBCS, 2 },
+    { "ISO-8859-4\0LATIN4\0", CS_SBCS, 3 },
+    { "ISO-8859-5\0CYRILLIC\0", CS_SBCS, 4 },
+    { "ISO-8859-6\0ARABIC\0", CS_SBCS, 5 },
+    { "ISO-8859-7\0GREEK\0", CS_SBCS, 6 },
+    { "ISO-8859-8\0HEBREW\0", CS_SBCS, 7 },
+    { "ISO-8859-9\0LATIN5\0", CS_SBCS, 8 },
+    { "ISO-8859-10\0LATIN6\0", CS_SBCS, 9 },
+    { "ISO-8859-11\0", CS_SBCS, 10 },
+    { "ISO-8859-13\0LATIN7\0", CS_SBCS, 11 },
+    { "ISO-8859-14\0LATIN8\0", CS_SBCS, 12 },
+    { "ISO-8859-15\0LATIN9\0", CS_SBCS, 13 },
+    { "ISO-8859-16\0LATIN10\0", CS_SBCS, 14 },
+    { "WINDOWS-1250\0CP1250\0", CS_SBCS, 15 },
+    { "WINDOWS-1251\0CP1251\0", CS_SBCS, 16 },
+    { "WINDOWS-1252\0CP1252\0", CS_SBCS, 17 },
+    { "WINDOWS-1253\0CP1253\0", CS_SBCS, 18 },
+    { "WINDOWS-1254\0CP1254\0", CS_SBCS, 19 },
+    { "WINDOWS-1255\0CP1255\0", CS_SBCS, 20 },
+    { "WINDOWS-1256\0CP1256\0", CS_SBCS, 21 },
+    { "WINDOWS-1257\0CP1257\0", CS_SBCS, 22 },
+    { "WINDOWS-1258\0CP1258\0", CS_SBCS, 23 },
+    { "KOI8-R\0", CS_SBCS, 24 },
+    { "KOI8-U\0", CS_SBCS, 25 },
+    { "GBK\0CP936\0", CS_GBK, T_GBK },
+    { "EUC-CN\0GB2312\0", CS_EUCCN, T_GBK },
+    { "SHIFT_JIS\0SJIS\0", CS_SJIS, T_JIS },
+    { "EUC-JP\0", CS_EUCJP, T_JIS },
+    { "EUC-KR\0", CS_EUCKR, T_KSC },
+};
+
+/*
+ * Code point to table index + 1, split into 256 pages by the high
+ * byte. Only pages holding mapped characters are allocated.
+ */
+struct revmap {
+    uint16_t *page[256];
 };
 
+static struct revmap *revmaps[NTABLES];
+
 typedef struct iconv_cd {
-    int type;
+    const struct charset *from;     /* NULL for a host descriptor */
+    const struct charset *to;
+    const struct revmap *rev;       /* reverse map of the target table */
+    int direct;                     /* single-byte pair using map */
+    short map[256];                 /* output byte or -1 */
 #if defined(__FreeBSD__) || defined(__NetBSD__) || \
     defined(__OpenBSD__) || defined(__DragonFly__)
     iconv_t host;
 #endif
 } iconv_cd;
 
-/* Determine whether a character set name refers to ASCII. */
-static int is_ascii_cs(const char *name)
+extern int __vlibc_utf8_decode(const unsigned char *s, size_t n,
+                               uint32_t *cp);
+extern size_t __vlibc_ascii_len(const unsigned char *s, size_t n);
+extern size_t __vlibc_utf8_to_utf16(uint16_t **d, const unsigned char **s,
+                                    size_t n);
+extern size_t __vlibc_utf16_to_utf8(unsigned char **d, const uint16_t **s,
+                                    size_t n);
+
+/* Compare charset names ignoring case, '-' and '_'. */
+static int name_eq(const char *a, const char *b)
 {
-    return name && (!strcasecmp(name, "ASCII") || !strcasecmp(name, "US-ASCII"));
+    for (;;) {
+        while (*a == '-' || *a == '_')
+            a++;
+        while (*b == '-' || *b == '_')
+            b++;
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+            return 0;
+        if (!*a)
+            return 1;
+        a++;
+        b++;
+    }
 }
 
-/* Determine whether a character set name refers to UTF-8. */
-static int is_utf8_cs(const char *name)
+static const struct charset *find_charset(const char *name)
 {
-    return name && (!strcasecmp(name, "UTF-8") || !strcasecmp(name, "UTF8"));
+    for (size_t i = 0; i < sizeof(charsets) / sizeof(charsets[0]); i++)
+        for (const char *n = charsets[i].names; *n; n += strlen(n) + 1)
+            if (name_eq(n, name))
+                return &charsets[i];
+    return NULL;
 }
 
-/* Determine whether a character set name refers to ISO-8859-1. */
-static int is_8859_1_cs(const char *name)
+static void free_revmap(struct revmap *r)
 {
-    return name && (!strcasecmp(name, "ISO-8859-1") ||
-                    !strcasecmp(name, "ISO8859-1") ||
-                    !strcasecmp(name, "LATIN1") ||
-                    !strcasecmp(name, "LATIN-1"));
+    for (int i = 0; i < 256; i++)
+        free(r->page[i]);
+    free(r);
 }
 
-/* Determine whether a character set name refers to UTF-16. */
-static int is_utf16_cs(const char *name)
+/* Reverse map of table t, built on first use and then shared. */
+static const struct revmap *get_revmap(int t)
 {
-    return name && (!strcasecmp(name, "UTF-16") || !strcasecmp(name, "UTF16"));
+    struct revmap *r = __atomic_load_n(&revmaps[t], __ATOMIC_ACQUIRE);
+    if (r)
+        return r;
+    r = calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+    /* walk backwards so the lowest code wins for duplicated characters */
+    for (unsigned i = tables[t].size; i-- > 0; ) {
+        uint16_t cp = tables[t].map[i];
+        if (!cp)
+            continue;
+        uint16_t **pg = &r->page[cp >> 8];
+        if (!*pg && !(*pg = calloc(256, sizeof(uint16_t)))) {
+            free_revmap(r);
+            return NULL;
+        }
+        (*pg)[cp & 0xFF] = (uint16_t)(i + 1);
+    }
+    struct revmap *old = NULL;
+    if (!__atomic_compare_exchange_n(&revmaps[t], &old, r, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free_revmap(r);
+        r = old;
+    }
+    return r;
 }
 
-/* Decode a single UTF-8 sequence from SRC advancing pointers on success. */
-static int decode_utf8(const unsigned char **src, size_t *left, unsigned *cp)
+static unsigned get16(int kind, const unsigned char *s)
 {
-    if (*left == 0)
-        return -2;
-    unsigned char c0 = (*src)[0];
-    if (c0 < 0x80) {
-        *cp = c0;
-        (*src)++; (*left)--;
-        return 0;
-    }
-    if ((c0 & 0xE0) == 0xC0) {
-        if (*left < 2) return -2;
-        unsigned char c1 = (*src)[1];
-        if ((c1 & 0xC0) != 0x80)
+    return kind == CS_UTF16LE ? s[0] | (s[1] << 8) : (s[0] << 8) | s[1];
+}
+
+static uint32_t get32(int kind, const unsigned char *s)
+{
+    if (kind == CS_UTF32LE)
+        return s[0] | (s[1] << 8) | (s[2] << 16) | ((uint32_t)s[3] << 24);
+    return ((uint32_t)s[0] << 24) | (s[1] << 16) | (s[2] << 8) | s[3];
+}
+
+/* Look up row and column of a 94x94 table. */
+static int decode94(int t, unsigned row, unsigned col, uint32_t *cp)
+{
+    uint16_t u = tables[t].map[row * 94 + col];
+    if (!u)
+        return -1;
+    *cp = u;
+    return 2;
+}
+
+/*
+ * Decode one character. Returns the number of bytes used, 0 when the
+ * input ends inside a character or -1 for an invalid sequence.
+ */
+static int cs_decode(const struct charset *cs, const unsigned char *s,
+                     size_t n, uint32_t *cp)
+{
+    unsigned c = s[0], c2;
+    uint16_t u;
+
+    switch (cs->kind) {
+    case CS_UTF8:
+        return __vlibc_utf8_decode(s, n, cp);
+
+    case CS_UTF16LE:
+    case CS_UTF16BE: {
+        if (n < 2)
+            return 0;
+        unsigned w = get16(cs->kind, s);
+        if (w >= 0xDC00 && w <= 0xDFFF)
             return -1;
-        *cp = ((c0 & 0x1F) << 6) | (c1 & 0x3F);
-        if (*cp < 0x80)
+        if (w >= 0xD800 && w <= 0xDBFF) {
+            if (n < 4)
+                return 0;
+            unsigned w2 = get16(cs->kind, s + 2);
+            if (w2 < 0xDC00 || w2 > 0xDFFF)
+                return -1;
+            *cp = 0x10000 + ((w - 0xD800) << 10) + (w2 - 0xDC00);
+            return 4;
+        }
+        *cp = w;
+        return 2;
+    }
+
+    case CS_UTF32LE:
+    case CS_UTF32BE: {
+        if (n < 4)
+            return 0;
+        uint32_t v = get32(cs->kind, s);
+        if (v > 0x10FFFF || (v >= 0xD800 && v <= 0xDFFF))
             return -1;
-        (*src) += 2; (*left) -= 2;
-        return 0;
+        *cp = v;
+        return 4;
+    }
     }
-    if ((c0 & 0xF0) == 0xE0) {
-        if (*left < 3) return -2;
-        unsigned char c1 = (*src)[1];
-        unsigned char c2 = (*src)[2];
-        if ((c1 & 0xC0) != 0x80 || (c2 & 0xC0) != 0x80)
+
+    /* the remaining charsets are ASCII supersets */
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    }
+
+    switch (cs->kind) {
+    case CS_SBCS:
+        u = tables[cs->table].map[c - 0x80];
+        if (!u)
             return -1;
-        *cp = ((c0 & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
-        if (*cp < 0x800)
+        *cp = u;
+        return 1;
+
+    case CS_GBK:
+    case CS_EUCCN:
+        if (c == 0x80 || c == 0xFF)
             return -1;
-        (*src) += 3; (*left) -= 3;
-        return 0;
+        if (n < 2)
+            return 0;
+        c2 = s[1];
+        if (c2 < 0x40 || c2 == 0x7F || c2 == 0xFF)
+            return -1;
+        if (cs->kind == CS_EUCCN && (c < 0xA1 || c2 < 0xA1))
+            return -1;
+        u = tables[T_GBK].map[(c - 0x81) * 191 + (c2 - 0x40)];
+        if (!u)
+            return -1;
+        *cp = u;
+        return 2;
+
+    case CS_SJIS:
+        if (c >= 0xA1 && c <= 0xDF) {           /* half-width katakana */
+            *cp = 0xFF61 + (c - 0xA1);
+            return 1;
+        }
+        if (!((c >= 0x81 && c <= 0x9F) || (c >= 0xE0 && c <= 0xEF)))
+            return -1;
+        if (n < 2)
+            return 0;
+        c2 = s[1];
+        if (c2 < 0x40 || c2 == 0x7F || c2 > 0xFC)
+            return -1;
+        {
+            unsigned row = (c < 0xA0 ? c - 0x81 : c - 0xC1) * 2, col;
+            if (c2 >= 0x9F) {
+                row++;
+                col = c2 - 0x9F;
+            } else {
+                col = c2 - (c2 > 0x7F ? 0x41 : 0x40);
+            }
+            return decode94(T_JIS, row, col, cp);
+        }
+
+    case CS_EUCJP:
+        if (c == 0x8E) {
+            if (n < 2)
+                return 0;
+            c2 = s[1];
+            if (c2 < 0xA1 || c2 > 0xDF)
+                return -1;
+            *cp = 0xFF61 + (c2 - 0xA1);
+            return 2;
+        }
+        /* fall through */
+    case CS_EUCKR:
+        if (c < 0xA1 || c == 0xFF)
+            return -1;
+        if (n < 2)
+            return 0;
+        c2 = s[1];
+        if (c2 < 0xA1 || c2 == 0xFF)
+            return -1;
+        return decode94(cs->table, c - 0xA1, c2 - 0xA1, cp);
     }
     return -1;
 }
 
-/* Encode a Unicode codepoint to UTF-8 advancing DST on success. */
-static int encode_utf8(unsigned cp, unsigned char **dst, size_t *left)
+/*
+ * Encode one code point in the target charset. Returns the number of
+ * bytes written, 0 when they do not fit in n bytes or -1 when the
+ * charset has no such character.
+ */
+static int cs_encode(const iconv_cd *cd, uint32_t cp, unsigned char *d,
+                     size_t n)
 {
+    int kind = cd->to->kind;
+
+    switch (kind) {
+    case CS_UTF8:
+        if (cp < 0x80) {
+            if (n < 1)
+                return 0;
+            d[0] = cp;
+            return 1;
+        }
+        if (cp < 0x800) {
+            if (n < 2)
+                return 0;
+            d[0] = 0xC0 | (cp >> 6);
+            d[1] = 0x80 | (cp & 0x3F);
+            return 2;
+        }
+        if (cp < 0x10000) {
+            if (n < 3)
+                return 0;
+            d[0] = 0xE0 | (cp >> 12);
+            d[1] = 0x80 | ((cp >> 6) & 0x3F);
+            d[2] = 0x80 | (cp & 0x3F);
+            return 3;
+        }
+        if (n < 4)
+            return 0;
+        d[0] = 0xF0 | (cp >> 18);
+        d[1] = 0x80 | ((cp >> 12) & 0x3F);
+        d[2] = 0x80 | ((cp >> 6) & 0x3F);
+        d[3] = 0x80 | (cp & 0x3F);
+        return 4;
+
+    case CS_UTF16LE:
+    case CS_UTF16BE: {
+        unsigned w[2] = { cp, 0 };
+        int units = 1;
+        if (cp > 0xFFFF) {
+            cp -= 0x10000;
+            w[0] = 0xD800 | (cp >> 10);
+            w[1] = 0xDC00 | (cp & 0x3FF);
+            units = 2;
+        }
+        if (n < (size_t)units * 2)
+            return 0;
+        for (int i = 0; i < units; i++) {
+            unsigned char hi = w[i] >> 8, lo = w[i] & 0xFF;
+            d[2 * i] = kind == CS_UTF16LE ? lo : hi;
+            d[2 * i + 1] = kind == CS_UTF16LE ? hi : lo;
+        }
+        return units * 2;
+    }
+
+    case CS_UTF32LE:
+    case CS_UTF32BE:
+        if (n < 4)
+            return 0;
+        for (int i = 0; i < 4; i++) {
+            int shift = kind == CS_UTF32LE ? 8 * i : 24 - 8 * i;
+            d[i] = (cp >> shift) & 0xFF;
+        }
+        return 4;
+    }
+
     if (cp < 0x80) {
-        if (*left < 1) return -2;
-        (*dst)[0] = cp;
-        (*dst)++; (*left)--;
-        return 0;
+        if (n < 1)
+            return 0;
+        d[0] = cp;
+        return 1;
     }
-    if (cp < 0x800) {
-        if (*left < 2) return -2;
-        (*dst)[0] = 0xC0 | (cp >> 6);
-        (*dst)[1] = 0x80 | (cp & 0x3F);
-        (*dst) += 2; (*left) -= 2;
-        return 0;
+    if (kind == CS_ASCII)
+        return -1;
+
+    if (cp >= 0xFF61 && cp <= 0xFF9F) {         /* half-width katakana */
+        if (kind == CS_SJIS) {
+            if (n < 1)
+                return 0;
+            d[0] = 0xA1 + (cp - 0xFF61);
+            return 1;
+        }
+        if (kind == CS_EUCJP) {
+            if (n < 2)
+                return 0;
+            d[0] = 0x8E;
+            d[1] = 0xA1 + (cp - 0xFF61);
+            return 2;
+        }
     }
-    if (cp <= 0xFFFF) {
-        if (*left < 3) return -2;
-        (*dst)[0] = 0xE0 | (cp >> 12);
-        (*dst)[1] = 0x80 | ((cp >> 6) & 0x3F);
-        (*dst)[2] = 0x80 | (cp & 0x3F);
-        (*dst) += 3; (*left) -= 3;
-        return 0;
+
+    const uint16_t *page = cp <= 0xFFFF ? cd->rev->page[cp >> 8] : NULL;
+    unsigned idx = page ? page[cp & 0xFF] : 0;
+    if (!idx)
+        return -1;
+    idx--;
+
+    if (kind == CS_SBCS) {
+        if (n < 1)
+            return 0;
+        d[0] = 0x80 + idx;
+        return 1;
     }
-    return -1;
+
+    unsigned b1, b2;
+    if (kind == CS_GBK || kind == CS_EUCCN) {
+        b1 = 0x81 + idx / 191;
+        b2 = 0x40 + idx % 191;
+        if (kind == CS_EUCCN && (b1 < 0xA1 || b2 < 0xA1))
+            return -1;
+    } else if (kind == CS_SJIS) {
+        unsigned row = idx / 94, col = idx % 94;
+        b1 = (row >> 1) + (row < 62 ? 0x81 : 0xC1);
+        if (row & 1)
+            b2 = col + 0x9F;
+        else
+            b2 = col + (col >= 63 ? 0x41 : 0x40);
+    } else {
+        b1 = 0xA1 + idx / 94;
+        b2 = 0xA1 + idx % 94;
+    }
+    if (n < 2)
+        return 0;
+    d[0] = b1;
+    d[1] = b2;
+    return 2;
 }
 
-/* Decode a 16-bit character from little-endian UTF-16. */
-static int decode_utf16(const unsigned char **src, size_t *left, unsigned *cp)
+static int ascii_based(int kind)
 {
-    if (*left < 2)
-        return -2;
-    unsigned c = (*src)[0] | ((*src)[1] << 8);
-    if (c >= 0xD800 && c <= 0xDFFF)
-        return -1;
-    *cp = c;
-    (*src) += 2; (*left) -= 2;
-    return 0;
+    return kind == CS_ASCII || kind == CS_UTF8 || kind >= CS_SBCS;
 }
 
-/* Encode a codepoint to little-endian UTF-16. */
-static int encode_utf16(unsigned cp, unsigned char **dst, size_t *left)
+/*
+ * Convert as much of the input as the bulk paths take in one call and
+ * return the number of characters converted. iconv() carries on one
+ * character at a time from where this stops, which is also where
+ * invalid input and a full output buffer are reported.
+ */
+static size_t convert_bulk(const iconv_cd *cd, char **src, size_t *inleft,
+                           char **dst, size_t *outleft)
 {
-    if (cp > 0xFFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    const unsigned char *s = (const unsigned char *)*src;
+    unsigned char *d = (unsigned char *)*dst;
+    size_t in = *inleft, out = *outleft;
+    size_t n = in < out ? in : out;
+    size_t chars;
+    int from = cd->from->kind, to = cd->to->kind;
+
+    if (cd->direct) {
+        size_t i = 0;
+        while (i < n && cd->map[s[i]] >= 0) {
+            d[i] = (unsigned char)cd->map[s[i]];
+            i++;
+        }
+        s += i; d += i; chars = i;
+    } else if (from == CS_UTF8 && to == CS_UTF8) {
+        n = vlibc_utf8_valid((const char *)s, n);
+        memcpy(d, s, n);
+        chars = vlibc_utf8_count((const char *)s, n);
+        s += n; d += n;
+    } else if (UTF16_BULK && from == CS_UTF8 && to == CS_UTF16LE &&
+               !((uintptr_t)d & 1)) {
+        uint16_t *d16 = (uint16_t *)d;
+        chars = __vlibc_utf8_to_utf16(&d16, &s, in < out / 2 ? in : out / 2);
+        d = (unsigned char *)d16;
+    } else if (UTF16_BULK && from == CS_UTF16LE && to == CS_UTF8 &&
+               !((uintptr_t)s & 1)) {
+        const uint16_t *s16 = (const uint16_t *)s;
+        chars = __vlibc_utf16_to_utf8(&d, &s16,
+                                      in / 2 < out / 3 ? in / 2 : out / 3);
+        s = (const unsigned char *)s16;
+    } else if (ascii_based(from) && ascii_based(to)) {
+        n = __vlibc_ascii_len(s, n);
+        memcpy(d, s, n);
+        s += n; d += n; chars = n;
+    } else {
+        return 0;
+    }
+
+    *inleft -= (size_t)(s - (const unsigned char *)*src);
+    *outleft -= (size_t)(d - (unsigned char *)*dst);
+    *src = (char *)s;
+    *dst = (char *)d;
+    return chars;
+}
+
+/* Prepare a descriptor for a pair of charsets vlibc knows. */
+static int cd_init(iconv_cd *cd, const struct charset *from,
+                   const struct charset *to)
+{
+    cd->from = from;
+    cd->to = to;
+    cd->rev = NULL;
+    cd->direct = 0;
+    if (to->table >= 0 && !(cd->rev = get_revmap(to->table)))
         return -1;
-    if (*left < 2)
-        return -2;
-    (*dst)[0] = cp & 0xFF;
-    (*dst)[1] = (cp >> 8) & 0xFF;
-    (*dst) += 2; (*left) -= 2;
+
+    /* byte-to-byte table for pairs of single-byte charsets */
+    if ((from->kind == CS_ASCII || from->kind == CS_SBCS) &&
+        (to->kind == CS_ASCII || to->kind == CS_SBCS)) {
+        for (int b = 0; b < 256; b++) {
+            unsigned char in = (unsigned char)b, out;
+            uint32_t cp;
+            cd->map[b] = -1;
+            if (cs_decode(from, &in, 1, &cp) == 1 &&
+                cs_encode(cd, cp, &out, 1) == 1)
+                cd->map[b] = out;
+        }
+        cd->direct = 1;
+    }
     return 0;
 }
 
 /*
- * iconv_open() - acquire a conversion descriptor. On BSD systems the
- * host iconv implementation is used when available; otherwise simple
- * ASCII and UTF-8 conversions are provided.
+ * iconv_open() - acquire a conversion descriptor. Conversions between
+ * the charsets listed above are handled by vlibc; on BSD systems other
+ * names are passed to the host iconv implementation when available.
  */
 iconv_t iconv_open(const char *tocode, const char *fromcode)
 {
@@ -182,21 +621,8 @@ iconv_t iconv_open(const char *tocode, const char *fromcode)
         return (iconv_t)-1;
     }
 
-#if defined(__FreeBSD__) || defined(__NetBSD__) || \
-    defined(__OpenBSD__) || defined(__DragonFly__)
-    iconv_t h = host_iconv_open(tocode, fromcode);
-    if (h != (iconv_t)-1) {
-        iconv_cd *cd = malloc(sizeof(*cd));
-        if (!cd) {
-            host_iconv_close(h);
-            errno = ENOMEM;
-            return (iconv_t)-1;
-        }
-        cd->type = CD_HOST;
-        cd->host = h;
-        return (iconv_t)cd;
-    }
-#endif
+    const struct charset *from = find_charset(fromcode);
+    const struct charset *to = find_charset(tocode);
 
     iconv_cd *cd = malloc(sizeof(*cd));
     if (!cd) {
@@ -204,51 +630,34 @@ iconv_t iconv_open(const char *tocode, const char *fromcode)
         return (iconv_t)-1;
     }
 
-    if (is_ascii_cs(fromcode) && is_ascii_cs(tocode))
-        cd->type = CD_ASCII_ASCII;
-    else if (is_ascii_cs(fromcode) && is_utf8_cs(tocode))
-        cd->type = CD_ASCII_UTF8;
-    else if (is_utf8_cs(fromcode) && is_ascii_cs(tocode))
-        cd->type = CD_UTF8_ASCII;
-    else if (is_utf8_cs(fromcode) && is_utf8_cs(tocode))
-        cd->type = CD_UTF8_UTF8;
-    else if (is_ascii_cs(fromcode) && is_8859_1_cs(tocode))
-        cd->type = CD_ASCII_8859_1;
-    else if (is_8859_1_cs(fromcode) && is_ascii_cs(tocode))
-        cd->type = CD_8859_1_ASCII;
-    else if (is_8859_1_cs(fromcode) && is_8859_1_cs(tocode))
-        cd->type = CD_8859_1_8859_1;
-    else if (is_8859_1_cs(fromcode) && is_utf8_cs(tocode))
-        cd->type = CD_8859_1_UTF8;
-    else if (is_utf8_cs(fromcode) && is_8859_1_cs(tocode))
-        cd->type = CD_UTF8_8859_1;
-    else if (is_ascii_cs(fromcode) && is_utf16_cs(tocode))
-        cd->type = CD_ASCII_UTF16;
-    else if (is_utf16_cs(fromcode) && is_ascii_cs(tocode))
-        cd->type = CD_UTF16_ASCII;
-    else if (is_utf8_cs(fromcode) && is_utf16_cs(tocode))
-        cd->type = CD_UTF8_UTF16;
-    else if (is_utf16_cs(fromcode) && is_utf8_cs(tocode))
-        cd->type = CD_UTF16_UTF8;
-    else if (is_8859_1_cs(fromcode) && is_utf16_cs(tocode))
-        cd->type = CD_8859_1_UTF16;
-    else if (is_utf16_cs(fromcode) && is_8859_1_cs(tocode))
-        cd->type = CD_UTF16_8859_1;
-    else if (is_utf16_cs(fromcode) && is_utf16_cs(tocode))
-        cd->type = CD_UTF16_UTF16;
-    else {
-        free(cd);
-        errno = EINVAL;
-        return (iconv_t)-1;
+    if (from && to) {
+        if (cd_init(cd, from, to) < 0) {
+            free(cd);
+            errno = ENOMEM;
+            return (iconv_t)-1;
+        }
+        return (iconv_t)cd;
     }
 
-    return (iconv_t)cd;
+#if defined(__FreeBSD__) || defined(__NetBSD__) || \
+    defined(__OpenBSD__) || defined(__DragonFly__)
+    iconv_t h = host_iconv_open(tocode, fromcode);
+    if (h != (iconv_t)-1) {
+        cd->from = NULL;
+        cd->host = h;
+        return (iconv_t)cd;
+    }
+#endif
+
+    free(cd);
+    errno = EINVAL;
+    return (iconv_t)-1;
 }
 
 /*
  * iconv() - convert a sequence of characters according to the
- * conversion descriptor. Supports basic ASCII and UTF-8 handling
- * and forwards to the host iconv implementation when present.
+ * conversion descriptor. Stops at the first invalid or unconvertible
+ * character with the buffers left at it.
  */
 size_t iconv(iconv_t cd_, char **inbuf, size_t *inbytesleft,
              char **outbuf, size_t *outbytesleft)
@@ -261,7 +670,7 @@ size_t iconv(iconv_t cd_, char **inbuf, size_t *inbytesleft,
 
 #if defined(__FreeBSD__) || defined(__NetBSD__) || \
     defined(__OpenBSD__) || defined(__DragonFly__)
-    if (cd->type == CD_HOST)
+    if (!cd->from)
         return host_iconv(cd->host, inbuf, inbytesleft, outbuf, outbytesleft);
 #endif
 
@@ -270,111 +679,27 @@ size_t iconv(iconv_t cd_, char **inbuf, size_t *inbytesleft,
     size_t inleft = inbytesleft ? *inbytesleft : 0;
     size_t outleft = outbytesleft ? *outbytesleft : 0;
     size_t converted = 0;
+    int err = 0;
 
     while (inleft > 0) {
-        unsigned char c = (unsigned char)*src;
-        unsigned cp = 0;
-        int r;
-
-        switch (cd->type) {
-        case CD_ASCII_ASCII:
-        case CD_ASCII_UTF8:
-        case CD_ASCII_8859_1:
-            if (c >= 0x80) { errno = EILSEQ; return (size_t)-1; }
-            if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-            *dst++ = *src++; inleft--; outleft--; converted++; break;
-
-        case CD_8859_1_ASCII:
-            if (c >= 0x80) { errno = EILSEQ; return (size_t)-1; }
-            if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-            *dst++ = *src++; inleft--; outleft--; converted++; break;
-
-        case CD_8859_1_8859_1:
-            if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-            *dst++ = *src++; inleft--; outleft--; converted++; break;
-
-        case CD_8859_1_UTF8:
-            if (c < 0x80) {
-                if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-                *dst++ = *src++; inleft--; outleft--; converted++; break;
-            } else {
-                if (outleft < 2) { errno = E2BIG; return (size_t)-1; }
-                dst[0] = 0xC0 | (c >> 6);
-                dst[1] = 0x80 | (c & 0x3F);
-                dst += 2; src++; inleft--; outleft -= 2; converted++; break;
-            }
-
-        case CD_UTF8_ASCII:
-            r = decode_utf8((const unsigned char **)&src, &inleft, &cp);
-            if (r == -2) { errno = EINVAL; return (size_t)-1; }
-            if (r == -1 || cp > 0x7F) { errno = EILSEQ; return (size_t)-1; }
-            if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-            *dst++ = (char)cp; outleft--; converted++; break;
-
-        case CD_UTF8_8859_1:
-            r = decode_utf8((const unsigned char **)&src, &inleft, &cp);
-            if (r == -2) { errno = EINVAL; return (size_t)-1; }
-            if (r == -1 || cp > 0xFF) { errno = EILSEQ; return (size_t)-1; }
-            if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-            *dst++ = (char)cp; outleft--; converted++; break;
-
-        case CD_UTF8_UTF8:
-            if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-            *dst++ = *src++; inleft--; outleft--; converted++; break;
-
-        case CD_ASCII_UTF16:
-            if (c >= 0x80) { errno = EILSEQ; return (size_t)-1; }
-            r = encode_utf16(c, (unsigned char **)&dst, &outleft);
-            if (r == -2) { errno = E2BIG; return (size_t)-1; }
-            src++; inleft--; converted++; break;
-
-        case CD_UTF16_ASCII:
-            r = decode_utf16((const unsigned char **)&src, &inleft, &cp);
-            if (r == -2) { errno = EINVAL; return (size_t)-1; }
-            if (r == -1 || cp > 0x7F) { errno = EILSEQ; return (size_t)-1; }
-            if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-            *dst++ = (char)cp; outleft--; converted++; break;
-
-        case CD_UTF8_UTF16:
-            r = decode_utf8((const unsigned char **)&src, &inleft, &cp);
-            if (r == -2) { errno = EINVAL; return (size_t)-1; }
-            if (r == -1) { errno = EILSEQ; return (size_t)-1; }
-            r = encode_utf16(cp, (unsigned char **)&dst, &outleft);
-            if (r == -1) { errno = EILSEQ; return (size_t)-1; }
-            if (r == -2) { errno = E2BIG; return (size_t)-1; }
-            converted++; break;
-
-        case CD_UTF16_UTF8:
-            r = decode_utf16((const unsigned char **)&src, &inleft, &cp);
-            if (r == -2) { errno = EINVAL; return (size_t)-1; }
-            if (r == -1) { errno = EILSEQ; return (size_t)-1; }
-            r = encode_utf8(cp, (unsigned char **)&dst, &outleft);
-            if (r == -1) { errno = EILSEQ; return (size_t)-1; }
-            if (r == -2) { errno = E2BIG; return (size_t)-1; }
-            converted++; break;
-
-        case CD_8859_1_UTF16:
-            r = encode_utf16(c, (unsigned char **)&dst, &outleft);
-            if (r == -2) { errno = E2BIG; return (size_t)-1; }
-            src++; inleft--; converted++; break;
-
-        case CD_UTF16_8859_1:
-            r = decode_utf16((const unsigned char **)&src, &inleft, &cp);
-            if (r == -2) { errno = EINVAL; return (size_t)-1; }
-            if (r == -1 || cp > 0xFF) { errno = EILSEQ; return (size_t)-1; }
-            if (outleft < 1) { errno = E2BIG; return (size_t)-1; }
-            *dst++ = (char)cp; outleft--; converted++; break;
-
-        case CD_UTF16_UTF16:
-            if (inleft < 2) { errno = EINVAL; return (size_t)-1; }
-            if (outleft < 2) { errno = E2BIG; return (size_t)-1; }
-            dst[0] = src[0]; dst[1] = src[1];
-            dst += 2; src += 2;
-            inleft -= 2; outleft -= 2; converted++; break;
-
-        default:
-            errno = EINVAL; return (size_t)-1;
+        converted += convert_bulk(cd, &src, &inleft, &dst, &outleft);
+        if (inleft == 0)
+            break;
+
+        uint32_t cp;
+        int r = cs_decode(cd->from, (const unsigned char *)src, inleft, &cp);
+        if (r <= 0) {
+            err = r ? EILSEQ : EINVAL;
+            break;
         }
+        int w = cs_encode(cd, cp, (unsigned char *)dst, outleft);
+        if (w <= 0) {
+            err = w ? EILSEQ : E2BIG;
+            break;
+        }
+        src += r; inleft -= r;
+        dst += w; outleft -= w;
+        converted++;
     }
 
     if (inbuf)
@@ -386,6 +711,10 @@ size_t iconv(iconv_t cd_, char **inbuf, size_t *inbytesleft,
     if (outbytesleft)
         *outbytesleft = outleft;
 
+    if (err) {
+        errno = err;
+        return (size_t)-1;
+    }
     return converted;
 }
 
@@ -402,7 +731,7 @@ int iconv_close(iconv_t cd_)
 
 #if defined(__FreeBSD__) || defined(__NetBSD__) || \
     defined(__OpenBSD__) || defined(__DragonFly__)
-    if (cd->type == CD_HOST) {
+    if (!cd->from) {
         int r = host_iconv_close(cd->host);
         free(cd);
         return r;
@@ -412,4 +741,3 @@ int iconv_close(iconv_t cd_)
     free(cd);
     return 0;
 }
-
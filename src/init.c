@@ -12,8 +12,16 @@
 #include "string.h"
 #include "errno.h"
 
+extern void __vlibc_vdso_init(void);
+extern void __vlibc_vmath_init(void);
+extern void __vlibc_utf8_init(void);
+
 void vlibc_init(void)
 {
+    __vlibc_vdso_init();
+    __vlibc_vmath_init();
+    __vlibc_utf8_init();
+
     stdin = malloc(sizeof(FILE));
     if (!stdin) {
         errno = ENOMEM;
@@ -16,6 +16,7 @@
 #include <fcntl.h>
 #include <stdarg.h>
 #include "sys/stat.h"
+#include "poll.h"
 
 #ifndef AT_FDCWD
 #define AT_FDCWD -100
@@ -36,9 +37,9 @@ int open(const char *path, int flags, ...)
         va_end(ap);
     }
 #ifdef SYS_open
-    long ret = vlibc_syscall(SYS_open, (long)path, flags, mode, 0, 0, 0);
+    long ret = vlibc_syscall3(SYS_open, (long)path, flags, mode);
 #else
-    long ret = vlibc_syscall(SYS_openat, AT_FDCWD, (long)path, flags, mode, 0, 0);
+    long ret = vlibc_syscall4(SYS_openat, AT_FDCWD, (long)path, flags, mode);
 #endif
     if (ret < 0) {
         errno = -ret;
@@ -47,13 +48,24 @@ int open(const char *path, int flags, ...)
     return (int)ret;
 }
 
+/*
+ * Set by the coroutine runtime in src/vco.c. Inside a coroutine it parks
+ * the caller until fd is ready and returns 0, so read() and write() on
+ * a non-blocking descriptor behave like blocking calls without tying up
+ * the worker thread. Elsewhere it returns -1 and EAGAIN is reported.
+ */
+int (*__vlibc_io_wait)(int fd, int events);
+
 /*
  * Read from a file descriptor using the SYS_read system call
  * via vlibc_syscall.
  */
 ssize_t read(int fd, void *buf, size_t count)
 {
-    long ret = vlibc_syscall(SYS_read, fd, (long)buf, count, 0, 0, 0);
+    long ret;
+    while ((ret = vlibc_syscall3(SYS_read, fd, (long)buf, count)) == -EAGAIN &&
+           __vlibc_io_wait && __vlibc_io_wait(fd, POLLIN) == 0)
+        ;
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -67,7 +79,10 @@ ssize_t read(int fd, void *buf, size_t count)
  */
 ssize_t write(int fd, const void *buf, size_t count)
 {
-    long ret = vlibc_syscall(SYS_write, fd, (long)buf, count, 0, 0, 0);
+    long ret;
+    while ((ret = vlibc_syscall3(SYS_write, fd, (long)buf, count)) == -EAGAIN &&
+           __vlibc_io_wait && __vlibc_io_wait(fd, POLLOUT) == 0)
+        ;
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -83,7 +98,7 @@ ssize_t write(int fd, const void *buf, size_t count)
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
 {
 #ifdef SYS_readv
-    long ret = vlibc_syscall(SYS_readv, fd, (long)iov, iovcnt, 0, 0, 0);
+    long ret = vlibc_syscall3(SYS_readv, fd, (long)iov, iovcnt);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -123,7 +138,7 @@ ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
 {
 #ifdef SYS_writev
-    long ret = vlibc_syscall(SYS_writev, fd, (long)iov, iovcnt, 0, 0, 0);
+    long ret = vlibc_syscall3(SYS_writev, fd, (long)iov, iovcnt);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -166,9 +181,9 @@ ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
 ssize_t pread(int fd, void *buf, size_t count, off_t offset)
 {
 #ifdef SYS_pread
-    long ret = vlibc_syscall(SYS_pread, fd, (long)buf, count, offset, 0, 0);
+    long ret = vlibc_syscall4(SYS_pread, fd, (long)buf, count, offset);
 #elif defined(SYS_pread64)
-    long ret = vlibc_syscall(SYS_pread64, fd, (long)buf, count, offset, 0, 0);
+    long ret = vlibc_syscall4(SYS_pread64, fd, (long)buf, count, offset);
 #else
     extern ssize_t host_pread(int, void *, size_t, off_t) __asm__("pread");
     return host_pread(fd, buf, count, offset);
@@ -188,9 +203,9 @@ ssize_t pread(int fd, void *buf, size_t count, off_t offset)
 ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset)
 {
 #ifdef SYS_pwrite
-    long ret = vlibc_syscall(SYS_pwrite, fd, (long)buf, count, offset, 0, 0);
+    long ret = vlibc_syscall4(SYS_pwrite, fd, (long)buf, count, offset);
 #elif defined(SYS_pwrite64)
-    long ret = vlibc_syscall(SYS_pwrite64, fd, (long)buf, count, offset, 0, 0);
+    long ret = vlibc_syscall4(SYS_pwrite64, fd, (long)buf, count, offset);
 #else
     extern ssize_t host_pwrite(int, const void *, size_t, off_t) __asm__("pwrite");
     return host_pwrite(fd, buf, count, offset);
@@ -210,9 +225,9 @@ ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset)
 ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
 {
 #ifdef SYS_preadv
-    long ret = vlibc_syscall(SYS_preadv, fd, (long)iov, iovcnt, offset, 0, 0);
+    long ret = vlibc_syscall5(SYS_preadv, fd, (long)iov, iovcnt, offset, 0);
 #elif defined(SYS_preadv2)
-    long ret = vlibc_syscall(SYS_preadv2, fd, (long)iov, iovcnt, offset, 0, 0);
+    long ret = vlibc_syscall6(SYS_preadv2, fd, (long)iov, iovcnt, offset, 0, 0);
 #else
 #if defined(__FreeBSD__) || defined(__NetBSD__) || \
     defined(__OpenBSD__) || defined(__DragonFly__)
@@ -252,9 +267,9 @@ ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
 ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
 {
 #ifdef SYS_pwritev
-    long ret = vlibc_syscall(SYS_pwritev, fd, (long)iov, iovcnt, offset, 0, 0);
+    long ret = vlibc_syscall5(SYS_pwritev, fd, (long)iov, iovcnt, offset, 0);
 #elif defined(SYS_pwritev2)
-    long ret = vlibc_syscall(SYS_pwritev2, fd, (long)iov, iovcnt, offset, 0, 0);
+    long ret = vlibc_syscall6(SYS_pwritev2, fd, (long)iov, iovcnt, offset, 0, 0);
 #else
 #if defined(__FreeBSD__) || defined(__NetBSD__) || \
     defined(__OpenBSD__) || defined(__DragonFly__)
@@ -292,7 +307,7 @@ ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
 /* Close a file descriptor via SYS_close using vlibc_syscall. */
 int close(int fd)
 {
-    long ret = vlibc_syscall(SYS_close, fd, 0, 0, 0, 0, 0);
+    long ret = vlibc_syscall1(SYS_close, fd);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -315,7 +330,7 @@ int openat(int dirfd, const char *path, int flags, ...)
         va_end(ap);
     }
 #ifdef SYS_openat
-    long ret = vlibc_syscall(SYS_openat, dirfd, (long)path, flags, mode, 0, 0);
+    long ret = vlibc_syscall4(SYS_openat, dirfd, (long)path, flags, mode);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -335,14 +350,19 @@ int openat(int dirfd, const char *path, int flags, ...)
 }
 
 /*
- * fstatat wrapper issuing SYS_fstatat through vlibc_syscall.
- * On BSD when the syscall is missing, it calls the host
- * fstatat implementation.
+ * fstatat wrapper issuing SYS_fstatat (SYS_newfstatat on 64-bit Linux)
+ * through vlibc_syscall. On BSD when the syscall is missing, it calls
+ * the host fstatat implementation.
  */
 int fstatat(int dirfd, const char *path, struct stat *buf, int flags)
 {
-#ifdef SYS_fstatat
-    long ret = vlibc_syscall(SYS_fstatat, dirfd, (long)path, (long)buf, flags, 0, 0);
+#if defined(SYS_fstatat) || defined(SYS_newfstatat)
+#ifdef SYS_newfstatat
+    long ret = vlibc_syscall4(SYS_newfstatat, dirfd, (long)path, (long)buf,
+                              flags);
+#else
+    long ret = vlibc_syscall4(SYS_fstatat, dirfd, (long)path, (long)buf, flags);
+#endif
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -369,7 +389,7 @@ int fstatat(int dirfd, const char *path, struct stat *buf, int flags)
 int unlinkat(int dirfd, const char *pathname, int flags)
 {
 #ifdef SYS_unlinkat
-    long ret = vlibc_syscall(SYS_unlinkat, dirfd, (long)pathname, flags, 0, 0, 0);
+    long ret = vlibc_syscall3(SYS_unlinkat, dirfd, (long)pathname, flags);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -396,7 +416,7 @@ int unlinkat(int dirfd, const char *pathname, int flags)
 int mkdirat(int dirfd, const char *pathname, mode_t mode)
 {
 #ifdef SYS_mkdirat
-    long ret = vlibc_syscall(SYS_mkdirat, dirfd, (long)pathname, mode, 0, 0, 0);
+    long ret = vlibc_syscall3(SYS_mkdirat, dirfd, (long)pathname, mode);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -423,7 +443,7 @@ int mkdirat(int dirfd, const char *pathname, mode_t mode)
 int symlinkat(const char *target, int dirfd, const char *linkpath)
 {
 #ifdef SYS_symlinkat
-    long ret = vlibc_syscall(SYS_symlinkat, (long)target, dirfd, (long)linkpath, 0, 0, 0);
+    long ret = vlibc_syscall3(SYS_symlinkat, (long)target, dirfd, (long)linkpath);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -449,7 +469,7 @@ int symlinkat(const char *target, int dirfd, const char *linkpath)
 int fchdir(int fd)
 {
 #ifdef SYS_fchdir
-    long ret = vlibc_syscall(SYS_fchdir, fd, 0, 0, 0, 0, 0);
+    long ret = vlibc_syscall1(SYS_fchdir, fd);
     if (ret < 0) {
         errno = -ret;
         return -1;
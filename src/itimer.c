@@ -15,7 +15,7 @@
 int setitimer(int which, const struct itimerval *new, struct itimerval *old)
 {
 #ifdef SYS_setitimer
-    long ret = vlibc_syscall(SYS_setitimer, which, (long)new, (long)old, 0, 0, 0);
+    long ret = vlibc_syscall3(SYS_setitimer, which, (long)new, (long)old);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -36,7 +36,7 @@ int setitimer(int which, const struct itimerval *new, struct itimerval *old)
 int getitimer(int which, struct itimerval *curr)
 {
 #ifdef SYS_getitimer
-    long ret = vlibc_syscall(SYS_getitimer, which, (long)curr, 0, 0, 0, 0);
+    long ret = vlibc_syscall2(SYS_getitimer, which, (long)curr);
     if (ret < 0) {
         errno = -ret;
         return -1;
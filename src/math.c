@@ -7,9 +7,352 @@
  */
 
 #include "math.h"
+#include <stdint.h>
 
-/* Value of pi used by the trig approximations */
-static const double PI = 3.14159265358979323846;
+/*
+ * exp, log and pow split their argument into a table lookup and a short
+ * polynomial. sin and cos reduce the argument modulo pi/2 with a
+ * Cody-Waite split of pi/2 for moderate inputs and with the bits of 2/pi
+ * (Payne-Hanek) for large ones, then use minimax kernels on [-pi/4, pi/4].
+ * Intermediate sums are carried as double-double values where rounding
+ * would otherwise cost accuracy; the double functions stay within one
+ * ULP. The float variants compute in double with shorter polynomials.
+ */
+
+static const double PIO4 = 0x1.921fb54442d18p-1;
+static const double TOINT = 0x1.8p52;
+
+/* pi/2 as a double-double and split into 33-bit pieces for Cody-Waite */
+static const double PIO2_H = 0x1.921fb54442d18p+0;
+static const double PIO2_L = 0x1.1a62633145c07p-54;
+static const double INVPIO2 = 0x1.45f306dc9c883p-1;
+static const double PIO2_1 = 0x1.921fb544p+0;
+static const double PIO2_2 = 0x1.0b4611a6p-34;
+static const double PIO2_3 = 0x1.3198a2ep-69;
+static const double PIO2_3T = 0x1.b839a252049c1p-104;
+/* beyond 2^20 * pi/2 the Cody-Waite products are no longer exact */
+static const double PIO2_MEDIUM = 0x1.921fb54442d18p+20;
+
+/* 1216 bits of 2/pi, most significant first */
+static const uint64_t TWO_OVER_PI[19] = {
+    0xa2f9836e4e441529ULL, 0xfc2757d1f534ddc0ULL,
+    0xdb6295993c439041ULL, 0xfe5163abdebbc561ULL,
+    0xb7246e3a424dd2e0ULL, 0x06492eea09d1921cULL,
+    0xfe1deb1cb129a73eULL, 0xe88235f52ebb4484ULL,
+    0xe99c7026b45f7e41ULL, 0x3991d639835339f4ULL,
+    0x9c845f8bbdf9283bULL, 0x1ff897ffde05980fULL,
+    0xef2f118b5a0a6d1fULL, 0x6d367ecf27cb09b7ULL,
+    0x4f463f669e5fea2dULL, 0x7527bac7ebe5f17bULL,
+    0x3d0739f78a5292eaULL, 0x6bfb5fb11f8d5d08ULL,
+    0x56033046fc7b6babULL,
+};
+
+/* exp(): 2^(i/128) = hi * (1 + tail) */
+#define EXP_BITS 7
+#define EXP_N (1 << EXP_BITS)
+static const double INVLN2N = 0x1.71547652b82fep+7;
+static const double LN2HI_N = 0x1.62e42fefc0000p-8;
+static const double LN2LO_N = -0x1.c610ca86c3899p-44;
+static const double LN2_N = 0x1.62e42fefa39efp-8;
+static const double EXP_MAX = 0x1.62e42fefa39efp+9;
+static const double EXP_MIN = -0x1.74910d52d3051p+9;
+
+static const struct {
+    double hi;
+    double tail;
+} exp_table[EXP_N] = {
+    {0x1.0000000000000p+0, 0x0.0p+0},
+    {0x1.0163da9fb3335p+0, 0x1.b3b4f1a88bf6ep-54},
+    {0x1.02c9a3e778061p+0, -0x1.160139cd8dc5dp-56},
+    {0x1.04315e86e7f85p+0, -0x1.05e7a108766d1p-54},
+    {0x1.059b0d3158574p+0, 0x1.cd2523567f613p-55},
+    {0x1.0706b29ddf6dep+0, -0x1.bce8023f98efap-55},
+    {0x1.0874518759bc8p+0, 0x1.0f74e61e6c861p-57},
+    {0x1.09e3ecac6f383p+0, 0x1.0a3e45b33d399p-54},
+    {0x1.0b5586cf9890fp+0, 0x1.79aa65d837b6dp-54},
+    {0x1.0cc922b7247f7p+0, 0x1.eb51a92fdeffcp-55},
+    {0x1.0e3ec32d3d1a2p+0, 0x1.ebe3d702f9cd1p-60},
+    {0x1.0fb66affed31bp+0, -0x1.a033489906e0bp-57},
+    {0x1.11301d0125b51p+0, -0x1.556522a2fbd0ep-54},
+    {0x1.12abdc06c31ccp+0, -0x1.080ef8c4eea55p-58},
+    {0x1.1429aaea92de0p+0, -0x1.1c923b9d5f416p-54},
+    {0x1.15a98c8a58e51p+0, 0x1.0d3e3e95c55afp-55},
+    {0x1.172b83c7d517bp+0, -0x1.01b15eaa59348p-55},
+    {0x1.18af9388c8deap+0, -0x1.f1ff055de323dp-55},
+    {0x1.1a35beb6fcb75p+0, 0x1.b898c3f1353bfp-55},
+    {0x1.1bbe084045cd4p+0, -0x1.6d99c7611eb26p-54},
+    {0x1.1d4873168b9aap+0, 0x1.aecf73e3a2f60p-54},
+    {0x1.1ed5022fcd91dp+0, -0x1.fe782cb86389dp-55},
+    {0x1.2063b88628cd6p+0, 0x1.a6f4144a6c38dp-55},
+    {0x1.21f49917ddc96p+0, 0x1.07a05b0e4047dp-55},
+    {0x1.2387a6e756238p+0, 0x1.68efde3a8a894p-54},
+    {0x1.251ce4fb2a63fp+0, 0x1.75e18f274487dp-55},
+    {0x1.26b4565e27cddp+0, 0x1.0472b981fe7f2p-55},
+    {0x1.284dfe1f56381p+0, -0x1.6b87b3f71085ep-54},
+    {0x1.29e9df51fdee1p+0, 0x1.2f7e16d09ab31p-55},
+    {0x1.2b87fd0dad990p+0, -0x1.d219b1a6fbffap-60},
+    {0x1.2d285a6e4030bp+0, 0x1.b3782720c0ab4p-55},
+    {0x1.2ecafa93e2f56p+0, 0x1.e149289cecb8fp-57},
+    {0x1.306fe0a31b715p+0, 0x1.34d754db0abb6p-55},
+    {0x1.32170fc4cd831p+0, 0x1.64201e2ac744cp-55},
+    {0x1.33c08b26416ffp+0, 0x1.fdd395dd3f84ap-55},
+    {0x1.356c55f929ff1p+0, -0x1.6a3803b8e5b04p-55},
+    {0x1.371a7373aa9cbp+0, -0x1.24aedcc4b5068p-54},
+    {0x1.38cae6d05d866p+0, -0x1.907f81b512d8ep-54},
+    {0x1.3a7db34e59ff7p+0, -0x1.1d1e83e9436d2p-56},
+    {0x1.3c32dc313a8e5p+0, -0x1.91919b3ce1b15p-54},
+    {0x1.3dea64c123422p+0, 0x1.59f48a72a4c6dp-55},
+    {0x1.3fa4504ac801cp+0, -0x1.312607a28698ap-54},
+    {0x1.4160a21f72e2ap+0, -0x1.8a78f4817895bp-58},
+    {0x1.431f5d950a897p+0, -0x1.c2c9b67499a1bp-56},
+    {0x1.44e086061892dp+0, 0x1.363ed60c2ac11p-59},
+    {0x1.46a41ed1d0057p+0, 0x1.666093b0664efp-54},
+    {0x1.486a2b5c13cd0p+0, 0x1.ecce1daa10379p-57},
+    {0x1.4a32af0d7d3dep+0, 0x1.3ff8e3f0f1230p-54},
+    {0x1.4bfdad5362a27p+0, 0x1.690cebb7aafb0p-56},
+    {0x1.4dcb299fddd0dp+0, 0x1.31dbdeb54e077p-54},
+    {0x1.4f9b2769d2ca7p+0, -0x1.f94340071a38ep-55},
+    {0x1.516daa2cf6642p+0, -0x1.7deccdc93a349p-55},
+    {0x1.5342b569d4f82p+0, -0x1.8dec6bd0f385fp-56},
+    {0x1.551a4ca5d920fp+0, -0x1.61246ec7b5cf6p-55},
+    {0x1.56f4736b527dap+0, 0x1.3350518fdd78ep-54},
+    {0x1.58d12d497c7fdp+0, 0x1.b98b72f8a9b05p-56},
+    {0x1.5ab07dd485429p+0, 0x1.063e1e21c5409p-54},
+    {0x1.5c9268a5946b7p+0, 0x1.4c7855019c6eap-60},
+    {0x1.5e76f15ad2148p+0, 0x1.432e62b64c035p-54},
+    {0x1.605e1b976dc09p+0, -0x1.ce44a6199769fp-55},
+    {0x1.6247eb03a5585p+0, -0x1.c33c53bef4da8p-55},
+    {0x1.6434634ccc320p+0, -0x1.45378892be9aep-55},
+    {0x1.6623882552225p+0, -0x1.3cedd78565858p-54},
+    {0x1.68155d44ca973p+0, 0x1.710aa807e1964p-58},
+    {0x1.6a09e667f3bcdp+0, -0x1.3b3efbf5e2228p-54},
+    {0x1.6c012750bdabfp+0, -0x1.a12ad8734b982p-57},
+    {0x1.6dfb23c651a2fp+0, -0x1.367efb86da9eep-57},
+    {0x1.6ff7df9519484p+0, -0x1.0dc3d54e08851p-55},
+    {0x1.71f75e8ec5f74p+0, -0x1.81f647e5a3ecfp-56},
+    {0x1.73f9a48a58174p+0, -0x1.6ee4ac08b7db0p-55},
+    {0x1.75feb564267c9p+0, -0x1.619321e55e68ap-55},
+    {0x1.780694fde5d3fp+0, 0x1.09ccb5e09d4d3p-54},
+    {0x1.7a11473eb0187p+0, -0x1.b32dcb94da51dp-56},
+    {0x1.7c1ed0130c132p+0, 0x1.4ecfd5467c06bp-54},
+    {0x1.7e2f336cf4e62p+0, 0x1.5ebe1abd66c55p-57},
+    {0x1.80427543e1a12p+0, -0x1.8a1c52fb3cf42p-55},
+    {0x1.82589994cce13p+0, -0x1.369b6f13b3734p-54},
+    {0x1.8471a4623c7adp+0, -0x1.05e843a19ff1ep-55},
+    {0x1.868d99b4492edp+0, -0x1.4d450d872576ep-54},
+    {0x1.88ac7d98a6699p+0, 0x1.0ad675b0e8a00p-54},
+    {0x1.8ace5422aa0dbp+0, 0x1.db72fc1f0eab4p-55},
+    {0x1.8cf3216b5448cp+0, -0x1.5b6609cc5e7ffp-57},
+    {0x1.8f1ae99157736p+0, 0x1.bf68359f35f44p-56},
+    {0x1.9145b0b91ffc6p+0, -0x1.3091fa71e3d83p-54},
+    {0x1.93737b0cdc5e5p+0, -0x1.da9b88b6c1e29p-58},
+    {0x1.95a44cbc8520fp+0, -0x1.c23f97c90b959p-57},
+    {0x1.97d829fde4e50p+0, -0x1.2434322f4f9aap-54},
+    {0x1.9a0f170ca07bap+0, -0x1.5ca6cd7668e4bp-55},
+    {0x1.9c49182a3f090p+0, 0x1.1affc2b91ce27p-56},
+    {0x1.9e86319e32323p+0, 0x1.dd235e10a73bbp-57},
+    {0x1.a0c667b5de565p+0, -0x1.7c50422622263p-55},
+    {0x1.a309bec4a2d33p+0, 0x1.b1c86e3e231d5p-55},
+    {0x1.a5503b23e255dp+0, -0x1.1bbd1d3bcbb15p-54},
+    {0x1.a799e1330b358p+0, 0x1.0cc319cee31d2p-54},
+    {0x1.a9e6b5579fdbfp+0, 0x1.469846e735ab3p-55},
+    {0x1.ac36bbfd3f37ap+0, -0x1.2dfcd978e9db4p-55},
+    {0x1.ae89f995ad3adp+0, 0x1.c1a7792cb3387p-55},
+    {0x1.b0e07298db666p+0, -0x1.07b8f4ad1d9fap-54},
+    {0x1.b33a2b84f15fbp+0, -0x1.5c3d956dcaebap-58},
+    {0x1.b59728de5593ap+0, -0x1.0a40e3da6f640p-54},
+    {0x1.b7f76f2fb5e47p+0, -0x1.8d6f438ad9334p-57},
+    {0x1.ba5b030a1064ap+0, -0x1.1eee26b588a35p-54},
+    {0x1.bcc1e904bc1d2p+0, 0x1.4ffd70a5fddcdp-56},
+    {0x1.bf2c25bd71e09p+0, -0x1.1bdfbfa9298acp-54},
+    {0x1.c199bdd85529cp+0, 0x1.36eae30af0cb3p-56},
+    {0x1.c40ab5fffd07ap+0, 0x1.ee3325c9ffd94p-55},
+    {0x1.c67f12e57d14bp+0, 0x1.4e08fd10959acp-55},
+    {0x1.c8f6d9406e7b5p+0, 0x1.3cdaf384e1a67p-57},
+    {0x1.cb720dcef9069p+0, 0x1.76b2c6c921968p-57},
+    {0x1.cdf0b555dc3fap+0, -0x1.08a1883ccb5d2p-55},
+    {0x1.d072d4a07897cp+0, -0x1.fad5d3ffffa6fp-55},
+    {0x1.d2f87080d89f2p+0, -0x1.00dae3875a949p-54},
+    {0x1.d5818dcfba487p+0, 0x1.4a385a63d07a7p-56},
+    {0x1.d80e316c98398p+0, -0x1.2919e2040220fp-55},
+    {0x1.da9e603db3285p+0, 0x1.e5a50d5c192acp-55},
+    {0x1.dd321f301b460p+0, 0x1.43a59ac016b4bp-55},
+    {0x1.dfc97337b9b5fp+0, -0x1.2d52107b43e1fp-55},
+    {0x1.e264614f5a129p+0, -0x1.92ab93b470dc9p-55},
+    {0x1.e502ee78b3ff6p+0, 0x1.4b604603a88d3p-56},
+    {0x1.e7a51fbc74c83p+0, 0x1.3c5ec519d7271p-55},
+    {0x1.ea4afa2a490dap+0, -0x1.ff7128fd391f0p-55},
+    {0x1.ecf482d8e67f1p+0, -0x1.dae98e223747dp-55},
+    {0x1.efa1bee615a27p+0, 0x1.ec3bc41aa2008p-55},
+    {0x1.f252b376bba97p+0, 0x1.42b94c3a9eb32p-55},
+    {0x1.f50765b6e4540p+0, 0x1.a64a931d185eep-55},
+    {0x1.f7bfdad9cbe14p+0, -0x1.e37bae43be3edp-55},
+    {0x1.fa7c1819e90d8p+0, 0x1.7893b4d91cd9dp-56},
+    {0x1.fd3c22b8f71f1p+0, 0x1.305c14160cc89p-58},
+};
+
+/*
+ * log(): the reduced argument z lies in [0.75, 1.5) and is split into
+ * 96 intervals of width 1/128 centred on c = (i + 96.5) / 128.
+ */
+#define LOG_OFF 96
+static const double LN2_HI = 0x1.62e42ffp-1;
+static const double LN2_LO = -0x1.718432a1b0e26p-35;
+static const double LN2 = 0x1.62e42fefa39efp-1;
+
+static const struct {
+    double invc;
+    double logc;
+    double logctail;
+} log_table[96] = {
+    {0x1.5390948f40febp+0, -0x1.214456d0eb8d4p-2, -0x1.f7ae91aeba60ap-57},
+    {0x1.5015015015015p+0, -0x1.16b5ccbacfb73p-2, -0x1.66fbd28b40935p-56},
+    {0x1.4cab88725af6ep+0, -0x1.0c42d676162e3p-2, -0x1.162c79d5d11eep-58},
+    {0x1.49539e3b2d067p+0, -0x1.01eae5626c691p-2, 0x1.18290bd2932e2p-59},
+    {0x1.460cbc7f5cf9ap+0, -0x1.ef5ade4dcffe6p-3, 0x1.08ab2ddc708a0p-58},
+    {0x1.42d6625d51f87p+0, -0x1.db13db0d48940p-3, -0x1.aa11d49f96cb9p-58},
+    {0x1.3fb013fb013fbp+0, -0x1.c6ffbc6f00f71p-3, 0x1.8e58b2c57a4a5p-57},
+    {0x1.3c995a47babe7p+0, -0x1.b31d8575bce3dp-3, 0x1.6353ab386a94dp-57},
+    {0x1.3991c2c187f63p+0, -0x1.9f6c407089664p-3, -0x1.35a19605e67efp-59},
+    {0x1.3698df3de0748p+0, -0x1.8beafeb38fe8cp-3, -0x1.55aa8b6997a40p-58},
+    {0x1.33ae45b57bcb2p+0, -0x1.7898d85444c73p-3, -0x1.ef8f6ebcfb201p-58},
+    {0x1.30d190130d190p+0, -0x1.6574ebe8c133ap-3, 0x1.d34f0f4621bedp-60},
+    {0x1.2e025c04b8097p+0, -0x1.527e5e4a1b58dp-3, 0x1.71a9682395bfdp-61},
+    {0x1.2b404ad012b40p+0, -0x1.3fb45a59928ccp-3, 0x1.d87e6a354d056p-57},
+    {0x1.288b01288b013p+0, -0x1.2d1610c86813ap-3, 0x1.499a3f25af95fp-58},
+    {0x1.25e22708092f1p+0, -0x1.1aa2b7e23f72ap-3, 0x1.c6ef1d9b2ef7ep-59},
+    {0x1.23456789abcdfp+0, -0x1.08598b59e3a07p-3, 0x1.dd7009902bf32p-57},
+    {0x1.20b470c67c0d9p+0, -0x1.ec739830a1120p-4, 0x1.a2bf991780d3fp-59},
+    {0x1.1e2ef3b3fb874p+0, -0x1.c885801bc4b23p-4, -0x1.a38cb559a6706p-58},
+    {0x1.1bb4a4046ed29p+0, -0x1.a4e7640b1bc38p-4, 0x1.5b5ca203e4259p-58},
+    {0x1.19453808ca29cp+0, -0x1.8197e2f40e3f0p-4, -0x1.b9f2dffbeed43p-60},
+    {0x1.16e0689427379p+0, -0x1.5e95a4d9791cbp-4, -0x1.f38745c5c450ap-58},
+    {0x1.1485f0e0acd3bp+0, -0x1.3bdf5a7d1ee64p-4, -0x1.7a976d3b5b45fp-59},
+    {0x1.12358e75d3033p+0, -0x1.1973bd1465567p-4, 0x1.7558367a6acf6p-59},
+    {0x1.0fef010fef011p+0, -0x1.eea31c006b87cp-5, 0x1.3e4fc93b7b66cp-59},
+    {0x1.0db20a88f4696p+0, -0x1.aaef2d0fb10fcp-5, -0x1.a353bb42e0addp-61},
+    {0x1.0b7e6ec259dc8p+0, -0x1.67c94f2d4bb58p-5, -0x1.0413e6505e603p-59},
+    {0x1.0953f39010954p+0, -0x1.252f32f8d183fp-5, 0x1.947f792615916p-59},
+    {0x1.073260a47f7c6p+0, -0x1.c63d2ec14aaf2p-6, 0x1.ce030a686bd86p-60},
+    {0x1.05197f7d73404p+0, -0x1.432a925980cc1p-6, 0x1.8cdaf39004192p-60},
+    {0x1.03091b51f5e1ap+0, -0x1.82448a388a2aap-7, -0x1.04b16137f09a0p-62},
+    {0x1.0101010101010p+0, -0x1.0080559588b35p-8, -0x1.f96638cf63677p-62},
+    {0x1.fe01fe01fe020p-1, 0x1.ff00aa2b10bc0p-9, 0x1.2821ad5a6d353p-63},
+    {0x1.fa11caa01fa12p-1, 0x1.7dc475f810a77p-7, -0x1.16d7687d3df21p-62},
+    {0x1.f6310aca0dbb5p-1, 0x1.3cea44346a575p-6, -0x1.0cb5a902b3a1cp-62},
+    {0x1.f25f644230ab5p-1, 0x1.b9fc027af9198p-6, -0x1.0ae69229dc868p-64},
+    {0x1.ee9c7f8458e02p-1, 0x1.1b0d98923d980p-5, -0x1.e9ae889bac481p-60},
+    {0x1.eae807aba01ebp-1, 0x1.58a5bafc8e4d5p-5, -0x1.ce55c2b4e2b72p-59},
+    {0x1.e741aa59750e4p-1, 0x1.95c830ec8e3ebp-5, 0x1.f5a0e80520bf2p-59},
+    {0x1.e3a9179dc1a73p-1, 0x1.d276b8adb0b52p-5, 0x1.1e3c53257fd47p-61},
+    {0x1.e01e01e01e01ep-1, 0x1.075983598e471p-4, 0x1.80da5333c45b8p-59},
+    {0x1.dca01dca01dcap-1, 0x1.253f62f0a1417p-4, -0x1.c125963fc4cfdp-62},
+    {0x1.d92f2231e7f8ap-1, 0x1.42edcbea646f0p-4, 0x1.ddd4f935996c9p-59},
+    {0x1.d5cac807572b2p-1, 0x1.60658a93750c4p-4, -0x1.388458ec21b6ap-58},
+    {0x1.d272ca3fc5b1ap-1, 0x1.7da766d7b12cdp-4, -0x1.eeedfcdd94131p-58},
+    {0x1.cf26e5c44bfc6p-1, 0x1.9ab42462033adp-4, -0x1.2099e1c184e8ep-59},
+    {0x1.cbe6d9601cbe7p-1, 0x1.b78c82bb0eda1p-4, 0x1.0878cf0327e21p-61},
+    {0x1.c8b265afb8a42p-1, 0x1.d4313d66cb35dp-4, 0x1.790dd951d90fap-58},
+    {0x1.c5894d10d4986p-1, 0x1.f0a30c01162a6p-4, 0x1.85f325c5bbacdp-58},
+    {0x1.c26b5392ea01cp-1, 0x1.0671512ca596ep-3, 0x1.50c647eb86499p-58},
+    {0x1.bf583ee868d8bp-1, 0x1.14785846742acp-3, 0x1.a28813e3a7f07p-57},
+    {0x1.bc4fd65883e7bp-1, 0x1.2266f190a5acbp-3, 0x1.f547bf1809e88p-57},
+    {0x1.b951e2b18ff23p-1, 0x1.303d718e47fd3p-3, -0x1.6b9c7d96091fap-63},
+    {0x1.b65e2e3beee05p-1, 0x1.3dfc2b0ecc62ap-3, -0x1.ab3a8e7d81017p-58},
+    {0x1.b37484ad806cep-1, 0x1.4ba36f39a55e5p-3, 0x1.68981bcc36756p-57},
+    {0x1.b094b31d922a4p-1, 0x1.59338d9982086p-3, -0x1.65d22aa8ad7cfp-58},
+    {0x1.adbe87f94905ep-1, 0x1.66acd4272ad51p-3, -0x1.0900e4e1ea8b2p-58},
+    {0x1.aaf1d2f87ebfdp-1, 0x1.740f8f54037a5p-3, -0x1.b264062a84cdbp-58},
+    {0x1.a82e65130e159p-1, 0x1.815c0a14357ebp-3, -0x1.4be48073a0564p-58},
+    {0x1.a574107688a4ap-1, 0x1.8e928de886d41p-3, -0x1.569d851a56770p-57},
+    {0x1.a2c2a87c51ca0p-1, 0x1.9bb362e7dfb83p-3, 0x1.575e31f003e0cp-57},
+    {0x1.a01a01a01a01ap-1, 0x1.a8becfc882f19p-3, -0x1.e8c37918c39ebp-58},
+    {0x1.9d79f176b682dp-1, 0x1.b5b519e8fb5a4p-3, 0x1.ba27fdc19e1a0p-57},
+    {0x1.9ae24ea5510dap-1, 0x1.c2968558c18c1p-3, -0x1.73dee38a3fb6bp-57},
+    {0x1.9852f0d8ec0ffp-1, 0x1.cf6354e09c5dcp-3, 0x1.239a07d55b695p-57},
+    {0x1.95cbb0be377aep-1, 0x1.dc1bca0abec7dp-3, 0x1.834c51998b6fcp-57},
+    {0x1.934c67f9b2ce6p-1, 0x1.e8c0252aa5a60p-3, -0x1.6e03a39bfc89bp-59},
+    {0x1.90d4f120190d5p-1, 0x1.f550a564b7b37p-3, 0x1.c5f6dfd018c37p-61},
+    {0x1.8e6527af1373fp-1, 0x1.00e6c45ad501dp-2, -0x1.cb9568ff6feadp-57},
+    {0x1.8bfce8062ff3ap-1, 0x1.071b85fcd590dp-2, 0x1.d1707f97bde80p-58},
+    {0x1.899c0f601899cp-1, 0x1.0d46b579ab74bp-2, 0x1.03ec81c3cbd92p-57},
+    {0x1.87427bcc092b9p-1, 0x1.136870293a8b0p-2, 0x1.7b66298edd24ap-56},
+    {0x1.84f00c2780614p-1, 0x1.1980d2dd4236fp-2, 0x1.9d3d1b0e4d147p-56},
+    {0x1.82a4a0182a4a0p-1, 0x1.1f8ff9e48a2f3p-2, -0x1.c9fdf9a0c4b07p-56},
+    {0x1.8060180601806p-1, 0x1.2596010df763ap-2, -0x1.0f76c57075e9ep-58},
+    {0x1.7e225515a4f1dp-1, 0x1.2b9303ab89d25p-2, -0x1.896b5fd852ad4p-56},
+    {0x1.7beb3922e017cp-1, 0x1.31871c9544185p-2, -0x1.51acc4c09b379p-60},
+    {0x1.79baa6bb6398bp-1, 0x1.3772662bfd85bp-2, -0x1.b5629d8117de7p-59},
+    {0x1.77908119ac60dp-1, 0x1.3d54fa5c1f710p-2, -0x1.e3265c6a1c98dp-56},
+    {0x1.756cac201756dp-1, 0x1.432ef2a04e814p-2, -0x1.29931715ac903p-56},
+    {0x1.734f0c541fe8dp-1, 0x1.49006804009d1p-2, -0x1.9ffc341f177dcp-57},
+    {0x1.713786d9c7c09p-1, 0x1.4ec973260026ap-2, -0x1.42a87d977dc5ep-56},
+    {0x1.6f26016f26017p-1, 0x1.548a2c3add263p-2, -0x1.819cf7e308ddbp-57},
+    {0x1.6d1a62681c861p-1, 0x1.5a42ab0f4cfe2p-2, -0x1.8ebcb7dee9a3dp-56},
+    {0x1.6b1490aa31a3dp-1, 0x1.5ff3070a793d4p-2, -0x1.bc60efafc6f6ep-57},
+    {0x1.691473a88d0c0p-1, 0x1.659b57303e1f3p-2, -0x1.f893d41c411f1p-56},
+    {0x1.6719f3601671ap-1, 0x1.6b3bb2235943ep-2, -0x1.da856ccd987b3p-56},
+    {0x1.6524f853b4aa3p-1, 0x1.70d42e2789236p-2, -0x1.52cc811d78d59p-57},
+    {0x1.63356b88ac0dep-1, 0x1.7664e1239dbcfp-2, -0x1.f6d5d64f5daf8p-57},
+    {0x1.614b36831ae94p-1, 0x1.7bede0a37afc0p-2, -0x1.8783cb9801a5cp-56},
+    {0x1.5f66434292dfcp-1, 0x1.816f41da0d496p-2, -0x1.2923ca04b701cp-56},
+    {0x1.5d867c3ece2a5p-1, 0x1.86e919a330ba0p-2, 0x1.3f9b16feb7dd8p-59},
+    {0x1.5babcc647fa91p-1, 0x1.8c5b7c858b48bp-2, -0x1.e0ab4fdfa0595p-56},
+    {0x1.59d61f123ccaap-1, 0x1.91c67eb45a83ep-2, -0x1.e0e0ae234ae11p-56},
+    {0x1.5805601580560p-1, 0x1.972a341135158p-2, 0x1.a5c09d24b70d9p-56},
+    {0x1.56397ba7c52e2p-1, 0x1.9c86b02dc0863p-2, -0x1.917eeb69dd421p-56},
+};
+
+/* Polynomial coefficients, Chebyshev-economized on the reduced ranges. */
+static const double EXP_C[4] = {
+    0x1.fffffffffff57p-2, 0x1.55555555554ddp-3,
+    0x1.55555acf8df8ep-5, 0x1.111114faa73bbp-7,
+};
+static const double EXPF_C[2] = { 0x1.00000522951e9p-1, 0x1.55555b7ed50fbp-3 };
+/* (log1p(u) - u + u^2/2) / u^3 for |u| <= 1/192 and |u| <= 1/128 */
+static const double LOG_C[6] = {
+    0x1.5555555555557p-2, -0x1.0000000000004p-2, 0x1.99999998050afp-3,
+    -0x1.555555531ef37p-3, 0x1.2494a7f92fc2dp-3, -0x1.00027d2c9026ap-3,
+};
+static const double LOG1_C[7] = {
+    0x1.5555555555555p-2, -0x1.000000000002dp-2, 0x1.9999999999a54p-3,
+    -0x1.5555554a21e22p-3, 0x1.249249160649fp-3, -0x1.000599b199f7ep-3,
+    0x1.c72814e73a013p-4,
+};
+/* (log1p(u) - u) / u^2 for the float variant */
+static const double LOGF_C[3] = {
+    -0x1.ffffffffbc931p-2, 0x1.55566667875d6p-2, -0x1.00012f69c71e7p-2,
+};
+static const double LOGF1_C[3] = {
+    -0x1.fffffffeaaa5bp-2, 0x1.5557bbc172a6bp-2, -0x1.0002aab22ac11p-2,
+};
+/* float sin/cos kernels in z = x^2 on [0, (pi/4)^2] */
+static const double SINF_C[4] = {
+    -0x1.555555545e482p-3, 0x1.11110def9d4f3p-7,
+    -0x1.a013a80b1a1fdp-13, 0x1.6dbe284317362p-19,
+};
+static const double COSF_C[5] = {
+    -0x1.fffffffffe69dp-2, 0x1.5555555150014p-5, -0x1.6c16bae67a3fdp-10,
+    0x1.a0129931c34e8p-16, -0x1.2474f3a36d0e6p-22,
+};
+
+static inline uint64_t asuint64(double x)
+{
+    union { double f; uint64_t i; } u = { x };
+    return u.i;
+}
+
+static inline double asdouble(uint64_t i)
+{
+    union { uint64_t i; double f; } u = { i };
+    return u.f;
+}
+
+/* 2^e for exponents in the normal range */
+static inline double pow2i(int e)
+{
+    return asdouble((uint64_t)(0x3ff + e) << 52);
+}
 
 /*
  * fabs_approx() - lightweight absolute value used internally.
@@ -20,138 +363,551 @@ static double fabs_approx(double x)
 }
 
 /*
- * sin() - compute sine using a Taylor series approximation.
- * The input is reduced to the range [-pi, pi] for better accuracy.
+ * Error-free transformations. two_sum() and fast_two_sum() return the
+ * rounded sum and store the rounding error in *err; fast_two_sum()
+ * requires |a| >= |b|. two_prod() does the same for a product using
+ * Veltkamp splitting, so it needs no fused multiply-add.
+ */
+static inline double two_sum(double a, double b, double *err)
+{
+    double s = a + b;
+    double bb = s - a;
+    *err = (a - (s - bb)) + (b - bb);
+    return s;
+}
+
+static inline double fast_two_sum(double a, double b, double *err)
+{
+    double s = a + b;
+    *err = b - (s - a);
+    return s;
+}
+
+static inline void split(double a, double *hi, double *lo)
+{
+    double c = 0x1.0000002p27 * a;
+    *hi = c - (c - a);
+    *lo = a - *hi;
+}
+
+static inline double two_prod(double a, double b, double *err)
+{
+    double p = a * b;
+    double ah, al, bh, bl;
+    split(a, &ah, &al);
+    split(b, &bh, &bl);
+    *err = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+    return p;
+}
+
+/*
+ * rem_pio2_large() - Payne-Hanek reduction for |x| >= 2^20 * pi/2.
+ * x = m * 2^s is multiplied by a 192-bit window of 2/pi chosen so that
+ * the discarded leading bits only contribute multiples of 4 to the
+ * product. Two integer bits give the quadrant and the next 128 bits the
+ * fraction, which is scaled back by pi/2 into *hi + *lo.
+ */
+static int rem_pio2_large(double x, double *hi, double *lo)
+{
+    uint64_t ix = asuint64(x);
+    int s = (int)((ix >> 52) & 0x7ff) - 1075;
+    uint64_t m = (ix & 0x000fffffffffffffULL) | 0x0010000000000000ULL;
+
+    int j0 = s >= 2 ? s - 1 : 1;
+    int idx = (j0 - 1) / 64, sh = (j0 - 1) % 64;
+    uint64_t w[3];
+    for (int k = 0; k < 3; k++)
+        w[k] = sh ? (TWO_OVER_PI[idx + k] << sh) |
+                    (TWO_OVER_PI[idx + k + 1] >> (64 - sh))
+                  : TWO_OVER_PI[idx + k];
+
+    uint64_t p[4];
+    unsigned __int128 t = (unsigned __int128)m * w[2];
+    p[0] = (uint64_t)t;
+    t = (unsigned __int128)m * w[1] + (uint64_t)(t >> 64);
+    p[1] = (uint64_t)t;
+    t = (unsigned __int128)m * w[0] + (uint64_t)(t >> 64);
+    p[2] = (uint64_t)t;
+    p[3] = (uint64_t)(t >> 64);
+
+    /* move the binary point of the product to bit 128 */
+    int d = j0 + 191 - s - 128;
+    int ws = d / 64, bs = d % 64;
+    uint64_t f[3];
+    for (int k = 0; k < 3; k++) {
+        uint64_t next = k + ws + 1 < 4 ? p[k + ws + 1] : 0;
+        f[k] = bs ? (p[k + ws] >> bs) | (next << (64 - bs)) : p[k + ws];
+    }
+
+    int n = (int)(f[2] & 3);
+    uint64_t fh = f[1], fl = f[0];
+    int neg = 0;
+    if (fh >> 63) {
+        /* fraction >= 1/2: round the quadrant up, remainder negative */
+        n++;
+        fh = ~fh;
+        fl = ~fl;
+        if (++fl == 0)
+            fh++;
+        neg = 1;
+    }
+
+    int shift = 0;
+    if (fh == 0) {
+        fh = fl;
+        fl = 0;
+        shift = 64;
+    }
+    if (fh == 0) {
+        *hi = *lo = 0.0;
+        return n;
+    }
+    int lz = __builtin_clzll(fh);
+    if (lz) {
+        fh = (fh << lz) | (fl >> (64 - lz));
+        fl <<= lz;
+    }
+    shift += lz;
+
+    double f1 = (double)(fh & ~0x7ffULL) * pow2i(-64 - shift);
+    double f2 = (double)(((fh & 0x7ff) << 53) | (fl >> 11)) *
+                pow2i(-117 - shift);
+    double e;
+    double r = two_prod(f1, PIO2_H, &e);
+    e += f1 * PIO2_L + f2 * PIO2_H;
+    r = fast_two_sum(r, e, lo);
+    if (neg != (x < 0)) {
+        r = -r;
+        *lo = -*lo;
+    }
+    *hi = r;
+    return x < 0 ? -n : n;
+}
+
+/*
+ * rem_pio2() - reduce x to *hi + *lo = x - n*pi/2 with |*hi| close to
+ * pi/4 at most and return n. The four-part Cody-Waite split of pi/2 has
+ * products that are exact for n < 2^20.
+ */
+static int rem_pio2(double x, double *hi, double *lo)
+{
+    if (fabs_approx(x) >= PIO2_MEDIUM)
+        return rem_pio2_large(x, hi, lo);
+
+    double fn = x * INVPIO2 + TOINT;
+    fn -= TOINT;
+    double t = x - fn * PIO2_1;
+    double e1, e2;
+    double y = two_sum(t, -(fn * PIO2_2), &e1);
+    y = two_sum(y, -(fn * PIO2_3), &e2);
+    double l = (e1 + e2) - fn * PIO2_3T;
+    *hi = fast_two_sum(y, l, lo);
+    return (int)fn;
+}
+
+/*
+ * kernel_sin() and kernel_cos() - minimax approximations of sin and cos
+ * of x + y for |x| <= pi/4, where y is the tail of the reduced argument.
+ * iy is zero when y is known to be zero.
+ */
+static double kernel_sin(double x, double y, int iy)
+{
+    static const double S1 = -1.66666666666666324348e-01,
+                        S2 = 8.33333333332248946124e-03,
+                        S3 = -1.98412698298579493134e-04,
+                        S4 = 2.75573137070700676789e-06,
+                        S5 = -2.50507602534068634195e-08,
+                        S6 = 1.58969099521155010221e-10;
+    double z = x * x;
+    double v = z * x;
+    double r = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+    if (iy == 0)
+        return x + v * (S1 + z * r);
+    return x - ((z * (0.5 * y - v * r) - y) - v * S1);
+}
+
+static double kernel_cos(double x, double y)
+{
+    static const double C1 = 4.16666666666666019037e-02,
+                        C2 = -1.38888888888741095749e-03,
+                        C3 = 2.48015872894767294178e-05,
+                        C4 = -2.75573143513906633035e-07,
+                        C5 = 2.08757232129817482790e-09,
+                        C6 = -1.13596475577881948265e-11;
+    double z = x * x;
+    double w = z * z;
+    double r = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+    double hz = 0.5 * z;
+    w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + (z * r - x * y));
+}
+
+/*
+ * sin() - compute sine. Arguments beyond pi/4 are reduced modulo pi/2
+ * and the quadrant selects the kernel and sign.
  */
 double sin(double x)
 {
-    while (x > PI)
-        x -= 2.0 * PI;
-    while (x < -PI)
-        x += 2.0 * PI;
+    double ax = fabs_approx(x);
+    if (ax <= PIO4) {
+        if (ax < 0x1p-26)
+            return x;
+        return kernel_sin(x, 0.0, 0);
+    }
+    if (!(ax < __builtin_inf()))
+        return x - x;
 
-    double term = x;
-    double sum = x;
-    for (int i = 1; i < 10; ++i) {
-        term *= -x * x / ((2 * i) * (2 * i + 1));
-        sum += term;
+    double hi, lo;
+    switch (rem_pio2(x, &hi, &lo) & 3) {
+    case 0:
+        return kernel_sin(hi, lo, 1);
+    case 1:
+        return kernel_cos(hi, lo);
+    case 2:
+        return -kernel_sin(hi, lo, 1);
+    default:
+        return -kernel_cos(hi, lo);
     }
-    return sum;
 }
 
 /*
- * cos() - compute cosine using a Taylor series approximation.
- * The angle is reduced similarly to sin().
+ * cos() - compute cosine using the same reduction as sin().
  */
 double cos(double x)
 {
-    while (x > PI)
-        x -= 2.0 * PI;
-    while (x < -PI)
-        x += 2.0 * PI;
+    double ax = fabs_approx(x);
+    if (ax <= PIO4) {
+        if (ax < 0x1p-27)
+            return 1.0;
+        return kernel_cos(x, 0.0);
+    }
+    if (!(ax < __builtin_inf()))
+        return x - x;
 
-    double term = 1.0;
-    double sum = 1.0;
-    for (int i = 1; i < 10; ++i) {
-        term *= -x * x / ((2 * i - 1) * (2 * i));
-        sum += term;
+    double hi, lo;
+    switch (rem_pio2(x, &hi, &lo) & 3) {
+    case 0:
+        return kernel_cos(hi, lo);
+    case 1:
+        return -kernel_sin(hi, lo, 1);
+    case 2:
+        return -kernel_cos(hi, lo);
+    default:
+        return kernel_sin(hi, lo, 1);
     }
-    return sum;
 }
 
 /*
- * tan() - compute tangent as sin(x)/cos(x).
- * Returns 0 when cosine is zero to avoid division by zero.
+ * tan() - compute tangent as the ratio of the sine and cosine kernels
+ * on the reduced argument.
  */
 double tan(double x)
 {
-    double s = sin(x);
-    double c = cos(x);
-    return c == 0.0 ? 0.0 : s / c;
+    double ax = fabs_approx(x);
+    if (ax <= PIO4) {
+        if (ax < 0x1p-27)
+            return x;
+        return kernel_sin(x, 0.0, 0) / kernel_cos(x, 0.0);
+    }
+    if (!(ax < __builtin_inf()))
+        return x - x;
+
+    double hi, lo;
+    int n = rem_pio2(x, &hi, &lo);
+    double s = kernel_sin(hi, lo, 1);
+    double c = kernel_cos(hi, lo);
+    return (n & 1) ? -c / s : s / c;
 }
 
 /*
- * sqrt() - compute square root using Newton's method.
- * Returns 0 for non-positive inputs.
+ * sqrt() - compute the square root. Targets with a hardware square root
+ * use it through the compiler builtin; others fall back to Newton's
+ * method. Negative inputs yield NaN.
  */
+#if defined(__SSE2__) || defined(__aarch64__) || \
+    (defined(__arm__) && defined(__ARM_FP) && (__ARM_FP & 8))
+#define VLIBC_HW_SQRT 1
+#endif
+
 double sqrt(double x)
 {
-    if (x <= 0.0)
-        return 0.0;
+    /* NaN and negative inputs must not reach the builtin, which would
+     * call back into sqrt() to report the domain error */
+    if (!(x >= 0.0))
+        return x < 0.0 ? (x - x) / (x - x) : x;
+#ifdef VLIBC_HW_SQRT
+    return __builtin_sqrt(x);
+#else
+    if (x == 0.0 || x == __builtin_inf())
+        return x;
 
     double guess = x;
     for (int i = 0; i < 20; ++i)
         guess = 0.5 * (guess + x / guess);
     return guess;
+#endif
 }
 
 /*
- * log_approx() - natural logarithm approximation using
- * an arithmetic series expansion.
+ * exp_inline() - e^(x + xtail) for EXP_MIN <= x <= EXP_MAX. x is split
+ * into k*ln2/128 + r with |r| <= ln2/256, giving
+ * 2^(k/128) * e^r = 2^(k>>7) * table[k&127] * e^r.
  */
-static double log_approx(double x)
+static double exp_inline(double x, double xtail)
 {
-    if (x <= 0.0)
-        return 0.0;
-    double y = (x - 1.0) / (x + 1.0);
-    double y2 = y * y;
-    double term = y;
-    double sum = 0.0;
-    for (int i = 1; i < 10; i += 2) {
-        sum += term / i;
-        term *= y2;
+    double kd = x * INVLN2N + TOINT;
+    kd -= TOINT;
+    int k = (int)kd;
+    double r = (x - kd * LN2HI_N) - kd * LN2LO_N + xtail;
+    int i = k & (EXP_N - 1);
+    int e = (k - i) / EXP_N;
+
+    double r2 = r * r;
+    double p = r + r2 * (EXP_C[0] + r * EXP_C[1] +
+                         r2 * (EXP_C[2] + r * EXP_C[3]));
+    double tmp = exp_table[i].tail + p;
+    uint64_t hi = asuint64(exp_table[i].hi);
+
+    if (e > 1000) {
+        /* keep the scale finite and apply the rest of it afterwards */
+        double scale = asdouble(hi + ((uint64_t)(int64_t)(e - 64) << 52));
+        return (scale + scale * tmp) * 0x1p64;
     }
-    return 2.0 * sum;
+    if (e < -1000) {
+        /*
+         * The result may be subnormal. Compute it scaled by 2^1022 and,
+         * below 1.0, round once at the subnormal ULP by adding 1.0.
+         */
+        double scale = asdouble(hi + ((uint64_t)(int64_t)(e + 1022) << 52));
+        double y = scale + scale * tmp;
+        if (y < 1.0) {
+            double lo = scale - y + scale * tmp;
+            double h = 1.0 + y;
+            lo = 1.0 - h + y + lo;
+            y = (h + lo) - 1.0;
+        }
+        return y * 0x1p-1022;
+    }
+    double scale = asdouble(hi + ((uint64_t)(int64_t)e << 52));
+    return scale + scale * tmp;
+}
+
+/* Return e raised to the given power. */
+double exp(double x)
+{
+    if (x != x)
+        return x + x;
+    if (x > EXP_MAX)
+        return __builtin_inf();
+    if (x < EXP_MIN)
+        return 0.0;
+    if (fabs_approx(x) < 0x1p-54)
+        return 1.0 + x;
+    return exp_inline(x, 0.0);
 }
 
 /*
- * exp_approx() - approximate exponential function using
- * a truncated power series.
+ * log_reduce() - write the positive finite x as 2^k * z with z in
+ * [0.75, 1.5) and return the table index for z. *uhi + *ulo is
+ * (z - c) / c to about 100 bits: the product of the 26-bit halves of the
+ * first quotient with the 9-bit c is exact, so its residual can be
+ * recovered.
  */
-static double exp_approx(double x)
+static int log_reduce(double x, int *k, double *uhi, double *ulo)
 {
-    double term = 1.0;
-    double sum = 1.0;
-    for (int i = 1; i <= 10; ++i) {
-        term *= x / i;
-        sum += term;
+    uint64_t ix = asuint64(x);
+    int kk = 0;
+    if (ix < 0x0010000000000000ULL) {
+        ix = asuint64(x * 0x1p54);
+        kk = -54;
     }
-    return sum;
+    int64_t top = (int64_t)(ix - 0x3fe8000000000000ULL) >> 52;
+    double z = asdouble(ix - ((uint64_t)top << 52));
+    *k = kk + (int)top;
+
+    int i = (int)(z * 128.0) - LOG_OFF;
+    double c = (double)(2 * i + 2 * LOG_OFF + 1) * 0x1p-8;
+    double invc = log_table[i].invc;
+    double f = z - c;
+    double u = f * invc;
+    double a, b;
+    split(u, &a, &b);
+    *uhi = u;
+    *ulo = ((f - a * c) - b * c) * invc;
+    return i;
+}
+
+static inline double log1_poly(double f)
+{
+    return LOG1_C[0] + f * (LOG1_C[1] + f * (LOG1_C[2] + f * (LOG1_C[3] +
+           f * (LOG1_C[4] + f * (LOG1_C[5] + f * LOG1_C[6])))));
+}
+
+static inline double log_poly(double u)
+{
+    return LOG_C[0] + u * (LOG_C[1] + u * (LOG_C[2] + u * (LOG_C[3] +
+           u * (LOG_C[4] + u * LOG_C[5]))));
+}
+
+/* Arguments this close to 1 use log1p's series around 1 directly. */
+static inline int log_near_one(double x)
+{
+    return x >= 1.0 - 0x1p-7 && x < 1.0 + 0x1p-7;
 }
 
 /*
- * pow() - raise a base to an exponent using repeated
- * multiplication or the exp/log identities for fractional
- * exponents.
+ * log_core() - natural logarithm of a positive finite x as
+ * k*ln2 + log(c) + log1p(u), summing the leading terms exactly.
  */
-double pow(double base, double exp)
+static double log_core(double x)
 {
-    if (exp == 0.0)
-        return 1.0;
-    if (exp < 0.0)
-        return 1.0 / pow(base, -exp);
-
-    int iexp = (int)exp;
-    if (fabs_approx(exp - iexp) < 1e-9) {
-        double result = 1.0;
-        for (int i = 0; i < iexp; ++i)
-            result *= base;
-        return result;
+    if (log_near_one(x)) {
+        double f = x - 1.0;
+        double f2 = f * f;
+        return f + (f2 * f * log1_poly(f) - 0.5 * f2);
     }
 
-    return exp_approx(exp * log_approx(base));
+    int k;
+    double u, ulo;
+    int i = log_reduce(x, &k, &u, &ulo);
+    double e1, e2;
+    double t = fast_two_sum(k * LN2_HI, log_table[i].logc, &e1);
+    t = fast_two_sum(t, u, &e2);
+    double u2 = u * u;
+    double q = u2 * u * log_poly(u) - 0.5 * u2;
+    double lo = e1 + e2 + log_table[i].logctail + k * LN2_LO + ulo;
+    return t + (lo + q);
 }
 
-/* Return the natural logarithm using log_approx. */
+/* Return the natural logarithm. */
 double log(double x)
 {
-    return log_approx(x);
+    if (x != x)
+        return x + x;
+    if (x <= 0.0)
+        return x == 0.0 ? -__builtin_inf() : (x - x) / (x - x);
+    if (x == __builtin_inf())
+        return x;
+    return log_core(x);
 }
 
-/* Return e raised to the given power using exp_approx. */
-double exp(double x)
+/*
+ * log_dd() - log(x) as a double-double *hi + return value for pow().
+ * The u^2/2 term is also formed exactly since y * log(x) magnifies any
+ * error in it.
+ */
+static double log_dd(double x, double *hi)
+{
+    double s, se, e1, e2, e3, lo;
+    if (log_near_one(x)) {
+        double f = x - 1.0;
+        s = two_prod(f, f, &se);
+        double h = fast_two_sum(f, -0.5 * s, &e1);
+        lo = e1 - 0.5 * se + f * s * log1_poly(f);
+        *hi = fast_two_sum(h, lo, &lo);
+        return lo;
+    }
+
+    int k;
+    double u, ulo;
+    int i = log_reduce(x, &k, &u, &ulo);
+    double t = fast_two_sum(k * LN2_HI, log_table[i].logc, &e1);
+    t = fast_two_sum(t, u, &e2);
+    s = two_prod(u, u, &se);
+    t = fast_two_sum(t, -0.5 * s, &e3);
+    lo = e1 + e2 + e3 + log_table[i].logctail + k * LN2_LO + ulo -
+         0.5 * se - u * ulo + s * u * log_poly(u);
+    *hi = fast_two_sum(t, lo, &lo);
+    return lo;
+}
+
+/*
+ * int_class() - 0 when y is not an integer, 1 for odd integers and 2 for
+ * even ones.
+ */
+static int int_class(double y)
 {
-    return exp_approx(x);
+    uint64_t iy = asuint64(y);
+    int e = (int)((iy >> 52) & 0x7ff);
+    if (e < 0x3ff)
+        return 0;
+    if (e > 0x3ff + 52)
+        return 2;
+    uint64_t unit = 1ULL << (0x3ff + 52 - e);
+    if (iy & (unit - 1))
+        return 0;
+    return (iy & unit) ? 1 : 2;
+}
+
+/*
+ * pow_special() - handle the special operands of pow(). Returns 1 with
+ * the result in *res, or 0 with x replaced by |x| and *sign set to the
+ * sign of the result.
+ */
+static int pow_special(double *x, double y, double *res, double *sign)
+{
+    double ax = fabs_approx(*x), ay = fabs_approx(y);
+    double inf = __builtin_inf();
+
+    *sign = 1.0;
+    if (y == 0.0 || *x == 1.0) {
+        *res = 1.0;
+        return 1;
+    }
+    if (*x != *x || y != y) {
+        *res = *x + y;
+        return 1;
+    }
+    if (ay == inf) {
+        if (ax == 1.0)
+            *res = 1.0;
+        else
+            *res = (ax < 1.0) == (y < 0.0) ? inf : 0.0;
+        return 1;
+    }
+    if (asuint64(*x) >> 63) {
+        int yint = int_class(y);
+        if (yint == 0 && ax != 0.0 && ax != inf) {
+            *res = (*x - *x) / (*x - *x);
+            return 1;
+        }
+        if (yint == 1)
+            *sign = -1.0;
+    }
+    if (ax == 0.0 || ax == inf) {
+        *res = *sign * ((ax == 0.0) == (y < 0.0) ? inf : 0.0);
+        return 1;
+    }
+    *x = ax;
+    return 0;
+}
+
+/*
+ * pow() - raise a base to an exponent as exp(y * log(x)), carrying
+ * log(x) and the product in double-double precision.
+ */
+double pow(double base, double exp)
+{
+    double res, sign;
+    if (pow_special(&base, exp, &res, &sign))
+        return res;
+
+    double lhi, llo = log_dd(base, &lhi);
+    double ehi = exp * lhi;
+    if (ehi > EXP_MAX + 1.0)
+        return sign * __builtin_inf();
+    if (ehi < EXP_MIN - 1.0)
+        return sign * 0.0;
+
+    double elo;
+    ehi = two_prod(exp, lhi, &elo);
+    elo += exp * llo;
+    ehi = fast_two_sum(ehi, elo, &elo);
+    if (ehi > EXP_MAX)
+        return sign * __builtin_inf();
+    if (ehi < EXP_MIN)
+        return sign * 0.0;
+    return sign * exp_inline(ehi, elo);
 }
 
 /* Round toward negative infinity. */
@@ -177,3 +933,167 @@ double fabs(double x)
 {
     return x < 0.0 ? -x : x;
 }
+
+/*
+ * Single precision variants. They evaluate in double, where the shorter
+ * polynomials below already leave the error far under a float ULP.
+ */
+
+float sqrtf(float x)
+{
+    if (!(x >= 0.0f))
+        return x < 0.0f ? (x - x) / (x - x) : x;
+#ifdef VLIBC_HW_SQRT
+    return __builtin_sqrtf(x);
+#else
+    return (float)sqrt((double)x);
+#endif
+}
+
+float expf(float x)
+{
+    if (x != x)
+        return x + x;
+    if (x > 89.0f)
+        return __builtin_inff();
+    if (x < -104.0f)
+        return 0.0f;
+
+    double xd = x;
+    double kd = xd * INVLN2N + TOINT;
+    kd -= TOINT;
+    int k = (int)kd;
+    double r = xd - kd * LN2_N;
+    int i = k & (EXP_N - 1);
+    int e = (k - i) / EXP_N;
+    double scale = asdouble(asuint64(exp_table[i].hi) +
+                            ((uint64_t)(int64_t)e << 52));
+    double p = r + r * r * (EXPF_C[0] + r * EXPF_C[1]);
+    return (float)(scale + scale * p);
+}
+
+float logf(float x)
+{
+    if (x != x)
+        return x + x;
+    if (x <= 0.0f)
+        return x == 0.0f ? -__builtin_inff() : (x - x) / (x - x);
+    if (x == __builtin_inff())
+        return x;
+
+    double xd = x;
+    if (log_near_one(xd)) {
+        double f = xd - 1.0;
+        return (float)(f + f * f * (LOGF1_C[0] + f * (LOGF1_C[1] +
+                                    f * LOGF1_C[2])));
+    }
+    uint64_t ix = asuint64(xd);
+    int64_t top = (int64_t)(ix - 0x3fe8000000000000ULL) >> 52;
+    double z = asdouble(ix - ((uint64_t)top << 52));
+    int i = (int)(z * 128.0) - LOG_OFF;
+    double c = (double)(2 * i + 2 * LOG_OFF + 1) * 0x1p-8;
+    double u = (z - c) * log_table[i].invc;
+    double p = u + u * u * (LOGF_C[0] + u * (LOGF_C[1] + u * LOGF_C[2]));
+    return (float)((double)top * LN2 + log_table[i].logc + p);
+}
+
+float powf(float x, float y)
+{
+    double xd = x, res, sign;
+    if (pow_special(&xd, y, &res, &sign))
+        return (float)res;
+
+    double e = (double)y * log_core(xd);
+    if (e > 89.0)
+        return (float)(sign * __builtin_inf());
+    if (e < -104.0)
+        return (float)(sign * 0.0);
+    return (float)(sign * exp_inline(e, 0.0));
+}
+
+static inline double sinf_poly(double x)
+{
+    double z = x * x;
+    return x + x * z * (SINF_C[0] + z * (SINF_C[1] + z * (SINF_C[2] +
+                                         z * SINF_C[3])));
+}
+
+static inline double cosf_poly(double x)
+{
+    double z = x * x;
+    return 1.0 + z * (COSF_C[0] + z * (COSF_C[1] + z * (COSF_C[2] +
+                      z * (COSF_C[3] + z * COSF_C[4]))));
+}
+
+/* Reduce a float modulo pi/2 in double precision. */
+static double rem_pio2f(float x, int *n)
+{
+    double xd = x;
+    if (fabs_approx(xd) >= PIO2_MEDIUM) {
+        double hi, lo;
+        *n = rem_pio2_large(xd, &hi, &lo);
+        return hi + lo;
+    }
+    double fn = xd * INVPIO2 + TOINT;
+    fn -= TOINT;
+    *n = (int)fn;
+    return ((xd - fn * PIO2_1) - fn * PIO2_2) - fn * PIO2_3;
+}
+
+float sinf(float x)
+{
+    float ax = x < 0.0f ? -x : x;
+    if (ax <= (float)PIO4)
+        return ax < 0x1p-12f ? x : (float)sinf_poly(x);
+    if (!(ax < __builtin_inff()))
+        return x - x;
+
+    int n;
+    double r = rem_pio2f(x, &n);
+    switch (n & 3) {
+    case 0:
+        return (float)sinf_poly(r);
+    case 1:
+        return (float)cosf_poly(r);
+    case 2:
+        return (float)-sinf_poly(r);
+    default:
+        return (float)-cosf_poly(r);
+    }
+}
+
+float cosf(float x)
+{
+    float ax = x < 0.0f ? -x : x;
+    if (ax <= (float)PIO4)
+        return ax < 0x1p-12f ? 1.0f : (float)cosf_poly(x);
+    if (!(ax < __builtin_inff()))
+        return x - x;
+
+    int n;
+    double r = rem_pio2f(x, &n);
+    switch (n & 3) {
+    case 0:
+        return (float)cosf_poly(r);
+    case 1:
+        return (float)-sinf_poly(r);
+    case 2:
+        return (float)-cosf_poly(r);
+    default:
+        return (float)sinf_poly(r);
+    }
+}
+
+float tanf(float x)
+{
+    float ax = x < 0.0f ? -x : x;
+    if (ax <= (float)PIO4)
+        return ax < 0x1p-12f ? x : (float)(sinf_poly(x) / cosf_poly(x));
+    if (!(ax < __builtin_inff()))
+        return x - x;
+
+    int n;
+    double r = rem_pio2f(x, &n);
+    double s = sinf_poly(r), c = cosf_poly(r);
+    return (float)((n & 1) ? -c / s : s / c);
+}
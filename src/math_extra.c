@@ -29,9 +29,12 @@ static double atan_approx(double z)
         z = -z;
     }
 
+    /* keep the series argument below tan(pi/8) so it converges */
     double result;
-    if (z > 1.0)
+    if (z > 2.414213562373095)
         result = PI / 2.0 - atan_series(1.0 / z);
+    else if (z > 0.414213562373095)
+        result = PI / 4.0 + atan_series((z - 1.0) / (z + 1.0));
     else
         result = atan_series(z);
 
@@ -0,0 +1,517 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the array math functions for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "math.h"
+#include <stdint.h>
+#include <stddef.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#include <cpuid.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * The vlibc_v* functions apply one function to a whole array. Their
+ * kernels work on blocks of four doubles written with GCC vector types:
+ * the compiler emits SSE2 or NEON instructions for them by default, and
+ * on x86_64 a second copy built for AVX2 is picked at startup when the
+ * CPU and OS support it. Lanes whose input needs special handling (NaN,
+ * infinities, overflow, huge trigonometric arguments) are recomputed by
+ * the scalar function, so every result matches the scalar semantics.
+ * Float arrays are widened to double inside the kernels.
+ */
+
+#define VLEN 4
+
+typedef double v4df __attribute__((vector_size(32)));
+typedef int64_t v4di __attribute__((vector_size(32)));
+typedef float v4sf __attribute__((vector_size(16)));
+
+/* element types for unaligned vector loads and stores */
+typedef v4df v4df_u __attribute__((aligned(8), may_alias));
+typedef v4sf v4sf_u __attribute__((aligned(4), may_alias));
+
+#define VINLINE static inline __attribute__((always_inline))
+
+static const double TOINT = 0x1.8p52;
+
+/* exp: x = k*ln2 + r, |r| <= ln2/2 */
+static const double INVLN2 = 0x1.71547652b82fep+0;
+static const double LN2_HI = 0x1.62e42fee00000p-1;
+static const double LN2_LO = 0x1.a39ef35793c76p-33;
+static const double VEXP_C[11] = {
+    0x1.0000000000000p-1, 0x1.5555555555557p-3, 0x1.5555555555557p-5,
+    0x1.11111111100d2p-7, 0x1.6c16c16c15a5fp-10, 0x1.a01a01abecf31p-13,
+    0x1.a01a01a9eda94p-16, 0x1.71de0221ee58cp-19, 0x1.27e4d40e7c665p-22,
+    0x1.af4e09f575337p-26, 0x1.1f7f3b9b968b1p-29,
+};
+static const double VEXP_LIMIT = 708.0;
+
+/* log: minimax coefficients of R(s) with log(1+f) = 2s + s*R(s^2) */
+static const double LG1 = 6.666666666666735130e-01,
+                    LG2 = 3.999999999940941908e-01,
+                    LG3 = 2.857142874366239149e-01,
+                    LG4 = 2.222219843214978396e-01,
+                    LG5 = 1.818357216161805012e-01,
+                    LG6 = 1.531383769920937332e-01,
+                    LG7 = 1.479819860511658591e-01;
+
+/* sin/cos: three-part Cody-Waite split of pi/2 and kernels */
+static const double INVPIO2 = 0x1.45f306dc9c883p-1;
+static const double PIO2_1 = 0x1.921fb544p+0;
+static const double PIO2_2 = 0x1.0b4611a6p-34;
+static const double PIO2_3 = 0x1.3198a2ep-69;
+static const double PIO2_3T = 0x1.b839a252049c1p-104;
+static const double VTRIG_LIMIT = 0x1p20;
+static const double S1 = -1.66666666666666324348e-01,
+                    S2 = 8.33333333332248946124e-03,
+                    S3 = -1.98412698298579493134e-04,
+                    S4 = 2.75573137070700676789e-06,
+                    S5 = -2.50507602534068634195e-08,
+                    S6 = 1.58969099521155010221e-10;
+static const double C1 = 4.16666666666666019037e-02,
+                    C2 = -1.38888888888741095749e-03,
+                    C3 = 2.48015872894767294178e-05,
+                    C4 = -2.75573143513906633035e-07,
+                    C5 = 2.08757232129817482790e-09,
+                    C6 = -1.13596475577881948265e-11;
+
+/*
+ * The cores take and return vectors through pointers: passing 32-byte
+ * vectors by value from code built without AVX would trip the psABI
+ * warning even though everything here is inlined.
+ */
+
+/* lanes of a where the mask m is set, lanes of b elsewhere */
+#define VSELECT(m, a, b) ((v4df)(((v4di)(a) & (m)) | ((v4di)(b) & ~(m))))
+#define VANY(m) (((m)[0] | (m)[1] | (m)[2] | (m)[3]) != 0)
+
+/* e^x for |x| < VEXP_LIMIT; sets *special for other lanes */
+VINLINE void vexp_core(v4df *out, const v4df *in, v4di *special)
+{
+    v4df x = *in;
+    v4df ax = (v4df)((v4di)x & 0x7fffffffffffffffLL);
+    *special = ~(ax < VEXP_LIMIT);
+
+    v4df kd = x * INVLN2 + TOINT;
+    v4di ki = (v4di)kd;
+    kd -= TOINT;
+    v4df r = (x - kd * LN2_HI) - kd * LN2_LO;
+    v4df r2 = r * r;
+    v4df p01 = VEXP_C[0] + r * VEXP_C[1];
+    v4df p23 = VEXP_C[2] + r * VEXP_C[3];
+    v4df p45 = VEXP_C[4] + r * VEXP_C[5];
+    v4df p67 = VEXP_C[6] + r * VEXP_C[7];
+    v4df p89 = VEXP_C[8] + r * VEXP_C[9];
+    v4df p = p89 + r2 * VEXP_C[10];
+    p = p67 + r2 * p;
+    p = p45 + r2 * p;
+    p = p23 + r2 * p;
+    p = p01 + r2 * p;
+    v4df y = r + r2 * p;
+
+    /* kd + TOINT holds k in its low bits; 2^k is built in the exponent */
+    v4di k = ki - (int64_t)0x4338000000000000LL;
+    v4df scale = (v4df)((k + 0x3ff) << 52);
+    *out = scale + scale * y;
+}
+
+/* log(x) for normal positive finite x; sets *special for other lanes */
+VINLINE void vlog_core(v4df *out, const v4df *in, v4di *special)
+{
+    v4df x = *in;
+    *special = ~((x >= 0x1p-1022) & (x <= 0x1.fffffffffffffp1023));
+
+    /* move the mantissa into [sqrt(2)/2, sqrt(2)) */
+    v4di ix = (v4di)x + ((int64_t)(0x3ff00000 - 0x3fe6a09e) << 32);
+    v4di k = ((ix >> 52) & 0x7ff) - 0x3ff;
+    ix = (ix & 0x000fffffffffffffLL) + ((int64_t)0x3fe6a09e << 32);
+    v4df f = (v4df)ix - 1.0;
+    /* k is small, so the TOINT trick converts it without cvtqq2pd */
+    v4df dk = (v4df)(k + (int64_t)0x4338000000000000LL) - TOINT;
+
+    v4df hfsq = 0.5 * f * f;
+    v4df s = f / (2.0 + f);
+    v4df z = s * s;
+    v4df w = z * z;
+    v4df t1 = w * (LG2 + w * (LG4 + w * LG6));
+    v4df t2 = z * (LG1 + w * (LG3 + w * (LG5 + w * LG7)));
+    v4df rr = t2 + t1;
+    *out = dk * LN2_HI - ((hfsq - (s * (hfsq + rr) + dk * LN2_LO)) - f);
+}
+
+/* sin and cos for |x| < VTRIG_LIMIT; sets *special for other lanes */
+VINLINE void vsincos_core(v4df *out, const v4df *in, int cosine,
+                          v4di *special)
+{
+    v4df x = *in;
+    v4df ax = (v4df)((v4di)x & 0x7fffffffffffffffLL);
+    *special = ~(ax < VTRIG_LIMIT);
+
+    v4df fn = x * INVPIO2 + TOINT;
+    v4di q = (v4di)fn;
+    fn -= TOINT;
+    v4df r = ((x - fn * PIO2_1) - fn * PIO2_2) - fn * PIO2_3;
+    r -= fn * PIO2_3T;
+
+    v4df z = r * r;
+    v4df v = z * r;
+    v4df sr = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+    v4df sn = r + v * (S1 + z * sr);
+
+    v4df w = z * z;
+    v4df cr = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+    v4df hz = 0.5 * z;
+    v4df cw = 1.0 - hz;
+    v4df cs = cw + (((1.0 - cw) - hz) + z * cr);
+
+    /* quadrant q: sin uses sin/cos/-sin/-cos, cos is shifted by one */
+    q += cosine;
+    v4di odd = -(q & 1);
+    v4di neg = (q & 2) << 62;
+    v4df y = VSELECT(odd, cs, sn);
+    *out = (v4df)((v4di)y ^ neg);
+}
+
+/*
+ * Block kernels. Each handles VLEN elements; the array drivers below
+ * feed partial blocks through a padded copy.
+ */
+VINLINE void vexp_block(double *out, const double *in)
+{
+    v4df x = *(const v4df_u *)in, y;
+    v4di sp;
+    vexp_core(&y, &x, &sp);
+    *(v4df_u *)out = y;
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = exp(in[i]);
+}
+
+VINLINE void vlog_block(double *out, const double *in)
+{
+    v4df x = *(const v4df_u *)in, y;
+    v4di sp;
+    vlog_core(&y, &x, &sp);
+    *(v4df_u *)out = y;
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = log(in[i]);
+}
+
+VINLINE void vsin_block(double *out, const double *in)
+{
+    v4df x = *(const v4df_u *)in, y;
+    v4di sp;
+    vsincos_core(&y, &x, 0, &sp);
+    *(v4df_u *)out = y;
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = sin(in[i]);
+}
+
+VINLINE void vcos_block(double *out, const double *in)
+{
+    v4df x = *(const v4df_u *)in, y;
+    v4di sp;
+    vsincos_core(&y, &x, 1, &sp);
+    *(v4df_u *)out = y;
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = cos(in[i]);
+}
+
+VINLINE void vexpf_block(float *out, const float *in)
+{
+    v4df x = __builtin_convertvector(*(const v4sf_u *)in, v4df), y;
+    v4di sp;
+    vexp_core(&y, &x, &sp);
+    *(v4sf_u *)out = __builtin_convertvector(y, v4sf);
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = expf(in[i]);
+}
+
+VINLINE void vlogf_block(float *out, const float *in)
+{
+    v4df x = __builtin_convertvector(*(const v4sf_u *)in, v4df), y;
+    v4di sp;
+    vlog_core(&y, &x, &sp);
+    *(v4sf_u *)out = __builtin_convertvector(y, v4sf);
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = logf(in[i]);
+}
+
+VINLINE void vsinf_block(float *out, const float *in)
+{
+    v4df x = __builtin_convertvector(*(const v4sf_u *)in, v4df), y;
+    v4di sp;
+    vsincos_core(&y, &x, 0, &sp);
+    *(v4sf_u *)out = __builtin_convertvector(y, v4sf);
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = sinf(in[i]);
+}
+
+VINLINE void vcosf_block(float *out, const float *in)
+{
+    v4df x = __builtin_convertvector(*(const v4sf_u *)in, v4df), y;
+    v4di sp;
+    vsincos_core(&y, &x, 1, &sp);
+    *(v4sf_u *)out = __builtin_convertvector(y, v4sf);
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = cosf(in[i]);
+}
+
+/* x^y as exp(y * log x) in double, ample for float results */
+VINLINE void vpowf_block(float *out, const float *x, const float *y)
+{
+    v4df xd = __builtin_convertvector(*(const v4sf_u *)x, v4df);
+    v4df yd = __builtin_convertvector(*(const v4sf_u *)y, v4df);
+    v4df l, r;
+    v4di sp1, sp2;
+    vlog_core(&l, &xd, &sp1);
+    l *= yd;
+    vexp_core(&r, &l, &sp2);
+    v4di sp = sp1 | sp2;
+    *(v4sf_u *)out = __builtin_convertvector(r, v4sf);
+    if (VANY(sp))
+        for (int i = 0; i < VLEN; i++)
+            if (sp[i])
+                out[i] = powf(x[i], y[i]);
+}
+
+VINLINE void vsqrt_block(double *out, const double *in)
+{
+#if defined(__x86_64__)
+    _mm_storeu_pd(out, _mm_sqrt_pd(_mm_loadu_pd(in)));
+    _mm_storeu_pd(out + 2, _mm_sqrt_pd(_mm_loadu_pd(in + 2)));
+#elif defined(__aarch64__)
+    vst1q_f64(out, vsqrtq_f64(vld1q_f64(in)));
+    vst1q_f64(out + 2, vsqrtq_f64(vld1q_f64(in + 2)));
+#else
+    for (int i = 0; i < VLEN; i++)
+        out[i] = sqrt(in[i]);
+#endif
+}
+
+VINLINE void vsqrtf_block(float *out, const float *in)
+{
+#if defined(__x86_64__)
+    _mm_storeu_ps(out, _mm_sqrt_ps(_mm_loadu_ps(in)));
+#elif defined(__aarch64__)
+    vst1q_f32(out, vsqrtq_f32(vld1q_f32(in)));
+#else
+    for (int i = 0; i < VLEN; i++)
+        out[i] = sqrtf(in[i]);
+#endif
+}
+
+/*
+ * Array drivers. Full blocks are processed in place; the remaining
+ * elements are copied into a block padded with 1.0, which is an
+ * ordinary input for every function.
+ */
+#define UNARY_DRIVER(name, type, block, attr)                               \
+    attr static void name(type *out, const type *in, size_t n)           \
+    {                                                                    \
+        size_t i = 0;                                                    \
+        for (; i + VLEN <= n; i += VLEN)                                 \
+            block(out + i, in + i);                                      \
+        if (i < n) {                                                     \
+            type a[VLEN] = { 1, 1, 1, 1 }, b[VLEN];                      \
+            for (size_t j = 0; j < n - i; j++)                           \
+                a[j] = in[i + j];                                        \
+            block(b, a);                                                 \
+            for (size_t j = 0; j < n - i; j++)                           \
+                out[i + j] = b[j];                                       \
+        }                                                                \
+    }
+
+#define BINARY_DRIVER(name, type, block, attr)                              \
+    attr static void name(type *out, const type *x, const type *y,        \
+                          size_t n)                                      \
+    {                                                                    \
+        size_t i = 0;                                                    \
+        for (; i + VLEN <= n; i += VLEN)                                 \
+            block(out + i, x + i, y + i);                                \
+        if (i < n) {                                                     \
+            type a[VLEN] = { 1, 1, 1, 1 }, c[VLEN] = { 1, 1, 1, 1 };     \
+            type b[VLEN];                                                \
+            for (size_t j = 0; j < n - i; j++) {                         \
+                a[j] = x[i + j];                                         \
+                c[j] = y[i + j];                                         \
+            }                                                            \
+            block(b, a, c);                                              \
+            for (size_t j = 0; j < n - i; j++)                           \
+                out[i + j] = b[j];                                       \
+        }                                                                \
+    }
+
+/*
+ * pow needs log(x) in double-double precision to stay within one ULP,
+ * so the double variant runs the scalar routine for every element.
+ */
+static void vpow_scalar(double *out, const double *x, const double *y,
+                        size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = pow(x[i], y[i]);
+}
+
+struct vmath_ops {
+    void (*exp)(double *, const double *, size_t);
+    void (*log)(double *, const double *, size_t);
+    void (*sin)(double *, const double *, size_t);
+    void (*cos)(double *, const double *, size_t);
+    void (*sqrt)(double *, const double *, size_t);
+    void (*expf)(float *, const float *, size_t);
+    void (*logf)(float *, const float *, size_t);
+    void (*sinf)(float *, const float *, size_t);
+    void (*cosf)(float *, const float *, size_t);
+    void (*sqrtf)(float *, const float *, size_t);
+    void (*powf)(float *, const float *, const float *, size_t);
+};
+
+#define DEFINE_OPS(sfx, attr)                                               \
+    UNARY_DRIVER(vexp_##sfx, double, vexp_block, attr)                    \
+    UNARY_DRIVER(vlog_##sfx, double, vlog_block, attr)                    \
+    UNARY_DRIVER(vsin_##sfx, double, vsin_block, attr)                    \
+    UNARY_DRIVER(vcos_##sfx, double, vcos_block, attr)                    \
+    UNARY_DRIVER(vsqrt_##sfx, double, vsqrt_block, attr)                  \
+    UNARY_DRIVER(vexpf_##sfx, float, vexpf_block, attr)                   \
+    UNARY_DRIVER(vlogf_##sfx, float, vlogf_block, attr)                   \
+    UNARY_DRIVER(vsinf_##sfx, float, vsinf_block, attr)                   \
+    UNARY_DRIVER(vcosf_##sfx, float, vcosf_block, attr)                   \
+    UNARY_DRIVER(vsqrtf_##sfx, float, vsqrtf_block, attr)                 \
+    BINARY_DRIVER(vpowf_##sfx, float, vpowf_block, attr)                  \
+    static const struct vmath_ops sfx##_ops = {                          \
+        vexp_##sfx, vlog_##sfx, vsin_##sfx, vcos_##sfx, vsqrt_##sfx,     \
+        vexpf_##sfx, vlogf_##sfx, vsinf_##sfx, vcosf_##sfx,              \
+        vsqrtf_##sfx, vpowf_##sfx,                                       \
+    };
+
+/* SSE2 on x86_64, NEON on aarch64, plain scalar code elsewhere */
+DEFINE_OPS(base, )
+
+#if defined(__x86_64__)
+DEFINE_OPS(avx2, __attribute__((target("avx2"))))
+
+/* AVX2 needs the CPUID bit and the OS saving the YMM registers. */
+int __vlibc_cpu_has_avx2(void)
+{
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d))
+        return 0;
+    if (!(c & bit_OSXSAVE) || !(c & bit_AVX))
+        return 0;
+    unsigned lo, hi;
+    __asm__ volatile ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+    if ((lo & 6) != 6)
+        return 0;
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+        return 0;
+    return (b & bit_AVX2) != 0;
+}
+#endif
+
+static const struct vmath_ops *vmath;
+
+/* Pick the kernels for this CPU. Safe to call more than once. */
+void __vlibc_vmath_init(void)
+{
+    if (__atomic_load_n(&vmath, __ATOMIC_ACQUIRE))
+        return;
+    const struct vmath_ops *ops = &base_ops;
+#if defined(__x86_64__)
+    if (__vlibc_cpu_has_avx2())
+        ops = &avx2_ops;
+#endif
+    __atomic_store_n(&vmath, ops, __ATOMIC_RELEASE);
+}
+
+static inline const struct vmath_ops *ops(void)
+{
+    const struct vmath_ops *o = __atomic_load_n(&vmath, __ATOMIC_ACQUIRE);
+    if (!o) {
+        __vlibc_vmath_init();
+        o = vmath;
+    }
+    return o;
+}
+
+void vlibc_vexp(double *out, const double *in, size_t n)
+{
+    ops()->exp(out, in, n);
+}
+
+void vlibc_vlog(double *out, const double *in, size_t n)
+{
+    ops()->log(out, in, n);
+}
+
+void vlibc_vsin(double *out, const double *in, size_t n)
+{
+    ops()->sin(out, in, n);
+}
+
+void vlibc_vcos(double *out, const double *in, size_t n)
+{
+    ops()->cos(out, in, n);
+}
+
+void vlibc_vsqrt(double *out, const double *in, size_t n)
+{
+    ops()->sqrt(out, in, n);
+}
+
+void vlibc_vpow(double *out, const double *x, const double *y, size_t n)
+{
+    vpow_scalar(out, x, y, n);
+}
+
+void vlibc_vexpf(float *out, const float *in, size_t n)
+{
+    ops()->expf(out, in, n);
+}
+
+void vlibc_vlogf(float *out, const float *in, size_t n)
+{
+    ops()->logf(out, in, n);
+}
+
+void vlibc_vsinf(float *out, const float *in, size_t n)
+{
+    ops()->sinf(out, in, n);
+}
+
+void vlibc_vcosf(float *out, const float *in, size_t n)
+{
+    ops()->cosf(out, in, n);
+}
+
+void vlibc_vsqrtf(float *out, const float *in, size_t n)
+{
+    ops()->sqrtf(out, in, n);
+}
+
+void vlibc_vpowf(float *out, const float *x, const float *y, size_t n)
+{
+    ops()->powf(out, x, y, n);
+}
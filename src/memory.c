@@ -26,10 +26,30 @@ int vlibc_test_alloc_fail_after = -1;
 
 struct posix_align_hdr {
     uint32_t magic;
+    uint32_t size;      /* length of a shared piece */
     void    *orig;
 };
 
 #define POSIX_ALIGN_MAGIC 0x50414C47 /* 'PALG' */
+#define SHARED_PIECE_MAGIC 0x53484152 /* 'SHAR' */
+
+/*
+ * A shared block starts with the number of pieces still live. Each piece
+ * carries a posix_align_hdr-shaped header naming the block, so free()
+ * on a piece drops one reference and the last one frees the block.
+ */
+struct shared_hdr {
+    long refs;
+};
+
+static void free_impl(void *ptr);
+
+static void shared_put(void *block)
+{
+    struct shared_hdr *sh = block;
+    if (__atomic_sub_fetch(&sh->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        free_impl(block);
+}
 
 #ifdef HAVE_SBRK
 #include <unistd.h>
@@ -115,10 +135,10 @@ void *malloc(size_t size)
         prev = b;
         b = b->next;
     }
-    pthread_mutex_unlock(&free_lock);
 
-    /* allocate new block from the system */
+    /* allocate new block from the system; sbrk itself is not thread safe */
     struct block_header *hdr = sbrk(sizeof(struct block_header) + size);
+    pthread_mutex_unlock(&free_lock);
     if (hdr == (void *)-1) {
         errno = ENOMEM;
         return NULL;
@@ -143,6 +163,11 @@ void free(void *ptr)
         free_impl(orig);
         return;
     }
+    if (ph->magic == SHARED_PIECE_MAGIC) {
+        ph->magic = 0;
+        shared_put(ph->orig);
+        return;
+    }
 
     free_impl(ptr);
 }
@@ -215,12 +240,57 @@ void free(void *ptr)
         free_impl(orig);
         return;
     }
+    if (ph->magic == SHARED_PIECE_MAGIC) {
+        ph->magic = 0;
+        shared_put(ph->orig);
+        return;
+    }
 
     free_impl(ptr);
 }
 
 #endif /* HAVE_SBRK */
 
+void vlibc_shared_init(void *block, size_t pieces)
+{
+    ((struct shared_hdr *)block)->refs = (long)pieces;
+}
+
+void *vlibc_shared_piece(void *block, size_t offset, size_t size)
+{
+    char *piece = (char *)block + offset + VLIBC_PIECE_HDR;
+    struct posix_align_hdr *ph = (struct posix_align_hdr *)piece - 1;
+    ph->magic = SHARED_PIECE_MAGIC;
+    ph->size = (uint32_t)size;
+    ph->orig = block;
+    return piece;
+}
+
+/* Size recorded in the header of a block returned by malloc(). */
+static size_t block_size(void *ptr)
+{
+#ifdef HAVE_SBRK
+    return ((struct block_header *)ptr - 1)->size;
+#else
+    return ((struct mmap_header *)ptr - 1)->size;
+#endif
+}
+
+/*
+ * Bytes usable at ptr. Aligned blocks and shared pieces carry their own
+ * header in front of ptr instead of the allocator's.
+ */
+static size_t alloc_size(void *ptr)
+{
+    struct posix_align_hdr *ph = (struct posix_align_hdr *)ptr - 1;
+    if (ph->magic == SHARED_PIECE_MAGIC)
+        return ph->size;
+    if (ph->magic == POSIX_ALIGN_MAGIC)
+        return block_size(ph->orig) -
+               (size_t)((char *)ptr - (char *)ph->orig);
+    return block_size(ptr);
+}
+
 /*
  * Allocates an array and zeroes it.
  * Uses malloc for the combined size then fills the memory with zeros.
@@ -252,12 +322,8 @@ void *realloc(void *ptr, size_t size)
         return NULL;
     }
 
-#ifdef HAVE_SBRK
-    struct block_header *old_hdr = (struct block_header *)ptr - 1;
-#else
-    struct mmap_header *old_hdr = (struct mmap_header *)ptr - 1;
-#endif
-    size_t copy = old_hdr->size < size ? old_hdr->size : size;
+    size_t old_size = alloc_size(ptr);
+    size_t copy = old_size < size ? old_size : size;
 
     void *new_ptr = malloc(size);
     if (!new_ptr)
@@ -369,12 +435,7 @@ void *recallocarray(void *ptr, size_t nmemb, size_t size)
         return NULL;
     }
 
-#ifdef HAVE_SBRK
-    struct block_header *old_hdr = (struct block_header *)ptr - 1;
-#else
-    struct mmap_header *old_hdr = (struct mmap_header *)ptr - 1;
-#endif
-    size_t old_size = old_hdr->size;
+    size_t old_size = alloc_size(ptr);
 
     void *new_ptr = realloc(ptr, total);
     if (!new_ptr)
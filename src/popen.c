@@ -20,6 +20,11 @@ struct popen_file {
     pid_t pid;
 };
 
+/*
+ * popen() - run command through the shell with a pipe to its standard
+ * input or output. The child is created with posix_spawn(), which does
+ * not copy the caller's address space.
+ */
 FILE *popen(const char *command, const char *mode)
 {
     if (!command || !mode)
@@ -30,61 +35,28 @@ FILE *popen(const char *command, const char *mode)
     if (!read_mode && !write_mode)
         return NULL;
 
+    /* CLOEXEC ends: only the one duplicated onto 0 or 1 survives exec */
     int pipefd[2];
-    if (pipe(pipefd) < 0)
-        return NULL;
-
-    int errpipe[2];
-    if (pipe(errpipe) < 0) {
-        close(pipefd[0]);
-        close(pipefd[1]);
-        return NULL;
-    }
-    fcntl(errpipe[0], F_SETFD, FD_CLOEXEC);
-    fcntl(errpipe[1], F_SETFD, FD_CLOEXEC);
-
-    pid_t pid = fork();
-    if (pid < 0) {
-        int err = errno;
-        close(pipefd[0]);
-        close(pipefd[1]);
-        close(errpipe[0]);
-        close(errpipe[1]);
-        errno = err;
+    if (pipe2(pipefd, O_CLOEXEC) < 0)
         return NULL;
-    }
 
-    if (pid == 0) {
-        close(errpipe[0]);
-        if (read_mode) {
-            dup2(pipefd[1], 1);
-            close(pipefd[0]);
-            close(pipefd[1]);
-        } else {
-            dup2(pipefd[0], 0);
-            close(pipefd[1]);
-            close(pipefd[0]);
-        }
+    posix_spawn_file_actions_t fa;
+    int r = posix_spawn_file_actions_init(&fa);
+    if (r == 0)
+        r = read_mode ? posix_spawn_file_actions_adddup2(&fa, pipefd[1], 1)
+                      : posix_spawn_file_actions_adddup2(&fa, pipefd[0], 0);
+    pid_t pid;
+    if (r == 0) {
         const char *shell = vlibc_default_shell();
         char *argv[] = {(char *)shell, "-c", (char *)command, NULL};
         extern char **environ;
-        execve(shell, argv, environ);
-        int err = errno;
-        ssize_t w = write(errpipe[1], &err, sizeof(err));
-        if (w < (ssize_t)sizeof(err))
-            _exit(127);
-        _exit(127);
+        r = posix_spawn(&pid, shell, &fa, NULL, argv, environ);
     }
-
-    close(errpipe[1]);
-    int child_err = 0;
-    ssize_t n = read(errpipe[0], &child_err, sizeof(child_err));
-    close(errpipe[0]);
-    if (n > 0) {
-        waitpid(pid, NULL, 0);
-        errno = child_err;
+    posix_spawn_file_actions_destroy(&fa);
+    if (r != 0) {
         close(pipefd[0]);
         close(pipefd[1]);
+        errno = r;
         return NULL;
     }
 
@@ -33,6 +33,7 @@ extern int __posix_spawnp(pid_t *, const char *,
 #include <stdarg.h>
 #include <fcntl.h>
 #include "stdio.h"
+#include "sys/mman.h"
 #include <stdint.h>
 extern long syscall(long number, ...);
 
@@ -43,11 +44,14 @@ extern long syscall(long number, ...);
 /* from atexit.c */
 extern void __run_atexit(void);
 
+/* bumped in each child so cached process ids can be refreshed */
+unsigned long __vlibc_fork_gen;
+
 /*
  * fork() - create a new process using the BSD fork system call.  The
  * wrapper returns the child's PID to the parent and 0 to the child.
  * On failure the negative error code from vlibc_syscall is converted
- * to errno and -1 is returned.
+ * to errno and -1 is returned.  The child bumps __vlibc_fork_gen.
  */
 
 pid_t fork(void)
@@ -58,6 +62,8 @@ pid_t fork(void)
         errno = -ret;
         return -1;
     }
+    if (ret == 0)
+        __vlibc_fork_gen++;
     return (pid_t)ret;
 #else
     errno = ENOSYS;
@@ -814,15 +820,6 @@ int posix_spawnattr_getpgroup(const posix_spawnattr_t *attr, pid_t *pgroup)
     return 0;
 }
 
-/*
- * vlibc_vfork() - small wrapper selecting vfork() when available and falling
- * back to fork() otherwise.  Used internally by posix_spawn().
- */
-static __attribute__((unused)) pid_t vlibc_vfork(void)
-{
-    return vfork();
-}
-
 #if defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || \
     defined(__DragonFly__) || defined(__APPLE__)
 /*
@@ -841,117 +838,258 @@ int posix_spawn(pid_t *pid, const char *path,
 
 #else
 
+/*
+ * The child is started with clone(CLONE_VM | CLONE_VFORK) on a small
+ * stack of its own. It shares the parent's memory and the parent stays
+ * suspended until it calls execve() or exits. Nothing is copied, so the
+ * cost of spawning no longer grows with the parent's address space the
+ * way fork() does. Architectures without a clone trampoline fall back
+ * to fork().
+ */
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define SPAWN_USE_CLONE 1
+#define SPAWN_STACK_SIZE (64 * 1024)
+#define SPAWN_CLONE_VM    0x00000100
+#define SPAWN_CLONE_VFORK 0x00004000
+
+/*
+ * __vlibc_clone(fn, stack_top, flags, arg) - run fn(arg) in a new task
+ * on stack_top and exit with its return value. Returns the child's id
+ * or a negative errno value in the parent.
+ */
+long __vlibc_clone(int (*fn)(void *), void *stack, int flags, void *arg);
+
+#if defined(__x86_64__)
+__asm__(
+    ".pushsection .text\n"
+    ".globl __vlibc_clone\n"
+    ".type __vlibc_clone,@function\n"
+    "__vlibc_clone:\n"
+    "    and $-16, %rsi\n"
+    "    sub $16, %rsi\n"
+    "    mov %rcx, 8(%rsi)\n"
+    "    mov %rdi, (%rsi)\n"
+    "    mov %edx, %edi\n"
+    "    xor %edx, %edx\n"
+    "    xor %r10d, %r10d\n"
+    "    xor %r8d, %r8d\n"
+    "    mov $56, %eax\n"           /* SYS_clone */
+    "    syscall\n"
+    "    test %rax, %rax\n"
+    "    jnz 1f\n"
+    "    xor %ebp, %ebp\n"
+    "    pop %rax\n"
+    "    pop %rdi\n"
+    "    call *%rax\n"
+    "    mov %eax, %edi\n"
+    "    mov $60, %eax\n"           /* SYS_exit */
+    "    syscall\n"
+    "    hlt\n"
+    "1:  ret\n"
+    ".size __vlibc_clone, .-__vlibc_clone\n"
+    ".popsection\n");
+#else
+__asm__(
+    ".pushsection .text\n"
+    ".globl __vlibc_clone\n"
+    ".type __vlibc_clone,%function\n"
+    "__vlibc_clone:\n"
+    "    and x1, x1, #-16\n"
+    "    stp x0, x3, [x1, #-16]!\n"
+    "    uxtw x0, w2\n"
+    "    mov x2, xzr\n"
+    "    mov x3, xzr\n"
+    "    mov x4, xzr\n"
+    "    mov x8, #220\n"            /* SYS_clone */
+    "    svc #0\n"
+    "    cbnz x0, 1f\n"
+    "    mov x29, xzr\n"
+    "    ldp x1, x0, [sp], #16\n"
+    "    blr x1\n"
+    "    mov x8, #93\n"             /* SYS_exit */
+    "    svc #0\n"
+    "1:  ret\n"
+    ".size __vlibc_clone, .-__vlibc_clone\n"
+    ".popsection\n");
+#endif
+#endif
+
+struct spawn_args {
+    const char *path;
+    const posix_spawn_file_actions_t *file_actions;
+    const posix_spawnattr_t *attrp;
+    char *const *argv;
+    char *const *envp;
+    sigset_t oldmask;           /* caller's mask, restored unless overridden */
+    int errfd;
+};
+
+/* Report err to the parent through the CLOEXEC pipe and exit. */
+static void spawn_fail(int errfd, int err)
+{
+    ssize_t w = write(errfd, &err, sizeof(err));
+    (void)w;
+    _exit(127);
+}
+
+/*
+ * spawn_child() - body of the new process. Under CLONE_VM it runs on the
+ * parent's memory, so it only makes system calls and never returns into
+ * the parent's frames.
+ */
+static int spawn_child(void *p)
+{
+    struct spawn_args *args = p;
+    const posix_spawnattr_t *attrp = args->attrp;
+    int errfd = args->errfd;
+
+    /*
+     * All signals are blocked on entry. Handlers installed by the parent
+     * must not run here on its memory, so reset them before unblocking.
+     */
+    for (int s = 1; s < _NSIG; s++) {
+        struct sigaction sa;
+        if (s == SIGKILL || s == SIGSTOP)
+            continue;
+        int def = attrp && (attrp->flags & POSIX_SPAWN_SETSIGDEF) &&
+                  sigismember(&attrp->sigdefault, s);
+        if (!def) {
+            if (sigaction(s, NULL, &sa) != 0 || sa.sa_handler == SIG_IGN ||
+                sa.sa_handler == SIG_DFL)
+                continue;
+        }
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = SIG_DFL;
+        sigaction(s, &sa, NULL);
+    }
+
+    if (attrp) {
+        if ((attrp->flags & POSIX_SPAWN_SETPGROUP) &&
+            setpgid(0, attrp->pgroup) != 0)
+            spawn_fail(errfd, errno);
+        if ((attrp->flags & POSIX_SPAWN_RESETIDS) &&
+            (setegid(getgid()) != 0 || seteuid(getuid()) != 0))
+            spawn_fail(errfd, errno);
+    }
+
+    const posix_spawn_file_actions_t *fa = args->file_actions;
+    for (size_t i = 0; fa && i < fa->count; i++) {
+        struct posix_spawn_file_action *a = &fa->actions[i];
+        /* keep the error pipe clear of descriptors the actions target */
+        if (a->fd == errfd || (a->type == SPAWN_ACTION_DUP2 &&
+                               a->newfd == errfd)) {
+            int n = fcntl(errfd, F_DUPFD_CLOEXEC, 0);
+            if (n < 0)
+                spawn_fail(errfd, errno);
+            errfd = n;
+        }
+        switch (a->type) {
+        case SPAWN_ACTION_OPEN: {
+            int fd = open(a->path, a->oflag, a->mode);
+            if (fd < 0)
+                spawn_fail(errfd, errno);
+            if (fd != a->fd) {
+                if (dup2(fd, a->fd) < 0)
+                    spawn_fail(errfd, errno);
+                close(fd);
+            }
+            break; }
+        case SPAWN_ACTION_CLOSE:
+            if (close(a->fd) < 0)
+                spawn_fail(errfd, errno);
+            break;
+        case SPAWN_ACTION_DUP2:
+            /* dup2 onto itself only clears close-on-exec */
+            if (a->fd == a->newfd) {
+                if (fcntl(a->fd, F_SETFD, 0) < 0)
+                    spawn_fail(errfd, errno);
+            } else if (dup2(a->fd, a->newfd) < 0) {
+                spawn_fail(errfd, errno);
+            }
+            break;
+        case SPAWN_ACTION_CHDIR:
+            if (chdir(a->path) < 0)
+                spawn_fail(errfd, errno);
+            break;
+        case SPAWN_ACTION_FCHDIR:
+            if (fchdir(a->fd) < 0)
+                spawn_fail(errfd, errno);
+            break;
+        }
+    }
+
+    sigprocmask(SIG_SETMASK,
+                attrp && (attrp->flags & POSIX_SPAWN_SETSIGMASK) ?
+                &attrp->sigmask : &args->oldmask, NULL);
+
+    execve(args->path, args->argv, args->envp);
+    spawn_fail(errfd, errno);
+    return 127;
+}
+
 int posix_spawn(pid_t *pid, const char *path,
                 const posix_spawn_file_actions_t *file_actions,
                 const posix_spawnattr_t *attrp,
                 char *const argv[], char *const envp[])
 {
     int errpipe[2];
-    if (pipe(errpipe) < 0)
+    if (pipe2(errpipe, O_CLOEXEC) < 0)
         return errno;
-    fcntl(errpipe[0], F_SETFD, FD_CLOEXEC);
-    fcntl(errpipe[1], F_SETFD, FD_CLOEXEC);
-
-    pid_t cpid = fork();
-    if (cpid < 0)
-        {
-            int err = errno;
-            close(errpipe[0]);
-            close(errpipe[1]);
-            return err;
-        }
-    if (cpid == 0) {
-        close(errpipe[0]);
-        int err;
-
-        if (attrp) {
-            if (attrp->flags & POSIX_SPAWN_SETPGROUP)
-                setpgid(0, attrp->pgroup);
-            if (attrp->flags & POSIX_SPAWN_SETSIGMASK)
-                sigprocmask(SIG_SETMASK, &attrp->sigmask, NULL);
-            if (attrp->flags & POSIX_SPAWN_SETSIGDEF)
-                for (int s = 1; s < _NSIG; s++)
-                    if (sigismember(&attrp->sigdefault, s))
-                        signal(s, SIG_DFL);
-        }
-
-        if (file_actions) {
-            for (size_t i = 0; i < file_actions->count; i++) {
-                struct posix_spawn_file_action *a = &file_actions->actions[i];
-                switch (a->type) {
-                case SPAWN_ACTION_OPEN: {
-                    int fd = open(a->path, a->oflag, a->mode);
-                    if (fd < 0) {
-                        err = errno;
-                        ssize_t w = write(errpipe[1], &err, sizeof(err));
-                        if (w < (ssize_t)sizeof(err))
-                            _exit(127);
-                        _exit(127);
-                    }
-                    if (fd != a->fd) {
-                        if (dup2(fd, a->fd) < 0) {
-                            err = errno;
-                            ssize_t w = write(errpipe[1], &err, sizeof(err));
-                            if (w < (ssize_t)sizeof(err))
-                                _exit(127);
-                            _exit(127);
-                        }
-                        close(fd);
-                    }
-                    break; }
-                case SPAWN_ACTION_CLOSE:
-                    if (close(a->fd) < 0) {
-                        err = errno;
-                        ssize_t w = write(errpipe[1], &err, sizeof(err));
-                        if (w < (ssize_t)sizeof(err))
-                            _exit(127);
-                        _exit(127);
-                    }
-                    break;
-                case SPAWN_ACTION_DUP2:
-                    if (dup2(a->fd, a->newfd) < 0) {
-                        err = errno;
-                        ssize_t w = write(errpipe[1], &err, sizeof(err));
-                        if (w < (ssize_t)sizeof(err))
-                            _exit(127);
-                        _exit(127);
-                    }
-                    break;
-                case SPAWN_ACTION_CHDIR:
-                    if (chdir(a->path) < 0) {
-                        err = errno;
-                        ssize_t w = write(errpipe[1], &err, sizeof(err));
-                        if (w < (ssize_t)sizeof(err))
-                            _exit(127);
-                        _exit(127);
-                    }
-                    break;
-                case SPAWN_ACTION_FCHDIR:
-                    if (fchdir(a->fd) < 0) {
-                        err = errno;
-                        ssize_t w = write(errpipe[1], &err, sizeof(err));
-                        if (w < (ssize_t)sizeof(err))
-                            _exit(127);
-                        _exit(127);
-                    }
-                    break;
-                }
-            }
-        }
 
-        execve(path, argv, envp ? envp : environ);
+    struct spawn_args args;
+    args.path = path;
+    args.file_actions = file_actions;
+    args.attrp = attrp;
+    args.argv = argv;
+    args.envp = envp ? envp : environ;
+    args.errfd = errpipe[1];
+
+    /* no handler may run in the child before it resets them */
+    sigset_t all;
+    sigfillset(&all);
+    sigprocmask(SIG_BLOCK, &all, &args.oldmask);
+
+    pid_t cpid;
+    int err = 0;
+#ifdef SPAWN_USE_CLONE
+    char *stack = mmap(NULL, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) {
         err = errno;
-        ssize_t w = write(errpipe[1], &err, sizeof(err));
-        if (w < (ssize_t)sizeof(err))
-            _exit(127);
-        _exit(127);
+        cpid = -1;
+    } else {
+        long r = __vlibc_clone(spawn_child, stack + SPAWN_STACK_SIZE,
+                               SPAWN_CLONE_VM | SPAWN_CLONE_VFORK | SIGCHLD,
+                               &args);
+        /* the child has exec'd or exited, so its stack is free again */
+        munmap(stack, SPAWN_STACK_SIZE);
+        cpid = r < 0 ? -1 : (pid_t)r;
+        if (r < 0)
+            err = (int)-r;
     }
+#else
+    cpid = fork();
+    if (cpid == 0)
+        _exit(spawn_child(&args));
+    if (cpid < 0)
+        err = errno;
+#endif
+    sigprocmask(SIG_SETMASK, &args.oldmask, NULL);
     close(errpipe[1]);
+
+    if (cpid < 0) {
+        close(errpipe[0]);
+        return err;
+    }
     int child_err = 0;
-    ssize_t n = read(errpipe[0], &child_err, sizeof(child_err));
+    ssize_t n;
+    do {
+        n = read(errpipe[0], &child_err, sizeof(child_err));
+    } while (n < 0 && errno == EINTR);
     close(errpipe[0]);
     if (n > 0) {
-        waitpid(cpid, NULL, 0);
+        while (waitpid(cpid, NULL, 0) < 0 && errno == EINTR)
+            ;
         return child_err;
     }
     if (pid)
@@ -0,0 +1,618 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the parallel directory walker for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "dirwalk.h"
+#include "dirent.h"
+#include "fcntl.h"
+#include "pthread.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "io.h"
+#include "unistd.h"
+#include <stdatomic.h>
+
+/*
+ * Every directory is one job. A job holds a reference for its own
+ * listing and one for each child job; the last release reports the
+ * directory as DP when asked and drops the reference on its parent.
+ *
+ * Workers pop their own deque from the back, so each thread goes depth
+ * first and keeps few jobs queued, while thieves take from the front
+ * where the jobs closest to the root, and usually the largest subtrees,
+ * wait.
+ *
+ * Jobs are carved from per-worker chunks in power of two size classes
+ * and recycled through shared free lists, so a walk calls malloc about
+ * once per 64 KiB of queued paths instead of once per directory.
+ */
+
+#define JOB_CHUNK   (64 * 1024)
+#define JOB_MIN     256
+#define JOB_CLASSES 6           /* 256 bytes .. 8 KiB */
+
+struct pjob {
+    struct pjob *parent;        /* free list link once released */
+    atomic_int refs;
+    int cls;                    /* size class or -1 for malloc */
+    int fd;                     /* -1 when closed to respect fdlimit */
+    int level;
+    int nostat;
+    size_t base;
+    size_t pathlen;
+    struct stat st;
+    char path[];
+};
+
+struct pwalk;
+
+struct pworker {
+    pthread_t thread;
+    int id;
+    struct pwalk *pw;
+    pthread_spinlock_t qlock;
+    struct pjob **q;
+    size_t head, cap;
+    atomic_size_t len;
+    char *buf;                  /* getdents64 buffer */
+    size_t bufsize;
+    char *path;                 /* directory being listed plus '/' */
+    size_t pathcap;
+    size_t prefix;
+    struct vlibc_dirent64 **ents; /* VLIBC_PWALK_SORTED listing */
+    size_t entcap;
+    char *chunk;                /* current job chunk; chunks are chained */
+    size_t chunk_used;
+};
+
+struct pwalk {
+    int flags;
+    int fdlimit;
+    int nworkers;
+    dev_t dev;
+    vlibc_pwalk_fn fn;
+    void *arg;
+    struct pworker *w;
+    atomic_long outstanding;    /* jobs not yet released */
+    atomic_int fds;             /* descriptors held by queued jobs */
+    atomic_int sleepers;
+    atomic_int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_spinlock_t free_lock;
+    struct pjob *free_jobs[JOB_CLASSES];
+    int result;
+    int err;
+};
+
+static struct pjob *job_alloc(struct pworker *me, size_t pathlen)
+{
+    struct pwalk *pw = me->pw;
+    size_t need = sizeof(struct pjob) + pathlen + 1;
+    size_t size = JOB_MIN;
+    int cls = 0;
+    while (size < need && cls < JOB_CLASSES - 1) {
+        size *= 2;
+        cls++;
+    }
+    if (size < need) {
+        struct pjob *j = malloc(need);
+        if (j)
+            j->cls = -1;
+        return j;
+    }
+
+    pthread_spin_lock(&pw->free_lock);
+    struct pjob *j = pw->free_jobs[cls];
+    if (j)
+        pw->free_jobs[cls] = j->parent;
+    pthread_spin_unlock(&pw->free_lock);
+    if (j)
+        return j;
+
+    if (!me->chunk || me->chunk_used + size > JOB_CHUNK) {
+        char *c = malloc(JOB_CHUNK);
+        if (!c)
+            return NULL;
+        *(char **)c = me->chunk;
+        me->chunk = c;
+        me->chunk_used = JOB_MIN;   /* first slot holds the chain link */
+    }
+    j = (struct pjob *)(me->chunk + me->chunk_used);
+    me->chunk_used += size;
+    j->cls = cls;
+    return j;
+}
+
+static void job_free(struct pwalk *pw, struct pjob *j)
+{
+    if (j->cls < 0) {
+        free(j);
+        return;
+    }
+    pthread_spin_lock(&pw->free_lock);
+    j->parent = pw->free_jobs[j->cls];
+    pw->free_jobs[j->cls] = j;
+    pthread_spin_unlock(&pw->free_lock);
+}
+
+static void set_result(struct pwalk *pw, int r, int err)
+{
+    pthread_mutex_lock(&pw->lock);
+    if (!pw->result) {
+        pw->result = r;
+        pw->err = err;
+    }
+    pthread_mutex_unlock(&pw->lock);
+    atomic_store(&pw->stop, 1);
+}
+
+static void deliver(struct pworker *me, const struct vlibc_walkent *e)
+{
+    struct pwalk *pw = me->pw;
+    int r = pw->fn(e, me->id, pw->arg);
+    if (r)
+        set_result(pw, r, errno);
+}
+
+static void wake(struct pwalk *pw, int all)
+{
+    if (!all && atomic_load(&pw->sleepers) == 0)
+        return;
+    pthread_mutex_lock(&pw->lock);
+    if (all)
+        pthread_cond_broadcast(&pw->cond);
+    else
+        pthread_cond_signal(&pw->cond);
+    pthread_mutex_unlock(&pw->lock);
+}
+
+static int q_push(struct pworker *w, struct pjob *j)
+{
+    pthread_spin_lock(&w->qlock);
+    size_t len = atomic_load_explicit(&w->len, memory_order_relaxed);
+    if (len == w->cap) {
+        size_t ncap = w->cap ? w->cap * 2 : 64;
+        struct pjob **nq = malloc(ncap * sizeof(*nq));
+        if (!nq) {
+            pthread_spin_unlock(&w->qlock);
+            return -1;
+        }
+        for (size_t i = 0; i < len; i++)
+            nq[i] = w->q[(w->head + i) % w->cap];
+        free(w->q);
+        w->q = nq;
+        w->cap = ncap;
+        w->head = 0;
+    }
+    w->q[(w->head + len) % w->cap] = j;
+    atomic_store(&w->len, len + 1);
+    pthread_spin_unlock(&w->qlock);
+    if (len > 0)
+        wake(w->pw, 0);
+    return 0;
+}
+
+static struct pjob *q_take(struct pworker *w, int back)
+{
+    if (atomic_load_explicit(&w->len, memory_order_relaxed) == 0)
+        return NULL;
+    struct pjob *j = NULL;
+    pthread_spin_lock(&w->qlock);
+    size_t len = atomic_load_explicit(&w->len, memory_order_relaxed);
+    if (len) {
+        if (back) {
+            j = w->q[(w->head + len - 1) % w->cap];
+        } else {
+            j = w->q[w->head];
+            w->head = (w->head + 1) % w->cap;
+        }
+        atomic_store(&w->len, len - 1);
+    }
+    pthread_spin_unlock(&w->qlock);
+    return j;
+}
+
+static struct pjob *steal(struct pworker *w)
+{
+    struct pwalk *pw = w->pw;
+    for (int i = 1; i < pw->nworkers; i++) {
+        struct pjob *j = q_take(&pw->w[(w->id + i) % pw->nworkers], 0);
+        if (j)
+            return j;
+    }
+    return NULL;
+}
+
+static int work_available(struct pwalk *pw)
+{
+    for (int i = 0; i < pw->nworkers; i++)
+        if (atomic_load(&pw->w[i].len))
+            return 1;
+    return atomic_load(&pw->outstanding) == 0;
+}
+
+static void job_release(struct pworker *me, struct pjob *j)
+{
+    struct pwalk *pw = me->pw;
+    while (j && atomic_fetch_sub(&j->refs, 1) == 1) {
+        struct pjob *parent = j->parent;
+        if ((pw->flags & VLIBC_WALK_POST) && !atomic_load(&pw->stop)) {
+            struct vlibc_walkent e;
+            memset(&e, 0, sizeof(e));
+            e.path = j->path;
+            e.pathlen = j->pathlen;
+            e.base = j->base;
+            e.level = j->level;
+            e.type = VLIBC_WALK_DP;
+            e.nostat = j->nostat;
+            e.st = j->st;
+            deliver(me, &e);
+        }
+        if (j->fd >= 0) {
+            close(j->fd);
+            atomic_fetch_sub(&pw->fds, 1);
+        }
+        job_free(pw, j);
+        if (atomic_fetch_sub(&pw->outstanding, 1) == 1)
+            wake(pw, 1);
+        j = parent;
+    }
+}
+
+static int path_reserve(struct pworker *w, size_t len)
+{
+    if (len < w->pathcap)
+        return 0;
+    size_t ncap = w->pathcap ? w->pathcap : 256;
+    while (ncap <= len)
+        ncap *= 2;
+    char *p = realloc(w->path, ncap);
+    if (!p)
+        return -1;
+    w->path = p;
+    w->pathcap = ncap;
+    return 0;
+}
+
+/* Queue the directory e describes below j, taking ownership of fd. */
+static int job_add(struct pworker *me, struct pjob *j,
+                   const struct vlibc_walkent *e, int fd)
+{
+    struct pwalk *pw = me->pw;
+    struct pjob *c = job_alloc(me, e->pathlen);
+    if (!c) {
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    c->parent = j;
+    atomic_init(&c->refs, 1);
+    c->level = e->level;
+    c->nostat = e->nostat;
+    c->base = e->base;
+    c->pathlen = e->pathlen;
+    c->st = e->st;
+    memcpy(c->path, e->path, e->pathlen + 1);
+    if (atomic_fetch_add(&pw->fds, 1) < pw->fdlimit) {
+        c->fd = fd;
+    } else {
+        atomic_fetch_sub(&pw->fds, 1);
+        close(fd);
+        c->fd = -1;
+    }
+    atomic_fetch_add(&j->refs, 1);
+    atomic_fetch_add(&pw->outstanding, 1);
+    if (q_push(me, c) < 0) {
+        atomic_store(&pw->stop, 1);
+        job_release(me, c);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+    const struct vlibc_dirent64 *x = *(struct vlibc_dirent64 *const *)a;
+    const struct vlibc_dirent64 *y = *(struct vlibc_dirent64 *const *)b;
+    return strcmp(x->d_name, y->d_name);
+}
+
+/* Read the whole directory and sort pointers to its records by name. */
+static long list_sorted(struct pworker *me, int fd)
+{
+    size_t len = 0;
+    for (;;) {
+        if (me->bufsize - len < 4096) {
+            char *nb = realloc(me->buf, me->bufsize * 2);
+            if (!nb) {
+                errno = ENOMEM;
+                return -1;
+            }
+            me->buf = nb;
+            me->bufsize *= 2;
+        }
+        ssize_t n = getdents64(fd, me->buf + len, me->bufsize - len);
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        len += (size_t)n;
+    }
+    struct vlibc_dirreader rd;
+    vlibc_dirreader_init(&rd, -1, me->buf, me->bufsize);
+    rd.len = len;
+    size_t count = 0;
+    int err;
+    struct vlibc_dirent64 *d;
+    while ((d = vlibc_dirreader_next(&rd, &err))) {
+        if (count == me->entcap) {
+            size_t ncap = me->entcap ? me->entcap * 2 : 256;
+            struct vlibc_dirent64 **ne = realloc(me->ents,
+                                                 ncap * sizeof(*ne));
+            if (!ne) {
+                errno = ENOMEM;
+                return -1;
+            }
+            me->ents = ne;
+            me->entcap = ncap;
+        }
+        me->ents[count++] = d;
+    }
+    qsort(me->ents, count, sizeof(*me->ents), entry_cmp);
+    return (long)count;
+}
+
+static int visit(struct pworker *me, struct pjob *j, int fd,
+                 const struct vlibc_dirent64 *d)
+{
+    struct pwalk *pw = me->pw;
+    struct vlibc_walkent e;
+    size_t nlen = strlen(d->d_name);
+    if (path_reserve(me, me->prefix + nlen) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(me->path + me->prefix, d->d_name, nlen + 1);
+    e.path = me->path;
+    e.pathlen = me->prefix + nlen;
+    e.base = me->prefix;
+    e.level = j->level + 1;
+
+    int cfd;
+    if (__vlibc_walk_classify(pw->flags, 0, pw->dev, fd, d->d_name,
+                              d->d_type, d->d_ino, &e, &cfd))
+        return 0;
+    deliver(me, &e);
+    if (cfd < 0)
+        return 0;
+    if (atomic_load(&pw->stop)) {
+        close(cfd);
+        return 0;
+    }
+    return job_add(me, j, &e, cfd);
+}
+
+static void run_job(struct pworker *me, struct pjob *j)
+{
+    struct pwalk *pw = me->pw;
+    int fd = j->fd;
+    if (atomic_load(&pw->stop))
+        goto out;
+    if (fd >= 0) {
+        j->fd = -1;
+        atomic_fetch_sub(&pw->fds, 1);
+    } else {
+        int fl = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+        if ((pw->flags & VLIBC_WALK_PHYS) && j->level)
+            fl |= O_NOFOLLOW;
+        fd = open(j->path, fl);
+        if (fd < 0) {
+            /* removed or made unreadable since it was classified */
+            struct vlibc_walkent e;
+            memset(&e, 0, sizeof(e));
+            e.path = j->path;
+            e.pathlen = j->pathlen;
+            e.base = j->base;
+            e.level = j->level;
+            e.type = VLIBC_WALK_DNR;
+            e.error = errno;
+            e.st = j->st;
+            deliver(me, &e);
+            goto out;
+        }
+    }
+
+    int failed = 0;
+    size_t add = j->pathlen && j->path[j->pathlen - 1] != '/' ? 1 : 0;
+    if (path_reserve(me, j->pathlen + add) < 0) {
+        errno = ENOMEM;
+        failed = 1;
+        goto done;
+    }
+    memcpy(me->path, j->path, j->pathlen);
+    if (add)
+        me->path[j->pathlen] = '/';
+    me->prefix = j->pathlen + add;
+
+    if (pw->flags & VLIBC_PWALK_SORTED) {
+        long n = list_sorted(me, fd);
+        if (n < 0)
+            failed = 1;
+        for (long i = 0; i < n && !atomic_load(&pw->stop); i++)
+            if (visit(me, j, fd, me->ents[i]) < 0) {
+                failed = 1;
+                break;
+            }
+    } else {
+        struct vlibc_dirreader rd;
+        vlibc_dirreader_init(&rd, fd, me->buf, me->bufsize);
+        struct vlibc_dirent64 *d;
+        int err;
+        while (!atomic_load(&pw->stop) &&
+               (d = vlibc_dirreader_next(&rd, &err))) {
+            if (visit(me, j, fd, d) < 0) {
+                failed = 1;
+                break;
+            }
+        }
+        if (!failed && !atomic_load(&pw->stop) && err) {
+            errno = err;
+            failed = 1;
+        }
+    }
+done:
+    if (failed)
+        set_result(pw, -1, errno);
+    close(fd);
+out:
+    job_release(me, j);
+}
+
+static void *worker_main(void *arg)
+{
+    struct pworker *me = arg;
+    struct pwalk *pw = me->pw;
+    for (;;) {
+        struct pjob *j = q_take(me, 1);
+        if (!j)
+            j = steal(me);
+        if (j) {
+            run_job(me, j);
+            continue;
+        }
+        if (atomic_load(&pw->outstanding) == 0)
+            break;
+        pthread_mutex_lock(&pw->lock);
+        atomic_fetch_add(&pw->sleepers, 1);
+        while (!work_available(pw))
+            pthread_cond_wait(&pw->cond, &pw->lock);
+        atomic_fetch_sub(&pw->sleepers, 1);
+        pthread_mutex_unlock(&pw->lock);
+    }
+    return NULL;
+}
+
+static void workers_free(struct pwalk *pw)
+{
+    if (!pw->w)
+        return;
+    for (int i = 0; i < pw->nworkers; i++) {
+        struct pworker *w = &pw->w[i];
+        while (w->chunk) {
+            char *next = *(char **)w->chunk;
+            free(w->chunk);
+            w->chunk = next;
+        }
+        free(w->q);
+        free(w->buf);
+        free(w->path);
+        free(w->ents);
+    }
+    free(pw->w);
+}
+
+extern long __vlibc_usable_cpus(void);
+
+int vlibc_pwalk(const char *root, int flags, int nthreads, int fdlimit,
+                vlibc_pwalk_fn fn, void *arg)
+{
+    if (!root || !fn) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (nthreads <= 0) {
+        long n = __vlibc_usable_cpus();
+        nthreads = n > 0 ? (int)n : 1;
+    }
+
+    struct vlibc_walkent e;
+    int fd;
+    const char *slash = strrchr(root, '/');
+    memset(&e, 0, sizeof(e));
+    e.path = root;
+    e.pathlen = strlen(root);
+    e.base = slash ? (size_t)(slash + 1 - root) : 0;
+    __vlibc_walk_classify(flags, 1, 0, AT_FDCWD, root, 0, 0, &e, &fd);
+    int r = fn(&e, 0, arg);
+    if (r || fd < 0) {
+        if (fd >= 0)
+            close(fd);
+        return r;
+    }
+
+    struct pwalk pw;
+    memset(&pw, 0, sizeof(pw));
+    pw.flags = flags;
+    pw.fdlimit = fdlimit > 0 ? fdlimit : 1;
+    pw.nworkers = nthreads;
+    pw.dev = e.st.st_dev;
+    pw.fn = fn;
+    pw.arg = arg;
+    pthread_mutex_init(&pw.lock, NULL);
+    pthread_cond_init(&pw.cond, NULL);
+    pthread_spin_init(&pw.free_lock, 0);
+    pw.w = calloc((size_t)nthreads, sizeof(*pw.w));
+    if (!pw.w)
+        goto nomem;
+    for (int i = 0; i < nthreads; i++) {
+        struct pworker *w = &pw.w[i];
+        w->id = i;
+        w->pw = &pw;
+        pthread_spin_init(&w->qlock, 0);
+        w->buf = malloc(VLIBC_DIRBUF_SIZE);
+        if (!w->buf)
+            goto nomem;
+        w->bufsize = VLIBC_DIRBUF_SIZE;
+    }
+
+    struct pjob *j = job_alloc(&pw.w[0], e.pathlen);
+    if (!j)
+        goto nomem;
+    j->parent = NULL;
+    atomic_init(&j->refs, 1);
+    j->fd = fd;
+    j->level = 0;
+    j->nostat = e.nostat;
+    j->base = e.base;
+    j->pathlen = e.pathlen;
+    j->st = e.st;
+    memcpy(j->path, root, e.pathlen + 1);
+    atomic_store(&pw.fds, 1);
+    atomic_store(&pw.outstanding, 1);
+    if (q_push(&pw.w[0], j) < 0) {
+        job_free(&pw, j);
+        goto nomem;
+    }
+    fd = -1;
+
+    /* the calling thread is worker 0; run with fewer if threads fail */
+    int started = 1;
+    for (; started < nthreads; started++)
+        if (pthread_create(&pw.w[started].thread, NULL, worker_main,
+                           &pw.w[started]) != 0)
+            break;
+    worker_main(&pw.w[0]);
+    for (int i = 1; i < started; i++)
+        pthread_join(pw.w[i].thread, NULL);
+
+    workers_free(&pw);
+    if (pw.result) {
+        errno = pw.err;
+        return pw.result;
+    }
+    return 0;
+
+nomem:
+    if (fd >= 0)
+        close(fd);
+    workers_free(&pw);
+    errno = ENOMEM;
+    return -1;
+}
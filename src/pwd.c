@@ -11,95 +11,54 @@
 #include "string.h"
 #include "stdlib.h"
 #include "env.h"
+#include "errno.h"
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
 
-#if defined(__FreeBSD__) || defined(__NetBSD__) || \
-    defined(__OpenBSD__) || defined(__DragonFly__)
+static __thread struct passwd pw_ent;
+static __thread char *pw_buf;
+static __thread size_t pw_cap;
 
-static const char *passwd_path(void)
-{
-    const char *p = getenv("VLIBC_PASSWD");
-    if (p && *p)
-        return p;
-    return "/etc/passwd";
-}
-
-static struct passwd pw;
-static char *linebuf;
-static size_t linecap;
-
-static struct passwd *parse_line(char *line)
+/*
+ * fetch() - run a reentrant lookup into a per-thread buffer, growing it
+ * until the entry fits.
+ */
+static struct passwd *fetch(const char *name, uid_t uid, int by_name)
 {
-    size_t len = strlen(line);
-    if (len && line[len - 1] == '\n')
-        line[len - 1] = '\0';
-    if (len + 1 > linecap) {
-        char *tmp = realloc(linebuf, len + 1);
+    struct passwd *res = NULL;
+    for (;;) {
+        if (!pw_buf) {
+            pw_buf = malloc(1024);
+            if (!pw_buf)
+                return NULL;
+            pw_cap = 1024;
+        }
+        int r = by_name ? getpwnam_r(name, &pw_ent, pw_buf, pw_cap, &res)
+                        : getpwuid_r(uid, &pw_ent, pw_buf, pw_cap, &res);
+        if (r != ERANGE)
+            return r == 0 ? res : NULL;
+        char *tmp = realloc(pw_buf, pw_cap * 2);
         if (!tmp)
             return NULL;
-        linebuf = tmp;
-        linecap = len + 1;
-    }
-    memcpy(linebuf, line, len + 1);
-
-    char *save;
-    pw.pw_name = strtok_r(linebuf, ":", &save);
-    pw.pw_passwd = strtok_r(NULL, ":", &save);
-    char *uid_s = strtok_r(NULL, ":", &save);
-    char *gid_s = strtok_r(NULL, ":", &save);
-    pw.pw_gecos = strtok_r(NULL, ":", &save);
-    pw.pw_dir = strtok_r(NULL, ":", &save);
-    pw.pw_shell = strtok_r(NULL, ":\n", &save);
-    if (!pw.pw_name || !pw.pw_passwd || !uid_s || !gid_s ||
-        !pw.pw_gecos || !pw.pw_dir || !pw.pw_shell)
-        return NULL;
-    pw.pw_uid = (uid_t)atoi(uid_s);
-    pw.pw_gid = (gid_t)atoi(gid_s);
-    return &pw;
-}
-
-static struct passwd *lookup(const char *name, uid_t uid, int by_name)
-{
-    FILE *f = fopen(passwd_path(), "r");
-    if (!f)
-        return NULL;
-
-    struct passwd *ret = NULL;
-    char *line = NULL;
-    size_t cap = 0;
-    while (getline(&line, &cap, f) != -1) {
-        struct passwd *p = parse_line(line);
-        if (!p)
-            continue;
-        if (by_name) {
-            if (strcmp(p->pw_name, name) == 0) {
-                ret = p;
-                break;
-            }
-        } else {
-            if (p->pw_uid == uid) {
-                ret = p;
-                break;
-            }
-        }
+        pw_buf = tmp;
+        pw_cap *= 2;
     }
-    free(line);
-    fclose(f);
-    return ret;
 }
 
 struct passwd *getpwuid(uid_t uid)
 {
-    return lookup(NULL, uid, 0);
+    return fetch(NULL, uid, 0);
 }
 
 struct passwd *getpwnam(const char *name)
 {
-    return lookup(name, 0, 1);
+    return fetch(name, 0, 1);
 }
 
+#if defined(__FreeBSD__) || defined(__NetBSD__) || \
+    defined(__OpenBSD__) || defined(__DragonFly__)
+
 extern void host_setpwent(void) __asm("setpwent");
 extern struct passwd *host_getpwent(void) __asm("getpwent");
 extern void host_endpwent(void) __asm("endpwent");
@@ -121,19 +80,6 @@ void endpwent(void)
 
 #else
 
-extern struct passwd *host_getpwuid(uid_t) __asm("getpwuid");
-extern struct passwd *host_getpwnam(const char *) __asm("getpwnam");
-
-struct passwd *getpwuid(uid_t uid)
-{
-    return host_getpwuid(uid);
-}
-
-struct passwd *getpwnam(const char *name)
-{
-    return host_getpwnam(name);
-}
-
 static const char *passwd_path(void)
 {
     const char *p = getenv("VLIBC_PASSWD");
@@ -11,11 +11,7 @@
 #include "string.h"
 #include "stdlib.h"
 #include "env.h"
-#include <fcntl.h>
-#include <unistd.h>
-
-#if defined(__FreeBSD__) || defined(__NetBSD__) || \
-    defined(__OpenBSD__) || defined(__DragonFly__)
+#include "errno.h"
 
 static const char *passwd_path(void)
 {
@@ -25,97 +21,31 @@ static const char *passwd_path(void)
     return "/etc/passwd";
 }
 
-static int parse_line_r(const char *line, struct passwd *pw,
-                        char *buf, size_t buflen)
-{
-    char lbuf[256];
-    strncpy(lbuf, line, sizeof(lbuf) - 1);
-    lbuf[sizeof(lbuf) - 1] = '\0';
-
-    char *save;
-    char *name = strtok_r(lbuf, ":", &save);
-    char *passwd = strtok_r(NULL, ":", &save);
-    char *uid_s = strtok_r(NULL, ":", &save);
-    char *gid_s = strtok_r(NULL, ":", &save);
-    char *gecos = strtok_r(NULL, ":", &save);
-    char *dir = strtok_r(NULL, ":", &save);
-    char *shell = strtok_r(NULL, ":\n", &save);
-    if (!name || !passwd || !uid_s || !gid_s || !gecos || !dir || !shell)
-        return -1;
-
-    size_t len;
-
-    len = strlcpy(buf, name, buflen);
-    if (len >= buflen)
-        return -1;
-    pw->pw_name = buf; buf += len + 1; buflen -= len + 1;
-
-    len = strlcpy(buf, passwd, buflen);
-    if (len >= buflen)
-        return -1;
-    pw->pw_passwd = buf; buf += len + 1; buflen -= len + 1;
-
-    len = strlcpy(buf, gecos, buflen);
-    if (len >= buflen)
-        return -1;
-    pw->pw_gecos = buf; buf += len + 1; buflen -= len + 1;
-
-    len = strlcpy(buf, dir, buflen);
-    if (len >= buflen)
-        return -1;
-    pw->pw_dir = buf; buf += len + 1; buflen -= len + 1;
-
-    len = strlcpy(buf, shell, buflen);
-    if (len >= buflen)
-        return -1;
-    pw->pw_shell = buf; buf += len + 1; buflen -= len + 1;
-
-    pw->pw_uid = (uid_t)atoi(uid_s);
-    pw->pw_gid = (gid_t)atoi(gid_s);
-    return 0;
-}
+extern int __vlibc_pwdb_getpw(const char *path, const char *name, uid_t uid,
+                              int by_name, struct passwd *pwd, char *buf,
+                              size_t buflen);
 
+/*
+ * lookup_r() - search the indexed passwd file by name or uid. A missing
+ * entry returns 0 with *result set to NULL.
+ */
 static int lookup_r(const char *name, uid_t uid, int by_name,
                     struct passwd *pwd, char *buf, size_t buflen,
                     struct passwd **result)
 {
     if (!pwd || !buf || !result)
-        return -1;
+        return EINVAL;
     *result = NULL;
 
-#ifdef O_CLOEXEC
-    int flags = O_RDONLY | O_CLOEXEC;
-#else
-    int flags = O_RDONLY;
-#endif
-    int fd = open(passwd_path(), flags, 0);
-    if (fd < 0)
-        return -1;
-    char filebuf[4096];
-    ssize_t n = read(fd, filebuf, sizeof(filebuf) - 1);
-    close(fd);
-    if (n <= 0)
-        return -1;
-    filebuf[n] = '\0';
-
-    char *save_line;
-    for (char *line = strtok_r(filebuf, "\n", &save_line); line;
-         line = strtok_r(NULL, "\n", &save_line)) {
-        if (parse_line_r(line, pwd, buf, buflen) != 0)
-            continue;
-        if (by_name) {
-            if (strcmp(pwd->pw_name, name) == 0) {
-                *result = pwd;
-                return 0;
-            }
-        } else {
-            if (pwd->pw_uid == uid) {
-                *result = pwd;
-                return 0;
-            }
-        }
+    int r = __vlibc_pwdb_getpw(passwd_path(), name, uid, by_name,
+                               pwd, buf, buflen);
+    if (r == 0) {
+        *result = pwd;
+        return 0;
     }
-    return -1;
+    if (r != ENOENT)
+        return r;
+    return 0;
 }
 
 int getpwuid_r(uid_t uid, struct passwd *pwd, char *buf, size_t buflen,
@@ -129,24 +59,3 @@ int getpwnam_r(const char *name, struct passwd *pwd, char *buf, size_t buflen,
 {
     return lookup_r(name, 0, 1, pwd, buf, buflen, result);
 }
-
-#else
-
-extern int host_getpwuid_r(uid_t, struct passwd *, char *, size_t,
-                           struct passwd **) __asm("getpwuid_r");
-extern int host_getpwnam_r(const char *, struct passwd *, char *, size_t,
-                           struct passwd **) __asm("getpwnam_r");
-
-int getpwuid_r(uid_t uid, struct passwd *pwd, char *buf, size_t buflen,
-               struct passwd **result)
-{
-    return host_getpwuid_r(uid, pwd, buf, buflen, result);
-}
-
-int getpwnam_r(const char *name, struct passwd *pwd, char *buf, size_t buflen,
-               struct passwd **result)
-{
-    return host_getpwnam_r(name, pwd, buf, buflen, result);
-}
-
-#endif
@@ -0,0 +1,644 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Indexed cache of the passwd and group databases. Each file is
+ * mapped once and indexed by name and id; the index is rebuilt only when
+ * the file's inode, size or modification time changes.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "pwd.h"
+#include "grp.h"
+#include "io.h"
+#include "string.h"
+#include "stdlib.h"
+#include "memory.h"
+#include "errno.h"
+#include "pthread.h"
+#include "sys/stat.h"
+#include "sys/mman.h"
+#include <fcntl.h>
+#include <stdint.h>
+
+/* a field inside the mapped file; not NUL terminated */
+struct field {
+    const char *p;
+    size_t n;
+};
+
+struct pw_rec {
+    struct field name, passwd, gecos, dir, shell;
+    uid_t uid;
+    gid_t gid;
+};
+
+struct gr_rec {
+    struct field name, passwd, mem;
+    gid_t gid;
+    size_t nmem;
+};
+
+/* one "user is a member of group" edge for getgrouplist() */
+struct gr_link {
+    struct field user;
+    size_t group;
+    size_t next; /* next link for the same user, 0 terminates */
+};
+
+/* a mapped database file and the identity it was indexed from */
+struct db_file {
+    char *path;
+    char *data;
+    size_t len;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    long mtime_nsec;
+    int loaded;
+};
+
+/* an edit within the same second only shows up in the nanoseconds */
+#if defined(__APPLE__)
+#define ST_MTIME_NSEC(st) ((st)->st_mtimespec.tv_nsec)
+#elif defined(__GLIBC__) && !defined(__USE_XOPEN2K8)
+/* glibc only names it st_mtim in POSIX 2008 mode, which -std=c11 is not */
+#define ST_MTIME_NSEC(st) ((st)->st_mtimensec)
+#else
+#define ST_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#endif
+
+/*
+ * Hash tables are open addressed with linear probing and hold record
+ * indexes plus one so that zero marks an empty slot.
+ */
+struct db_hash {
+    size_t *slot;
+    size_t mask;
+};
+
+static pthread_mutex_t pw_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct db_file pw_file;
+static struct pw_rec *pw_recs;
+static size_t pw_count;
+static struct db_hash pw_by_name;
+static struct db_hash pw_by_uid;
+
+static pthread_mutex_t gr_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct db_file gr_file;
+static struct gr_rec *gr_recs;
+static size_t gr_count;
+static struct gr_link *gr_links;
+static size_t gr_nlinks;
+static struct db_hash gr_by_name;
+static struct db_hash gr_by_gid;
+static struct db_hash gr_by_user;
+
+/* FNV-1a over a counted string */
+static size_t hash_bytes(const char *s, size_t n)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static size_t hash_id(unsigned long id)
+{
+    uint64_t h = (uint64_t)id * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(h >> 32);
+}
+
+static int field_eq(struct field f, const char *s, size_t n)
+{
+    return f.n == n && memcmp(f.p, s, n) == 0;
+}
+
+static int hash_init(struct db_hash *h, size_t count)
+{
+    size_t size = 16;
+    while (size < count * 2)
+        size <<= 1;
+    free(h->slot);
+    h->slot = calloc(size, sizeof(size_t));
+    if (!h->slot) {
+        h->mask = 0;
+        return -1;
+    }
+    h->mask = size - 1;
+    return 0;
+}
+
+static void hash_free(struct db_hash *h)
+{
+    free(h->slot);
+    h->slot = NULL;
+    h->mask = 0;
+}
+
+/*
+ * split_fields() - split a line at ':' into at most max fields.
+ * Empty fields are preserved. Returns the number of fields found.
+ */
+static size_t split_fields(const char *p, const char *end,
+                           struct field *out, size_t max)
+{
+    size_t n = 0;
+    while (n < max) {
+        const char *c = memchr(p, ':', (size_t)(end - p));
+        if (!c || n == max - 1) {
+            out[n].p = p;
+            out[n].n = (size_t)(end - p);
+            return n + 1;
+        }
+        out[n].p = p;
+        out[n].n = (size_t)(c - p);
+        n++;
+        p = c + 1;
+    }
+    return n;
+}
+
+static unsigned long parse_id(struct field f)
+{
+    unsigned long v = 0;
+    for (size_t i = 0; i < f.n && f.p[i] >= '0' && f.p[i] <= '9'; i++)
+        v = v * 10 + (unsigned long)(f.p[i] - '0');
+    return v;
+}
+
+/*
+ * next_line() - return the next non-empty, non-comment line starting
+ * at *pos. The line excludes its terminating newline.
+ */
+static int next_line(const struct db_file *f, size_t *pos,
+                     const char **start, const char **end)
+{
+    while (*pos < f->len) {
+        const char *s = f->data + *pos;
+        const char *nl = memchr(s, '\n', f->len - *pos);
+        const char *e = nl ? nl : f->data + f->len;
+        *pos = (size_t)(e - f->data) + 1;
+        if (e > s && e[-1] == '\r')
+            e--;
+        if (e == s || *s == '#')
+            continue;
+        *start = s;
+        *end = e;
+        return 1;
+    }
+    return 0;
+}
+
+static void db_unmap(struct db_file *f)
+{
+    if (f->data)
+        munmap(f->data, f->len);
+    f->data = NULL;
+    f->len = 0;
+    f->loaded = 0;
+}
+
+/*
+ * db_refresh() - make sure *f maps the current contents of path.
+ * Returns 1 when the mapping was replaced, 0 when the cached mapping is
+ * still valid and -1 when the file cannot be read.
+ */
+static int db_refresh(struct db_file *f, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        db_unmap(f);
+        return -1;
+    }
+    if (f->loaded && f->path && strcmp(f->path, path) == 0 &&
+        f->dev == st.st_dev && f->ino == st.st_ino &&
+        f->size == st.st_size && f->mtime == st.st_mtime &&
+        f->mtime_nsec == (long)ST_MTIME_NSEC(&st))
+        return 0;
+
+    db_unmap(f);
+    if (!f->path || strcmp(f->path, path) != 0) {
+        char *p = strdup(path);
+        if (!p)
+            return -1;
+        free(f->path);
+        f->path = p;
+    }
+
+#ifdef O_CLOEXEC
+    int flags = O_RDONLY | O_CLOEXEC;
+#else
+    int flags = O_RDONLY;
+#endif
+    int fd = open(path, flags, 0);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                       fd, 0);
+        if (m == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        f->data = m;
+        f->len = (size_t)st.st_size;
+    }
+    close(fd);
+    f->dev = st.st_dev;
+    f->ino = st.st_ino;
+    f->size = st.st_size;
+    f->mtime = st.st_mtime;
+    f->mtime_nsec = (long)ST_MTIME_NSEC(&st);
+    f->loaded = 1;
+    return 1;
+}
+
+static void pw_reset(void)
+{
+    free(pw_recs);
+    pw_recs = NULL;
+    pw_count = 0;
+    hash_free(&pw_by_name);
+    hash_free(&pw_by_uid);
+}
+
+/* pw_build() - parse the mapped passwd file into records and indexes */
+static int pw_build(void)
+{
+    pw_reset();
+
+    size_t lines = 0;
+    for (size_t i = 0; i < pw_file.len; i++)
+        if (pw_file.data[i] == '\n')
+            lines++;
+    lines++;
+
+    pw_recs = malloc(lines * sizeof(*pw_recs));
+    if (!pw_recs || hash_init(&pw_by_name, lines) != 0 ||
+        hash_init(&pw_by_uid, lines) != 0) {
+        pw_reset();
+        return -1;
+    }
+
+    size_t pos = 0;
+    const char *s, *e;
+    while (next_line(&pw_file, &pos, &s, &e)) {
+        struct field fl[7];
+        if (split_fields(s, e, fl, 7) != 7)
+            continue;
+        struct pw_rec *r = &pw_recs[pw_count];
+        r->name = fl[0];
+        r->passwd = fl[1];
+        r->uid = (uid_t)parse_id(fl[2]);
+        r->gid = (gid_t)parse_id(fl[3]);
+        r->gecos = fl[4];
+        r->dir = fl[5];
+        r->shell = fl[6];
+
+        /* the first entry wins, as with a sequential scan */
+        size_t i = hash_bytes(r->name.p, r->name.n) & pw_by_name.mask;
+        while (pw_by_name.slot[i] &&
+               !field_eq(pw_recs[pw_by_name.slot[i] - 1].name,
+                         r->name.p, r->name.n))
+            i = (i + 1) & pw_by_name.mask;
+        if (!pw_by_name.slot[i])
+            pw_by_name.slot[i] = pw_count + 1;
+
+        i = hash_id(r->uid) & pw_by_uid.mask;
+        while (pw_by_uid.slot[i] && pw_recs[pw_by_uid.slot[i] - 1].uid != r->uid)
+            i = (i + 1) & pw_by_uid.mask;
+        if (!pw_by_uid.slot[i])
+            pw_by_uid.slot[i] = pw_count + 1;
+
+        pw_count++;
+    }
+    return 0;
+}
+
+static void gr_reset(void)
+{
+    free(gr_recs);
+    gr_recs = NULL;
+    gr_count = 0;
+    free(gr_links);
+    gr_links = NULL;
+    gr_nlinks = 0;
+    hash_free(&gr_by_name);
+    hash_free(&gr_by_gid);
+    hash_free(&gr_by_user);
+}
+
+/* gr_build() - parse the mapped group file into records and indexes */
+static int gr_build(void)
+{
+    gr_reset();
+
+    size_t lines = 0, commas = 0;
+    for (size_t i = 0; i < gr_file.len; i++) {
+        if (gr_file.data[i] == '\n')
+            lines++;
+        else if (gr_file.data[i] == ',')
+            commas++;
+    }
+    lines++;
+
+    gr_recs = malloc(lines * sizeof(*gr_recs));
+    gr_links = malloc((lines + commas + 1) * sizeof(*gr_links));
+    if (!gr_recs || !gr_links || hash_init(&gr_by_name, lines) != 0 ||
+        hash_init(&gr_by_gid, lines) != 0 ||
+        hash_init(&gr_by_user, lines + commas) != 0) {
+        gr_reset();
+        return -1;
+    }
+    /* link 0 is reserved as the list terminator */
+    gr_nlinks = 1;
+
+    size_t pos = 0;
+    const char *s, *e;
+    while (next_line(&gr_file, &pos, &s, &e)) {
+        struct field fl[4];
+        size_t nf = split_fields(s, e, fl, 4);
+        if (nf < 3)
+            continue;
+        struct gr_rec *r = &gr_recs[gr_count];
+        r->name = fl[0];
+        r->passwd = fl[1];
+        r->gid = (gid_t)parse_id(fl[2]);
+        r->mem.p = nf == 4 ? fl[3].p : e;
+        r->mem.n = nf == 4 ? fl[3].n : 0;
+        r->nmem = 0;
+
+        size_t i = hash_bytes(r->name.p, r->name.n) & gr_by_name.mask;
+        while (gr_by_name.slot[i] &&
+               !field_eq(gr_recs[gr_by_name.slot[i] - 1].name,
+                         r->name.p, r->name.n))
+            i = (i + 1) & gr_by_name.mask;
+        if (!gr_by_name.slot[i])
+            gr_by_name.slot[i] = gr_count + 1;
+
+        i = hash_id(r->gid) & gr_by_gid.mask;
+        while (gr_by_gid.slot[i] && gr_recs[gr_by_gid.slot[i] - 1].gid != r->gid)
+            i = (i + 1) & gr_by_gid.mask;
+        if (!gr_by_gid.slot[i])
+            gr_by_gid.slot[i] = gr_count + 1;
+
+        gr_count++;
+    }
+
+    /*
+     * Build the user -> groups lists by walking the groups backwards and
+     * pushing each membership onto the front of the user's list, which
+     * leaves every list in file order.
+     */
+    for (size_t g = gr_count; g-- > 0;) {
+        struct gr_rec *r = &gr_recs[g];
+        const char *p = r->mem.p;
+        const char *end = r->mem.p + r->mem.n;
+        while (p < end) {
+            const char *c = memchr(p, ',', (size_t)(end - p));
+            const char *me = c ? c : end;
+            if (me > p) {
+                struct gr_link *l = &gr_links[gr_nlinks];
+                l->user.p = p;
+                l->user.n = (size_t)(me - p);
+                l->group = g;
+                size_t i = hash_bytes(p, l->user.n) & gr_by_user.mask;
+                while (gr_by_user.slot[i] &&
+                       !field_eq(gr_links[gr_by_user.slot[i]].user,
+                                 p, l->user.n))
+                    i = (i + 1) & gr_by_user.mask;
+                l->next = gr_by_user.slot[i];
+                gr_by_user.slot[i] = gr_nlinks++;
+                r->nmem++;
+            }
+            p = me + 1;
+        }
+    }
+    return 0;
+}
+
+/* pw_load() - refresh the passwd index; called with pw_lock held */
+static int pw_load(const char *path)
+{
+    int r = db_refresh(&pw_file, path);
+    if (r < 0) {
+        pw_reset();
+        return -1;
+    }
+    if (r > 0 || !pw_recs)
+        return pw_build();
+    return 0;
+}
+
+/* gr_load() - refresh the group index; called with gr_lock held */
+static int gr_load(const char *path)
+{
+    int r = db_refresh(&gr_file, path);
+    if (r < 0) {
+        gr_reset();
+        return -1;
+    }
+    if (r > 0 || !gr_recs)
+        return gr_build();
+    return 0;
+}
+
+/* copy_field() - append a NUL terminated copy of f to the output buffer */
+static char *copy_field(struct field f, char **buf, size_t *left)
+{
+    if (f.n + 1 > *left)
+        return NULL;
+    char *dst = *buf;
+    memcpy(dst, f.p, f.n);
+    dst[f.n] = '\0';
+    *buf += f.n + 1;
+    *left -= f.n + 1;
+    return dst;
+}
+
+/*
+ * __vlibc_pwdb_getpw() - look up a passwd entry in the index of path by
+ * name or uid and copy it into caller storage. Returns 0 on success,
+ * ENOENT when no entry matches or the file is unreadable and ERANGE
+ * when buf is too small.
+ */
+int __vlibc_pwdb_getpw(const char *path, const char *name, uid_t uid,
+                       int by_name, struct passwd *pwd, char *buf,
+                       size_t buflen)
+{
+    pthread_mutex_lock(&pw_lock);
+    if (pw_load(path) != 0) {
+        pthread_mutex_unlock(&pw_lock);
+        return ENOENT;
+    }
+
+    const struct pw_rec *r = NULL;
+    if (by_name) {
+        size_t n = strlen(name);
+        size_t i = hash_bytes(name, n) & pw_by_name.mask;
+        for (; pw_by_name.slot[i]; i = (i + 1) & pw_by_name.mask) {
+            if (field_eq(pw_recs[pw_by_name.slot[i] - 1].name, name, n)) {
+                r = &pw_recs[pw_by_name.slot[i] - 1];
+                break;
+            }
+        }
+    } else {
+        size_t i = hash_id(uid) & pw_by_uid.mask;
+        for (; pw_by_uid.slot[i]; i = (i + 1) & pw_by_uid.mask) {
+            if (pw_recs[pw_by_uid.slot[i] - 1].uid == uid) {
+                r = &pw_recs[pw_by_uid.slot[i] - 1];
+                break;
+            }
+        }
+    }
+    if (!r) {
+        pthread_mutex_unlock(&pw_lock);
+        return ENOENT;
+    }
+
+    int ret = 0;
+    if (!(pwd->pw_name = copy_field(r->name, &buf, &buflen)) ||
+        !(pwd->pw_passwd = copy_field(r->passwd, &buf, &buflen)) ||
+        !(pwd->pw_gecos = copy_field(r->gecos, &buf, &buflen)) ||
+        !(pwd->pw_dir = copy_field(r->dir, &buf, &buflen)) ||
+        !(pwd->pw_shell = copy_field(r->shell, &buf, &buflen)))
+        ret = ERANGE;
+    pwd->pw_uid = r->uid;
+    pwd->pw_gid = r->gid;
+    pthread_mutex_unlock(&pw_lock);
+    return ret;
+}
+
+/*
+ * __vlibc_pwdb_getgr() - group counterpart of __vlibc_pwdb_getpw(). The
+ * member pointer array is stored at the (aligned) start of buf.
+ */
+int __vlibc_pwdb_getgr(const char *path, const char *name, gid_t gid,
+                       int by_name, struct group *grp, char *buf,
+                       size_t buflen)
+{
+    pthread_mutex_lock(&gr_lock);
+    if (gr_load(path) != 0) {
+        pthread_mutex_unlock(&gr_lock);
+        return ENOENT;
+    }
+
+    const struct gr_rec *r = NULL;
+    if (by_name) {
+        size_t n = strlen(name);
+        size_t i = hash_bytes(name, n) & gr_by_name.mask;
+        for (; gr_by_name.slot[i]; i = (i + 1) & gr_by_name.mask) {
+            if (field_eq(gr_recs[gr_by_name.slot[i] - 1].name, name, n)) {
+                r = &gr_recs[gr_by_name.slot[i] - 1];
+                break;
+            }
+        }
+    } else {
+        size_t i = hash_id(gid) & gr_by_gid.mask;
+        for (; gr_by_gid.slot[i]; i = (i + 1) & gr_by_gid.mask) {
+            if (gr_recs[gr_by_gid.slot[i] - 1].gid == gid) {
+                r = &gr_recs[gr_by_gid.slot[i] - 1];
+                break;
+            }
+        }
+    }
+    if (!r) {
+        pthread_mutex_unlock(&gr_lock);
+        return ENOENT;
+    }
+
+    size_t pad = (sizeof(char *) - ((uintptr_t)buf % sizeof(char *))) %
+                 sizeof(char *);
+    size_t need = pad + (r->nmem + 1) * sizeof(char *);
+    if (need > buflen) {
+        pthread_mutex_unlock(&gr_lock);
+        return ERANGE;
+    }
+    char **mem = (char **)(void *)(buf + pad);
+    buf += need;
+    buflen -= need;
+
+    int ret = 0;
+    if (!(grp->gr_name = copy_field(r->name, &buf, &buflen)) ||
+        !(grp->gr_passwd = copy_field(r->passwd, &buf, &buflen)))
+        ret = ERANGE;
+    size_t n = 0;
+    const char *p = r->mem.p;
+    const char *end = r->mem.p + r->mem.n;
+    while (ret == 0 && p < end) {
+        const char *c = memchr(p, ',', (size_t)(end - p));
+        const char *me = c ? c : end;
+        if (me > p) {
+            struct field f = { p, (size_t)(me - p) };
+            if (!(mem[n++] = copy_field(f, &buf, &buflen)))
+                ret = ERANGE;
+        }
+        p = me + 1;
+    }
+    mem[ret == 0 ? n : 0] = NULL;
+    grp->gr_mem = mem;
+    grp->gr_gid = r->gid;
+    pthread_mutex_unlock(&gr_lock);
+    return ret;
+}
+
+/*
+ * __vlibc_pwdb_grouplist() - getgrouplist() backend. Walks the indexed
+ * membership list of user instead of rescanning every group. Returns
+ * the number of groups or -1 with *ngroups set to the required size.
+ * When the group file cannot be read only group itself is reported.
+ */
+int __vlibc_pwdb_grouplist(const char *path, const char *user, gid_t group,
+                           gid_t *groups, int *ngroups)
+{
+    int limit = *ngroups;
+    int count = 0;
+    groups[count++] = group;
+
+    pthread_mutex_lock(&gr_lock);
+    if (gr_load(path) != 0) {
+        pthread_mutex_unlock(&gr_lock);
+        *ngroups = count;
+        return count;
+    }
+
+    size_t n = strlen(user);
+    size_t i = hash_bytes(user, n) & gr_by_user.mask;
+    size_t first = 0;
+    for (; gr_by_user.slot[i]; i = (i + 1) & gr_by_user.mask) {
+        if (field_eq(gr_links[gr_by_user.slot[i]].user, user, n)) {
+            first = gr_by_user.slot[i];
+            break;
+        }
+    }
+
+    for (size_t link = first; link; link = gr_links[link].next) {
+        gid_t gid = gr_recs[gr_links[link].group].gid;
+        /*
+         * Check the earlier links rather than the caller's buffer, which
+         * stops holding them once it fills up.
+         */
+        int dup = gid == group;
+        for (size_t l = first; !dup && l != link; l = gr_links[l].next)
+            dup = gr_recs[gr_links[l].group].gid == gid;
+        if (dup)
+            continue;
+        if (count < limit)
+            groups[count] = gid;
+        count++;
+    }
+    pthread_mutex_unlock(&gr_lock);
+
+    *ngroups = count;
+    if (count > limit)
+        return -1;
+    return count;
+}
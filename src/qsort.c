@@ -8,8 +8,21 @@
 
 #include "stdlib.h"
 
+#include <stdint.h>
+
+typedef int (*sort_cmp)(const void *, const void *, void *);
+
 static void swap(char *a, char *b, size_t size)
 {
+    if (((uintptr_t)a | (uintptr_t)b | size) % sizeof(long) == 0) {
+        long *x = (long *)a, *y = (long *)b;
+        for (size_t n = size / sizeof(long); n--; x++, y++) {
+            long tmp = *x;
+            *x = *y;
+            *y = tmp;
+        }
+        return;
+    }
     while (size--) {
         char tmp = *a;
         *a++ = *b;
@@ -17,23 +30,119 @@ static void swap(char *a, char *b, size_t size)
     }
 }
 
+static void sift_down(char *b, size_t root, size_t n, size_t size,
+                      sort_cmp cmp, void *ctx)
+{
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= n)
+            return;
+        if (child + 1 < n &&
+            cmp(b + child * size, b + (child + 1) * size, ctx) < 0)
+            child++;
+        if (cmp(b + root * size, b + child * size, ctx) >= 0)
+            return;
+        swap(b + root * size, b + child * size, size);
+        root = child;
+    }
+}
+
+static void heap_sort(char *b, size_t n, size_t size, sort_cmp cmp, void *ctx)
+{
+    for (size_t i = n / 2; i-- > 0;)
+        sift_down(b, i, n, size, cmp, ctx);
+    for (size_t end = n - 1; end > 0; end--) {
+        swap(b, b + end * size, size);
+        sift_down(b, 0, end, size, cmp, ctx);
+    }
+}
+
+/*
+ * Introsort: quicksort with a median of three pivot and a partition that
+ * stops on equal keys, so runs of duplicates split evenly. The smaller
+ * side recurses and the larger one loops, bounding the stack, and a
+ * depth budget of 2*log2(n) switches to heapsort on adversarial input.
+ * Short ranges finish with insertion sort.
+ */
+static void intro_sort(char *b, size_t n, size_t size, sort_cmp cmp,
+                       void *ctx, int depth)
+{
+    while (n > 16) {
+        if (depth-- == 0) {
+            heap_sort(b, n, size, cmp, ctx);
+            return;
+        }
+        char *lo = b, *mid = b + (n / 2) * size, *hi = b + (n - 1) * size;
+        if (cmp(mid, lo, ctx) < 0)
+            swap(mid, lo, size);
+        if (cmp(hi, mid, ctx) < 0) {
+            swap(hi, mid, size);
+            if (cmp(mid, lo, ctx) < 0)
+                swap(mid, lo, size);
+        }
+        swap(lo, mid, size);            /* pivot to the front */
+
+        size_t i = 1, j = n - 1;
+        for (;;) {
+            while (i <= j && cmp(b + i * size, b, ctx) < 0)
+                i++;
+            while (j >= i && cmp(b + j * size, b, ctx) > 0)
+                j--;
+            if (i >= j)
+                break;
+            swap(b + i * size, b + j * size, size);
+            i++;
+            j--;
+        }
+        swap(b, b + j * size, size);
+
+        /* [0, j) and (j, n) remain */
+        size_t left = j, right = n - j - 1;
+        if (left < right) {
+            intro_sort(b, left, size, cmp, ctx, depth);
+            b += (j + 1) * size;
+            n = right;
+        } else {
+            intro_sort(b + (j + 1) * size, right, size, cmp, ctx, depth);
+            n = left;
+        }
+    }
+    for (size_t i = 1; i < n; i++)
+        for (size_t k = i; k > 0 &&
+             cmp(b + (k - 1) * size, b + k * size, ctx) > 0; k--)
+            swap(b + (k - 1) * size, b + k * size, size);
+}
+
+static void sort(void *base, size_t nmemb, size_t size, sort_cmp cmp,
+                 void *ctx)
+{
+    if (nmemb < 2 || size == 0)
+        return;
+    int depth = 0;
+    for (size_t n = nmemb; n > 1; n >>= 1)
+        depth += 2;
+    intro_sort(base, nmemb, size, cmp, ctx, depth);
+}
+
+struct plain_cmp {
+    int (*compar)(const void *, const void *);
+};
+
+static int call_plain(const void *a, const void *b, void *ctx)
+{
+    return ((struct plain_cmp *)ctx)->compar(a, b);
+}
+
 /*
  * qsort() - sort an array using the supplied comparison function.
- * Elements are sorted in ascending order using a simple bubble sort
- * implementation as this file favors clarity over raw speed.
+ * Elements are sorted in ascending order in O(n log n) comparisons;
+ * the sort is not stable.
  */
 void qsort(void *base, size_t nmemb, size_t size,
            int (*compar)(const void *, const void *))
 {
-    char *b = base;
-    for (size_t i = 0; i < nmemb; i++) {
-        for (size_t j = i + 1; j < nmemb; j++) {
-            char *pi = b + i * size;
-            char *pj = b + j * size;
-            if (compar(pi, pj) > 0)
-                swap(pi, pj, size);
-        }
-    }
+    struct plain_cmp pc = { compar };
+    sort(base, nmemb, size, call_plain, &pc);
 }
 
 /*
@@ -43,15 +152,7 @@ void qsort(void *base, size_t nmemb, size_t size,
 void qsort_r(void *base, size_t nmemb, size_t size,
              int (*compar)(const void *, const void *, void *), void *ctx)
 {
-    char *b = base;
-    for (size_t i = 0; i < nmemb; i++) {
-        for (size_t j = i + 1; j < nmemb; j++) {
-            char *pi = b + i * size;
-            char *pj = b + j * size;
-            if (compar(pi, pj, ctx) > 0)
-                swap(pi, pj, size);
-        }
-    }
+    sort(base, nmemb, size, compar, ctx);
 }
 
 /*
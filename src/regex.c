@@ -8,762 +8,1602 @@
 
 #include "regex.h"
 #include "memory.h"
+#include "stdlib.h"
 #include <string.h>
 #include <ctype.h>
 #include "errno.h"
 #include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
 
 /*
- * This implementation is adapted from the public domain tiny-regex-c
- * project. It builds a very small NFA for the pattern and performs a
- * backtracking search. Originally only a subset of BRE/ERE syntax was
- * supported: '.', '*', '+', '?', '^', '$' and basic character classes.
- * This version adds simple alternation, grouping and repetition ranges
- * "{m,n}" along with POSIX character classes.
+ * regcomp() parses the pattern into a small syntax tree and compiles it
+ * once into a Thompson NFA program. regexec() runs the program with one
+ * of three executors:
+ *
+ *  - a lazily built DFA when only match/no-match is needed
+ *    (nmatch == 0 or REG_NOSUB); states are created on demand and cached
+ *    in the compiled pattern,
+ *  - a Pike VM that tracks capture offsets and reports the leftmost
+ *    longest match,
+ *  - a backtracking matcher for patterns containing backreferences,
+ *    which cannot be expressed as an automaton.
+ *
+ * The first two run in time linear in the subject length. regcomp()
+ * also extracts a literal prefix, the longest literal every match must
+ * contain and the set of bytes a match can start with. regexec() uses
+ * memmem()/memchr() on these to reject subjects and to skip ahead to
+ * candidate start positions before running an executor. Extended
+ * syntax is always used, with the \d \w \s shorthands and their
+ * negations available inside and outside bracket expressions.
  */
 
-struct token {
-    unsigned char type;
-    union {
-        unsigned char ch;
-        unsigned char *ccl;
-        int group;
-    } u;
+#define REGEX_DUP_MAX 255       /* largest {m,n} bound */
+#define REGEX_MAX_PROG 65536    /* instruction limit after expansion */
+#define REGEX_MAX_DEPTH 512     /* nesting limit for groups */
+#define DFA_MAX_STATES 512
+#define DFA_MAX_POOL (1 << 18)  /* ints of NFA state sets per cache */
+#define DFA_MAX_FLUSHES 32      /* give up on the DFA after this many */
+#define DFA_HASH_SIZE 1024
+
+/* program opcodes */
+enum {
+    OP_CHAR, OP_CLASS, OP_SPLIT, OP_JMP, OP_SAVE, OP_BOL, OP_EOL,
+    OP_MARK, OP_CHECK, OP_BACKREF, OP_MATCH
+};
+
+struct rinst {
+    unsigned char op;
+    int x;  /* char, class, target, slot or group */
+    int y;  /* second SPLIT target */
 };
 
-/* token types */
+struct rclass {
+    uint8_t bits[32];
+};
+
+/* syntax tree node types */
 enum {
-    UNUSED, DOT, BEGIN, END, QUESTION, STAR, PLUS, CHAR, CHAR_CLASS, INV_CHAR_CLASS,
-    DIGIT, NOT_DIGIT, ALPHA, NOT_ALPHA, SPACE, NOT_SPACE,
-    CAP_OPEN, CAP_CLOSE, BACKREF
+    N_EMPTY, N_CHAR, N_CLASS, N_BOL, N_EOL, N_CAT, N_ALT, N_REP, N_GROUP,
+    N_BACKREF
+};
+
+struct rnode {
+    unsigned char type;
+    int a;      /* char, class, first child, group number */
+    int b;      /* group index for N_GROUP */
+    int min, max;
+    int next;   /* next sibling in a N_CAT or N_ALT list */
+};
+
+/* one cached DFA state: a set of NFA program counters */
+struct dstate {
+    uint32_t hash;
+    int off;            /* first pc in the pool */
+    int n;
+    unsigned char bol;  /* previous character started a line */
+    unsigned char idle; /* only the start pc is pending */
+    signed char endm[2];
+    int hnext;
+    int next[256];
+};
+
+#define DFA_UNKNOWN (-1)
+#define DFA_MATCH (-2)
+#define DFA_FULL (-3)
+#define DFA_NOMEM (-4)
+
+struct dfa_cache {
+    struct dstate *states;
+    int nstates;
+    int *pool;
+    int npool;
+    int buckets[DFA_HASH_SIZE];
 };
 
-struct regex_alt {
-    struct token *pat;
-    unsigned char *ccl;
+/* per-pattern buffers reused by the executors */
+struct vm_scratch {
+    int *gen;           /* per-pc visit stamps */
+    int stamp;
+    int *stack;         /* add_thread work stack, three ints per entry */
+    int *list_pc[2];
+    int *list_caps[2];
+    int *tmp;           /* closure and step buffers for the DFA */
+    int *tmp2;
 };
 
 struct regex_impl {
-    struct regex_alt *alts;
-    size_t nalt;
+    struct rinst *prog;
+    int nprog;
+    struct rclass *cls;
+    int ncls;
+    int nmarks;
+    int cflags;
+    int has_backref;
+    int anchored;       /* every match must start at offset 0 */
+    char *prefix;       /* literal every match starts with */
+    size_t prefix_len;
+    char *required;     /* literal every match contains */
+    size_t required_len;
+    int has_first;      /* first is valid (pattern is not nullable) */
+    int first_byte;     /* sole member of first, or -1 */
+    struct rclass first;
+    atomic_flag busy;   /* guards scratch and dfa */
+    struct vm_scratch scratch;
+    int scratch_ready;
+    struct dfa_cache dfa;
 };
 
-/* helper prototypes */
-static int matchpattern(struct token *pat, const char *text, int *matchlen,
-                        const char *string, regmatch_t *caps);
+/* ---------------------------------------------------------------- */
+/* parsing                                                          */
 
-/* Build the token list for a single pattern alternative. */
-static int compile_single(struct regex_alt *alt, const char *pattern,
-                          size_t *groups_out)
+struct rparse {
+    const char *p;
+    int cflags;
+    struct rnode *nodes;
+    int nn, ncap;
+    struct rclass *cls;
+    int ncls, clscap;
+    int ngroups;
+    int depth;
+    int err;
+    int has_backref;
+};
+
+static int new_node(struct rparse *ps, int type, int a, int b)
 {
-    size_t len = strlen(pattern);
-    size_t patcap = len * 8 + 1;
-    alt->pat = malloc(patcap * sizeof(struct token));
-    if (!alt->pat)
-        return -1;
-    alt->ccl = malloc(len * 2 + 1);
-    if (!alt->ccl) {
-        free(alt->pat);
-        alt->pat = NULL;
-        return -1;
-    }
-    size_t ccl_idx = 1; /* first byte reserved */
-    size_t i = 0, j = 0;
-    int stack[10];
-    int depth = 0;
-    size_t groups = 0;
-    while (pattern[i] && j + 1 < patcap - 1) {
-        char c = pattern[i];
-        switch (c) {
-        case '^': alt->pat[j].type = BEGIN; break;
-        case '$': alt->pat[j].type = END;   break;
-        case '.': alt->pat[j].type = DOT;   break;
-        case '*': alt->pat[j].type = STAR;  break;
-        case '+': alt->pat[j].type = PLUS;  break;
-        case '?': alt->pat[j].type = QUESTION; break;
-        case '\\':
-            if (pattern[i+1]) {
-                i++;
-                if (pattern[i] >= '1' && pattern[i] <= '9') {
-                    alt->pat[j].type = BACKREF;
-                    alt->pat[j].u.group = pattern[i] - '0';
-                } else switch (pattern[i]) {
-                case 'd': alt->pat[j].type = DIGIT; break;
-                case 'D': alt->pat[j].type = NOT_DIGIT; break;
-                case 'w': alt->pat[j].type = ALPHA; break;
-                case 'W': alt->pat[j].type = NOT_ALPHA; break;
-                case 's': alt->pat[j].type = SPACE; break;
-                case 'S': alt->pat[j].type = NOT_SPACE; break;
-                default:  alt->pat[j].type = CHAR; alt->pat[j].u.ch = pattern[i]; break;
-                }
-            }
-            break;
-        case '(': {
-            if (groups < 9) {
-                groups++; depth++; stack[depth-1] = groups;
-                alt->pat[j].type = CAP_OPEN;
-                alt->pat[j].u.group = groups;
-            } else {
-                alt->pat[j].type = CHAR; alt->pat[j].u.ch = c;
-            }
-            break; }
-        case ')': {
-            if (depth > 0) {
-                int id = stack[--depth];
-                alt->pat[j].type = CAP_CLOSE;
-                alt->pat[j].u.group = id;
-            } else {
-                alt->pat[j].type = CHAR; alt->pat[j].u.ch = c;
-            }
-            break; }
-        case '[': {
-            size_t start = ccl_idx;
-            if (pattern[i+1] == '^') { alt->pat[j].type = INV_CHAR_CLASS; i++; }
-            else alt->pat[j].type = CHAR_CLASS;
-            while (pattern[++i]) {
-                if (pattern[i] == '\\' && pattern[i+1]) {
-                    alt->ccl[ccl_idx++] = pattern[i++];
-                    alt->ccl[ccl_idx++] = pattern[i];
-                    continue;
-                }
-                if (pattern[i] == '[' && pattern[i+1] == ':') {
-                    alt->ccl[ccl_idx++] = pattern[i++];
-                    while (pattern[i] && !(pattern[i] == ':' && pattern[i+1] == ']'))
-                        alt->ccl[ccl_idx++] = pattern[i++];
-                    if (pattern[i]) {
-                        alt->ccl[ccl_idx++] = pattern[i++];
-                        alt->ccl[ccl_idx++] = pattern[i];
-                    }
-                    continue;
-                }
-                if (pattern[i] == ']')
-                    break;
-                alt->ccl[ccl_idx++] = pattern[i];
-            }
-            alt->ccl[ccl_idx++] = 0;
-            alt->pat[j].u.ccl = &alt->ccl[start];
-            break; }
-        default:
-            alt->pat[j].type = CHAR; alt->pat[j].u.ch = c; break;
+    if (ps->nn == ps->ncap) {
+        int nc = ps->ncap ? ps->ncap * 2 : 32;
+        struct rnode *n = realloc(ps->nodes, (size_t)nc * sizeof(*n));
+        if (!n) {
+            ps->err = REG_ESPACE;
+            return -1;
         }
-        i++; j++; if (ccl_idx + 1 >= len * 2) break;
+        ps->nodes = n;
+        ps->ncap = nc;
     }
-    alt->pat[j].type = UNUSED;
-    if (groups_out) *groups_out = groups;
-    return 0;
+    struct rnode *n = &ps->nodes[ps->nn];
+    n->type = (unsigned char)type;
+    n->a = a;
+    n->b = b;
+    n->min = n->max = 0;
+    n->next = -1;
+    return ps->nn++;
 }
 
-/* pattern expansion helpers */
-struct strlist {
-    char **items;
-    size_t count;
-    size_t cap;
-};
-
-/* Append a string to the growing list.
- * Returns 0 on success, -1 on allocation failure. */
-static int list_add(struct strlist *l, char *s)
+/* Append a class bitmap and return its index. */
+static int new_class(struct rparse *ps, const struct rclass *c)
 {
-    if (l->count >= l->cap) {
-        size_t nc = l->cap ? l->cap * 2 : 4;
-        char **n = realloc(l->items, nc * sizeof(char *));
-        if (!n)
+    if (ps->ncls == ps->clscap) {
+        int nc = ps->clscap ? ps->clscap * 2 : 8;
+        struct rclass *n = realloc(ps->cls, (size_t)nc * sizeof(*n));
+        if (!n) {
+            ps->err = REG_ESPACE;
             return -1;
-        l->items = n;
-        l->cap = nc;
+        }
+        ps->cls = n;
+        ps->clscap = nc;
     }
-    l->items[l->count++] = s;
-    return 0;
+    ps->cls[ps->ncls] = *c;
+    return ps->ncls++;
 }
 
-/* Free all strings in the list and reset it. */
-static void list_free(struct strlist *l)
+static void cls_set(struct rclass *c, unsigned char ch)
 {
-    for (size_t i = 0; i < l->count; i++)
-        free(l->items[i]);
-    free(l->items);
-    l->items = NULL;
-    l->count = l->cap = 0;
+    c->bits[ch >> 3] |= (uint8_t)(1u << (ch & 7));
+}
+
+static int cls_has(const struct rclass *c, unsigned char ch)
+{
+    return (c->bits[ch >> 3] >> (ch & 7)) & 1;
 }
 
 /* Test if character C belongs to the named POSIX class. */
-static int match_posix_class(char c, const char *name, size_t len)
-{
-    if (len == 5 && strncmp(name, "alnum", 5) == 0) return isalnum((unsigned char)c);
-    if (len == 5 && strncmp(name, "alpha", 5) == 0) return isalpha((unsigned char)c);
-    if (len == 5 && strncmp(name, "digit", 5) == 0) return isdigit((unsigned char)c);
-    if (len == 5 && strncmp(name, "lower", 5) == 0) return islower((unsigned char)c);
-    if (len == 5 && strncmp(name, "upper", 5) == 0) return isupper((unsigned char)c);
-    if (len == 5 && strncmp(name, "space", 5) == 0) return isspace((unsigned char)c);
-    if (len == 6 && strncmp(name, "xdigit", 6) == 0) return isxdigit((unsigned char)c);
-    if (len == 5 && strncmp(name, "print", 5) == 0) return isprint((unsigned char)c);
-    if (len == 5 && strncmp(name, "graph", 5) == 0) return isgraph((unsigned char)c);
-    if (len == 5 && strncmp(name, "cntrl", 5) == 0) return iscntrl((unsigned char)c);
-    if (len == 5 && strncmp(name, "punct", 5) == 0) return ispunct((unsigned char)c);
+static int match_posix_class(int c, const char *name, size_t len, int *ok)
+{
+    *ok = 1;
+    if (len == 5 && strncmp(name, "alnum", 5) == 0) return isalnum(c);
+    if (len == 5 && strncmp(name, "alpha", 5) == 0) return isalpha(c);
+    if (len == 5 && strncmp(name, "digit", 5) == 0) return isdigit(c);
+    if (len == 5 && strncmp(name, "lower", 5) == 0) return islower(c);
+    if (len == 5 && strncmp(name, "upper", 5) == 0) return isupper(c);
+    if (len == 5 && strncmp(name, "space", 5) == 0) return isspace(c);
+    if (len == 6 && strncmp(name, "xdigit", 6) == 0) return isxdigit(c);
+    if (len == 5 && strncmp(name, "print", 5) == 0) return isprint(c);
+    if (len == 5 && strncmp(name, "graph", 5) == 0) return isgraph(c);
+    if (len == 5 && strncmp(name, "cntrl", 5) == 0) return iscntrl(c);
+    if (len == 5 && strncmp(name, "punct", 5) == 0) return ispunct(c);
     if (len == 5 && strncmp(name, "blank", 5) == 0) return c == ' ' || c == '\t';
+    *ok = 0;
     return 0;
 }
 
-/* Expand repetition ranges like {m,n}, {m} and {m,} in PAT. Only
- * non-negative values are handled and m <= n when n is given.  The
- * returned string must be freed by the caller. */
-static char *expand_ranges(const char *pat)
-{
-    size_t len = strlen(pat);
-    size_t cap = len * 4 + 1; /* grow heuristic */
-    char *out = malloc(cap);
-    if (!out)
-        return NULL;
-    size_t o = 0;
-    for (size_t i = 0; i < len; ) {
-        size_t item_start = i;
-        size_t item_end = i;
-        if (pat[i] == '\\' && i + 1 < len) {
-            item_end = i + 2;
-        } else if (pat[i] == '[') {
-            item_end = i + 1;
-            while (item_end < len && pat[item_end] != ']') {
-                if (pat[item_end] == '\\' && item_end + 1 < len)
-                    item_end += 2;
-                else
-                    item_end++;
-            }
-            if (item_end < len)
-                item_end++;
-        } else if (pat[i] == '(') {
-            int depth = 1;
-            item_end = i + 1;
-            while (item_end < len && depth > 0) {
-                if (pat[item_end] == '\\' && item_end + 1 < len)
-                    item_end += 2;
-                else if (pat[item_end] == '(')
-                    depth++, item_end++;
-                else if (pat[item_end] == ')')
-                    depth--, item_end++;
-                else
-                    item_end++;
-            }
-        } else {
-            item_end = i + 1;
-        }
-        size_t item_len = item_end - item_start;
-        i = item_end;
-        int m = -1, n = -1;
-        int open = 0;
-        if (i < len && pat[i] == '{' && isdigit((unsigned char)pat[i+1])) {
-            size_t p = i + 1;
-            m = 0;
-            while (p < len && isdigit((unsigned char)pat[p])) {
-                m = m * 10 + (pat[p] - '0');
-                p++;
-            }
-            if (p < len && pat[p] == ',') {
-                p++;
-                if (p < len && pat[p] == '}') {
-                    open = 1;
-                    i = p + 1;
-                } else {
-                    n = 0;
-                    while (p < len && isdigit((unsigned char)pat[p])) {
-                        n = n * 10 + (pat[p] - '0');
-                        p++;
-                    }
-                    if (p < len && pat[p] == '}') {
-                        i = p + 1;
-                    } else {
-                        m = -1; /* treat as literal */
-                    }
-                }
-            } else if (p < len && pat[p] == '}') {
-                n = m;
-                i = p + 1;
-            } else {
-                m = -1;
-            }
+/* Add the set for a \d \w \s style escape. Returns 0 if E is not one. */
+static int add_shorthand(struct rclass *c, char e)
+{
+    int neg = isupper((unsigned char)e);
+    int kind = tolower((unsigned char)e);
+    if (kind != 'd' && kind != 'w' && kind != 's')
+        return 0;
+    for (int ch = 1; ch < 256; ch++) {
+        int in;
+        if (kind == 'd')
+            in = isdigit(ch);
+        else if (kind == 'w')
+            in = isalnum(ch) || ch == '_';
+        else
+            in = isspace(ch);
+        if (!in != !neg)
+            cls_set(c, (unsigned char)ch);
+    }
+    return 1;
+}
+
+/* Add the other case of every letter already in C. */
+static void cls_fold(struct rclass *c)
+{
+    for (int ch = 'A'; ch <= 'Z'; ch++) {
+        if (cls_has(c, (unsigned char)ch) || cls_has(c, (unsigned char)(ch + 32))) {
+            cls_set(c, (unsigned char)ch);
+            cls_set(c, (unsigned char)(ch + 32));
         }
+    }
+}
+
+/* Parse a literal character, folding case when requested. */
+static int literal(struct rparse *ps, unsigned char ch)
+{
+    if ((ps->cflags & REG_ICASE) && isalpha(ch)) {
+        struct rclass c;
+        memset(&c, 0, sizeof(c));
+        cls_set(&c, (unsigned char)tolower(ch));
+        cls_set(&c, (unsigned char)toupper(ch));
+        int idx = new_class(ps, &c);
+        return idx < 0 ? -1 : new_node(ps, N_CLASS, idx, 0);
+    }
+    return new_node(ps, N_CHAR, ch, 0);
+}
+
+/* Read one bracket element that may start a range. */
+static int bracket_char(struct rparse *ps, unsigned char *out)
+{
+    const char *p = ps->p;
+    if (p[0] == '[' && (p[1] == '.' || p[1] == '=') && p[2] &&
+        p[3] == p[1] && p[4] == ']') {
+        *out = (unsigned char)p[2];
+        ps->p += 5;
+        return 1;
+    }
+    if (p[0] == '\\' && p[1]) {
+        *out = (unsigned char)p[1];
+        ps->p += 2;
+        return 1;
+    }
+    *out = (unsigned char)p[0];
+    ps->p++;
+    return 1;
+}
 
-        /* ensure capacity */
-        size_t need = item_len;
-        if (m >= 0 && open) {
-            need = item_len * (size_t)(m + 1) + 1; /* trailing '*' */
-        } else if (m >= 0 && n >= m) {
-            need = item_len * (size_t)n + (n - m); /* for '?' */
+/* Parse a bracket expression; ps->p points just past '['. */
+static int parse_bracket(struct rparse *ps)
+{
+    struct rclass c;
+    memset(&c, 0, sizeof(c));
+    int neg = 0;
+    if (*ps->p == '^') {
+        neg = 1;
+        ps->p++;
+    }
+    int first = 1;
+    for (;;) {
+        const char *p = ps->p;
+        if (*p == '\0') {
+            ps->err = REG_EBRACK;
+            return -1;
         }
-        if (o + need + 1 >= cap) {
-            if (cap > SIZE_MAX / 2 || need > SIZE_MAX - cap - 1) {
-                free(out);
-                errno = ENAMETOOLONG;
-                return NULL;
-            }
-            size_t req = cap + need + 1;
-            if (req > SIZE_MAX / 2) {
-                free(out);
-                errno = ENAMETOOLONG;
-                return NULL;
-            }
-            cap = req * 2;
-            char *tmp = realloc(out, cap);
-            if (!tmp) {
-                free(out);
-                return NULL;
-            }
-            out = tmp;
+        if (*p == ']' && !first) {
+            ps->p++;
+            break;
         }
-
-        if (m >= 0 && open) {
-            for (int k = 0; k < m; k++) {
-                memcpy(out + o, pat + item_start, item_len);
-                o += item_len;
-            }
-            memcpy(out + o, pat + item_start, item_len);
-            o += item_len;
-            out[o++] = '*';
-        } else if (m >= 0 && n >= m) {
-            for (int k = 0; k < m; k++) {
-                memcpy(out + o, pat + item_start, item_len);
-                o += item_len;
+        first = 0;
+        if (p[0] == '[' && p[1] == ':') {
+            const char *end = strstr(p + 2, ":]");
+            if (!end) {
+                ps->err = REG_EBRACK;
+                return -1;
             }
-            for (int k = 0; k < n - m; k++) {
-                memcpy(out + o, pat + item_start, item_len);
-                o += item_len;
-                out[o++] = '?';
+            int ok = 1;
+            for (int ch = 1; ch < 256 && ok; ch++)
+                if (match_posix_class(ch, p + 2, (size_t)(end - (p + 2)), &ok))
+                    cls_set(&c, (unsigned char)ch);
+            if (!ok) {
+                ps->err = REG_ECTYPE;
+                return -1;
             }
-        } else {
-            memcpy(out + o, pat + item_start, item_len);
-            o += item_len;
-        }
-    }
-    out[o] = '\0';
-    return out;
-}
-
-/* Recursively expand alternation operators. The resulting list must be
- * freed with list_free(). */
-/* Recursively expand alternation operators. The resulting list must be
- * freed with list_free(). Returns 0 on success, -1 on allocation failure. */
-static int expand_alts(const char *pat, struct strlist *out)
-{
-    int level = 0, cls = 0;
-    size_t start = 0, len = strlen(pat);
-    struct strlist seg = {0};
-    for (size_t i = 0; i < len; i++) {
-        char c = pat[i];
-        if (c == '\\' && i + 1 < len) { i++; continue; }
-        if (cls) { if (c == ']') cls = 0; continue; }
-        if (c == '[') { cls = 1; continue; }
-        if (c == '(') { level++; continue; }
-        if (c == ')' && level > 0) { level--; continue; }
-        if (c == '|' && level == 0) {
-            char *s = strndup(pat + start, i - start);
-            if (!s || list_add(&seg, s) != 0) {
-                free(s);
-                list_free(&seg);
+            ps->p = end + 2;
+            continue;
+        }
+        if (p[0] == '\\' && p[1] && add_shorthand(&c, p[1])) {
+            ps->p += 2;
+            continue;
+        }
+        unsigned char lo, hi;
+        bracket_char(ps, &lo);
+        hi = lo;
+        if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+            ps->p++;
+            bracket_char(ps, &hi);
+            if (hi < lo) {
+                ps->err = REG_ERANGE;
                 return -1;
             }
-            start = i + 1;
         }
+        for (int ch = lo; ch <= hi; ch++)
+            cls_set(&c, (unsigned char)ch);
     }
-    char *s = strndup(pat + start, len - start);
-    if (!s || list_add(&seg, s) != 0) {
-        free(s);
-        list_free(&seg);
-        return -1;
+    if (ps->cflags & REG_ICASE)
+        cls_fold(&c);
+    if (neg) {
+        for (int i = 0; i < 32; i++)
+            c.bits[i] = (uint8_t)~c.bits[i];
+        if (ps->cflags & REG_NEWLINE)
+            c.bits['\n' >> 3] &= (uint8_t)~(1u << ('\n' & 7));
     }
+    c.bits[0] &= (uint8_t)~1u;   /* NUL terminates the subject */
+    int idx = new_class(ps, &c);
+    return idx < 0 ? -1 : new_node(ps, N_CLASS, idx, 0);
+}
+
+static int parse_alt(struct rparse *ps);
 
-    if (seg.count > 1) {
-        for (size_t i = 0; i < seg.count; i++) {
-            if (expand_alts(seg.items[i], out) != 0) {
-                list_free(&seg);
+static int parse_atom(struct rparse *ps)
+{
+    unsigned char ch = (unsigned char)*ps->p++;
+    switch (ch) {
+    case '(': {
+        if (++ps->depth > REGEX_MAX_DEPTH) {
+            ps->err = REG_ESPACE;
+            return -1;
+        }
+        int idx = ++ps->ngroups;
+        int child = parse_alt(ps);
+        if (child < 0)
+            return -1;
+        if (*ps->p != ')') {
+            ps->err = REG_EPAREN;
+            return -1;
+        }
+        ps->p++;
+        ps->depth--;
+        return new_node(ps, N_GROUP, child, idx);
+    }
+    case '[':
+        return parse_bracket(ps);
+    case '.': {
+        struct rclass c;
+        memset(&c, 0xff, sizeof(c));
+        c.bits[0] &= (uint8_t)~1u;
+        if (ps->cflags & REG_NEWLINE)
+            c.bits['\n' >> 3] &= (uint8_t)~(1u << ('\n' & 7));
+        int idx = new_class(ps, &c);
+        return idx < 0 ? -1 : new_node(ps, N_CLASS, idx, 0);
+    }
+    case '^':
+        return new_node(ps, N_BOL, 0, 0);
+    case '$':
+        return new_node(ps, N_EOL, 0, 0);
+    case '\\': {
+        unsigned char e = (unsigned char)*ps->p;
+        if (e == '\0') {
+            ps->err = REG_EESCAPE;
+            return -1;
+        }
+        ps->p++;
+        if (e >= '1' && e <= '9') {
+            if (e - '0' > ps->ngroups) {
+                ps->err = REG_ESUBREG;
                 return -1;
             }
+            ps->has_backref = 1;
+            return new_node(ps, N_BACKREF, e - '0', 0);
         }
-        list_free(&seg);
-        return 0;
+        struct rclass c;
+        memset(&c, 0, sizeof(c));
+        if (add_shorthand(&c, (char)e)) {
+            int idx = new_class(ps, &c);
+            return idx < 0 ? -1 : new_node(ps, N_CLASS, idx, 0);
+        }
+        return literal(ps, e);
     }
+    default:
+        return literal(ps, ch);
+    }
+}
 
-    /* no top-level alternation: process groups */
-    struct strlist cur = {0};
-    if (list_add(&cur, strdup("")) != 0)
+/* Parse "{m}", "{m,}" or "{m,n}". Returns 0 when P is not a bound. */
+static int parse_bound(struct rparse *ps, int *min, int *max)
+{
+    const char *p = ps->p + 1;
+    if (!isdigit((unsigned char)*p))
+        return 0;
+    long m = 0, n;
+    while (isdigit((unsigned char)*p) && m <= REGEX_DUP_MAX)
+        m = m * 10 + (*p++ - '0');
+    if (*p == '}') {
+        n = m;
+    } else if (*p == ',') {
+        p++;
+        if (*p == '}') {
+            n = -1;
+        } else {
+            if (!isdigit((unsigned char)*p))
+                return 0;
+            n = 0;
+            while (isdigit((unsigned char)*p) && n <= REGEX_DUP_MAX)
+                n = n * 10 + (*p++ - '0');
+            if (*p != '}')
+                return 0;
+        }
+    } else {
+        return 0;
+    }
+    if (m > REGEX_DUP_MAX || n > REGEX_DUP_MAX || (n >= 0 && n < m)) {
+        ps->err = REG_BADBR;
         return -1;
-    for (size_t i = 0; i < len; ) {
-        if (pat[i] == '\\' && i + 1 < len) {
-            for (size_t j = 0; j < cur.count; j++) {
-                size_t l = strlen(cur.items[j]);
-                cur.items[j] = realloc(cur.items[j], l + 3);
-                cur.items[j][l] = pat[i];
-                cur.items[j][l+1] = pat[i+1];
-                cur.items[j][l+2] = '\0';
-            }
-            i += 2;
-        } else if (pat[i] == '[') {
-            size_t j = i + 1;
-            int cls2 = 1;
-            while (j < len && cls2) {
-                if (pat[j] == '\\' && j + 1 < len) j += 2;
-                else if (pat[j] == ']') cls2 = 0, j++;
-                else j++;
-            }
-            size_t ilen = j - i;
-            for (size_t k = 0; k < cur.count; k++) {
-                size_t l = strlen(cur.items[k]);
-                cur.items[k] = realloc(cur.items[k], l + ilen + 1);
-                memcpy(cur.items[k] + l, pat + i, ilen);
-                cur.items[k][l+ilen] = '\0';
-            }
-            i = j;
-        } else if (pat[i] == '(') {
-            size_t j = i + 1; int depth = 1;
-            while (j < len && depth) {
-                if (pat[j] == '\\' && j + 1 < len) j += 2;
-                else if (pat[j] == '(') { depth++; j++; }
-                else if (pat[j] == ')') { depth--; j++; }
-                else j++;
-            }
-            char *inside = strndup(pat + i + 1, j - i - 2);
-            if (!inside) { list_free(&cur); list_free(&seg); return -1; }
-            struct strlist sub = {0};
-            if (expand_alts(inside, &sub) != 0) {
-                free(inside);
-                list_free(&cur);
-                list_free(&seg);
+    }
+    ps->p = p + 1;
+    *min = (int)m;
+    *max = (int)n;
+    return 1;
+}
+
+static int parse_rep(struct rparse *ps)
+{
+    int atom = parse_atom(ps);
+    while (atom >= 0) {
+        int min, max;
+        char c = *ps->p;
+        if (c == '*') {
+            min = 0; max = -1; ps->p++;
+        } else if (c == '+') {
+            min = 1; max = -1; ps->p++;
+        } else if (c == '?') {
+            min = 0; max = 1; ps->p++;
+        } else if (c == '{') {
+            int r = parse_bound(ps, &min, &max);
+            if (r < 0)
                 return -1;
-            }
-            free(inside);
-            struct strlist newl = {0};
-            for (size_t k = 0; k < cur.count; k++) {
-                for (size_t m = 0; m < sub.count; m++) {
-                    size_t l = strlen(cur.items[k]);
-                    size_t ilen = strlen(sub.items[m]);
-                    char *ns = malloc(l + ilen + 3);
-                    memcpy(ns, cur.items[k], l);
-                    ns[l] = '(';
-                    memcpy(ns + l + 1, sub.items[m], ilen);
-                    ns[l + ilen + 1] = ')';
-                    ns[l + ilen + 2] = '\0';
-                    if (list_add(&newl, ns) != 0) {
-                        free(ns);
-                        list_free(&newl);
-                        list_free(&sub);
-                        list_free(&cur);
-                        list_free(&seg);
-                        return -1;
-                    }
-                }
-                free(cur.items[k]);
-            }
-            free(cur.items);
-            cur = newl;
-            list_free(&sub);
-            i = j;
+            if (r == 0)
+                break;  /* literal '{' */
         } else {
-            for (size_t k = 0; k < cur.count; k++) {
-                size_t l = strlen(cur.items[k]);
-                cur.items[k] = realloc(cur.items[k], l + 2);
-                cur.items[k][l] = pat[i];
-                cur.items[k][l+1] = '\0';
-            }
-            i++;
+            break;
         }
-    }
-    for (size_t i = 0; i < cur.count; i++)
-        if (list_add(out, cur.items[i]) != 0) {
-            free(cur.items[i]);
-            list_free(&cur);
-            list_free(&seg);
+        int rep = new_node(ps, N_REP, atom, 0);
+        if (rep < 0)
             return -1;
-        }
-    free(cur.items);
-    list_free(&seg);
-    return 0;
+        ps->nodes[rep].min = min;
+        ps->nodes[rep].max = max;
+        atom = rep;
+    }
+    return atom;
 }
 
-/* Basic character category checks used by the matcher. */
-static int matchdigit(char c) { return isdigit((unsigned char)c); }
-static int matchalpha(char c) { return isalnum((unsigned char)c) || c == '_'; }
-static int matchspace(char c) { return isspace((unsigned char)c); }
-
-/* Test if C falls within the range described by STR. */
-static int matchrange(char c, const char *str)
+static int parse_cat(struct rparse *ps)
 {
-    return (c != '-') && str[0] && str[1] == '-' && str[2] &&
-           c >= str[0] && c <= str[2];
+    int head = -1, tail = -1;
+    while (*ps->p && *ps->p != '|' && !(*ps->p == ')' && ps->depth > 0)) {
+        int n = parse_rep(ps);
+        if (n < 0)
+            return -1;
+        if (tail < 0)
+            head = n;
+        else
+            ps->nodes[tail].next = n;
+        tail = n;
+    }
+    if (head < 0)
+        return new_node(ps, N_EMPTY, 0, 0);
+    if (ps->nodes[head].next < 0)
+        return head;
+    return new_node(ps, N_CAT, head, 0);
 }
 
-/* Match any character except newline unless configured otherwise. */
-static int matchdot(char c)
+static int parse_alt(struct rparse *ps)
 {
-#ifdef RE_DOT_MATCHES_NEWLINE
-    (void)c; return 1;
-#else
-    return c != '\n' && c != '\r';
-#endif
+    int head = parse_cat(ps);
+    if (head < 0 || *ps->p != '|')
+        return head;
+    int tail = head;
+    while (*ps->p == '|') {
+        ps->p++;
+        int n = parse_cat(ps);
+        if (n < 0)
+            return -1;
+        ps->nodes[tail].next = n;
+        tail = n;
+    }
+    return new_node(ps, N_ALT, head, 0);
 }
 
-/* Return non-zero if C denotes a shorthand meta escape. */
-static int ismeta(char c)
+/* ---------------------------------------------------------------- */
+/* compilation                                                      */
+
+struct rcomp {
+    struct rparse *ps;
+    struct rinst *ins;
+    int n, cap;
+    int nmarks;
+    int err;
+};
+
+static int emit(struct rcomp *rc, int op, int x, int y)
 {
-    return c=='s' || c=='S' || c=='w' || c=='W' || c=='d' || c=='D';
+    if (rc->n >= REGEX_MAX_PROG) {
+        rc->err = REG_ESPACE;
+        return -1;
+    }
+    if (rc->n == rc->cap) {
+        int nc = rc->cap ? rc->cap * 2 : 64;
+        struct rinst *n = realloc(rc->ins, (size_t)nc * sizeof(*n));
+        if (!n) {
+            rc->err = REG_ESPACE;
+            return -1;
+        }
+        rc->ins = n;
+        rc->cap = nc;
+    }
+    rc->ins[rc->n].op = (unsigned char)op;
+    rc->ins[rc->n].x = x;
+    rc->ins[rc->n].y = y;
+    return rc->n++;
 }
 
-/* Match character classes like \d or \w. */
-static int matchmeta(char c, const char *str)
+/* Return non-zero if node I can match the empty string. */
+static int nullable(const struct rparse *ps, int i)
 {
-    switch (str[0]) {
-    case 'd': return  matchdigit(c);
-    case 'D': return !matchdigit(c);
-    case 'w': return  matchalpha(c);
-    case 'W': return !matchalpha(c);
-    case 's': return  matchspace(c);
-    case 'S': return !matchspace(c);
-    default:  return c == str[0];
+    const struct rnode *n = &ps->nodes[i];
+    switch (n->type) {
+    case N_CHAR:
+    case N_CLASS:
+        return 0;
+    case N_CAT:
+        for (int c = n->a; c >= 0; c = ps->nodes[c].next)
+            if (!nullable(ps, c))
+                return 0;
+        return 1;
+    case N_ALT:
+        for (int c = n->a; c >= 0; c = ps->nodes[c].next)
+            if (nullable(ps, c))
+                return 1;
+        return 0;
+    case N_REP:
+        return n->min == 0 || nullable(ps, n->a);
+    case N_GROUP:
+        return nullable(ps, n->a);
+    default:
+        return 1;
     }
 }
 
-/* Evaluate character classes, including POSIX names. */
-static int matchclass(char c, const char *str)
+static int compile_node(struct rcomp *rc, int i);
+
+/*
+ * Emit an unbounded loop over CHILD. When the body can match the empty
+ * string MARK/CHECK stop the backtracking matcher from looping without
+ * consuming input; the automaton executors treat them as no-ops.
+ */
+static int compile_loop(struct rcomp *rc, int child, int at_least_once)
+{
+    int nul = nullable(rc->ps, child);
+    int mark = nul ? rc->nmarks++ : -1;
+    int split = -1;
+    int top = rc->n;
+    if (!at_least_once && (split = emit(rc, OP_SPLIT, rc->n + 1, 0)) < 0)
+        return -1;
+    if (nul && emit(rc, OP_MARK, mark, 0) < 0)
+        return -1;
+    if (compile_node(rc, child) < 0)
+        return -1;
+    if (at_least_once && (split = emit(rc, OP_SPLIT, rc->n + 1, 0)) < 0)
+        return -1;
+    if (nul && emit(rc, OP_CHECK, mark, 0) < 0)
+        return -1;
+    if (emit(rc, OP_JMP, top, 0) < 0)
+        return -1;
+    rc->ins[split].y = rc->n;
+    return 0;
+}
+
+static int compile_node(struct rcomp *rc, int i)
 {
-    do {
-        if (str[0] == '[' && str[1] == ':') {
-            const char *end = strstr(str + 2, ":]");
-            if (end) {
-                if (match_posix_class(c, str + 2, (size_t)(end - (str + 2))))
-                    return 1;
-                str = end + 2;
-                continue;
+    const struct rnode *n = &rc->ps->nodes[i];
+    switch (n->type) {
+    case N_EMPTY:
+        return 0;
+    case N_CHAR:
+        return emit(rc, OP_CHAR, n->a, 0) < 0 ? -1 : 0;
+    case N_CLASS:
+        return emit(rc, OP_CLASS, n->a, 0) < 0 ? -1 : 0;
+    case N_BOL:
+        return emit(rc, OP_BOL, 0, 0) < 0 ? -1 : 0;
+    case N_EOL:
+        return emit(rc, OP_EOL, 0, 0) < 0 ? -1 : 0;
+    case N_BACKREF:
+        return emit(rc, OP_BACKREF, n->a, 0) < 0 ? -1 : 0;
+    case N_GROUP:
+        if (emit(rc, OP_SAVE, 2 * n->b, 0) < 0 ||
+            compile_node(rc, n->a) < 0 ||
+            emit(rc, OP_SAVE, 2 * n->b + 1, 0) < 0)
+            return -1;
+        return 0;
+    case N_CAT:
+        for (int c = n->a; c >= 0; c = rc->ps->nodes[c].next)
+            if (compile_node(rc, c) < 0)
+                return -1;
+        return 0;
+    case N_ALT: {
+        /* jumps to the end are chained through their x field */
+        int jumps = -1;
+        for (int c = n->a; c >= 0; c = rc->ps->nodes[c].next) {
+            int last = rc->ps->nodes[c].next < 0;
+            int split = -1;
+            if (!last && (split = emit(rc, OP_SPLIT, rc->n + 1, 0)) < 0)
+                return -1;
+            if (compile_node(rc, c) < 0)
+                return -1;
+            if (!last) {
+                int j = emit(rc, OP_JMP, jumps, 0);
+                if (j < 0)
+                    return -1;
+                jumps = j;
+                rc->ins[split].y = rc->n;
             }
         }
-        if (matchrange(c, str))
-            return 1;
-        else if (str[0] == '\\') {
-            str++;
-            if (matchmeta(c, str))
-                return 1;
-            else if (c == str[0] && !ismeta(c))
-                return 1;
-        } else if (c == str[0]) {
-            if (c == '-')
-                return (str[-1] == '\0' || str[1] == '\0');
-            return 1;
+        while (jumps >= 0) {
+            int prev = rc->ins[jumps].x;
+            rc->ins[jumps].x = rc->n;
+            jumps = prev;
+        }
+        return 0;
+    }
+    case N_REP: {
+        int child = n->a, min = n->min, max = n->max;
+        if (max < 0) {
+            for (int k = 0; k + 1 < min; k++)
+                if (compile_node(rc, child) < 0)
+                    return -1;
+            return compile_loop(rc, child, min > 0);
         }
-    } while (*str++);
+        for (int k = 0; k < min; k++)
+            if (compile_node(rc, child) < 0)
+                return -1;
+        int splits[REGEX_DUP_MAX];
+        int nsplit = 0;
+        for (int k = min; k < max; k++) {
+            int s = emit(rc, OP_SPLIT, rc->n + 1, 0);
+            if (s < 0 || compile_node(rc, child) < 0)
+                return -1;
+            splits[nsplit++] = s;
+        }
+        for (int k = 0; k < nsplit; k++)
+            rc->ins[splits[k]].y = rc->n;
+        return 0;
+    }
+    }
     return 0;
 }
 
-/* Match a single token against one character. */
-static int matchone(struct token t, char c)
+/*
+ * Append the literal text matched by node I to BUF. Returns 1 if the
+ * node is entirely literal, 0 if only a leading part (maybe none) was.
+ */
+static int literal_run(const struct rparse *ps, int i, char *buf, size_t *len)
 {
-    switch (t.type) {
-    case DOT:            return matchdot(c);
-    case CHAR_CLASS:     return  matchclass(c, (const char*)t.u.ccl);
-    case INV_CHAR_CLASS: return !matchclass(c, (const char*)t.u.ccl);
-    case DIGIT:          return  matchdigit(c);
-    case NOT_DIGIT:      return !matchdigit(c);
-    case ALPHA:          return  matchalpha(c);
-    case NOT_ALPHA:      return !matchalpha(c);
-    case SPACE:          return  matchspace(c);
-    case NOT_SPACE:      return !matchspace(c);
-    default:             return t.u.ch == (unsigned char)c;
+    const struct rnode *n = &ps->nodes[i];
+    switch (n->type) {
+    case N_CHAR:
+        buf[(*len)++] = (char)n->a;
+        return 1;
+    case N_GROUP:
+        return literal_run(ps, n->a, buf, len);
+    case N_CAT:
+        for (int c = n->a; c >= 0; c = ps->nodes[c].next)
+            if (!literal_run(ps, c, buf, len))
+                return 0;
+        return 1;
+    default:
+        return 0;
     }
 }
 
-/* Greedy Kleene star matcher. */
-static int matchstar(struct token p, struct token *pat, const char *text, int *ml,
-                     const char *string, regmatch_t *caps)
+/* Add the bytes a match of node I can start with; returns nullability. */
+static int first_set(const struct rparse *ps, int i, struct rclass *set)
 {
-    int pre = *ml;
-    const char *save = text;
-    while (*text && matchone(p, *text)) {
-        text++; (*ml)++; }
-    while (text >= save) {
-        if (matchpattern(pat, text, ml, string, caps))
-            return 1;
-        text--; (*ml)--;
+    const struct rnode *n = &ps->nodes[i];
+    switch (n->type) {
+    case N_CHAR:
+        cls_set(set, (unsigned char)n->a);
+        return 0;
+    case N_CLASS:
+        for (int k = 0; k < 32; k++)
+            set->bits[k] |= ps->cls[n->a].bits[k];
+        return 0;
+    case N_CAT:
+        for (int c = n->a; c >= 0; c = ps->nodes[c].next)
+            if (!first_set(ps, c, set))
+                return 0;
+        return 1;
+    case N_ALT: {
+        int nul = 0;
+        for (int c = n->a; c >= 0; c = ps->nodes[c].next)
+            nul |= first_set(ps, c, set);
+        return nul;
+    }
+    case N_REP:
+        return first_set(ps, n->a, set) || n->min == 0;
+    case N_GROUP:
+        return first_set(ps, n->a, set);
+    default:
+        return 1;
+    }
+}
+
+/*
+ * Extract the literal prefix, the longest run of consecutive literal
+ * terms at the top level and the first-byte set of the pattern.
+ */
+static int analyze(struct regex_impl *ri, const struct rparse *ps, int root,
+                   size_t patlen)
+{
+    char *buf = malloc(patlen + 1);
+    char *best = malloc(patlen + 1);
+    if (!buf || !best) {
+        free(buf);
+        free(best);
+        return -1;
+    }
+
+    const struct rnode *r = &ps->nodes[root];
+    int head = r->type == N_CAT ? r->a : root;
+    int c = head;
+    while (c >= 0 && ps->nodes[c].type == N_BOL)
+        c = r->type == N_CAT ? ps->nodes[c].next : -1;
+    size_t plen = 0;
+    for (; c >= 0; c = r->type == N_CAT ? ps->nodes[c].next : -1)
+        if (!literal_run(ps, c, buf, &plen))
+            break;
+    if (plen) {
+        ri->prefix = malloc(plen);
+        if (!ri->prefix) {
+            free(buf);
+            free(best);
+            return -1;
+        }
+        memcpy(ri->prefix, buf, plen);
+        ri->prefix_len = plen;
+    }
+
+    size_t blen = 0, len = 0;
+    for (c = head; c >= 0; c = r->type == N_CAT ? ps->nodes[c].next : -1) {
+        /* a partial term still extends the run by its literal head */
+        int whole = literal_run(ps, c, buf, &len);
+        if (len > blen) {
+            memcpy(best, buf, len);
+            blen = len;
+        }
+        if (!whole)
+            len = 0;
+    }
+    /* a required literal no longer than the prefix adds nothing */
+    if (blen > plen) {
+        ri->required = best;
+        ri->required_len = blen;
+        best = NULL;
+    }
+    free(best);
+    free(buf);
+
+    memset(&ri->first, 0, sizeof(ri->first));
+    ri->has_first = !first_set(ps, root, &ri->first);
+    ri->first.bits[0] &= (uint8_t)~1u;
+    ri->first_byte = -1;
+    if (ri->has_first) {
+        int count = 0;
+        for (int ch = 1; ch < 256; ch++)
+            if (cls_has(&ri->first, (unsigned char)ch)) {
+                count++;
+                ri->first_byte = ch;
+            }
+        if (count != 1)
+            ri->first_byte = -1;
     }
-    *ml = pre;
     return 0;
 }
 
-/* Greedy "one or more" matcher. */
-static int matchplus(struct token p, struct token *pat, const char *text, int *ml,
-                     const char *string, regmatch_t *caps)
+/* Return non-zero when every match must begin at offset 0. */
+static int starts_anchored(const struct rparse *ps, int root)
 {
-    const char *save = text;
-    while (*text && matchone(p, *text)) { text++; (*ml)++; }
-    while (text > save) {
-        if (matchpattern(pat, text, ml, string, caps))
-            return 1;
-        text--; (*ml)--;
+    const struct rnode *n = &ps->nodes[root];
+    if (n->type == N_CAT)
+        n = &ps->nodes[n->a];
+    return n->type == N_BOL;
+}
+
+/* Compile PATTERN into an NFA program. */
+int regcomp(regex_t *preg, const char *pattern, int cflags)
+{
+    if (!preg || !pattern)
+        return REG_BADPAT;
+
+    struct rparse ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = pattern;
+    ps.cflags = cflags;
+    int root = parse_alt(&ps);
+    if (root < 0 || ps.err) {
+        free(ps.nodes);
+        free(ps.cls);
+        return ps.err ? ps.err : REG_BADPAT;
+    }
+
+    struct rcomp rc;
+    memset(&rc, 0, sizeof(rc));
+    rc.ps = &ps;
+    if (emit(&rc, OP_SAVE, 0, 0) < 0 || compile_node(&rc, root) < 0 ||
+        emit(&rc, OP_SAVE, 1, 0) < 0 || emit(&rc, OP_MATCH, 0, 0) < 0) {
+        free(rc.ins);
+        free(ps.nodes);
+        free(ps.cls);
+        return rc.err ? rc.err : REG_ESPACE;
     }
+
+    struct regex_impl *ri = calloc(1, sizeof(*ri));
+    if (!ri) {
+        free(rc.ins);
+        free(ps.nodes);
+        free(ps.cls);
+        return REG_ESPACE;
+    }
+    ri->prog = rc.ins;
+    ri->nprog = rc.n;
+    ri->cls = ps.cls;
+    ri->ncls = ps.ncls;
+    ri->nmarks = rc.nmarks;
+    ri->cflags = cflags;
+    ri->has_backref = ps.has_backref;
+    ri->anchored = !(cflags & REG_NEWLINE) && starts_anchored(&ps, root);
+    atomic_flag_clear(&ri->busy);
+    int aerr = analyze(ri, &ps, root, strlen(pattern));
+    free(ps.nodes);
+    if (aerr != 0) {
+        preg->impl = ri;
+        regfree(preg);
+        return REG_ESPACE;
+    }
+
+    preg->impl = ri;
+    preg->re_nsub = (size_t)ps.ngroups;
     return 0;
 }
 
-/* Optional match of a single token. */
-static int matchquestion(struct token p, struct token *pat, const char *text, int *ml,
-                         const char *string, regmatch_t *caps)
+/* ---------------------------------------------------------------- */
+/* execution helpers                                                */
+
+static int at_bol(const struct regex_impl *ri, const char *s, size_t sp,
+                  int eflags)
 {
-    if (p.type == UNUSED)
-        return 1;
-    if (matchpattern(pat, text, ml, string, caps))
-        return 1;
-    if (*text && matchone(p, *text++)) {
-        if (matchpattern(pat, text, ml, string, caps)) {
-            (*ml)++; return 1; }
+    if (sp == 0)
+        return !(eflags & REG_NOTBOL);
+    return (ri->cflags & REG_NEWLINE) && s[sp - 1] == '\n';
+}
+
+static int at_eol(const struct regex_impl *ri, const char *s, size_t sp,
+                  int eflags)
+{
+    if (s[sp] == '\0')
+        return !(eflags & REG_NOTEOL);
+    return (ri->cflags & REG_NEWLINE) && s[sp] == '\n';
+}
+
+/* Return non-zero if the consuming instruction I accepts C. */
+static int inst_accepts(const struct regex_impl *ri, const struct rinst *i,
+                        unsigned char c)
+{
+    if (i->op == OP_CHAR)
+        return c != '\0' && i->x == c;
+    return cls_has(&ri->cls[i->x], c);
+}
+
+/* Start a new visit generation, clearing the stamps on wrap-around. */
+static void next_stamp(struct vm_scratch *s, int nprog)
+{
+    if (s->stamp == INT_MAX) {
+        memset(s->gen, 0, (size_t)nprog * sizeof(int));
+        s->stamp = 0;
+    }
+    s->stamp++;
+}
+
+static void free_scratch(struct vm_scratch *s)
+{
+    free(s->gen);
+    free(s->stack);
+    free(s->list_pc[0]);
+    free(s->list_pc[1]);
+    free(s->list_caps[0]);
+    free(s->list_caps[1]);
+    free(s->tmp);
+    free(s->tmp2);
+    memset(s, 0, sizeof(*s));
+}
+
+/* Allocate executor buffers sized for the full capture set. */
+static int alloc_scratch(const struct regex_impl *ri, const regex_t *preg,
+                         struct vm_scratch *s)
+{
+    size_t n = (size_t)ri->nprog;
+    size_t ncap = 2 * (preg->re_nsub + 1);
+    memset(s, 0, sizeof(*s));
+    s->gen = calloc(n, sizeof(int));
+    s->stack = malloc((2 * n + 2) * 3 * sizeof(int));
+    s->list_pc[0] = malloc(n * sizeof(int));
+    s->list_pc[1] = malloc(n * sizeof(int));
+    s->list_caps[0] = malloc(n * ncap * sizeof(int));
+    s->list_caps[1] = malloc(n * ncap * sizeof(int));
+    s->tmp = malloc((n + 1) * sizeof(int));
+    s->tmp2 = malloc((n + 1) * sizeof(int));
+    if (!s->gen || !s->stack || !s->list_pc[0] || !s->list_pc[1] ||
+        !s->list_caps[0] || !s->list_caps[1] || !s->tmp || !s->tmp2) {
+        free_scratch(s);
+        return -1;
     }
     return 0;
 }
 
-/* Core iterative matcher that processes tokens sequentially. */
-static int matchpattern(struct token *pat, const char *text, int *matchlen,
-                        const char *string, regmatch_t *caps)
+/*
+ * Borrow the pattern's cached buffers. Concurrent callers that find them
+ * in use get private ones instead; *shared tells release_scratch which.
+ */
+static struct vm_scratch *get_scratch(const regex_t *preg,
+                                      struct vm_scratch *local, int *shared)
 {
-    int pre = *matchlen;
-    for (;;) {
-        if (pat[0].type == CAP_OPEN) {
-            if (caps)
-                caps[pat[0].u.group].rm_so = text - string;
-            pat++;
+    struct regex_impl *ri = preg->impl;
+    if (!atomic_flag_test_and_set_explicit(&ri->busy, memory_order_acquire)) {
+        if (!ri->scratch_ready) {
+            if (alloc_scratch(ri, preg, &ri->scratch) != 0) {
+                atomic_flag_clear_explicit(&ri->busy, memory_order_release);
+                return NULL;
+            }
+            ri->scratch_ready = 1;
+        }
+        *shared = 1;
+        return &ri->scratch;
+    }
+    *shared = 0;
+    return alloc_scratch(ri, preg, local) == 0 ? local : NULL;
+}
+
+static void release_scratch(const regex_t *preg, struct vm_scratch *s,
+                            int shared)
+{
+    struct regex_impl *ri = preg->impl;
+    if (shared)
+        atomic_flag_clear_explicit(&ri->busy, memory_order_release);
+    else
+        free_scratch(s);
+}
+
+#define NO_CANDIDATE ((size_t)-1)
+
+/*
+ * Return the first offset at or after FROM where a match could start,
+ * or NO_CANDIDATE. Only valid for unanchored patterns with has_first.
+ */
+static size_t next_candidate(const struct regex_impl *ri, const char *str,
+                             size_t len, size_t from)
+{
+    if (from >= len)
+        return NO_CANDIDATE;
+    const char *p;
+    if (ri->prefix_len > 1)
+        p = memmem(str + from, len - from, ri->prefix, ri->prefix_len);
+    else if (ri->first_byte >= 0)
+        p = memchr(str + from, ri->first_byte, len - from);
+    else {
+        const unsigned char *u = (const unsigned char *)str;
+        for (size_t i = from; i < len; i++)
+            if (cls_has(&ri->first, u[i]))
+                return i;
+        return NO_CANDIDATE;
+    }
+    return p ? (size_t)(p - str) : NO_CANDIDATE;
+}
+
+/* ---------------------------------------------------------------- */
+/* Pike VM                                                          */
+
+struct vm_list {
+    int n;
+    int *pc;
+    int *caps;
+};
+
+/*
+ * Add the thread at PC0 and everything reachable from it through
+ * non-consuming instructions to L, in priority order. CUR holds the
+ * thread's capture offsets and is restored before returning.
+ */
+static void add_thread(const struct regex_impl *ri, struct vm_scratch *s,
+                       struct vm_list *l, int pc0, int *cur, int ncap,
+                       const char *str, size_t sp, int eflags)
+{
+    int *stk = s->stack;
+    int top = 0;
+    stk[top++] = pc0; stk[top++] = 0; stk[top++] = 0;
+    while (top > 0) {
+        top -= 3;
+        int pc = stk[top];
+        if (pc < 0) {
+            cur[stk[top + 1]] = stk[top + 2];   /* restore a capture */
             continue;
-        } else if (pat[0].type == CAP_CLOSE) {
-            if (caps)
-                caps[pat[0].u.group].rm_eo = text - string;
-            pat++;
+        }
+        if (s->gen[pc] == s->stamp)
             continue;
-        } else if (pat[0].type == BACKREF) {
-            int id = pat[0].u.group;
-            if (!caps || caps[id].rm_so < 0 || caps[id].rm_eo < 0) {
-                *matchlen = pre;
-                return 0;
+        s->gen[pc] = s->stamp;
+        const struct rinst *in = &ri->prog[pc];
+        switch (in->op) {
+        case OP_JMP:
+            stk[top++] = in->x; stk[top++] = 0; stk[top++] = 0;
+            break;
+        case OP_SPLIT:
+            stk[top++] = in->y; stk[top++] = 0; stk[top++] = 0;
+            stk[top++] = in->x; stk[top++] = 0; stk[top++] = 0;
+            break;
+        case OP_SAVE:
+            if (in->x < ncap) {
+                stk[top++] = -1; stk[top++] = in->x; stk[top++] = cur[in->x];
+                cur[in->x] = (int)sp;
             }
-            int blen = caps[id].rm_eo - caps[id].rm_so;
-            if (strncmp(string + caps[id].rm_so, text, blen) != 0) {
-                *matchlen = pre;
-                return 0;
+            stk[top++] = pc + 1; stk[top++] = 0; stk[top++] = 0;
+            break;
+        case OP_BOL:
+            if (at_bol(ri, str, sp, eflags)) {
+                stk[top++] = pc + 1; stk[top++] = 0; stk[top++] = 0;
             }
-            text += blen;
-            *matchlen += blen;
-            pat++;
-            continue;
+            break;
+        case OP_EOL:
+            if (at_eol(ri, str, sp, eflags)) {
+                stk[top++] = pc + 1; stk[top++] = 0; stk[top++] = 0;
+            }
+            break;
+        case OP_MARK:
+        case OP_CHECK:
+            stk[top++] = pc + 1; stk[top++] = 0; stk[top++] = 0;
+            break;
+        default:
+            l->pc[l->n] = pc;
+            memcpy(l->caps + (size_t)l->n * ncap, cur, (size_t)ncap * sizeof(int));
+            l->n++;
+            break;
         }
+    }
+}
 
-        if (pat[0].type == BEGIN) {
-            if (text != string) {
-                *matchlen = pre;
-                return 0;
+/* Run the Pike VM and report the leftmost longest match in CAPS. */
+static int pike_exec(const regex_t *preg, const char *str, size_t len,
+                     int ncap, int *caps, int eflags)
+{
+    const struct regex_impl *ri = preg->impl;
+    struct vm_scratch local;
+    int shared;
+    struct vm_scratch *s = get_scratch(preg, &local, &shared);
+    if (!s)
+        return -1;
+
+    int curbuf[32];
+    int *cur = ncap <= 32 ? curbuf : malloc((size_t)ncap * sizeof(int));
+    if (!cur) {
+        release_scratch(preg, s, shared);
+        return -1;
+    }
+    struct vm_list lists[2] = {
+        { 0, s->list_pc[0], s->list_caps[0] },
+        { 0, s->list_pc[1], s->list_caps[1] },
+    };
+    struct vm_list *clist = &lists[0], *nlist = &lists[1];
+    int matched = 0;
+    next_stamp(s, ri->nprog);
+    for (size_t sp = 0;; sp++) {
+        if (!matched && (sp == 0 || !ri->anchored)) {
+            if (clist->n == 0 && ri->has_first && !ri->anchored) {
+                sp = next_candidate(ri, str, len, sp);
+                if (sp == NO_CANDIDATE)
+                    break;
             }
-            pat++;
-            continue;
-        } else if (pat[0].type == END) {
-            if (*text != '\0') {
-                *matchlen = pre;
-                return 0;
+            for (int i = 0; i < ncap; i++)
+                cur[i] = -1;
+            add_thread(ri, s, clist, 0, cur, ncap, str, sp, eflags);
+        }
+        if (clist->n == 0 && (matched || ri->anchored))
+            break;
+        unsigned char c = (unsigned char)str[sp];
+        next_stamp(s, ri->nprog);
+        nlist->n = 0;
+        for (int t = 0; t < clist->n; t++) {
+            int *tc = clist->caps + (size_t)t * ncap;
+            if (matched && tc[0] > caps[0])
+                continue;   /* started right of the match found */
+            const struct rinst *in = &ri->prog[clist->pc[t]];
+            if (in->op == OP_MATCH) {
+                if (!matched || tc[0] < caps[0] ||
+                    (tc[0] == caps[0] && tc[1] > caps[1]))
+                    memcpy(caps, tc, (size_t)ncap * sizeof(int));
+                matched = 1;
+            } else if (inst_accepts(ri, in, c)) {
+                memcpy(cur, tc, (size_t)ncap * sizeof(int));
+                add_thread(ri, s, nlist, clist->pc[t] + 1, cur, ncap, str,
+                           sp + 1, eflags);
             }
-            pat++;
-            continue;
         }
+        struct vm_list *tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+        if (c == '\0')
+            break;
+    }
+    if (cur != curbuf)
+        free(cur);
+    release_scratch(preg, s, shared);
+    return matched;
+}
+
+/* ---------------------------------------------------------------- */
+/* lazy DFA                                                         */
+
+static void dfa_flush(struct dfa_cache *d)
+{
+    d->nstates = 0;
+    d->npool = 0;
+    for (int i = 0; i < DFA_HASH_SIZE; i++)
+        d->buckets[i] = -1;
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
 
-        if (pat[0].type == UNUSED)
-            return 1;
-        if (pat[1].type == QUESTION)
-            return matchquestion(pat[0], &pat[2], text, matchlen, string, caps);
-        else if (pat[1].type == STAR)
-            return matchstar(pat[0], &pat[2], text, matchlen, string, caps);
-        else if (pat[1].type == PLUS)
-            return matchplus(pat[0], &pat[2], text, matchlen, string, caps);
+/*
+ * Find or create the state for the sorted set PCS. Returns DFA_FULL when
+ * the cache must be flushed first.
+ */
+static int dfa_intern(struct dfa_cache *d, const int *pcs, int n, int bol)
+{
+    uint32_t h = 2166136261u ^ (uint32_t)bol;
+    for (int i = 0; i < n; i++)
+        h = (h ^ (uint32_t)pcs[i]) * 16777619u;
+    int b = (int)(h & (DFA_HASH_SIZE - 1));
+    for (int i = d->buckets[b]; i >= 0; i = d->states[i].hnext) {
+        struct dstate *st = &d->states[i];
+        if (st->hash == h && st->n == n && st->bol == bol &&
+            memcmp(d->pool + st->off, pcs, (size_t)n * sizeof(int)) == 0)
+            return i;
+    }
+    if (d->nstates == DFA_MAX_STATES || d->npool + n > DFA_MAX_POOL)
+        return DFA_FULL;
+    if (!d->states) {
+        d->states = malloc(DFA_MAX_STATES * sizeof(struct dstate));
+        d->pool = malloc(DFA_MAX_POOL * sizeof(int));
+        if (!d->states || !d->pool) {
+            free(d->states);
+            free(d->pool);
+            d->states = NULL;
+            d->pool = NULL;
+            return DFA_NOMEM;
+        }
+    }
+    struct dstate *st = &d->states[d->nstates];
+    st->hash = h;
+    st->off = d->npool;
+    st->n = n;
+    st->bol = (unsigned char)bol;
+    st->endm[0] = st->endm[1] = -1;
+    st->idle = n == 1 && pcs[0] == 0;
+    for (int i = 0; i < 256; i++)
+        st->next[i] = DFA_UNKNOWN;
+    memcpy(d->pool + d->npool, pcs, (size_t)n * sizeof(int));
+    d->npool += n;
+    st->hnext = d->buckets[b];
+    d->buckets[b] = d->nstates;
+    return d->nstates++;
+}
 
-        if (*text && matchone(*pat, *text)) {
-            (*matchlen)++;
-            pat++; text++;
+/*
+ * Follow non-consuming instructions from the pcs of ST. Consuming pcs
+ * are stored in OUT; returns their count, or -1 if MATCH is reachable.
+ */
+static int dfa_closure(const struct regex_impl *ri, struct vm_scratch *s,
+                       const int *pcs, int n, int bol, int eol, int *out)
+{
+    int *stk = s->stack;
+    int top = 0, nout = 0;
+    next_stamp(s, ri->nprog);
+    for (int i = n - 1; i >= 0; i--)
+        stk[top++] = pcs[i];
+    while (top > 0) {
+        int pc = stk[--top];
+        if (s->gen[pc] == s->stamp)
             continue;
+        s->gen[pc] = s->stamp;
+        const struct rinst *in = &ri->prog[pc];
+        switch (in->op) {
+        case OP_JMP:
+            stk[top++] = in->x;
+            break;
+        case OP_SPLIT:
+            stk[top++] = in->y;
+            stk[top++] = in->x;
+            break;
+        case OP_BOL:
+            if (bol)
+                stk[top++] = pc + 1;
+            break;
+        case OP_EOL:
+            if (eol)
+                stk[top++] = pc + 1;
+            break;
+        case OP_MATCH:
+            return -1;
+        case OP_CHAR:
+        case OP_CLASS:
+            out[nout++] = pc;
+            break;
+        default:
+            stk[top++] = pc + 1;
+            break;
         }
-        break;
     }
-    *matchlen = pre;
-    return 0;
+    return nout;
 }
 
-/* Compile PATTERN into an internal NFA representation. */
-int regcomp(regex_t *preg, const char *pattern, int cflags)
+/*
+ * Compute the transition of state CUR on byte C. Returns the next state,
+ * DFA_MATCH or DFA_NOMEM. *flushed is set when the cache had to be
+ * emptied to make room, which also discards CUR.
+ */
+static int dfa_step(const struct regex_impl *ri, struct dfa_cache *d,
+                    struct vm_scratch *s, int cur, unsigned char c,
+                    int *flushed)
 {
-    (void)cflags;
-    char *expanded = expand_ranges(pattern);
-    if (!expanded)
+    struct dstate *st = &d->states[cur];
+    int nl = (ri->cflags & REG_NEWLINE) && c == '\n';
+    int n = dfa_closure(ri, s, d->pool + st->off, st->n, st->bol, nl, s->tmp);
+    if (n < 0) {
+        st->next[c] = DFA_MATCH;
+        return DFA_MATCH;
+    }
+    int m = 0;
+    next_stamp(s, ri->nprog);
+    for (int i = 0; i < n; i++) {
+        const struct rinst *in = &ri->prog[s->tmp[i]];
+        int to = s->tmp[i] + 1;
+        if (inst_accepts(ri, in, c) && s->gen[to] != s->stamp) {
+            s->gen[to] = s->stamp;
+            s->tmp2[m++] = to;
+        }
+    }
+    if (!ri->anchored && s->gen[0] != s->stamp)
+        s->tmp2[m++] = 0;
+    qsort(s->tmp2, (size_t)m, sizeof(int), cmp_int);
+    int nx = dfa_intern(d, s->tmp2, m, nl);
+    if (nx == DFA_FULL) {
+        dfa_flush(d);
+        *flushed = 1;
+        return dfa_intern(d, s->tmp2, m, nl);
+    }
+    if (nx >= 0)
+        d->states[cur].next[c] = nx;
+    return nx;
+}
+
+/* Return the state with only the start pc pending. */
+static int dfa_start(struct dfa_cache *d, int bol)
+{
+    int start = 0;
+    int st = dfa_intern(d, &start, 1, bol);
+    if (st == DFA_FULL) {
+        dfa_flush(d);
+        st = dfa_intern(d, &start, 1, bol);
+    }
+    return st;
+}
+
+/*
+ * Decide whether STR contains a match using the cached DFA. Returns 1 or
+ * 0, or -1 when the caller should fall back to the Pike VM.
+ */
+static int dfa_exec(const regex_t *preg, const char *str, size_t len,
+                    int eflags)
+{
+    struct regex_impl *ri = preg->impl;
+    if (atomic_flag_test_and_set_explicit(&ri->busy, memory_order_acquire))
         return -1;
-    struct strlist alts = {0};
-    if (expand_alts(expanded, &alts) != 0) {
-        free(expanded);
-        list_free(&alts);
+    if (!ri->scratch_ready) {
+        if (alloc_scratch(ri, preg, &ri->scratch) != 0) {
+            atomic_flag_clear_explicit(&ri->busy, memory_order_release);
+            return -1;
+        }
+        ri->scratch_ready = 1;
+    }
+    struct vm_scratch *s = &ri->scratch;
+    struct dfa_cache *d = &ri->dfa;
+    if (!d->states)
+        dfa_flush(d);
+
+    int result = -1;
+    int flushes = 0;
+    int cur = dfa_start(d, !(eflags & REG_NOTBOL));
+    const unsigned char *p = (const unsigned char *)str;
+    int skip = ri->has_first && !ri->anchored;
+    while (cur >= 0) {
+        if (d->states[cur].n == 0) {
+            result = 0;
+            break;
+        }
+        if (skip && d->states[cur].idle) {
+            /* no match in progress: jump to the next possible start */
+            size_t pos = (size_t)((const char *)p - str);
+            size_t q = next_candidate(ri, str, len, pos);
+            if (q == NO_CANDIDATE) {
+                result = 0;
+                break;
+            }
+            if (q != pos) {
+                p = (const unsigned char *)str + q;
+                cur = dfa_start(d, at_bol(ri, str, q, eflags));
+                if (cur < 0)
+                    break;
+            }
+        }
+        unsigned char c = *p;
+        if (c == '\0') {
+            int noteol = (eflags & REG_NOTEOL) != 0;
+            struct dstate *st = &d->states[cur];
+            if (st->endm[noteol] < 0)
+                st->endm[noteol] = dfa_closure(ri, s, d->pool + st->off,
+                                               st->n, st->bol, !noteol,
+                                               s->tmp) < 0;
+            result = st->endm[noteol];
+            break;
+        }
+        int nx = d->states[cur].next[c];
+        if (nx == DFA_UNKNOWN) {
+            int flushed = 0;
+            nx = dfa_step(ri, d, s, cur, c, &flushed);
+            if (flushed && ++flushes > DFA_MAX_FLUSHES)
+                break;
+        }
+        if (nx == DFA_MATCH) {
+            result = 1;
+            break;
+        }
+        cur = nx;
+        p++;
+    }
+    atomic_flag_clear_explicit(&ri->busy, memory_order_release);
+    return result;
+}
+
+/* ---------------------------------------------------------------- */
+/* backtracking matcher for backreferences                          */
+
+enum { BT_BRANCH, BT_CAP, BT_MARK };
+
+struct bt_ent {
+    int kind;
+    int a;
+    int b;
+};
+
+struct bt_stack {
+    struct bt_ent *e;
+    size_t n, cap;
+};
+
+static int bt_push(struct bt_stack *st, int kind, int a, int b)
+{
+    if (st->n == st->cap) {
+        size_t nc = st->cap ? st->cap * 2 : 64;
+        struct bt_ent *n = realloc(st->e, nc * sizeof(*n));
+        if (!n)
+            return -1;
+        st->e = n;
+        st->cap = nc;
+    }
+    st->e[st->n].kind = kind;
+    st->e[st->n].a = a;
+    st->e[st->n].b = b;
+    st->n++;
+    return 0;
+}
+
+/* Compare a captured substring at SP, folding case if requested. */
+static int backref_len(const struct regex_impl *ri, const char *str,
+                       const int *caps, int group, size_t sp)
+{
+    int so = caps[2 * group], eo = caps[2 * group + 1];
+    if (so < 0 || eo < so)
         return -1;
+    int len = eo - so;
+    for (int i = 0; i < len; i++) {
+        unsigned char a = (unsigned char)str[so + i];
+        unsigned char b = (unsigned char)str[sp + i];
+        if (b == '\0')
+            return -1;
+        if (a != b && !((ri->cflags & REG_ICASE) && tolower(a) == tolower(b)))
+            return -1;
     }
-    free(expanded);
-    if (alts.count == 0)
+    return len;
+}
+
+/* Try to match at START, leaving offsets in CAPS. Returns 1, 0 or -1. */
+static int bt_run(const struct regex_impl *ri, const char *str, size_t start,
+                  int *caps, int ncap, int *marks, struct bt_stack *st,
+                  int eflags)
+{
+    for (int i = 0; i < ncap; i++)
+        caps[i] = -1;
+    st->n = 0;
+    if (bt_push(st, BT_BRANCH, 0, (int)start) < 0)
         return -1;
-    struct regex_impl *ri = calloc(1, sizeof(*ri));
-    if (!ri) { list_free(&alts); return -1; }
-    ri->alts = calloc(alts.count, sizeof(struct regex_alt));
-    ri->nalt = alts.count;
-    if (!ri->alts) { free(ri); list_free(&alts); return -1; }
-    size_t groups = 0;
-    for (size_t i = 0; i < alts.count; i++) {
-        if (compile_single(&ri->alts[i], alts.items[i], &groups) != 0) {
-            for (size_t k = 0; k <= i; k++) {
-                free(ri->alts[k].pat);
-                free(ri->alts[k].ccl);
+    while (st->n > 0) {
+        struct bt_ent e = st->e[--st->n];
+        if (e.kind == BT_CAP) {
+            caps[e.a] = e.b;
+            continue;
+        }
+        if (e.kind == BT_MARK) {
+            marks[e.a] = e.b;
+            continue;
+        }
+        int pc = e.a;
+        size_t sp = (size_t)e.b;
+        for (;;) {
+            const struct rinst *in = &ri->prog[pc];
+            int ok = 1;
+            switch (in->op) {
+            case OP_CHAR:
+            case OP_CLASS:
+                ok = inst_accepts(ri, in, (unsigned char)str[sp]);
+                if (ok) {
+                    sp++;
+                    pc++;
+                }
+                break;
+            case OP_SPLIT:
+                if (bt_push(st, BT_BRANCH, in->y, (int)sp) < 0)
+                    return -1;
+                pc = in->x;
+                break;
+            case OP_JMP:
+                pc = in->x;
+                break;
+            case OP_SAVE:
+                if (bt_push(st, BT_CAP, in->x, caps[in->x]) < 0)
+                    return -1;
+                caps[in->x] = (int)sp;
+                pc++;
+                break;
+            case OP_BOL:
+                ok = at_bol(ri, str, sp, eflags);
+                pc++;
+                break;
+            case OP_EOL:
+                ok = at_eol(ri, str, sp, eflags);
+                pc++;
+                break;
+            case OP_MARK:
+                if (bt_push(st, BT_MARK, in->x, marks[in->x]) < 0)
+                    return -1;
+                marks[in->x] = (int)sp;
+                pc++;
+                break;
+            case OP_CHECK:
+                ok = marks[in->x] != (int)sp;
+                pc++;
+                break;
+            case OP_BACKREF: {
+                int len = backref_len(ri, str, caps, in->x, sp);
+                ok = len >= 0;
+                sp += ok ? (size_t)len : 0;
+                pc++;
+                break;
             }
-            free(ri->alts);
-            free(ri);
-            list_free(&alts);
-            return -1;
+            case OP_MATCH:
+                return 1;
+            }
+            if (!ok)
+                break;
         }
     }
-    list_free(&alts);
-    preg->impl = ri;
-    preg->re_nsub = groups;
     return 0;
 }
 
+/* Leftmost-first search used when the pattern has backreferences. */
+static int bt_exec(const regex_t *preg, const char *str, size_t len,
+                   int *caps, int eflags)
+{
+    const struct regex_impl *ri = preg->impl;
+    int ncap = 2 * ((int)preg->re_nsub + 1);
+    int *marks = malloc(((size_t)ri->nmarks + 1) * sizeof(int));
+    if (!marks)
+        return -1;
+    struct bt_stack st = { NULL, 0, 0 };
+    int r = 0;
+    for (size_t sp = 0;; sp++) {
+        if (ri->has_first && !ri->anchored) {
+            sp = next_candidate(ri, str, len, sp);
+            if (sp == NO_CANDIDATE)
+                break;
+        }
+        r = bt_run(ri, str, sp, caps, ncap, marks, &st, eflags);
+        if (r != 0 || ri->anchored || str[sp] == '\0')
+            break;
+    }
+    free(st.e);
+    free(marks);
+    return r;
+}
+
+/* ---------------------------------------------------------------- */
+
 /* Execute a compiled regex on STRING and report matches. */
 int regexec(const regex_t *preg, const char *string,
             size_t nmatch, regmatch_t pmatch[], int eflags)
 {
-    (void)eflags;
-    if (!preg || !preg->impl)
+    if (!preg || !preg->impl || !string)
         return REG_NOMATCH;
-    struct regex_impl *ri = (struct regex_impl *)preg->impl;
-    int len = 0;
-    int pos = -1;
-    regmatch_t *caps = NULL;
-    if (preg->re_nsub) {
-        caps = calloc(preg->re_nsub + 1, sizeof(regmatch_t));
-        if (caps)
-            memset(caps, -1, (preg->re_nsub + 1) * sizeof(regmatch_t));
-    }
-    for (size_t a = 0; a < ri->nalt && pos < 0; a++) {
-        struct token *pat = ri->alts[a].pat;
-        if (pat[0].type == BEGIN) {
-            if (matchpattern(&pat[1], string, &len, string, caps))
-                pos = 0;
+    const struct regex_impl *ri = preg->impl;
+    if ((ri->cflags & REG_NOSUB) || !pmatch)
+        nmatch = 0;
+
+    size_t len = strlen(string);
+    if (ri->required_len &&
+        !memmem(string, len, ri->required, ri->required_len))
+        return REG_NOMATCH;
+
+    /* the DFA answers no-match cheaply even when offsets are wanted */
+    if (!ri->has_backref) {
+        int r = dfa_exec(preg, string, len, eflags);
+        if (r == 0 || (r == 1 && nmatch == 0))
+            return r ? 0 : REG_NOMATCH;
+    }
+
+    size_t want = nmatch < preg->re_nsub + 1 ? nmatch : preg->re_nsub + 1;
+    int ncap = ri->has_backref ? 2 * ((int)preg->re_nsub + 1)
+                               : 2 * (want ? (int)want : 1);
+    int capbuf[32];
+    int *caps = ncap <= 32 ? capbuf : malloc((size_t)ncap * sizeof(int));
+    if (!caps)
+        return REG_ESPACE;
+    int r = ri->has_backref ? bt_exec(preg, string, len, caps, eflags)
+                            : pike_exec(preg, string, len, ncap, caps, eflags);
+    if (r <= 0) {
+        if (caps != capbuf)
+            free(caps);
+        return r < 0 ? REG_ESPACE : REG_NOMATCH;
+    }
+    for (size_t i = 0; i < nmatch; i++) {
+        if (i < want) {
+            pmatch[i].rm_so = caps[2 * i];
+            pmatch[i].rm_eo = caps[2 * i + 1];
         } else {
-            const char *t = string; int idx = -1; int l;
-            do {
-                idx++; l = 0;
-                if (caps)
-                    memset(caps, -1, (preg->re_nsub + 1) * sizeof(regmatch_t));
-                if (matchpattern(pat, t, &l, string, caps)) { pos = idx; len = l; break; }
-            } while (*t++);
+            pmatch[i].rm_so = pmatch[i].rm_eo = -1;
         }
     }
-    if (pos < 0)
-    {
+    if (caps != capbuf)
         free(caps);
-        return REG_NOMATCH;
-    }
-    if (nmatch > 0) {
-        pmatch[0].rm_so = pos;
-        pmatch[0].rm_eo = pos + len;
-        for (size_t i = 1; i <= preg->re_nsub && i < nmatch; i++)
-            pmatch[i] = caps[i];
-    }
-    free(caps);
     return 0;
 }
 
@@ -773,12 +1613,14 @@ void regfree(regex_t *preg)
     if (!preg || !preg->impl)
         return;
     struct regex_impl *ri = (struct regex_impl *)preg->impl;
-    for (size_t i = 0; i < ri->nalt; i++) {
-        free(ri->alts[i].pat);
-        free(ri->alts[i].ccl);
-    }
-    free(ri->alts);
+    free(ri->prog);
+    free(ri->cls);
+    free(ri->prefix);
+    free(ri->required);
+    if (ri->scratch_ready)
+        free_scratch(&ri->scratch);
+    free(ri->dfa.states);
+    free(ri->dfa.pool);
     free(ri);
     preg->impl = NULL;
 }
-
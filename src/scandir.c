@@ -18,6 +18,30 @@ int alphasort(const struct dirent **a, const struct dirent **b)
     return strcmp((*a)->d_name, (*b)->d_name);
 }
 
+/* Large reads: a directory of n entries costs about n * 32 / 256K calls. */
+#define SCANDIR_BUF (256 * 1024)
+
+static int arena_reserve(char **arena, size_t *cap, size_t need)
+{
+    if (need <= *cap)
+        return 0;
+    size_t ncap = *cap ? *cap : 64 * 1024;
+    while (ncap < need)
+        ncap *= 2;
+    char *n = realloc(*arena, ncap);
+    if (!n)
+        return -1;
+    *arena = n;
+    *cap = ncap;
+    return 0;
+}
+
+/*
+ * scandir() - collect the entries of PATH accepted by FILTER, sorted with
+ * COMPAR. All entries and the returned array are packed into a single
+ * shared block; each of them may still be released with free() and the
+ * block goes away with the last one.
+ */
 int scandir(const char *path, struct dirent ***namelist,
             int (*filter)(const struct dirent *),
             int (*compar)(const struct dirent **, const struct dirent **))
@@ -30,43 +54,59 @@ int scandir(const char *path, struct dirent ***namelist,
     DIR *dir = opendir(path);
     if (!dir)
         return -1;
+    vlibc_setdirbuf(dir, SCANDIR_BUF);
 
-    size_t cap = 16;
+    char *arena = NULL;
+    size_t cap = 0;
+    size_t used = VLIBC_SHARED_HDR;
     size_t count = 0;
-    struct dirent **list = malloc(cap * sizeof(struct dirent *));
-    if (!list) {
+    for (;;) {
+        errno = 0;
+        struct dirent *ent = readdir(dir);
+        if (!ent)
+            break;
+        if (filter && !filter(ent))
+            continue;
+        size_t hdr = offsetof(struct dirent, d_name);
+        size_t nlen = strlen(ent->d_name);
+        size_t reclen = (hdr + nlen + 1 + 7) & ~(size_t)7;
+        if (arena_reserve(&arena, &cap, used + VLIBC_PIECE_HDR + reclen) < 0)
+            goto nomem;
+        struct dirent *copy =
+            (struct dirent *)(arena + used + VLIBC_PIECE_HDR);
+        memcpy(copy, ent, hdr);
+        memcpy(copy->d_name, ent->d_name, nlen + 1);
+        copy->d_reclen = (unsigned short)reclen;
+        used += VLIBC_PIECE_HDR + reclen;
+        count++;
+    }
+    if (errno) {
+        int saved = errno;
         closedir(dir);
-        errno = ENOMEM;
+        free(arena);
+        errno = saved;
         return -1;
     }
+    closedir(dir);
 
-    struct dirent *ent;
-    while ((ent = readdir(dir))) {
-        if (filter && !filter(ent))
-            continue;
-
-        size_t len = offsetof(struct dirent, d_name) + strlen(ent->d_name) + 1;
-        struct dirent *copy = malloc(len);
-        if (!copy) {
-            errno = ENOMEM;
-            goto fail;
-        }
-        memcpy(copy, ent, len);
+    size_t list_off = used;
+    size_t list_len = (count ? count : 1) * sizeof(struct dirent *);
+    if (arena_reserve(&arena, &cap, used + VLIBC_PIECE_HDR + list_len) < 0) {
+        free(arena);
+        errno = ENOMEM;
+        return -1;
+    }
 
-        if (count == cap) {
-            size_t new_cap = cap * 2;
-            struct dirent **tmp = realloc(list, new_cap * sizeof(struct dirent *));
-            if (!tmp) {
-                free(copy);
-                errno = ENOMEM;
-                goto fail;
-            }
-            list = tmp;
-            cap = new_cap;
-        }
-        list[count++] = copy;
+    /* the block no longer moves: hand out the pieces */
+    vlibc_shared_init(arena, count + 1);
+    struct dirent **list = vlibc_shared_piece(arena, list_off, list_len);
+    size_t off = VLIBC_SHARED_HDR;
+    for (size_t i = 0; i < count; i++) {
+        struct dirent *ent =
+            (struct dirent *)(arena + off + VLIBC_PIECE_HDR);
+        list[i] = vlibc_shared_piece(arena, off, ent->d_reclen);
+        off += VLIBC_PIECE_HDR + ent->d_reclen;
     }
-    closedir(dir);
 
     if (compar && count > 1)
         qsort(list, count, sizeof(struct dirent *),
@@ -75,10 +115,9 @@ int scandir(const char *path, struct dirent ***namelist,
     *namelist = list;
     return (int)count;
 
-fail:
+nomem:
     closedir(dir);
-    for (size_t i = 0; i < count; i++)
-        free(list[i]);
-    free(list);
+    free(arena);
+    errno = ENOMEM;
     return -1;
 }
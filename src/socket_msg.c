@@ -68,3 +68,61 @@ ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
 #endif
 }
 
+
+/*
+ * The BSDs declare sendmmsg and recvmmsg with their own signatures, so
+ * the host versions are used there and these cover Linux and hosts
+ * without a native sys/socket.h.
+ */
+#if defined(__linux__) || !defined(VLIBC_SYS_SOCKET_NATIVE)
+/*
+ * sendmmsg() - send several messages with a single system call.
+ * Each entry's msg_len is set to the bytes sent for it. Returns the
+ * number of messages sent or -1 when the first one fails.
+ */
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+#ifdef SYS_sendmmsg
+    long ret = vlibc_syscall4(SYS_sendmmsg, sockfd, (long)msgvec, vlen, flags);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return (int)ret;
+#else
+    /* no batched call: send one message at a time */
+    unsigned int i;
+    for (i = 0; i < vlen; i++) {
+        ssize_t r = sendmsg(sockfd, &msgvec[i].msg_hdr, flags);
+        if (r < 0)
+            return i ? (int)i : -1;
+        msgvec[i].msg_len = (unsigned int)r;
+    }
+    return (int)i;
+#endif
+}
+
+/*
+ * recvmmsg() - receive several messages with a single system call.
+ * With MSG_WAITFORONE only the first message blocks. The timeout is
+ * checked after each datagram, as in the kernel. Returns the number of
+ * messages received or -1 on error with errno set.
+ */
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+             struct timespec *timeout)
+{
+#ifdef SYS_recvmmsg
+    long ret = vlibc_syscall5(SYS_recvmmsg, sockfd, (long)msgvec, vlen, flags,
+                              (long)timeout);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return (int)ret;
+#else
+    (void)sockfd; (void)msgvec; (void)vlen; (void)flags; (void)timeout;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+#endif
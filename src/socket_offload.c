@@ -0,0 +1,164 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the zero-copy and UDP segmentation offload helpers for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "sys/socket.h"
+#include "errno.h"
+#include "string.h"
+#include <stdint.h>
+
+/* Layout of the IP_RECVERR payload from <linux/errqueue.h>. */
+struct vlibc_sock_err {
+    uint32_t ee_errno;
+    uint8_t ee_origin;
+    uint8_t ee_type;
+    uint8_t ee_code;
+    uint8_t ee_pad;
+    uint32_t ee_info;
+    uint32_t ee_data;
+};
+
+#define EE_ORIGIN_ZEROCOPY      5
+#define EE_CODE_ZEROCOPY_COPIED 1
+#define LEVEL_IP                0
+#define LEVEL_IPV6              41
+#define TYPE_IP_RECVERR         11
+#define TYPE_IPV6_RECVERR       25
+
+/* CMSG_NXTHDR from the host headers may call into its C library. */
+static struct cmsghdr *next_cmsg(struct msghdr *msg, struct cmsghdr *c)
+{
+    size_t pos = (size_t)((char *)c - (char *)msg->msg_control);
+    size_t next = pos + CMSG_ALIGN(c->cmsg_len);
+    if (c->cmsg_len < sizeof(*c) ||
+        next + sizeof(struct cmsghdr) > msg->msg_controllen)
+        return NULL;
+    return (struct cmsghdr *)((char *)msg->msg_control + next);
+}
+
+int vlibc_zerocopy_enable(int sockfd)
+{
+    int one = 1;
+    return setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+}
+
+/*
+ * Completions arrive on the socket error queue as IP_RECVERR or
+ * IPV6_RECVERR messages. Other queued errors such as ICMP reports are
+ * consumed and skipped.
+ */
+int vlibc_zerocopy_reap(int sockfd, unsigned int *lo, unsigned int *hi,
+                        int *copied)
+{
+    for (;;) {
+        union {
+            char buf[CMSG_SPACE(sizeof(struct vlibc_sock_err) + 64)];
+            struct cmsghdr align;
+        } ctl;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = ctl.buf;
+        msg.msg_controllen = sizeof(ctl.buf);
+
+        if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c;
+             c = next_cmsg(&msg, c)) {
+            if (!((c->cmsg_level == LEVEL_IP &&
+                   c->cmsg_type == TYPE_IP_RECVERR) ||
+                  (c->cmsg_level == LEVEL_IPV6 &&
+                   c->cmsg_type == TYPE_IPV6_RECVERR)))
+                continue;
+            struct vlibc_sock_err ee;
+            memcpy(&ee, CMSG_DATA(c), sizeof(ee));
+            if (ee.ee_errno != 0 || ee.ee_origin != EE_ORIGIN_ZEROCOPY)
+                continue;
+            if (lo)
+                *lo = ee.ee_info;
+            if (hi)
+                *hi = ee.ee_data;
+            if (copied)
+                *copied = (ee.ee_code & EE_CODE_ZEROCOPY_COPIED) != 0;
+            return 1;
+        }
+    }
+}
+
+ssize_t vlibc_udp_send_gso(int sockfd, const void *buf, size_t len,
+                           unsigned short seg_size,
+                           const struct sockaddr *dest, socklen_t addrlen)
+{
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } ctl;
+    struct iovec iov = { (void *)buf, len };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(&ctl, 0, sizeof(ctl));
+    msg.msg_name = (void *)dest;
+    msg.msg_namelen = addrlen;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (seg_size && len > seg_size) {
+        msg.msg_control = ctl.buf;
+        msg.msg_controllen = sizeof(ctl.buf);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_UDP;
+        c->cmsg_type = UDP_SEGMENT;
+        c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t gso = seg_size;
+        memcpy(CMSG_DATA(c), &gso, sizeof(gso));
+    }
+    return sendmsg(sockfd, &msg, 0);
+}
+
+int vlibc_udp_enable_gro(int sockfd)
+{
+    int one = 1;
+    return setsockopt(sockfd, SOL_UDP, UDP_GRO, &one, sizeof(one));
+}
+
+ssize_t vlibc_udp_recv_gro(int sockfd, void *buf, size_t len,
+                           unsigned short *seg_size,
+                           struct sockaddr *src, socklen_t *addrlen)
+{
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctl;
+    struct iovec iov = { buf, len };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = src;
+    msg.msg_namelen = addrlen ? *addrlen : 0;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+
+    ssize_t n = recvmsg(sockfd, &msg, 0);
+    if (n < 0)
+        return -1;
+    if (addrlen)
+        *addrlen = msg.msg_namelen;
+    if (seg_size) {
+        *seg_size = (unsigned short)n;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c;
+             c = next_cmsg(&msg, c)) {
+            if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) {
+                int gso;
+                memcpy(&gso, CMSG_DATA(c), sizeof(gso));
+                *seg_size = (unsigned short)gso;
+            }
+        }
+    }
+    return n;
+}
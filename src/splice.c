@@ -0,0 +1,320 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the splice, tee, vmsplice and copy_file_range functions for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/file.h"
+#include "sys/stat.h"
+#include "errno.h"
+#include "io.h"
+#include "poll.h"
+#include <sys/syscall.h>
+#include "syscall.h"
+
+static ssize_t sys_result(long ret)
+{
+    if (ret < 0) {
+        errno = (int)-ret;
+        return -1;
+    }
+    return (ssize_t)ret;
+}
+
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+               size_t len, unsigned int flags)
+{
+#ifdef SYS_splice
+    return sys_result(vlibc_syscall(SYS_splice, fd_in, (long)off_in, fd_out,
+                                    (long)off_out, (long)len, flags));
+#else
+    (void)fd_in; (void)off_in; (void)fd_out; (void)off_out;
+    (void)len; (void)flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+#ifdef SYS_tee
+    return sys_result(vlibc_syscall(SYS_tee, fd_in, fd_out, (long)len, flags,
+                                    0, 0));
+#else
+    (void)fd_in; (void)fd_out; (void)len; (void)flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+ssize_t vmsplice(int fd, const struct iovec *iov, size_t nr_segs,
+                 unsigned int flags)
+{
+#ifdef SYS_vmsplice
+    return sys_result(vlibc_syscall(SYS_vmsplice, fd, (long)iov,
+                                    (long)nr_segs, flags, 0, 0));
+#else
+    (void)fd; (void)iov; (void)nr_segs; (void)flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out,
+                        off_t *off_out, size_t len, unsigned int flags)
+{
+#ifdef SYS_copy_file_range
+    return sys_result(vlibc_syscall(SYS_copy_file_range, fd_in, (long)off_in,
+                                    fd_out, (long)off_out, (long)len,
+                                    flags));
+#else
+    (void)fd_in; (void)off_in; (void)fd_out; (void)off_out;
+    (void)len; (void)flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+ * vlibc_copy_fd() helpers. Each one moves at most len bytes and returns
+ * the count, 0 at end of file or -1. A path that fails before moving
+ * anything with one of the errors below is treated as unavailable for
+ * this pair of descriptors and the next one is tried.
+ */
+#define CHUNK_MAX ((size_t)1 << 30)
+#define PIPE_SIZE (1 << 20)
+#define F_SETPIPE_SZ_CMD 1031
+
+static int unsupported(int err)
+{
+    return err == ENOSYS || err == EINVAL || err == EXDEV ||
+           err == EOPNOTSUPP || err == EBADF || err == ESPIPE;
+}
+
+static size_t clamp(size_t len)
+{
+    return len > CHUNK_MAX ? CHUNK_MAX : len;
+}
+
+static ssize_t via_range(int in, int out, size_t len)
+{
+    return copy_file_range(in, NULL, out, NULL, clamp(len), 0);
+}
+
+static ssize_t via_sendfile(int in, int out, size_t len)
+{
+#if defined(SYS_sendfile) && defined(__linux__)
+    /* the Linux call, unlike the BSD style sendfile() in file.c */
+    return sys_result(vlibc_syscall(SYS_sendfile, out, in, 0,
+                                    (long)clamp(len), 0, 0));
+#else
+    (void)in; (void)out; (void)len;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int is_pipe(int fd)
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+/* block until a non-blocking out can take more data */
+static int wait_out(int out)
+{
+    struct pollfd p = { out, POLLOUT, 0 };
+    for (;;) {
+        int r = poll(&p, 1, -1);
+        if (r >= 0 || errno != EINTR)
+            return r < 0 ? -1 : 0;
+    }
+}
+
+/*
+ * Write all of buf unless out fails. Bytes already taken from in have
+ * nowhere else to go, so EAGAIN waits for room rather than failing.
+ * Returns the count written, which is short only on error.
+ */
+static size_t write_all(int out, const char *buf, size_t len)
+{
+    size_t off = 0;
+    while (off < len) {
+        ssize_t w = write(out, buf + off, len - off);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_out(out) == 0)
+                continue;
+            break;
+        }
+        off += (size_t)w;
+    }
+    return off;
+}
+
+/* copy what is left in the private pipe to out with read and write */
+static size_t drain_pipe(int pfd, int out, size_t left)
+{
+    char buf[65536];
+    size_t done = 0;
+    while (left) {
+        ssize_t n = read(pfd, buf, left < sizeof(buf) ? left : sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        size_t w = write_all(out, buf, (size_t)n);
+        done += w;
+        if (w < (size_t)n)
+            break;
+        left -= (size_t)n;
+    }
+    return done;
+}
+
+/*
+ * splice needs a pipe on one side. Between two other descriptors the
+ * data goes through a private pipe, enlarged to cut the call count.
+ * When out turns out not to accept splice (an O_APPEND file, say) the
+ * bytes already taken from in are written out of the pipe by hand and
+ * *drained is set so the caller continues with plain read and write.
+ * If out fails for good partway, the count that reached it is returned
+ * and *err holds the error; the rest of the pipe is lost with out.
+ */
+static ssize_t via_splice(int in, int out, size_t len, int pipefd[2],
+                          int *drained, int *err)
+{
+    unsigned flags = SPLICE_F_MOVE | SPLICE_F_MORE;
+    if (pipefd[0] < 0)
+        return splice(in, NULL, out, NULL, clamp(len), flags);
+
+    if (len > PIPE_SIZE)
+        len = PIPE_SIZE;
+    ssize_t n = splice(in, NULL, pipefd[1], NULL, len, flags);
+    if (n <= 0)
+        return n;
+    size_t left = (size_t)n;
+    while (left) {
+        ssize_t w = splice(pipefd[0], NULL, out, NULL, left, flags);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_out(out) == 0)
+                continue;
+            if (unsupported(errno)) {
+                size_t d = drain_pipe(pipefd[0], out, left);
+                *drained = 1;
+                left -= d;
+                if (!left)
+                    break;
+            }
+            *err = errno;
+            break;
+        }
+        left -= (size_t)w;
+    }
+    n -= (ssize_t)left;
+    if (*err && n == 0) {
+        *err = 0;
+        return -1;
+    }
+    return n;
+}
+
+static ssize_t via_buffer(int in, int out, size_t len, int *err)
+{
+    char buf[65536];
+    if (len > sizeof(buf))
+        len = sizeof(buf);
+    ssize_t n = read(in, buf, len);
+    if (n <= 0)
+        return n;
+    size_t w = write_all(out, buf, (size_t)n);
+    if (w < (size_t)n) {
+        if (w == 0)
+            return -1;
+        *err = errno;
+    }
+    return (ssize_t)w;
+}
+
+ssize_t vlibc_copy_fd(int in, int out, size_t len, int *method)
+{
+    int pipefd[2] = { -1, -1 };
+    int m = VLIBC_COPY_RANGE;
+    size_t done = 0;
+    int fresh = 1;              /* current path has not moved data yet */
+    int drained = 0;            /* splice into out failed after reading */
+    int err = 0;                /* out failed after taking part of a chunk */
+
+    while (done < len) {
+        ssize_t n;
+        switch (m) {
+        case VLIBC_COPY_RANGE:
+            n = via_range(in, out, len - done);
+            break;
+        case VLIBC_COPY_SENDFILE:
+            n = via_sendfile(in, out, len - done);
+            break;
+        case VLIBC_COPY_SPLICE:
+            n = via_splice(in, out, len - done, pipefd, &drained, &err);
+            break;
+        default:
+            n = via_buffer(in, out, len - done, &err);
+            break;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        /*
+         * A first call returning 0 is not trusted as end of file:
+         * copy_file_range and sendfile report 0 for files such as those
+         * in /proc whose size is unknown.
+         */
+        if (fresh && m != VLIBC_COPY_BUFFER &&
+            (n == 0 || (n < 0 && unsupported(errno)))) {
+            m++;
+            if (m == VLIBC_COPY_SPLICE && !is_pipe(in) && !is_pipe(out)) {
+                if (pipe2(pipefd, O_CLOEXEC) != 0) {
+                    m++;
+                } else {
+                    vlibc_syscall(SYS_fcntl, pipefd[1], F_SETPIPE_SZ_CMD,
+                                  PIPE_SIZE, 0, 0, 0);
+                }
+            }
+            continue;
+        }
+        if (n < 0) {
+            if (done)
+                break;
+            if (pipefd[0] >= 0) {
+                int e = errno;
+                close(pipefd[0]);
+                close(pipefd[1]);
+                errno = e;
+            }
+            return -1;
+        }
+        if (n == 0)
+            break;
+        fresh = 0;
+        done += (size_t)n;
+        if (err)
+            break;
+        if (drained) {
+            drained = 0;
+            m = VLIBC_COPY_BUFFER;
+        }
+    }
+    if (pipefd[0] >= 0) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+    }
+    if (method)
+        *method = m;
+    return (ssize_t)done;
+}
@@ -8,160 +8,572 @@
 
 #include "time.h"
 #include "string.h"
+#include "stdlib.h"
+#include "errno.h"
+#include <stdint.h>
+
+extern long __vlibc_days_from_civil(long y, int m, int d);
 
 static const char *wd_short[7] = {
     "Sun","Mon","Tue","Wed","Thu","Fri","Sat"
 };
 
+static const char *wd_full[7] = {
+    "Sunday","Monday","Tuesday","Wednesday","Thursday","Friday","Saturday"
+};
+
 static const char *mon_short[12] = {
     "Jan","Feb","Mar","Apr","May","Jun",
     "Jul","Aug","Sep","Oct","Nov","Dec"
 };
 
-static int fmt_int(char *buf, size_t size, int val, int width)
+static const char *mon_full[12] = {
+    "January","February","March","April","May","June",
+    "July","August","September","October","November","December"
+};
+
+/*
+ * A format is compiled once into a list of ops: literal runs, numeric
+ * fields with a width and pad character, name lookups and the zone
+ * conversions. Composite conversions such as %F and %T expand into
+ * their parts, so rendering never parses the format again.
+ */
+enum { OP_LIT, OP_NUM, OP_NAME, OP_ZONE, OP_OFF, OP_EPOCH };
+
+enum {
+    F_YEAR, F_CENT, F_YY, F_MON, F_MDAY, F_HOUR, F_HOUR12,
+    F_MIN, F_SEC, F_YDAY, F_WDAY, F_UWDAY
+};
+
+enum { N_WDAY, N_WDAY_FULL, N_MON, N_MON_FULL, N_AMPM };
+
+/* struct tm members an op reads */
+#define D_SEC  0x001
+#define D_MIN  0x002
+#define D_HOUR 0x004
+#define D_MDAY 0x008
+#define D_MON  0x010
+#define D_YEAR 0x020
+#define D_WDAY 0x040
+#define D_YDAY 0x080
+#define D_ZONE 0x100
+#define D_OFF  0x200
+
+static const unsigned short field_deps[] = {
+    [F_YEAR] = D_YEAR, [F_CENT] = D_YEAR, [F_YY] = D_YEAR,
+    [F_MON] = D_MON, [F_MDAY] = D_MDAY, [F_HOUR] = D_HOUR,
+    [F_HOUR12] = D_HOUR, [F_MIN] = D_MIN, [F_SEC] = D_SEC,
+    [F_YDAY] = D_YDAY, [F_WDAY] = D_WDAY, [F_UWDAY] = D_WDAY
+};
+
+static const unsigned short name_deps[] = {
+    [N_WDAY] = D_WDAY, [N_WDAY_FULL] = D_WDAY, [N_MON] = D_MON,
+    [N_MON_FULL] = D_MON, [N_AMPM] = D_HOUR
+};
+
+struct sf_op {
+    unsigned char kind;
+    unsigned char arg;     /* field or name table */
+    unsigned char width;
+    char pad;
+    unsigned short deps;
+    unsigned int off;      /* literal pool offset */
+    unsigned int len;      /* literal length */
+};
+
+struct vlibc_strftime_fmt {
+    unsigned long id;      /* identifies the program in the render cache */
+    int nops;
+    unsigned deps;         /* union of the ops' deps */
+    struct sf_op *ops;
+    char *lit;
+};
+
+static unsigned long sf_next_id;
+
+struct sf_build {
+    struct sf_op *ops;     /* NULL while only counting */
+    int nops, maxops;
+    char *lit;
+    size_t nlit, maxlit;
+    unsigned deps;
+    int last_lit;
+};
+
+static struct sf_op *sf_new(struct sf_build *b, int kind, unsigned deps)
 {
-    char tmp[16];
-    int pos = 0;
-    if (val < 0)
-        val = -val;
-    do {
-        tmp[pos++] = '0' + (val % 10);
-        val /= 10;
-    } while (val && pos < (int)sizeof(tmp));
-    while (pos < width && pos < (int)sizeof(tmp))
-        tmp[pos++] = '0';
-    if (pos > (int)size)
-        pos = (int)size;
-    for (int i = 0; i < pos; ++i)
-        buf[i] = tmp[pos - i - 1];
-    return pos;
+    b->last_lit = kind == OP_LIT;
+    b->deps |= deps;
+    if (b->nops++ >= b->maxops || !b->ops)
+        return NULL;
+    struct sf_op *op = &b->ops[b->nops - 1];
+    memset(op, 0, sizeof(*op));
+    op->kind = (unsigned char)kind;
+    op->deps = (unsigned short)deps;
+    return op;
 }
 
-size_t strftime(char *s, size_t max, const char *format, const struct tm *tm)
+static void sf_lit(struct sf_build *b, const char *p, size_t n)
 {
-    if (!s || !format || !tm || max == 0)
-        return 0;
-    size_t pos = 0;
-    for (const char *p = format; *p; ++p) {
+    if (!b->last_lit) {
+        struct sf_op *op = sf_new(b, OP_LIT, 0);
+        if (op)
+            op->off = (unsigned)b->nlit;
+    }
+    if (b->ops && b->nops <= b->maxops)
+        b->ops[b->nops - 1].len += (unsigned)n;
+    if (b->lit && b->nlit + n <= b->maxlit)
+        memcpy(b->lit + b->nlit, p, n);
+    b->nlit += n;
+}
+
+static void sf_num(struct sf_build *b, int field, int width, char pad)
+{
+    struct sf_op *op = sf_new(b, OP_NUM, field_deps[field]);
+    if (op) {
+        op->arg = (unsigned char)field;
+        op->width = (unsigned char)width;
+        op->pad = pad;
+    }
+}
+
+static void sf_name(struct sf_build *b, int table)
+{
+    struct sf_op *op = sf_new(b, OP_NAME, name_deps[table]);
+    if (op)
+        op->arg = (unsigned char)table;
+}
+
+static void sf_compile(struct sf_build *b, const char *p)
+{
+    for (; *p; ++p) {
         if (*p != '%') {
-            if (pos + 1 >= max)
-                return 0;
-            s[pos++] = *p;
+            const char *q = p;
+            while (q[1] && q[1] != '%')
+                ++q;
+            sf_lit(b, p, (size_t)(q - p + 1));
+            p = q;
             continue;
         }
         ++p;
-        if (!*p)
-            break;
-        char buf[16];
-        int len = 0;
         switch (*p) {
-        case '%':
-            if (pos + 1 >= max)
-                return 0;
-            s[pos++] = '%';
+        case '\0':
+            return;
+        case '%': sf_lit(b, "%", 1); break;
+        case 'n': sf_lit(b, "\n", 1); break;
+        case 't': sf_lit(b, "\t", 1); break;
+        case 'Y': sf_num(b, F_YEAR, 4, '0'); break;
+        case 'C': sf_num(b, F_CENT, 2, '0'); break;
+        case 'y': sf_num(b, F_YY, 2, '0'); break;
+        case 'm': sf_num(b, F_MON, 2, '0'); break;
+        case 'd': sf_num(b, F_MDAY, 2, '0'); break;
+        case 'e': sf_num(b, F_MDAY, 2, ' '); break;
+        case 'H': sf_num(b, F_HOUR, 2, '0'); break;
+        case 'I': sf_num(b, F_HOUR12, 2, '0'); break;
+        case 'M': sf_num(b, F_MIN, 2, '0'); break;
+        case 'S': sf_num(b, F_SEC, 2, '0'); break;
+        case 'j': sf_num(b, F_YDAY, 3, '0'); break;
+        case 'w': sf_num(b, F_WDAY, 1, '0'); break;
+        case 'u': sf_num(b, F_UWDAY, 1, '0'); break;
+        case 'a': sf_name(b, N_WDAY); break;
+        case 'A': sf_name(b, N_WDAY_FULL); break;
+        case 'b':
+        case 'h': sf_name(b, N_MON); break;
+        case 'B': sf_name(b, N_MON_FULL); break;
+        case 'p': sf_name(b, N_AMPM); break;
+        case 'Z': sf_new(b, OP_ZONE, D_ZONE); break;
+        case 'z': sf_new(b, OP_OFF, D_OFF); break;
+        case 's':
+            sf_new(b, OP_EPOCH, D_SEC | D_MIN | D_HOUR | D_MDAY | D_MON |
+                                D_YEAR | D_OFF);
             break;
-        case 'a': {
-            const char *wd = (tm->tm_wday >= 0 && tm->tm_wday < 7) ?
-                wd_short[tm->tm_wday] : "";
-            len = (int)strlen(wd);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, wd, (size_t)len);
-            pos += (size_t)len;
+        case 'F': sf_compile(b, "%Y-%m-%d"); break;
+        case 'T':
+        case 'X': sf_compile(b, "%H:%M:%S"); break;
+        case 'R': sf_compile(b, "%H:%M"); break;
+        case 'D':
+        case 'x': sf_compile(b, "%m/%d/%y"); break;
+        case 'r': sf_compile(b, "%I:%M:%S %p"); break;
+        case 'c': sf_compile(b, "%a %b %e %H:%M:%S %Y"); break;
+        default:
+            /* unknown conversions are copied through */
+            sf_lit(b, p - 1, 2);
             break;
         }
-        case 'b': {
-            const char *mn = (tm->tm_mon >= 0 && tm->tm_mon < 12) ?
-                mon_short[tm->tm_mon] : "";
-            len = (int)strlen(mn);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, mn, (size_t)len);
-            pos += (size_t)len;
+    }
+}
+
+/*
+ * The copies here are a few bytes to a few dozen, so they move whole
+ * words and finish bytewise instead of going through memcpy().
+ */
+static inline void sf_copy(char *d, const char *s, size_t n)
+{
+    for (; n >= 8; n -= 8, d += 8, s += 8) {
+        uint64_t w;
+        __builtin_memcpy(&w, s, 8);
+        __builtin_memcpy(d, &w, 8);
+    }
+    while (n--)
+        *d++ = *s++;
+}
+
+/*
+ * Compare the caller's format with the saved one of length len, a word
+ * at a time while the read cannot cross into the next page.
+ */
+static int fmt_equal(const char *saved, size_t len, const char *fmt)
+{
+    size_t i = 0;
+    for (; i + 8 <= len + 1; i += 8) {
+        if (((uintptr_t)(fmt + i) & 4095) > 4096 - 8)
             break;
+        uint64_t a, b;
+        __builtin_memcpy(&a, saved + i, 8);
+        __builtin_memcpy(&b, fmt + i, 8);
+        if (a != b)
+            return 0;
+    }
+    for (; i <= len; ++i)
+        if (saved[i] != fmt[i])
+            return 0;
+    return 1;
+}
+
+static size_t fmt_num(char *buf, long val, int width, char pad)
+{
+    char tmp[24];
+    int pos = 0;
+    unsigned long v = val < 0 ? -(unsigned long)val : (unsigned long)val;
+    do {
+        tmp[pos++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (pos < width)
+        tmp[pos++] = pad;
+    if (val < 0)
+        tmp[pos++] = '-';
+    for (int i = 0; i < pos; ++i)
+        buf[i] = tmp[pos - i - 1];
+    return (size_t)pos;
+}
+
+static long field_value(int field, const struct tm *tm)
+{
+    long year = tm->tm_year + 1900L;
+    switch (field) {
+    case F_YEAR:   return year;
+    case F_CENT:   return year >= 0 ? year / 100 : -((99 - year) / 100);
+    case F_YY:     return (year % 100 + 100) % 100;
+    case F_MON:    return tm->tm_mon + 1;
+    case F_MDAY:   return tm->tm_mday;
+    case F_HOUR:   return tm->tm_hour;
+    case F_HOUR12: return tm->tm_hour % 12 ? tm->tm_hour % 12 : 12;
+    case F_MIN:    return tm->tm_min;
+    case F_SEC:    return tm->tm_sec;
+    case F_YDAY:   return tm->tm_yday + 1;
+    case F_WDAY:   return tm->tm_wday;
+    default:       return tm->tm_wday == 0 ? 7 : tm->tm_wday;
+    }
+}
+
+static const char *name_value(int table, const struct tm *tm)
+{
+    int wd = tm->tm_wday >= 0 && tm->tm_wday < 7;
+    int mn = tm->tm_mon >= 0 && tm->tm_mon < 12;
+    switch (table) {
+    case N_WDAY:      return wd ? wd_short[tm->tm_wday] : "";
+    case N_WDAY_FULL: return wd ? wd_full[tm->tm_wday] : "";
+    case N_MON:       return mn ? mon_short[tm->tm_mon] : "";
+    case N_MON_FULL:  return mn ? mon_full[tm->tm_mon] : "";
+    default:          return tm->tm_hour < 12 ? "AM" : "PM";
+    }
+}
+
+/* Seconds since the epoch for %s without normalizing the caller's tm. */
+static long tm_epoch(const struct tm *tm)
+{
+    long y = tm->tm_year + 1900L + tm->tm_mon / 12;
+    int m = tm->tm_mon % 12;
+    if (m < 0) {
+        m += 12;
+        y--;
+    }
+    long days = __vlibc_days_from_civil(y, m + 1, 1) + tm->tm_mday - 1;
+    return days * 86400 + tm->tm_hour * 3600L + tm->tm_min * 60L +
+           tm->tm_sec - tm->tm_gmtoff;
+}
+
+/* Text for one op: either a pointer to constant data or into tmp. */
+static const char *render_op(const struct vlibc_strftime_fmt *f,
+                             const struct sf_op *op, const struct tm *tm,
+                             char *tmp, size_t *len)
+{
+    const char *r;
+    switch (op->kind) {
+    case OP_LIT:
+        *len = op->len;
+        return f->lit + op->off;
+    case OP_NUM: {
+        long v = field_value(op->arg, tm);
+        if (op->width == 2 && v >= 0 && v < 100) {
+            tmp[0] = v >= 10 ? (char)('0' + v / 10) : op->pad;
+            tmp[1] = (char)('0' + v % 10);
+            *len = 2;
+        } else {
+            *len = fmt_num(tmp, v, op->width, op->pad);
         }
-        case 'Y':
-            len = fmt_int(buf, sizeof(buf), tm->tm_year + 1900, 4);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, buf, (size_t)len);
-            pos += (size_t)len;
-            break;
-        case 'm':
-            len = fmt_int(buf, sizeof(buf), tm->tm_mon + 1, 2);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, buf, (size_t)len);
-            pos += (size_t)len;
-            break;
-        case 'd':
-            len = fmt_int(buf, sizeof(buf), tm->tm_mday, 2);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, buf, (size_t)len);
-            pos += (size_t)len;
-            break;
-        case 'H':
-            len = fmt_int(buf, sizeof(buf), tm->tm_hour, 2);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, buf, (size_t)len);
-            pos += (size_t)len;
-            break;
-        case 'M':
-            len = fmt_int(buf, sizeof(buf), tm->tm_min, 2);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, buf, (size_t)len);
-            pos += (size_t)len;
-            break;
-        case 'S':
-            len = fmt_int(buf, sizeof(buf), tm->tm_sec, 2);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, buf, (size_t)len);
-            pos += (size_t)len;
-            break;
-        case 'Z':
-            len = 3;
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, "UTC", (size_t)len);
-            pos += (size_t)len;
-            break;
-        case 'z':
-            if (pos + 5 >= max)
-                return 0;
-            memcpy(s + pos, "+0000", 5);
-            pos += 5;
-            break;
-        case 'w':
-            len = fmt_int(buf, sizeof(buf), tm->tm_wday, 1);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, buf, (size_t)len);
-            pos += (size_t)len;
-            break;
-        case 'u':
-            len = fmt_int(buf, sizeof(buf), tm->tm_wday == 0 ? 7 : tm->tm_wday, 1);
-            if (pos + (size_t)len >= max)
-                return 0;
-            memcpy(s + pos, buf, (size_t)len);
-            pos += (size_t)len;
-            break;
-        default:
-            if (pos + 1 >= max)
-                return 0;
-            s[pos++] = '%';
-            if (pos + 1 >= max)
-                return 0;
-            s[pos++] = *p;
-            break;
+        return tmp;
+    }
+    case OP_NAME:
+        r = name_value(op->arg, tm);
+        break;
+    case OP_ZONE:
+        r = tm->tm_zone ? tm->tm_zone : "UTC";
+        break;
+    case OP_OFF: {
+        long off = tm->tm_gmtoff;
+        tmp[0] = off < 0 ? '-' : '+';
+        if (off < 0)
+            off = -off;
+        off /= 60;
+        tmp[1] = (char)('0' + off / 600 % 10);
+        tmp[2] = (char)('0' + off / 60 % 10);
+        tmp[3] = (char)('0' + off % 60 / 10);
+        tmp[4] = (char)('0' + off % 10);
+        *len = 5;
+        return tmp;
+    }
+    default:
+        *len = fmt_num(tmp, tm_epoch(tm), 1, '0');
+        return tmp;
+    }
+    *len = strlen(r);
+    return r;
+}
+
+/*
+ * Render every op into dst. When at/n are given the position and length
+ * of each op is recorded for later patching. Returns the length or -1
+ * when the output plus terminator does not fit.
+ */
+static long render(char *dst, size_t max, const struct vlibc_strftime_fmt *f,
+                   const struct tm *tm, unsigned short *at, unsigned short *n)
+{
+    size_t pos = 0;
+    char tmp[24];
+    for (int i = 0; i < f->nops; ++i) {
+        size_t len;
+        const char *r = render_op(f, &f->ops[i], tm, tmp, &len);
+        if (pos + len >= max)
+            return -1;
+        sf_copy(dst + pos, r, len);
+        if (at) {
+            at[i] = (unsigned short)pos;
+            n[i] = (unsigned short)len;
+        }
+        pos += len;
+    }
+    dst[pos] = '\0';
+    return (long)pos;
+}
+
+/*
+ * Per-thread copy of the last rendered output. Formatting successive
+ * timestamps with the same program usually changes only the seconds, so
+ * ops whose inputs are unchanged are reused and changed fields are
+ * rewritten in place as long as their width stays the same.
+ */
+#define SF_CACHE_OPS 32
+#define SF_CACHE_OUT 256
+#define SF_CACHE_ZONE 16
+
+struct sf_cache {
+    unsigned long id;      /* program the output belongs to, 0 if none */
+    struct tm tm;          /* inputs of the cached output */
+    char zone[SF_CACHE_ZONE];
+    long len;
+    unsigned short at[SF_CACHE_OPS];
+    unsigned short n[SF_CACHE_OPS];
+    char out[SF_CACHE_OUT];
+};
+
+static __thread struct sf_cache sf_cache;
+
+static unsigned tm_changes(const struct sf_cache *c, const struct tm *tm,
+                           unsigned deps)
+{
+    unsigned ch = 0;
+    if (tm->tm_sec != c->tm.tm_sec) ch |= D_SEC;
+    if (tm->tm_min != c->tm.tm_min) ch |= D_MIN;
+    if (tm->tm_hour != c->tm.tm_hour) ch |= D_HOUR;
+    if (tm->tm_mday != c->tm.tm_mday) ch |= D_MDAY;
+    if (tm->tm_mon != c->tm.tm_mon) ch |= D_MON;
+    if (tm->tm_year != c->tm.tm_year) ch |= D_YEAR;
+    if (tm->tm_wday != c->tm.tm_wday) ch |= D_WDAY;
+    if (tm->tm_yday != c->tm.tm_yday) ch |= D_YDAY;
+    if (tm->tm_gmtoff != c->tm.tm_gmtoff) ch |= D_OFF;
+    if (deps & D_ZONE) {
+        /* compare contents; the old tm_zone pointer may be gone */
+        const char *z = tm->tm_zone ? tm->tm_zone : "UTC";
+        if (!c->zone[SF_CACHE_ZONE - 1] ||
+            strncmp(z, c->zone, SF_CACHE_ZONE - 1) != 0)
+            ch |= D_ZONE;
+    }
+    return ch & deps;
+}
+
+static void cache_key(struct sf_cache *c, const struct tm *tm, unsigned changed)
+{
+    c->tm = *tm;
+    if (!(changed & D_ZONE))
+        return;
+    const char *z = tm->tm_zone ? tm->tm_zone : "UTC";
+    size_t zl = strlen(z);
+    memset(c->zone, 0, sizeof(c->zone));
+    if (zl < SF_CACHE_ZONE - 1) {
+        memcpy(c->zone, z, zl);
+        /* the last byte marks a usable copy */
+        c->zone[SF_CACHE_ZONE - 1] = 1;
+    }
+}
+
+static int cache_patch(struct sf_cache *c, const struct vlibc_strftime_fmt *f,
+                       const struct tm *tm, unsigned changed)
+{
+    char tmp[24];
+    for (int i = 0; i < f->nops; ++i) {
+        if (!(f->ops[i].deps & changed))
+            continue;
+        size_t len;
+        const char *r = render_op(f, &f->ops[i], tm, tmp, &len);
+        if (len != c->n[i])
+            return -1;
+        sf_copy(c->out + c->at[i], r, len);
+    }
+    return 0;
+}
+
+static size_t sf_exec(char *s, size_t max, const struct vlibc_strftime_fmt *f,
+                      const struct tm *tm)
+{
+    if (f->nops > SF_CACHE_OPS) {
+        long len = render(s, max, f, tm, NULL, NULL);
+        return len < 0 ? 0 : (size_t)len;
+    }
+
+    struct sf_cache *c = &sf_cache;
+    if (c->id == f->id) {
+        unsigned changed = tm_changes(c, tm, f->deps);
+        if (changed && cache_patch(c, f, tm, changed) < 0)
+            c->id = 0;
+        else if (changed)
+            cache_key(c, tm, changed);
+    }
+    if (c->id != f->id) {
+        c->len = render(c->out, sizeof(c->out), f, tm, c->at, c->n);
+        if (c->len < 0) {
+            c->id = 0;
+            long len = render(s, max, f, tm, NULL, NULL);
+            return len < 0 ? 0 : (size_t)len;
         }
+        c->id = f->id;
+        cache_key(c, tm, ~0u);
     }
-    if (pos >= max)
+    if ((size_t)c->len >= max)
         return 0;
-    s[pos] = '\0';
-    return pos;
+    sf_copy(s, c->out, (size_t)c->len + 1);
+    return (size_t)c->len;
 }
 
+/*
+ * Compile a strftime format for repeated use with vlibc_strftime_exec().
+ * Returns NULL with errno set when the format is NULL or memory is
+ * exhausted.
+ */
+vlibc_strftime_fmt *vlibc_strftime_compile(const char *format)
+{
+    if (!format) {
+        errno = EINVAL;
+        return NULL;
+    }
+    struct sf_build b = { .maxops = 0x7fffffff, .maxlit = (size_t)-1 };
+    sf_compile(&b, format);
+
+    size_t size = sizeof(struct vlibc_strftime_fmt) +
+                  (size_t)b.nops * sizeof(struct sf_op) + b.nlit;
+    vlibc_strftime_fmt *f = malloc(size);
+    if (!f)
+        return NULL;
+    f->ops = (struct sf_op *)(f + 1);
+    f->lit = (char *)(f->ops + b.nops);
+    b = (struct sf_build){ .ops = f->ops, .maxops = b.nops,
+                           .lit = f->lit, .maxlit = b.nlit };
+    sf_compile(&b, format);
+    f->nops = b.nops;
+    f->deps = b.deps;
+    f->id = __atomic_add_fetch(&sf_next_id, 1, __ATOMIC_RELAXED);
+    return f;
+}
+
+/* Format tm with a program from vlibc_strftime_compile(). */
+size_t vlibc_strftime_exec(char *s, size_t max, const vlibc_strftime_fmt *f,
+                           const struct tm *tm)
+{
+    if (!s || !f || !tm || max == 0)
+        return 0;
+    return sf_exec(s, max, f, tm);
+}
+
+void vlibc_strftime_free(vlibc_strftime_fmt *f)
+{
+    free(f);
+}
+
+/* the last format given to strftime(), compiled in place */
+#define SF_LOCAL_FMT 128
+
+struct sf_local {
+    vlibc_strftime_fmt prog;
+    size_t len;
+    char fmt[SF_LOCAL_FMT];
+    struct sf_op ops[SF_CACHE_OPS];
+    char lit[SF_LOCAL_FMT];
+};
+
+static __thread struct sf_local sf_local;
+
+size_t strftime(char *s, size_t max, const char *format, const struct tm *tm)
+{
+    if (!s || !format || !tm || max == 0)
+        return 0;
+
+    struct sf_local *l = &sf_local;
+    if (!l->prog.id || !fmt_equal(l->fmt, l->len, format)) {
+        size_t flen = strlen(format);
+        struct sf_build b = { .ops = l->ops, .maxops = SF_CACHE_OPS,
+                              .lit = l->lit, .maxlit = sizeof(l->lit) };
+        l->prog.id = 0;
+        if (flen < sizeof(l->fmt))
+            sf_compile(&b, format);
+        if (flen >= sizeof(l->fmt) || b.nops > b.maxops ||
+            b.nlit > b.maxlit) {
+            /* too large for the per-thread slot */
+            vlibc_strftime_fmt *f = vlibc_strftime_compile(format);
+            if (!f)
+                return 0;
+            size_t n = sf_exec(s, max, f, tm);
+            vlibc_strftime_free(f);
+            return n;
+        }
+        memset(l->fmt, 0, sizeof(l->fmt));
+        memcpy(l->fmt, format, flen);
+        l->len = flen;
+        l->prog.ops = l->ops;
+        l->prog.lit = l->lit;
+        l->prog.nops = b.nops;
+        l->prog.deps = b.deps;
+        l->prog.id = __atomic_add_fetch(&sf_next_id, 1, __ATOMIC_RELAXED);
+    }
+    return sf_exec(s, max, &l->prog, tm);
+}
@@ -8,12 +8,36 @@
 
 #include "string.h"
 #include "ctype.h"
+#include <stdint.h>
 
-/* Locate first occurrence of byte c in the first n bytes of s */
+/* word type allowed to alias the byte buffers scanned by memchr() */
+typedef size_t __attribute__((__may_alias__)) scan_word;
+
+/*
+ * Locate first occurrence of byte c in the first n bytes of s. Aligned
+ * words are tested eight bytes at a time with the usual "has zero byte"
+ * bit trick after XORing in the repeated search byte.
+ */
 void *memchr(const void *s, int c, size_t n)
 {
     const unsigned char *p = s;
     unsigned char ch = (unsigned char)c;
+    while (n && ((uintptr_t)p & (sizeof(size_t) - 1))) {
+        if (*p == ch)
+            return (void *)p;
+        p++;
+        n--;
+    }
+    const size_t ones = (size_t)-1 / 0xff;
+    const size_t highs = ones << 7;
+    const size_t rep = ones * ch;
+    while (n >= sizeof(size_t)) {
+        size_t w = *(const scan_word *)(const void *)p ^ rep;
+        if ((w - ones) & ~w & highs)
+            break;
+        p += sizeof(size_t);
+        n -= sizeof(size_t);
+    }
     while (n--) {
         if (*p == ch)
             return (void *)p;
@@ -34,7 +58,11 @@ void *memrchr(const void *s, int c, size_t n)
     return NULL;
 }
 
-/* Search haystack for the first occurrence of needle */
+/*
+ * Search haystack for the first occurrence of needle. Candidates are
+ * found with memchr() on the needle's first byte and confirmed by also
+ * checking its last byte before comparing the rest.
+ */
 void *memmem(const void *haystack, size_t haystacklen,
              const void *needle, size_t needlelen)
 {
@@ -44,10 +72,15 @@ void *memmem(const void *haystack, size_t haystacklen,
         return NULL;
     const unsigned char *h = haystack;
     const unsigned char *n = needle;
-    size_t end = haystacklen - needlelen + 1;
-    for (size_t i = 0; i < end; i++) {
-        if (h[i] == n[0] && memcmp(h + i, n, needlelen) == 0)
-            return (void *)(h + i);
+    const unsigned char *last = h + (haystacklen - needlelen);
+    unsigned char tail = n[needlelen - 1];
+    while (h <= last) {
+        h = memchr(h, n[0], (size_t)(last - h) + 1);
+        if (!h)
+            return NULL;
+        if (h[needlelen - 1] == tail && memcmp(h, n, needlelen) == 0)
+            return (void *)h;
+        h++;
     }
     return NULL;
 }
@@ -11,7 +11,13 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 #include "errno.h"
+#include "syscall.h"
 
+/*
+ * Generic entry point for callers that do not know the argument count.
+ * All six argument registers are loaded; wrappers on hot paths use the
+ * fixed-arity helpers from syscall.h instead.
+ */
 long vlibc_syscall(long number, ...)
 {
     va_list ap;
@@ -24,14 +30,18 @@ long vlibc_syscall(long number, ...)
     unsigned long a6 = va_arg(ap, unsigned long);
     va_end(ap);
 
-    register long r10 __asm__("r10") = (long)a4;
-    register long r8  __asm__("r8")  = (long)a5;
-    register long r9  __asm__("r9")  = (long)a6;
-    long ret;
-    __asm__ volatile ("syscall"
-                      : "=a" (ret)
-                      : "a" (number), "D" (a1), "S" (a2), "d" (a3),
-                        "r" (r10), "r" (r8), "r" (r9)
-                      : "rcx", "r11", "memory");
+#ifdef VLIBC_INLINE_SYSCALL
+    return vlibc_syscall6(number, (long)a1, (long)a2, (long)a3, (long)a4,
+                          (long)a5, (long)a6);
+#else
+    /*
+     * Without inline helpers vlibc_syscall6() expands back to this
+     * function, so go through the host syscall() and turn its -1/errno
+     * result into the raw negative error code.
+     */
+    long ret = syscall(number, a1, a2, a3, a4, a5, a6);
+    if (ret == -1)
+        return -errno;
     return ret;
+#endif
 }
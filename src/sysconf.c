@@ -8,6 +8,14 @@
 
 #include "unistd.h"
 #include "errno.h"
+#include <sys/syscall.h>
+#include "syscall.h"
+#include "io.h"
+#include "stdlib.h"
+#include <fcntl.h>
+#ifdef __linux__
+#include <elf.h>
+#endif
 
 /*
  * On most platforms the system provides a sysconf() implementation.
@@ -16,6 +24,27 @@
 extern long host_sysconf(int name) __asm("sysconf");
 extern int host_getpagesize(void) __asm("getpagesize");
 
+#ifdef __linux__
+extern unsigned long __vlibc_auxval(unsigned long type);
+
+/*
+ * aux_page_size() - AT_PAGESZ from the aux vector. The sysconf symbol
+ * above resolves to vlibc's own sysconf(), which asks getpagesize(), so
+ * the kernel has to be consulted directly.
+ */
+static long aux_page_size(void)
+{
+    static long cached;
+    long sz = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+    if (sz > 0)
+        return sz;
+    sz = (long)__vlibc_auxval(AT_PAGESZ);
+    if (sz > 0)
+        __atomic_store_n(&cached, sz, __ATOMIC_RELAXED);
+    return sz;
+}
+#endif
+
 int getpagesize(void)
 {
 #ifdef PAGE_SIZE
@@ -23,12 +52,8 @@ int getpagesize(void)
 #elif defined(PAGESIZE)
     return PAGESIZE;
 #else
-# if defined(_SC_PAGESIZE)
-    long r = host_sysconf(_SC_PAGESIZE);
-    if (r > 0)
-        return (int)r;
-# elif defined(_SC_PAGE_SIZE)
-    long r = host_sysconf(_SC_PAGE_SIZE);
+# ifdef __linux__
+    long r = aux_page_size();
     if (r > 0)
         return (int)r;
 # endif
@@ -37,6 +62,112 @@ int getpagesize(void)
 #endif
 }
 
+#ifdef __linux__
+/*
+ * cpu_list_count() - count the CPUs in a sysfs list such as
+ * "0-3,8,10-11". Returns -1 when the file cannot be read.
+ */
+static long cpu_list_count(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    char buf[4096];
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -1;
+    buf[len] = '\0';
+
+    long n = 0;
+    const char *p = buf;
+    while (*p >= '0' && *p <= '9') {
+        long lo = 0, hi;
+        while (*p >= '0' && *p <= '9')
+            lo = lo * 10 + (*p++ - '0');
+        hi = lo;
+        if (*p == '-') {
+            hi = 0;
+            p++;
+            while (*p >= '0' && *p <= '9')
+                hi = hi * 10 + (*p++ - '0');
+        }
+        if (hi >= lo)
+            n += hi - lo + 1;
+        if (*p == ',')
+            p++;
+    }
+    return n > 0 ? n : -1;
+}
+#endif
+
+/*
+ * online_cpus() - count the CPUs the kernel has online, from the sysfs
+ * list. -1 means the count is unknown.
+ */
+static long online_cpus(void)
+{
+#ifdef __linux__
+    return cpu_list_count("/sys/devices/system/cpu/online");
+#else
+    return -1;
+#endif
+}
+
+/*
+ * __vlibc_usable_cpus() - count the CPUs this process may run on, for
+ * sizing worker pools. Linux reports them through the sched_getaffinity
+ * mask, which is grown until the kernel accepts its size; the online
+ * count is used when that fails.
+ */
+long __vlibc_usable_cpus(void)
+{
+#ifdef SYS_sched_getaffinity
+    unsigned long small[16];
+    unsigned long *mask = small;
+    size_t size = sizeof(small);
+    long ret;
+    for (;;) {
+        ret = vlibc_syscall(SYS_sched_getaffinity, 0, size, (long)mask,
+                            0, 0, 0);
+        if (ret != -EINVAL || size >= ((size_t)1 << 20))
+            break;
+        size *= 2;
+        unsigned long *bigger = mask == small ? malloc(size)
+                                              : realloc(mask, size);
+        if (!bigger)
+            break;
+        mask = bigger;
+    }
+    long n = 0;
+    if (ret > 0) {
+        for (size_t i = 0; i < (size_t)ret / sizeof(mask[0]); i++)
+            n += __builtin_popcountl(mask[i]);
+    }
+    if (mask != small)
+        free(mask);
+    if (n > 0)
+        return n;
+#endif
+    return online_cpus();
+}
+
+/*
+ * configured_cpus() - count the CPUs the system is configured with,
+ * whether or not they are online or usable by this process.
+ */
+static long configured_cpus(void)
+{
+#ifdef __linux__
+    long n = cpu_list_count("/sys/devices/system/cpu/possible");
+    if (n <= 0)
+        n = cpu_list_count("/sys/devices/system/cpu/present");
+    if (n > 0)
+        return n;
+#endif
+    return online_cpus();
+}
+
 long sysconf(int name)
 {
     switch (name) {
@@ -53,11 +184,11 @@ long sysconf(int name)
 #endif
 #ifdef _SC_NPROCESSORS_ONLN
     case _SC_NPROCESSORS_ONLN:
-        return host_sysconf(name);
+        return online_cpus();
 #endif
 #ifdef _SC_NPROCESSORS_CONF
     case _SC_NPROCESSORS_CONF:
-        return host_sysconf(name);
+        return configured_cpus();
 #endif
 #ifdef _SC_CLK_TCK
     case _SC_CLK_TCK:
@@ -9,19 +9,428 @@
 #include "syslog.h"
 #include "string.h"
 #include "stdio.h"
+#include "stdlib.h"
 #include "process.h"
+#include "pthread.h"
+#include "sched.h"
+#include "signal.h"
 #include "io.h"
 #include "errno.h"
+#include "futex.h"
 #include "sys/socket.h"
+#include "sys/uio.h"
 #include <fcntl.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
+extern unsigned long __vlibc_fork_gen;
+
+/* messages up to LOG_STACK bytes are formatted without allocating */
+#define LOG_STACK 1024
+/* longest record sent; longer messages are truncated */
+#define LOG_MAX   65536
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
 static int log_fd = -1;
+static int log_stream;
 static int log_facility = LOG_USER;
 static int log_option = 0;
 static char log_ident[32] = "";
+static char log_path[sizeof(((struct sockaddr_un *)0)->sun_path)] =
+    "/dev/log";
+
+/* "ident[pid]: " prepared by openlog() and refreshed after fork() */
+static char log_tag[sizeof(log_ident) + 16];
+static size_t log_taglen;
+static unsigned long log_gen;
+
+static struct vlibc_syslog_stats log_stats;
+
+/*
+ * Open a socket to log_path. syslogd normally listens on a datagram
+ * socket; when it only accepts streams, records are sent NUL terminated
+ * over a stream connection instead.
+ */
+static int log_connect(int *stream)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strlcpy(addr.sun_path, log_path, sizeof(addr.sun_path));
+
+    int types[2] = { SOCK_DGRAM, SOCK_STREAM };
+    for (int i = 0; i < 2; i++) {
+        int type = types[i];
+#ifdef SOCK_CLOEXEC
+        type |= SOCK_CLOEXEC;
+#endif
+        int fd = socket(AF_UNIX, type, 0);
+        if (fd < 0)
+            return -1;
+#ifndef SOCK_CLOEXEC
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 ||
+            (i == 0 && errno != EPROTOTYPE)) {
+            /* an unconnected datagram socket still reports send errors */
+            *stream = i;
+            return fd;
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+static void tag_build(void)
+{
+    size_t n = 0;
+    if (log_ident[0]) {
+        n = strlcpy(log_tag, log_ident, sizeof(log_tag));
+        if (log_option & LOG_PID)
+            n += (size_t)snprintf(log_tag + n, sizeof(log_tag) - n, "[%d]",
+                                  (int)getpid());
+        n += strlcpy(log_tag + n, ": ", sizeof(log_tag) - n);
+    }
+    log_tag[n] = '\0';
+    log_taglen = n;
+    log_gen = __vlibc_fork_gen;
+}
+
+/*
+ * Format "<pri>tag message" into buf. Returns the full length, which
+ * may exceed size like vsnprintf(), or -1 on a formatting error.
+ */
+static int log_format(char *buf, size_t size, int priority, const char *format,
+                      va_list ap)
+{
+    char pri[16];
+    int p = priority | log_facility, n = 0;
+    char digits[12];
+    int nd = 0;
+    do {
+        digits[nd++] = (char)('0' + p % 10);
+        p /= 10;
+    } while (p > 0 && nd < (int)sizeof(digits));
+    pri[n++] = '<';
+    while (nd)
+        pri[n++] = digits[--nd];
+    pri[n++] = '>';
+
+    size_t head = (size_t)n + log_taglen;
+    if (head >= size)
+        return -1;
+    memcpy(buf, pri, (size_t)n);
+    memcpy(buf + n, log_tag, log_taglen);
+    int len = vsnprintf(buf + head, size - head, format, ap);
+    if (len < 0)
+        return -1;
+    return (int)head + len;
+}
+
+/* Send one record on the synchronous connection. */
+static int log_send(const char *buf, size_t len)
+{
+    if (log_fd == -1)
+        return -1;
+    /* stream framing includes the terminating NUL */
+    ssize_t r = send(log_fd, buf, len + (size_t)log_stream, 0);
+    __atomic_add_fetch(r < 0 ? &log_stats.failed : &log_stats.sent, 1,
+                       __ATOMIC_RELAXED);
+    return r < 0 ? -1 : 0;
+}
+
+/*
+ * Asynchronous mode. Producers reserve space in a byte ring by moving
+ * head with a compare-and-swap, copy their record in and publish it by
+ * storing its position in the record header. A single sender thread
+ * walks the ring from tail, hands batches of published records to
+ * sendmmsg() or writev() and then releases the space by moving tail.
+ * A record that would wrap is preceded by a filler up to the ring end.
+ */
+struct log_rec {
+    uint64_t seq;          /* position + 1 once published */
+    uint32_t len;          /* message bytes excluding the NUL */
+    uint32_t fill;         /* nonzero for padding up to the ring end */
+};
+
+#define REC_ALIGN 16
+#define LOG_BATCH 32
+#define RING_DEFAULT (256 * 1024)
+
+static struct {
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+    atomic_int wake;       /* bumped to rouse a sleeping sender */
+    atomic_int sleeping;
+    atomic_int progress;   /* bumped each time tail moves */
+    atomic_int waiters;    /* producers and flushers waiting on progress */
+    atomic_int users;      /* producers inside the ring */
+    int running;
+    int stop;
+    int policy;
+    char *buf;
+    size_t cap;
+    int fd;
+    int stream;
+    pthread_t thread;
+} ring;
+
+static size_t rec_size(size_t len)
+{
+    return (sizeof(struct log_rec) + len + 1 + REC_ALIGN - 1) &
+           ~(size_t)(REC_ALIGN - 1);
+}
+
+static void wake_sender(void)
+{
+    if (atomic_load(&ring.sleeping)) {
+        atomic_fetch_add(&ring.wake, 1);
+        futex_wake(&ring.wake, 1);
+    }
+}
+
+/* Reserve space for a record of need bytes; -1 when the ring is full. */
+static int ring_reserve(size_t need, uint64_t *pos, size_t *fill)
+{
+    uint64_t head = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+    for (;;) {
+        size_t off = (size_t)head & (ring.cap - 1);
+        size_t pad = off + need > ring.cap ? ring.cap - off : 0;
+        uint64_t tail = __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
+        if (head + pad + need - tail > ring.cap)
+            return -1;
+        if (__atomic_compare_exchange_n(&ring.head, &head, head + pad + need,
+                                        1, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED)) {
+            *pos = head;
+            *fill = pad;
+            return 0;
+        }
+    }
+}
+
+static void ring_publish(uint64_t pos, const char *msg, size_t len,
+                         uint32_t fill)
+{
+    struct log_rec *r =
+        (struct log_rec *)(ring.buf + ((size_t)pos & (ring.cap - 1)));
+    r->len = (uint32_t)len;
+    r->fill = fill;
+    if (!fill) {
+        memcpy(r + 1, msg, len);
+        ((char *)(r + 1))[len] = '\0';
+    }
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/* Wait until progress moves past the value seen before a failed check. */
+static void wait_progress(int seen)
+{
+    atomic_fetch_add(&ring.waiters, 1);
+    if (atomic_load(&ring.progress) == seen)
+        futex_wait(&ring.progress, seen, NULL);
+    atomic_fetch_sub(&ring.waiters, 1);
+}
+
+/*
+ * Queue one formatted record. Returns 0, -1 when the ring is full or -2
+ * when the record is too large for it.
+ */
+static int ring_put(const char *msg, size_t len)
+{
+    size_t need = rec_size(len);
+    if (need > ring.cap / 4)
+        return -2;
+    uint64_t pos;
+    size_t fill;
+    for (;;) {
+        int seen = atomic_load(&ring.progress);
+        if (ring_reserve(need, &pos, &fill) == 0)
+            break;
+        if (ring.policy != VLIBC_SYSLOG_BLOCK)
+            return -1;
+        wake_sender();
+        wait_progress(seen);
+    }
+    if (fill) {
+        ring_publish(pos, NULL, 0, 1);
+        pos += fill;
+    }
+    ring_publish(pos, msg, len, 0);
+    __atomic_add_fetch(&log_stats.queued, 1, __ATOMIC_RELAXED);
+    wake_sender();
+    return 0;
+}
+
+/* Send a batch on the sender's connection; returns records consumed. */
+static unsigned send_batch(struct iovec *iov, unsigned n)
+{
+    if (ring.fd == -1) {
+        ring.fd = log_connect(&ring.stream);
+        if (ring.fd == -1) {
+            __atomic_add_fetch(&log_stats.failed, n, __ATOMIC_RELAXED);
+            return n;
+        }
+    }
+    if (ring.stream) {
+        /* records keep their NUL as the stream delimiter */
+        for (unsigned i = 0; i < n; i++)
+            iov[i].iov_len++;
+        unsigned done = 0;
+        while (done < n) {
+            ssize_t w = writev(ring.fd, iov + done, (int)(n - done));
+            if (w < 0) {
+                if (errno == EINTR)
+                    continue;
+                close(ring.fd);
+                ring.fd = -1;
+                __atomic_add_fetch(&log_stats.failed, n - done,
+                                   __ATOMIC_RELAXED);
+                return n;
+            }
+            while (done < n && (size_t)w >= iov[done].iov_len) {
+                w -= (ssize_t)iov[done].iov_len;
+                done++;
+                __atomic_add_fetch(&log_stats.sent, 1, __ATOMIC_RELAXED);
+            }
+            if (done < n) {
+                iov[done].iov_base = (char *)iov[done].iov_base + w;
+                iov[done].iov_len -= (size_t)w;
+            }
+        }
+        return n;
+    }
+
+    struct mmsghdr mv[LOG_BATCH];
+    memset(mv, 0, sizeof(struct mmsghdr) * n);
+    for (unsigned i = 0; i < n; i++) {
+        mv[i].msg_hdr.msg_iov = &iov[i];
+        mv[i].msg_hdr.msg_iovlen = 1;
+    }
+    int r = sendmmsg(ring.fd, mv, n, 0);
+    if (r > 0) {
+        __atomic_add_fetch(&log_stats.sent, (unsigned)r, __ATOMIC_RELAXED);
+        return (unsigned)r;
+    }
+    if (r < 0 && errno == EINTR)
+        return 0;
+    /* the first record failed: drop it and reconnect for the rest */
+    __atomic_add_fetch(&log_stats.failed, 1, __ATOMIC_RELAXED);
+    if (r < 0 && errno != EMSGSIZE && errno != ENOBUFS) {
+        close(ring.fd);
+        ring.fd = -1;
+    }
+    return 1;
+}
+
+/* Send what is published from tail on. Returns the records consumed. */
+static unsigned ring_drain(void)
+{
+    uint64_t tail = ring.tail;
+    uint64_t ends[LOG_BATCH];
+    struct iovec iov[LOG_BATCH];
+    unsigned n = 0;
+    while (n < LOG_BATCH) {
+        struct log_rec *r =
+            (struct log_rec *)(ring.buf + ((size_t)tail & (ring.cap - 1)));
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != tail + 1)
+            break;
+        if (r->fill) {
+            tail += ring.cap - ((size_t)tail & (ring.cap - 1));
+            if (n == 0) {
+                __atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+                continue;
+            }
+            ends[n - 1] = tail;
+            continue;
+        }
+        iov[n].iov_base = r + 1;
+        iov[n].iov_len = r->len;
+        tail += rec_size(r->len);
+        ends[n++] = tail;
+    }
+    if (n == 0)
+        return 0;
+
+    unsigned done = 0;
+    while (done < n) {
+        unsigned k = send_batch(iov + done, n - done);
+        if (k == 0)
+            continue;
+        done += k;
+        __atomic_store_n(&ring.tail, ends[done - 1], __ATOMIC_RELEASE);
+        atomic_fetch_add(&ring.progress, 1);
+        if (atomic_load(&ring.waiters))
+            futex_wake(&ring.progress, 0x7fffffff);
+    }
+    return n;
+}
+
+static void *sender_main(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        if (ring_drain())
+            continue;
+        uint64_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+        if (head != ring.tail) {
+            /* reserved but not yet published */
+            sched_yield();
+            continue;
+        }
+        if (__atomic_load_n(&ring.stop, __ATOMIC_ACQUIRE))
+            break;
+        int seen = atomic_load(&ring.wake);
+        atomic_store(&ring.sleeping, 1);
+        if (__atomic_load_n(&ring.head, __ATOMIC_SEQ_CST) == ring.tail &&
+            !__atomic_load_n(&ring.stop, __ATOMIC_ACQUIRE))
+            futex_wait(&ring.wake, seen, NULL);
+        atomic_store(&ring.sleeping, 0);
+    }
+    return NULL;
+}
+
+/* Stop the sender after it has sent everything queued. log_lock held. */
+static void async_stop(void)
+{
+    if (!ring.running)
+        return;
+    __atomic_store_n(&ring.running, 0, __ATOMIC_SEQ_CST);
+    while (atomic_load(&ring.users))
+        sched_yield();
+    __atomic_store_n(&ring.stop, 1, __ATOMIC_RELEASE);
+    atomic_fetch_add(&ring.wake, 1);
+    futex_wake(&ring.wake, 1);
+    pthread_join(ring.thread, NULL);
+    if (ring.fd != -1)
+        close(ring.fd);
+    free(ring.buf);
+    ring.buf = NULL;
+}
+
+/*
+ * A forked child has the ring but not the sender thread, so it goes
+ * back to sending synchronously and refreshes the cached pid. The
+ * child starts with a single thread, which may have been forked while
+ * another one held log_lock.
+ */
+static void fork_check(void)
+{
+    if (log_gen == __vlibc_fork_gen)
+        return;
+    log_lock = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+    if (ring.running) {
+        if (ring.fd != -1)
+            close(ring.fd);
+        ring.running = 0;
+        ring.buf = NULL;
+        atomic_store(&ring.users, 0);
+    }
+    tag_build();
+}
 
 /*
  * openlog() - configure the connection to the system logger. The
@@ -29,6 +438,7 @@ static char log_ident[32] = "";
  */
 void openlog(const char *ident, int option, int facility)
 {
+    pthread_mutex_lock(&log_lock);
     if (ident)
         strlcpy(log_ident, ident, sizeof(log_ident));
     else
@@ -36,79 +446,197 @@ void openlog(const char *ident, int option, int facility)
 
     log_option = option;
     log_facility = facility;
+    tag_build();
 
     if (log_fd != -1) {
         close(log_fd);
         log_fd = -1;
     }
-
-    int type = SOCK_DGRAM;
-#ifdef SOCK_CLOEXEC
-    type |= SOCK_CLOEXEC;
-#endif
-    log_fd = socket(AF_UNIX, type, 0);
-    if (log_fd < 0)
-        return;
-#ifndef SOCK_CLOEXEC
-    fcntl(log_fd, F_SETFD, FD_CLOEXEC);
-#endif
-
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strlcpy(addr.sun_path, "/dev/log", sizeof(addr.sun_path));
-    connect(log_fd, (struct sockaddr *)&addr, sizeof(addr));
+    log_fd = log_connect(&log_stream);
+    pthread_mutex_unlock(&log_lock);
 }
 
 /*
  * closelog() - close the connection to the system log daemon if it
- * has been opened via openlog().
+ * has been opened via openlog(). In asynchronous mode the queued
+ * messages are sent first and the sender thread exits.
  */
 void closelog(void)
 {
+    pthread_mutex_lock(&log_lock);
+    async_stop();
     if (log_fd != -1) {
         close(log_fd);
         log_fd = -1;
     }
+    pthread_mutex_unlock(&log_lock);
+}
+
+/*
+ * vlibc_syslog_async() - send later messages from a background thread.
+ * The settings may be NULL for a 256 KiB ring that drops messages
+ * when full.
+ */
+int vlibc_syslog_async(const struct vlibc_syslog_config *cfg)
+{
+    size_t size = cfg && cfg->ring_size ? cfg->ring_size : RING_DEFAULT;
+    int policy = cfg ? cfg->policy : VLIBC_SYSLOG_DROP;
+    if (policy != VLIBC_SYSLOG_DROP && policy != VLIBC_SYSLOG_BLOCK &&
+        policy != VLIBC_SYSLOG_SYNC) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (cfg && cfg->path && strlen(cfg->path) >= sizeof(log_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    size_t cap = 4096;
+    while (cap < size && cap < ((size_t)1 << 30))
+        cap <<= 1;
+
+    fork_check();
+    pthread_mutex_lock(&log_lock);
+    if (ring.running) {
+        pthread_mutex_unlock(&log_lock);
+        errno = EBUSY;
+        return -1;
+    }
+    if (cfg && cfg->path) {
+        strlcpy(log_path, cfg->path, sizeof(log_path));
+        if (log_fd != -1) {
+            close(log_fd);
+            log_fd = log_connect(&log_stream);
+        }
+    }
+    if (log_gen != __vlibc_fork_gen || !log_taglen)
+        tag_build();
+    ring.buf = calloc(1, cap);
+    if (!ring.buf) {
+        pthread_mutex_unlock(&log_lock);
+        return -1;
+    }
+    ring.cap = cap;
+    ring.head = ring.tail = 0;
+    ring.policy = policy;
+    ring.stop = 0;
+    ring.fd = log_connect(&ring.stream);
+
+    /* the sender must not run the application's signal handlers */
+    sigset_t all, old;
+    sigfillset(&all);
+    sigprocmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&ring.thread, NULL, sender_main, NULL);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    if (err) {
+        if (ring.fd != -1)
+            close(ring.fd);
+        free(ring.buf);
+        ring.buf = NULL;
+        pthread_mutex_unlock(&log_lock);
+        errno = err;
+        return -1;
+    }
+    __atomic_store_n(&ring.running, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&log_lock);
+    return 0;
+}
+
+/*
+ * vlibc_syslog_flush() - wait until every message queued before the
+ * call has been handed to the socket.
+ */
+int vlibc_syslog_flush(void)
+{
+    atomic_fetch_add(&ring.users, 1);
+    if (!__atomic_load_n(&ring.running, __ATOMIC_SEQ_CST)) {
+        atomic_fetch_sub(&ring.users, 1);
+        return 0;
+    }
+    uint64_t target = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        int seen = atomic_load(&ring.progress);
+        if ((int64_t)(__atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) -
+                      target) >= 0)
+            break;
+        wake_sender();
+        wait_progress(seen);
+    }
+    atomic_fetch_sub(&ring.users, 1);
+    return 0;
+}
+
+/* vlibc_syslog_stats() - copy the message counters. */
+void vlibc_syslog_stats(struct vlibc_syslog_stats *st)
+{
+    if (!st)
+        return;
+    st->queued = __atomic_load_n(&log_stats.queued, __ATOMIC_RELAXED);
+    st->sent = __atomic_load_n(&log_stats.sent, __ATOMIC_RELAXED);
+    st->dropped = __atomic_load_n(&log_stats.dropped, __ATOMIC_RELAXED);
+    st->failed = __atomic_load_n(&log_stats.failed, __ATOMIC_RELAXED);
+    st->truncated = __atomic_load_n(&log_stats.truncated, __ATOMIC_RELAXED);
 }
 
 /*
  * vsyslog() - format a message using a va_list and send it to the
- * system logger with the given priority.
+ * system logger with the given priority. Messages longer than the
+ * stack buffer are formatted into the heap, up to LOG_MAX bytes.
  */
 void vsyslog(int priority, const char *format, va_list ap)
 {
-    if (log_fd == -1)
+    fork_check();
+    if (log_fd == -1 && !__atomic_load_n(&ring.running, __ATOMIC_ACQUIRE))
         openlog(NULL, 0, LOG_USER);
 
-    char msg[256];
+    char stack[LOG_STACK];
+    char *buf = stack;
     va_list aq;
     va_copy(aq, ap);
-    int len = vsnprintf(msg, sizeof(msg), format, aq);
+    int len = log_format(stack, sizeof(stack), priority, format, aq);
     va_end(aq);
     if (len < 0)
         return;
-    if (len >= (int)sizeof(msg))
-        len = sizeof(msg) - 1;
-
-    char buf[300];
-    int n = snprintf(buf, sizeof(buf), "<%d>", priority | log_facility);
-    if (log_ident[0]) {
-        n += snprintf(buf + n, sizeof(buf) - n, "%s", log_ident);
-        if (log_option & LOG_PID)
-            n += snprintf(buf + n, sizeof(buf) - n, "[%d]", getpid());
-        n += snprintf(buf + n, sizeof(buf) - n, ": ");
+    if (len >= (int)sizeof(stack)) {
+        size_t size = sizeof(stack);
+        char *big = malloc(len < LOG_MAX ? (size_t)len + 1 : LOG_MAX);
+        if (big) {
+            buf = big;
+            size = len < LOG_MAX ? (size_t)len + 1 : LOG_MAX;
+            va_copy(aq, ap);
+            log_format(buf, size, priority, format, aq);
+            va_end(aq);
+        }
+        if ((size_t)len >= size) {
+            len = (int)size - 1;
+            __atomic_add_fetch(&log_stats.truncated, 1, __ATOMIC_RELAXED);
+        }
     }
-    if ((size_t)(n + len) >= sizeof(buf))
-        len = sizeof(buf) - n - 1;
-    memcpy(buf + n, msg, len);
-    n += len;
 
-    if (log_fd != -1) {
-        ssize_t r = send(log_fd, buf, n, 0);
-        if (r < 0)
+    atomic_fetch_add(&ring.users, 1);
+    if (__atomic_load_n(&ring.running, __ATOMIC_SEQ_CST)) {
+        int r = ring_put(buf, (size_t)len);
+        int policy = ring.policy;
+        atomic_fetch_sub(&ring.users, 1);
+        if (r == 0 || (r == -1 && policy == VLIBC_SYSLOG_DROP)) {
+            if (r)
+                __atomic_add_fetch(&log_stats.dropped, 1, __ATOMIC_RELAXED);
+            if (buf != stack)
+                free(buf);
+            return;
+        }
+        /* full under VLIBC_SYSLOG_SYNC, or too large for the ring */
+        pthread_mutex_lock(&log_lock);
+        if (log_fd == -1)
+            log_fd = log_connect(&log_stream);
+        log_send(buf, (size_t)len);
+        pthread_mutex_unlock(&log_lock);
+    } else {
+        atomic_fetch_sub(&ring.users, 1);
+        if (log_send(buf, (size_t)len) < 0)
             perror("vsyslog");
     }
+    if (buf != stack)
+        free(buf);
 }
 
 /*
@@ -14,59 +14,71 @@
 #include "vlibc.h"
 
 /*
- * system() - execute a shell command by forking and running the user's
- * preferred shell via execve(). The parent waits with waitpid() and
- * returns the child's exit status. On fork or waitpid failure -1 is
- * returned.
+ * system() - execute a shell command with the user's preferred shell and
+ * return its wait status. The child is created with posix_spawn(). As
+ * POSIX requires, SIGINT and SIGQUIT are ignored and SIGCHLD is blocked
+ * in the caller while the command runs, and the child starts with the
+ * caller's original dispositions and mask. Returns -1 when no child
+ * could be created and the status of a shell exiting with 127, with
+ * errno set, when the shell could not be executed.
  */
 int system(const char *command)
 {
     if (!command)
         return 1;
 
-    int errpipe[2];
-    if (pipe(errpipe) < 0)
-        return -1;
-    fcntl(errpipe[0], F_SETFD, FD_CLOEXEC);
-    fcntl(errpipe[1], F_SETFD, FD_CLOEXEC);
+    struct sigaction ign, oint, oquit;
+    memset(&ign, 0, sizeof(ign));
+    ign.sa_handler = SIG_IGN;
+    sigemptyset(&ign.sa_mask);
+    sigaction(SIGINT, &ign, &oint);
+    sigaction(SIGQUIT, &ign, &oquit);
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        int err = errno;
-        close(errpipe[0]);
-        close(errpipe[1]);
-        errno = err;
-        return -1;
-    }
-    if (pid == 0) {
-        close(errpipe[0]);
-        const char *shell = vlibc_default_shell();
-        char *argv[] = {(char *)shell, "-c", (char *)command, NULL};
-        extern char **environ;
-        execve(shell, argv, environ);
-        int err = errno;
-        ssize_t w = write(errpipe[1], &err, sizeof(err));
-        if (w < (ssize_t)sizeof(err))
-            _exit(127);
-        _exit(127);
-    }
+    sigset_t block, omask;
+    sigemptyset(&block);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, &omask);
 
-    close(errpipe[1]);
-    int child_err = 0;
-    ssize_t n = read(errpipe[0], &child_err, sizeof(child_err));
-    close(errpipe[0]);
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &omask);
+    sigset_t def;
+    sigemptyset(&def);
+    if (oint.sa_handler != SIG_IGN)
+        sigaddset(&def, SIGINT);
+    if (oquit.sa_handler != SIG_IGN)
+        sigaddset(&def, SIGQUIT);
+    attr.sigdefault = def;
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+                                    POSIX_SPAWN_SETSIGDEF);
 
-    int status = 0;
-    pid_t r;
-    do {
-        r = waitpid(pid, &status, 0);
-    } while (r < 0 && errno == EINTR);
-    if (r < 0)
-        return -1;
+    const char *shell = vlibc_default_shell();
+    char *argv[] = {(char *)shell, "-c", (char *)command, NULL};
+    extern char **environ;
+    pid_t pid;
+    int err = posix_spawn(&pid, shell, NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
 
-    if (n > 0)
-        errno = child_err;
+    int status = 0;
+    if (err == 0) {
+        pid_t r;
+        do {
+            r = waitpid(pid, &status, 0);
+        } while (r < 0 && errno == EINTR);
+        if (r < 0) {
+            err = errno;
+            status = -1;
+        }
+    } else if (err == EAGAIN || err == ENOMEM) {
+        status = -1;
+    } else {
+        status = 127 << 8;      /* as if the shell had exited with 127 */
+    }
 
+    sigaction(SIGINT, &oint, NULL);
+    sigaction(SIGQUIT, &oquit, NULL);
+    sigprocmask(SIG_SETMASK, &omask, NULL);
+    if (err)
+        errno = err;
     return status;
 }
-
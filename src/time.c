@@ -17,6 +17,9 @@ extern int host_gettimeofday(struct timeval *tv, void *tz)
     __asm__("gettimeofday");
 #endif
 
+extern int __vlibc_vdso_time(time_t *out);
+extern int __vlibc_vdso_gettimeofday(struct timeval *tv, void *tz);
+
 #ifdef SYS_clock_gettime
 #ifndef CLOCK_REALTIME
 #define CLOCK_REALTIME 0
@@ -25,14 +28,20 @@ extern int host_gettimeofday(struct timeval *tv, void *tz)
 
 /*
  * Return seconds since the Unix epoch.  The wrapper uses the
- * best available kernel interface: SYS_time, SYS_clock_gettime
- * with CLOCK_REALTIME, or as a last resort the host time()
- * implementation.
+ * best available kernel interface: the vDSO, SYS_time,
+ * SYS_clock_gettime with CLOCK_REALTIME, or as a last resort
+ * the host time() implementation.
  */
 time_t time(time_t *t)
 {
+    time_t now;
+    if (__vlibc_vdso_time(&now) == 0) {
+        if (t)
+            *t = now;
+        return now;
+    }
 #ifdef SYS_time
-    long ret = vlibc_syscall(SYS_time, (long)t, 0, 0, 0, 0, 0);
+    long ret = vlibc_syscall1(SYS_time, (long)t);
     if (ret < 0) {
         errno = -ret;
         return (time_t)-1;
@@ -43,7 +52,7 @@ time_t time(time_t *t)
     return sec;
 #elif defined(SYS_clock_gettime)
     struct timespec ts;
-    long ret = vlibc_syscall(SYS_clock_gettime, CLOCK_REALTIME, (long)&ts, 0, 0, 0, 0);
+    long ret = vlibc_syscall2(SYS_clock_gettime, CLOCK_REALTIME, (long)&ts);
     if (ret < 0) {
         errno = -ret;
         return (time_t)-1;
@@ -58,15 +67,23 @@ time_t time(time_t *t)
 
 /*
  * Fill in a timeval structure with the current time of day.
- * Like time(), this wrapper prefers SYS_time or
+ * Like time(), this wrapper prefers the vDSO, then SYS_time or
  * SYS_clock_gettime when available and otherwise relies on the
  * host gettimeofday().
  */
 int gettimeofday(struct timeval *tv, void *tz)
 {
+    int vret = __vlibc_vdso_gettimeofday(tv, NULL);
+    if (vret != -ENOSYS) {
+        if (vret < 0) {
+            errno = -vret;
+            return -1;
+        }
+        return 0;
+    }
     (void)tz;
 #ifdef SYS_time
-    long ret = vlibc_syscall(SYS_time, 0, 0, 0, 0, 0, 0);
+    long ret = vlibc_syscall1(SYS_time, 0);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -79,7 +96,7 @@ int gettimeofday(struct timeval *tv, void *tz)
     return 0;
 #elif defined(SYS_clock_gettime)
     struct timespec ts;
-    long ret = vlibc_syscall(SYS_clock_gettime, CLOCK_REALTIME, (long)&ts, 0, 0, 0, 0);
+    long ret = vlibc_syscall2(SYS_clock_gettime, CLOCK_REALTIME, (long)&ts);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -102,7 +119,7 @@ int gettimeofday(struct timeval *tv, void *tz)
 unsigned int alarm(unsigned int seconds)
 {
 #ifdef SYS_alarm
-    long ret = vlibc_syscall(SYS_alarm, seconds, 0, 0, 0, 0, 0);
+    long ret = vlibc_syscall1(SYS_alarm, seconds);
     if (ret < 0) {
         errno = -ret;
         return 0;
@@ -8,21 +8,9 @@
 
 #include "time.h"
 #include "stdio.h"
-#include "time.h"  /* for __vlibc_tzoff */
 
-static int is_leap(int year)
-{
-    if ((year % 4) != 0)
-        return 0;
-    if ((year % 100) != 0)
-        return 1;
-    return (year % 400) == 0;
-}
-
-static const int days_per_month[2][12] = {
-    {31,28,31,30,31,30,31,31,30,31,30,31},
-    {31,29,31,30,31,30,31,31,30,31,30,31}
-};
+extern long __vlibc_days_from_civil(long y, int m, int d);
+extern time_t __vlibc_tz_mktime(time_t local, int isdst);
 
 static __thread struct tm tm_buf;
 
@@ -36,65 +24,56 @@ struct tm *gmtime(const time_t *timep)
 }
 
 /*
- * Wrapper around localtime_r() using a thread-local buffer.
- * Timezone handling matches localtime_r.
+ * Wrapper around localtime_r() using a thread-local buffer. Like
+ * mktime() it picks up changes to TZ first.
  */
 struct tm *localtime(const time_t *timep)
 {
+    tzset();
     return localtime_r(timep, &tm_buf);
 }
 
+/* Seconds since the epoch of tm's fields read as UTC, carrying overflow. */
+static time_t tm_seconds(const struct tm *tm)
+{
+    long mon = tm->tm_mon;
+    long year = tm->tm_year + 1900L + mon / 12;
+    mon %= 12;
+    if (mon < 0) {
+        mon += 12;
+        year--;
+    }
+    return (time_t)__vlibc_days_from_civil(year, (int)mon + 1, 1) * 86400 +
+           (time_t)(tm->tm_mday - 1) * 86400 + (time_t)tm->tm_hour * 3600 +
+           (time_t)tm->tm_min * 60 + tm->tm_sec;
+}
+
 /*
- * Convert broken-down local time to seconds since the epoch.
- * Daylight saving time information is ignored. The configured
- * timezone offset is subtracted so the returned time value is
- * in UTC.
+ * Convert broken-down local time to seconds since the epoch. Fields
+ * out of range are carried into the larger ones and tm is rewritten
+ * in normalized form. tm_isdst selects between the two instances of
+ * a repeated hour; pass -1 to let the zone decide.
  */
 time_t mktime(struct tm *tm)
 {
     if (!tm)
         return (time_t)-1;
-
-    int year = tm->tm_year + 1900;
-    time_t days = 0;
-    for (int y = 1970; y < year; y++)
-        days += is_leap(y) ? 366 : 365;
-
-    const int *ml = days_per_month[is_leap(year)];
-    for (int m = 0; m < tm->tm_mon; m++)
-        days += ml[m];
-    days += tm->tm_mday - 1;
-
-    tm->tm_yday = (int)days;
-    tm->tm_wday = (int)((days + 4) % 7);
-    tm->tm_isdst = 0;
-
-    time_t t = days * 86400 + tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec;
-    t -= __vlibc_tzoff;
+    time_t t = __vlibc_tz_mktime(tm_seconds(tm), tm->tm_isdst);
+    if (!localtime_r(&t, tm))
+        return (time_t)-1;
     return t;
 }
 
-/* Non-standard conversion from broken-down UTC to time_t. */
+/*
+ * Non-standard conversion from broken-down UTC to time_t. Like mktime()
+ * it normalizes the fields of tm.
+ */
 time_t timegm(struct tm *tm)
 {
     if (!tm)
         return (time_t)-1;
-
-    int year = tm->tm_year + 1900;
-    time_t days = 0;
-    for (int y = 1970; y < year; y++)
-        days += is_leap(y) ? 366 : 365;
-
-    const int *ml = days_per_month[is_leap(year)];
-    for (int m = 0; m < tm->tm_mon; m++)
-        days += ml[m];
-    days += tm->tm_mday - 1;
-
-    tm->tm_yday = (int)days;
-    tm->tm_wday = (int)((days + 4) % 7);
-    tm->tm_isdst = 0;
-
-    time_t t = days * 86400 + tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec;
+    time_t t = tm_seconds(tm);
+    gmtime_r(&t, tm);
     return t;
 }
 
@@ -7,97 +7,75 @@
  */
 
 #include "time.h"
-#include "env.h"
-#include "stdio.h"
+#include "errno.h"
 
-int __vlibc_tzoff = 0;
+extern long __vlibc_tz_local(time_t t, int check_env, int *isdst,
+                             const char **abbr);
 
-static int parse_offset(const char *s)
+/*
+ * Calendar arithmetic after Howard Hinnant's days_from_civil and
+ * civil_from_days: years are shifted to start on March 1 so the leap
+ * day ends the year, and a 400-year era has a fixed 146097 days. Both
+ * directions are a handful of integer operations for any date.
+ */
+
+/* days since 1970-01-01 of a proleptic Gregorian date; m is 1-12 */
+long __vlibc_days_from_civil(long y, int m, int d)
 {
-    if (!s || !*s)
-        return 0;
-    while (*s && !((*s >= '0' && *s <= '9') || *s == '+' || *s == '-'))
-        s++;
-    int sign = 1;
-    if (*s == '+') {
-        sign = 1;
-        s++;
-    } else if (*s == '-') {
-        sign = -1;
-        s++;
-    }
-    int h = 0, m = 0;
-    while (*s >= '0' && *s <= '9') {
-        h = h * 10 + (*s - '0');
-        s++;
-    }
-    if (*s == ':') {
-        s++;
-        while (*s >= '0' && *s <= '9') {
-            m = m * 10 + (*s - '0');
-            s++;
-            if (m >= 60)
-                break;
-        }
-    } else if (*s && *(s + 1) && (*s >= '0' && *s <= '9')) {
-        m = (*s - '0') * 10 + (*(s + 1) - '0');
-    }
-    return sign * (h * 3600 + m * 60);
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;                            /* [0, 399] */
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;    /* [0, 146096] */
+    return era * 146097 + doe - 719468;
 }
 
-static int is_leap(int year)
+/* date of a day count from 1970-01-01; *m is 1-12 */
+void __vlibc_civil_from_days(long z, long *y, int *m, int *d, int *yday)
 {
-    if ((year % 4) != 0)
-        return 0;
-    if ((year % 100) != 0)
-        return 1;
-    return (year % 400) == 0;
+    z += 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);  /* from March 1 */
+    long mp = (5 * doy + 2) / 153;
+    *d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = yoe + era * 400 + (*m <= 2);
+    /* January and February close the shifted year */
+    int leap = (*y % 4 == 0 && *y % 100 != 0) || *y % 400 == 0;
+    *yday = (int)(mp >= 10 ? doy - 306 : doy + 59 + leap);
 }
 
-static const int days_per_month[2][12] = {
-    {31,28,31,30,31,30,31,31,30,31,30,31},
-    {31,29,31,30,31,30,31,31,30,31,30,31}
-};
-
-static void convert_tm(time_t t, struct tm *out)
+static int convert_tm(time_t t, struct tm *out)
 {
-    if (t < 0)
-        t = 0;
-
-    int sec = t % 60; t /= 60;
-    int min = t % 60; t /= 60;
-    int hour = t % 24; t /= 24;
-    int days = (int)t;
-
-    int wday = (days + 4) % 7; /* 1970-01-01 was Thursday */
-    int year = 1970;
-    while (1) {
-        int ydays = is_leap(year) ? 366 : 365;
-        if (days >= ydays) {
-            days -= ydays;
-            year++;
-        } else {
-            break;
-        }
+    long days = (long)(t / 86400);
+    long secs = (long)(t % 86400);
+    if (secs < 0) {
+        secs += 86400;
+        days--;
     }
-    int yday = days;
-    const int *ml = days_per_month[is_leap(year)];
-    int mon = 0;
-    while (days >= ml[mon]) {
-        days -= ml[mon];
-        mon++;
+
+    long year;
+    int mon, mday, yday;
+    __vlibc_civil_from_days(days, &year, &mon, &mday, &yday);
+    if (year - 1900 > 0x7fffffffL || year - 1900 < -0x7fffffffL - 1) {
+        errno = EOVERFLOW;
+        return -1;
     }
-    int mday = days + 1;
 
-    out->tm_sec = sec;
-    out->tm_min = min;
-    out->tm_hour = hour;
+    out->tm_sec = (int)(secs % 60);
+    out->tm_min = (int)(secs / 60 % 60);
+    out->tm_hour = (int)(secs / 3600);
     out->tm_mday = mday;
-    out->tm_mon = mon;
-    out->tm_year = year - 1900;
-    out->tm_wday = wday;
+    out->tm_mon = mon - 1;
+    out->tm_year = (int)(year - 1900);
+    out->tm_wday = (int)((days % 7 + 11) % 7); /* 1970-01-01 was Thursday */
     out->tm_yday = yday;
     out->tm_isdst = 0;
+    out->tm_gmtoff = 0;
+    out->tm_zone = "UTC";
+    return 0;
 }
 
 /*
@@ -110,44 +88,33 @@ struct tm *gmtime_r(const time_t *timep, struct tm *result)
     if (!result)
         return NULL;
     time_t t = timep ? *timep : time(NULL);
-    convert_tm(t, result);
+    if (convert_tm(t, result) < 0)
+        return NULL;
     return result;
 }
 
 /*
- * Convert a time value to local broken-down form applying the
- * configured timezone offset. tzset() controls the offset by
- * parsing the TZ environment variable or /etc/localtime.
+ * Convert a time value to local broken-down form in the zone loaded by
+ * tzset(), including daylight saving time. Later changes to TZ take
+ * effect at the next tzset(), localtime() or mktime() call.
  */
 struct tm *localtime_r(const time_t *timep, struct tm *result)
 {
     if (!result)
         return NULL;
     time_t t = timep ? *timep : time(NULL);
-    t += __vlibc_tzoff;
-    convert_tm(t, result);
-    return result;
-}
-
-static void load_tz(const char *tz)
-{
-    __vlibc_tzoff = parse_offset(tz);
-}
-
-void tzset(void)
-{
-    const char *tz = getenv("TZ");
-    if (!tz || !*tz) {
-        FILE *f = fopen("/etc/localtime", "r");
-        if (f) {
-            char buf[64];
-            if (fgets(buf, sizeof(buf), f))
-                tz = buf;
-            fclose(f);
-        }
+    /* no year this far out fits in tm_year; keeps t + off from overflowing */
+    if (t < -((time_t)1 << 56) || t > (time_t)1 << 56) {
+        errno = EOVERFLOW;
+        return NULL;
     }
-    if (tz)
-        load_tz(tz);
-    else
-        __vlibc_tzoff = 0;
+    int isdst;
+    const char *abbr;
+    long off = __vlibc_tz_local(t, 0, &isdst, &abbr);
+    if (convert_tm(t + off, result) < 0)
+        return NULL;
+    result->tm_isdst = isdst;
+    result->tm_gmtoff = off;
+    result->tm_zone = abbr;
+    return result;
 }
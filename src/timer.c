@@ -53,7 +53,7 @@ int timer_create(clockid_t clockid, struct sigevent *sevp, timer_t *timerid)
         return -1;
     }
     long id;
-    long ret = vlibc_syscall(SYS_timer_create, clockid, (long)sevp, (long)&id, 0, 0, 0);
+    long ret = vlibc_syscall3(SYS_timer_create, clockid, (long)sevp, (long)&id);
     if (ret < 0) {
         free(t);
         errno = -ret;
@@ -75,7 +75,7 @@ int timer_create(clockid_t clockid, struct sigevent *sevp, timer_t *timerid)
         errno = ENOMEM;
         return -1;
     }
-    long fd = vlibc_syscall(SYS_timerfd_create, clockid, 0, 0, 0, 0, 0);
+    long fd = vlibc_syscall2(SYS_timerfd_create, clockid, 0);
     if (fd < 0) {
         int err = -fd;
         free(t);
@@ -143,7 +143,7 @@ int timer_delete(timer_t timerid)
 #if defined(__linux__)
     if (t->is_fd) {
 #ifdef SYS_close
-        long ret = vlibc_syscall(SYS_close, t->id, 0, 0, 0, 0, 0);
+        long ret = vlibc_syscall1(SYS_close, t->id);
         int err = 0;
         if (ret < 0)
             err = -ret;
@@ -160,7 +160,7 @@ int timer_delete(timer_t timerid)
 #endif
     }
 #endif /* __linux__ */
-    long ret = vlibc_syscall(SYS_timer_delete, t->id, 0, 0, 0, 0, 0);
+    long ret = vlibc_syscall1(SYS_timer_delete, t->id);
     int err = 0;
     if (ret < 0)
         err = -ret;
@@ -210,8 +210,8 @@ int timer_settime(timer_t timerid, int flags,
 #if defined(__linux__)
     if (t->is_fd) {
 #ifdef SYS_timerfd_settime
-        long ret = vlibc_syscall(SYS_timerfd_settime, t->id, flags,
-                                 (long)new_value, (long)old_value, 0);
+        long ret = vlibc_syscall4(SYS_timerfd_settime, t->id, flags,
+                                  (long)new_value, (long)old_value);
         if (ret < 0) {
             errno = -ret;
             return -1;
@@ -223,8 +223,8 @@ int timer_settime(timer_t timerid, int flags,
 #endif
     }
 #endif
-    long ret = vlibc_syscall(SYS_timer_settime, t->id, flags,
-                             (long)new_value, (long)old_value, 0);
+    long ret = vlibc_syscall4(SYS_timer_settime, t->id, flags,
+                              (long)new_value, (long)old_value);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -245,8 +245,8 @@ int timer_settime(timer_t timerid, int flags,
     return kevent(t->kq, &kev, 1, NULL, 0, NULL);
 #elif defined(SYS_timerfd_settime)
     struct vlibc_timer *t = (struct vlibc_timer *)timerid;
-    long ret = vlibc_syscall(SYS_timerfd_settime, t->id, flags,
-                             (long)new_value, (long)old_value, 0);
+    long ret = vlibc_syscall4(SYS_timerfd_settime, t->id, flags,
+                              (long)new_value, (long)old_value);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -270,8 +270,8 @@ int timer_gettime(timer_t timerid, struct itimerspec *curr_value)
 #if defined(__linux__)
     if (t->is_fd) {
 #ifdef SYS_timerfd_gettime
-        long ret = vlibc_syscall(SYS_timerfd_gettime, t->id,
-                                 (long)curr_value, 0, 0, 0);
+        long ret = vlibc_syscall2(SYS_timerfd_gettime, t->id,
+                                  (long)curr_value);
         if (ret < 0) {
             errno = -ret;
             return -1;
@@ -283,8 +283,8 @@ int timer_gettime(timer_t timerid, struct itimerspec *curr_value)
 #endif
     }
 #endif
-    long ret = vlibc_syscall(SYS_timer_gettime, t->id,
-                             (long)curr_value, 0, 0, 0);
+    long ret = vlibc_syscall2(SYS_timer_gettime, t->id,
+                              (long)curr_value);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -303,8 +303,8 @@ int timer_gettime(timer_t timerid, struct itimerspec *curr_value)
     return 0;
 #elif defined(SYS_timerfd_gettime)
     struct vlibc_timer *t = (struct vlibc_timer *)timerid;
-    long ret = vlibc_syscall(SYS_timerfd_gettime, t->id,
-                             (long)curr_value, 0, 0, 0);
+    long ret = vlibc_syscall2(SYS_timerfd_gettime, t->id,
+                              (long)curr_value);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -20,7 +20,7 @@ clock_t times(struct tms *buf)
 #ifdef SYS_times
     struct tms ktms;
     struct tms *arg = buf ? buf : &ktms;
-    long ret = vlibc_syscall(SYS_times, (long)arg, 0, 0, 0, 0, 0);
+    long ret = vlibc_syscall1(SYS_times, (long)arg);
     if (ret < 0) {
         errno = -ret;
         return (clock_t)-1;
@@ -0,0 +1,714 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Time zone support for vlibc. Loads compiled zoneinfo (TZif)
+ * files and POSIX TZ strings and answers UTC offset queries for
+ * localtime_r, mktime and strftime.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "time.h"
+#include "env.h"
+#include "io.h"
+#include "string.h"
+#include "stdlib.h"
+#include "pthread.h"
+#include "sys/stat.h"
+#include "sys/mman.h"
+#include <fcntl.h>
+#include <stdint.h>
+
+#define TZ_DIR "/usr/share/zoneinfo"
+#define TZ_DEFAULT "/etc/localtime"
+/* how often, in seconds, a zone file is checked for replacement */
+#define TZ_RECHECK 1
+
+int __vlibc_tzoff = 0;
+
+/* std or dst half of a POSIX TZ string */
+struct tz_type {
+    long off;                   /* seconds east of UTC */
+    int isdst;
+    char abbr[16];
+};
+
+/* a transition rule: Jn, n or Mm.w.d, then the local time of day */
+struct tz_date {
+    char kind;                  /* 'J', 'D' or 'M' */
+    int mon, week, day;
+    long time;
+};
+
+struct tz_rule {
+    struct tz_type std, dst;
+    int has_dst;
+    struct tz_date start, end;
+};
+
+/*
+ * A loaded zone. Zones are immutable once published and are never
+ * freed, so tm_zone pointers into them stay valid. Every zone built is
+ * kept on a list and reused when TZ switches back to it, so a new one
+ * is only built for a TZ value or zone file not seen before.
+ */
+struct tz_zone {
+    struct tz_zone *next;       /* all zones built so far */
+    char *key;                  /* TZ value it was built for, NULL if unset */
+    char *path;                 /* zone file, NULL for a bare TZ string */
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    time_t checked;             /* last time the file was stat()ed */
+
+    void *map;
+    size_t maplen;
+    const unsigned char *trans; /* big-endian transition times */
+    int tsize;                  /* 8 for v2+ data, 4 for v1 */
+    const unsigned char *idx;   /* type of each transition */
+    const unsigned char *types; /* 6-byte ttinfo records */
+    const char *abbrs;
+    uint32_t timecnt, typecnt, charcnt;
+
+    int has_rule;
+    struct tz_rule rule;        /* for times after the last transition */
+};
+
+/* offset in effect for t, constant over [lo, hi) */
+struct tz_span {
+    time_t lo, hi;
+    long off;
+    int isdst;
+    const char *abbr;
+};
+
+static pthread_mutex_t tz_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct tz_zone *tz_cur;
+static struct tz_zone *tz_all;
+
+/* last span found by this thread, for runs of nearby timestamps */
+static __thread const struct tz_zone *tz_last_zone;
+static __thread struct tz_span tz_last;
+
+/* time_t is 64 bits on every supported target */
+#define TIME_MIN ((time_t)INT64_MIN)
+#define TIME_MAX ((time_t)INT64_MAX)
+
+/*
+ * Times further than this from the epoch have no year that fits in
+ * tm_year. Keeping lookups inside it also keeps t plus an offset and
+ * the rule arithmetic clear of overflow.
+ */
+#define TZ_LIMIT ((time_t)1 << 56)
+
+/* every UTC offset in use lies within this many seconds of zero */
+#define TZ_MAX_OFF (26 * 3600L)
+
+extern long __vlibc_days_from_civil(long y, int m, int d);
+extern void __vlibc_civil_from_days(long z, long *y, int *m, int *d,
+                                    int *yday);
+
+static int64_t get_be(const unsigned char *p, int n)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++)
+        v = (v << 8) | p[i];
+    if (n == 4)
+        return (int32_t)(uint32_t)v;
+    return (int64_t)v;
+}
+
+static int is_leap(long y)
+{
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+static long year_of(time_t t)
+{
+    long y;
+    int m, d, yday;
+    __vlibc_civil_from_days((long)(t / 86400 - (t % 86400 < 0)), &y, &m,
+                            &d, &yday);
+    return y;
+}
+
+/* ---- POSIX TZ strings ---- */
+
+static const char *parse_abbr(const char *s, char *out)
+{
+    size_t n = 0;
+    if (*s == '<') {
+        s++;
+        while (*s && *s != '>') {
+            if (n < 15)
+                out[n++] = *s;
+            s++;
+        }
+        if (*s != '>')
+            return NULL;
+        s++;
+    } else {
+        while ((*s >= 'A' && *s <= 'Z') || (*s >= 'a' && *s <= 'z')) {
+            if (n < 15)
+                out[n++] = *s;
+            s++;
+        }
+    }
+    out[n] = '\0';
+    return n >= 3 ? s : NULL;
+}
+
+static const char *parse_num(const char *s, int *v, int max)
+{
+    if (*s < '0' || *s > '9')
+        return NULL;
+    int n = 0;
+    while (*s >= '0' && *s <= '9') {
+        n = n * 10 + (*s++ - '0');
+        if (n > max)
+            return NULL;
+    }
+    *v = n;
+    return s;
+}
+
+/* [+-]hh[:mm[:ss]] in seconds */
+static const char *parse_hms(const char *s, long *out)
+{
+    int sign = 1, h, m = 0, sec = 0;
+    if (*s == '+' || *s == '-')
+        sign = *s++ == '-' ? -1 : 1;
+    if (!(s = parse_num(s, &h, 167)))
+        return NULL;
+    if (*s == ':' && !(s = parse_num(s + 1, &m, 59)))
+        return NULL;
+    if (*s == ':' && !(s = parse_num(s + 1, &sec, 59)))
+        return NULL;
+    *out = sign * ((long)h * 3600 + m * 60 + sec);
+    return s;
+}
+
+static const char *parse_date(const char *s, struct tz_date *d)
+{
+    if (*s == 'J') {
+        d->kind = 'J';
+        s = parse_num(s + 1, &d->day, 365);
+        if (!s || d->day < 1)
+            return NULL;
+    } else if (*s == 'M') {
+        d->kind = 'M';
+        if (!(s = parse_num(s + 1, &d->mon, 12)) || *s != '.' ||
+            !(s = parse_num(s + 1, &d->week, 5)) || *s != '.' ||
+            !(s = parse_num(s + 1, &d->day, 6)) || d->mon < 1 ||
+            d->week < 1)
+            return NULL;
+    } else {
+        d->kind = 'D';
+        if (!(s = parse_num(s, &d->day, 365)))
+            return NULL;
+    }
+    d->time = 7200;
+    if (*s == '/')
+        s = parse_hms(s + 1, &d->time);
+    return s;
+}
+
+/*
+ * Parse "std offset [dst [offset] [,start[/time],end[/time]]]". POSIX
+ * offsets count west of UTC, so "EST5" is five hours behind.
+ */
+static int parse_rule(const char *s, struct tz_rule *r)
+{
+    long off;
+    memset(r, 0, sizeof(*r));
+    if (!(s = parse_abbr(s, r->std.abbr)) || !(s = parse_hms(s, &off)))
+        return -1;
+    r->std.off = -off;
+    if (!*s)
+        return 0;
+    if (!(s = parse_abbr(s, r->dst.abbr)))
+        return -1;
+    r->has_dst = 1;
+    r->dst.isdst = 1;
+    r->dst.off = r->std.off + 3600;
+    if (*s && *s != ',') {
+        if (!(s = parse_hms(s, &off)))
+            return -1;
+        r->dst.off = -off;
+    }
+    if (!*s) {
+        /* no dates given: the US rules */
+        r->start = (struct tz_date){ 'M', 3, 2, 0, 7200 };
+        r->end = (struct tz_date){ 'M', 11, 1, 0, 7200 };
+        return 0;
+    }
+    if (*s != ',' || !(s = parse_date(s + 1, &r->start)) || *s != ',' ||
+        !(s = parse_date(s + 1, &r->end)) || *s)
+        return -1;
+    return 0;
+}
+
+/* UTC time at which date d of year y starts, local time given by off */
+static time_t rule_time(const struct tz_date *d, long y, long off)
+{
+    long days;
+    if (d->kind == 'J') {
+        days = __vlibc_days_from_civil(y, 1, 1) + d->day - 1;
+        if (is_leap(y) && d->day >= 60)
+            days++;
+    } else if (d->kind == 'D') {
+        days = __vlibc_days_from_civil(y, 1, 1) + d->day;
+    } else {
+        static const unsigned char mdays[12] = {
+            31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+        };
+        long first = __vlibc_days_from_civil(y, d->mon, 1);
+        int wday = (int)(((first + 4) % 7 + 7) % 7);
+        int mday = 1 + (d->day - wday + 7) % 7 + (d->week - 1) * 7;
+        int len = mdays[d->mon - 1] + (d->mon == 2 && is_leap(y));
+        while (mday > len)
+            mday -= 7;
+        days = first + mday - 1;
+    }
+    return (time_t)days * 86400 + d->time - off;
+}
+
+/*
+ * Find the span of rule r around t. The DST start and end instants of
+ * the neighbouring years are sorted, which handles zones on either
+ * hemisphere.
+ */
+static void rule_span(const struct tz_rule *r, time_t t, struct tz_span *sp)
+{
+    const struct tz_type *ty = &r->std;
+    sp->lo = TIME_MIN;
+    sp->hi = TIME_MAX;
+    if (r->has_dst) {
+        struct { time_t at; const struct tz_type *to; } ev[6];
+        long y = year_of(t + r->std.off);
+        int n = 0;
+        for (long yy = y - 1; yy <= y + 1; yy++) {
+            ev[n].at = rule_time(&r->start, yy, r->std.off);
+            ev[n++].to = &r->dst;
+            ev[n].at = rule_time(&r->end, yy, r->dst.off);
+            ev[n++].to = &r->std;
+        }
+        for (int i = 1; i < n; i++)
+            for (int j = i; j > 0 && ev[j].at < ev[j - 1].at; j--) {
+                time_t at = ev[j].at;
+                const struct tz_type *to = ev[j].to;
+                ev[j] = ev[j - 1];
+                ev[j - 1].at = at;
+                ev[j - 1].to = to;
+            }
+        /* before the first event the type is the opposite of its target */
+        ty = ev[0].to == &r->dst ? &r->std : &r->dst;
+        for (int i = 0; i < n; i++) {
+            if (ev[i].at > t) {
+                sp->hi = ev[i].at;
+                break;
+            }
+            sp->lo = ev[i].at;
+            ty = ev[i].to;
+        }
+    }
+    sp->off = ty->off;
+    sp->isdst = ty->isdst;
+    sp->abbr = ty->abbr;
+}
+
+/* ---- TZif files ---- */
+
+static void type_span(const struct tz_zone *z, unsigned type,
+                      struct tz_span *sp)
+{
+    const unsigned char *tt = z->types + 6 * type;
+    sp->off = (long)get_be(tt, 4);
+    sp->isdst = tt[4];
+    sp->abbr = z->abbrs + tt[5];
+}
+
+/*
+ * Check the layout of a TZif file and point the zone at its newest
+ * data block and footer. Returns 0 or -1 if the file is malformed.
+ */
+static int parse_tzif(struct tz_zone *z, const unsigned char *p, size_t len)
+{
+    const unsigned char *end = p + len;
+    int version;
+    uint32_t cnt[6];
+
+    for (int pass = 0;; pass++) {
+        if ((size_t)(end - p) < 44 || memcmp(p, "TZif", 4) != 0)
+            return -1;
+        version = p[4];
+        for (int i = 0; i < 6; i++)
+            cnt[i] = (uint32_t)get_be(p + 20 + 4 * i, 4);
+        /* isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt */
+        int tsize = pass ? 8 : 4;
+        uint64_t body = (uint64_t)cnt[3] * tsize + cnt[3] + cnt[4] * 6ULL +
+                        cnt[5] + cnt[2] * (tsize + 4ULL) + cnt[1] + cnt[0];
+        if (cnt[4] == 0 || cnt[5] == 0 || (uint64_t)(end - p - 44) < body)
+            return -1;
+        if (pass == 0 && version >= '2') {
+            p += 44 + body;
+            continue;
+        }
+        p += 44;
+        z->tsize = tsize;
+        z->timecnt = cnt[3];
+        z->typecnt = cnt[4];
+        z->charcnt = cnt[5];
+        z->trans = p;
+        z->idx = p + (size_t)cnt[3] * tsize;
+        z->types = z->idx + cnt[3];
+        z->abbrs = (const char *)(z->types + 6 * cnt[4]);
+        p += body;
+        break;
+    }
+
+    if (z->abbrs[z->charcnt - 1] != '\0')
+        return -1;
+    for (uint32_t i = 0; i < z->timecnt; i++)
+        if (z->idx[i] >= z->typecnt)
+            return -1;
+    for (uint32_t i = 0; i < z->typecnt; i++)
+        if (z->types[6 * i + 5] >= z->charcnt)
+            return -1;
+
+    /* the v2+ footer: "\n" TZ string "\n" */
+    if (z->tsize == 8 && p < end && *p == '\n') {
+        const unsigned char *nl = memchr(p + 1, '\n', (size_t)(end - p - 1));
+        if (nl && nl - p - 1 < 64) {
+            char buf[64];
+            memcpy(buf, p + 1, (size_t)(nl - p - 1));
+            buf[nl - p - 1] = '\0';
+            z->has_rule = buf[0] && parse_rule(buf, &z->rule) == 0;
+        }
+    }
+    return 0;
+}
+
+static int load_file(struct tz_zone *z, const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < 44) {
+        close(fd);
+        return -1;
+    }
+    void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+        return -1;
+    if (parse_tzif(z, m, (size_t)st.st_size) < 0) {
+        munmap(m, (size_t)st.st_size);
+        return -1;
+    }
+    z->map = m;
+    z->maplen = (size_t)st.st_size;
+    z->dev = st.st_dev;
+    z->ino = st.st_ino;
+    z->size = st.st_size;
+    z->mtime = st.st_mtime;
+    z->path = strdup(path);
+    return z->path ? 0 : -1;
+}
+
+/*
+ * Build the zone for a TZ value: unset means /etc/localtime, a leading
+ * ':' or a name that exists under the zoneinfo directory selects a
+ * file, and anything else is read as a POSIX TZ string. Unusable
+ * values give UTC.
+ */
+static struct tz_zone *build_zone(const char *tz)
+{
+    struct tz_zone *z = calloc(1, sizeof(*z));
+    if (!z)
+        return NULL;
+    if (tz && !(z->key = strdup(tz))) {
+        free(z);
+        return NULL;
+    }
+    z->checked = time(NULL);
+
+    const char *name = tz ? tz : TZ_DEFAULT;
+    if (*name == ':')
+        name++;
+    int loaded = 0;
+    if (*name == '/') {
+        loaded = load_file(z, name) == 0;
+    } else if (*name && !strstr(name, "..") &&
+               strlen(name) < 256) {
+        char path[sizeof(TZ_DIR) + 256];
+        memcpy(path, TZ_DIR "/", sizeof(TZ_DIR));
+        strcpy(path + sizeof(TZ_DIR), name);
+        loaded = load_file(z, path) == 0;
+    }
+    if (!loaded) {
+        z->timecnt = 0;
+        z->has_rule = 1;
+        if (!tz || parse_rule(tz, &z->rule) < 0)
+            parse_rule("UTC0", &z->rule);
+    }
+    return z;
+}
+
+/* Offset span of zone z at time t, which lies within TZ_LIMIT. */
+static void zone_span(const struct tz_zone *z, time_t t, struct tz_span *sp)
+{
+    uint32_t n = z->timecnt;
+    if (n == 0) {
+        if (z->has_rule) {
+            rule_span(&z->rule, t, sp);
+        } else {
+            type_span(z, 0, sp);
+            sp->lo = TIME_MIN;
+            sp->hi = TIME_MAX;
+        }
+        return;
+    }
+
+    int ts = z->tsize;
+    if (t < get_be(z->trans, ts)) {
+        type_span(z, 0, sp);
+        sp->lo = TIME_MIN;
+        sp->hi = (time_t)get_be(z->trans, ts);
+        return;
+    }
+    time_t last = (time_t)get_be(z->trans + (size_t)(n - 1) * ts, ts);
+    if (t >= last) {
+        if (z->has_rule) {
+            rule_span(&z->rule, t, sp);
+            if (sp->lo < last)
+                sp->lo = last;
+        } else {
+            type_span(z, z->idx[n - 1], sp);
+            sp->lo = last;
+            sp->hi = TIME_MAX;
+        }
+        return;
+    }
+
+    /* last transition at or before t */
+    uint32_t lo = 0, hi = n - 1;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (get_be(z->trans + (size_t)mid * ts, ts) <= t)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    type_span(z, z->idx[lo], sp);
+    sp->lo = (time_t)get_be(z->trans + (size_t)lo * ts, ts);
+    sp->hi = (time_t)get_be(z->trans + (size_t)hi * ts, ts);
+}
+
+static int same_key(const char *a, const char *b)
+{
+    if (!a || !b)
+        return a == b;
+    return strcmp(a, b) == 0;
+}
+
+/* Has the zone file been replaced since z was built? */
+static int file_changed(const struct tz_zone *z)
+{
+    struct stat st;
+    if (stat(z->path, &st) < 0)
+        return 1;
+    return st.st_dev != z->dev || st.st_ino != z->ino ||
+           st.st_size != z->size || st.st_mtime != z->mtime;
+}
+
+/*
+ * Return the current zone. With check_env the TZ variable is compared
+ * with the one the zone was built for; a zone file is stat()ed at most
+ * once every TZ_RECHECK seconds.
+ */
+static const struct tz_zone *tz_get(int check_env)
+{
+    struct tz_zone *z = __atomic_load_n(&tz_cur, __ATOMIC_ACQUIRE);
+    const char *tz = check_env || !z ? getenv("TZ") : NULL;
+    time_t now = 0;
+
+    if (z && (!check_env || same_key(z->key, tz))) {
+        if (!z->path)
+            return z;
+        now = time(NULL);
+        if (now - __atomic_load_n(&z->checked, __ATOMIC_RELAXED) <
+            TZ_RECHECK)
+            return z;
+    }
+
+    pthread_mutex_lock(&tz_lock);
+    z = tz_cur;
+    if (!check_env && z)
+        tz = z->key;
+    if (z && same_key(z->key, tz) && z->path) {
+        if (!now)
+            now = time(NULL);
+        if (!file_changed(z)) {
+            __atomic_store_n(&z->checked, now, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&tz_lock);
+            return z;
+        }
+    } else if (z && same_key(z->key, tz)) {
+        pthread_mutex_unlock(&tz_lock);
+        return z;
+    }
+
+    /* reuse a zone built for this value earlier if its file is unchanged */
+    struct tz_zone *nz;
+    for (nz = tz_all; nz; nz = nz->next) {
+        if (!same_key(nz->key, tz))
+            continue;
+        if (!nz->path)
+            break;
+        if (!file_changed(nz)) {
+            __atomic_store_n(&nz->checked, time(NULL), __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    if (!nz && (nz = build_zone(tz))) {
+        nz->next = tz_all;
+        tz_all = nz;
+    }
+    if (nz) {
+        struct tz_span sp;
+        zone_span(nz, time(NULL), &sp);
+        __vlibc_tzoff = (int)sp.off;
+        __atomic_store_n(&tz_cur, nz, __ATOMIC_RELEASE);
+        z = nz;
+    }
+    pthread_mutex_unlock(&tz_lock);
+    return z;
+}
+
+static void span_at(const struct tz_zone *z, time_t t, struct tz_span *sp)
+{
+    if (tz_last_zone == z && t >= tz_last.lo && t < tz_last.hi) {
+        *sp = tz_last;
+        return;
+    }
+    zone_span(z, t, sp);
+    tz_last = *sp;
+    tz_last_zone = z;
+}
+
+static const struct tz_span utc_span = {
+    TIME_MIN, TIME_MAX, 0, 0, "UTC"
+};
+
+/*
+ * __vlibc_tz_local() - offset east of UTC, DST flag and abbreviation
+ * in effect at t. Re-reads TZ when check_env is set, as localtime()
+ * and mktime() do; localtime_r() only follows changes to the file.
+ */
+long __vlibc_tz_local(time_t t, int check_env, int *isdst,
+                      const char **abbr)
+{
+    const struct tz_zone *z = tz_get(check_env);
+    struct tz_span sp;
+    if (z && t >= -TZ_LIMIT && t <= TZ_LIMIT)
+        span_at(z, t, &sp);
+    else
+        sp = utc_span;
+    if (isdst)
+        *isdst = sp.isdst;
+    if (abbr)
+        *abbr = sp.abbr;
+    return sp.off;
+}
+
+/*
+ * Offset of the span nearest to t whose DST flag is isdst, searching a
+ * few transitions either way. Returns 0 with *off unset if there is
+ * none, as in a zone without DST.
+ */
+static int nearest_kind(const struct tz_zone *z, time_t t, int isdst,
+                        long *off)
+{
+    struct tz_span back, fwd;
+    zone_span(z, t, &back);
+    fwd = back;
+    for (int i = 0; i < 8; i++) {
+        if (back.isdst == isdst) {
+            *off = back.off;
+            return 1;
+        }
+        if (fwd.isdst == isdst) {
+            *off = fwd.off;
+            return 1;
+        }
+        if (back.lo > -TZ_LIMIT)
+            zone_span(z, back.lo - 1, &back);
+        if (fwd.hi < TZ_LIMIT)
+            zone_span(z, fwd.hi, &fwd);
+    }
+    return 0;
+}
+
+/*
+ * __vlibc_tz_mktime() - UTC time for local seconds-since-epoch value
+ * local. In a repeated hour isdst picks the instance and -1 takes the
+ * earlier one. A local time skipped by a forward transition is read
+ * with the offset in effect before it. When isdst is 0 or 1 and
+ * disagrees with the zone at that time, local is read with the nearest
+ * offset of the requested kind, shifting it by the DST difference.
+ */
+time_t __vlibc_tz_mktime(time_t local, int isdst)
+{
+    const struct tz_zone *z = tz_get(1);
+    if (!z || local < -TZ_LIMIT + TZ_MAX_OFF || local > TZ_LIMIT - TZ_MAX_OFF)
+        return local;
+
+    /*
+     * Every solution of t + off(t) == local lies within TZ_MAX_OFF of
+     * local, so walk the spans covering that window in order.
+     */
+    int kind = isdst < 0 ? -1 : isdst > 0;
+    struct tz_span sp, prev;
+    time_t first = 0, match = 0, skipped = 0;
+    int nfirst = 0, nmatch = 0, nskipped = 0;
+    time_t t = local - TZ_MAX_OFF;
+    for (int i = 0;; i++) {
+        span_at(z, t, &sp);
+        time_t u = local - sp.off;
+        if (u >= sp.lo && u < sp.hi) {
+            if (!nfirst++)
+                first = u;
+            if (sp.isdst == kind && !nmatch++)
+                match = u;
+        }
+        /* the transition into sp jumps over local */
+        if (i > 0 && u < sp.lo && local - prev.off >= sp.lo && !nskipped++)
+            skipped = local - prev.off;
+        if (sp.hi > local + TZ_MAX_OFF)
+            break;
+        prev = sp;
+        t = sp.hi;
+    }
+
+    if (nmatch)
+        return match;
+    time_t res = nfirst ? first : nskipped ? skipped : local - sp.off;
+    long off;
+    if (kind >= 0 && nearest_kind(z, res, kind, &off))
+        return local - off;
+    return res;
+}
+
+/*
+ * tzset() - load the zone named by TZ. An unset TZ uses /etc/localtime;
+ * values naming a zoneinfo file load it, other values are read as POSIX
+ * TZ strings. The zone file is checked for changes again at most once
+ * a second by the conversion functions.
+ */
+void tzset(void)
+{
+    tz_get(1);
+}
@@ -9,18 +9,285 @@
 #include "string.h"
 #include "errno.h"
 #include "process.h"
+#include "unistd.h"
+#include "sys/mman.h"
 #include <stdarg.h>
+#include <stdint.h>
 
-#ifndef VLIBC_HAS_SYS_UCONTEXT
+#ifdef VLIBC_HAVE_MCONTEXT
+
+/*
+ * The register switch lives in a few lines of assembly per
+ * architecture. The routines store the caller's callee-saved registers,
+ * stack pointer and return address into uc_mcontext, which sits at
+ * offset zero of ucontext_t, and resume a context by loading the same
+ * fields and jumping to the saved address with a return value of 0.
+ *
+ *   getcontext               save, then tail call __vlibc_ucontext_mask
+ *   vlibc_swapcontext_nosig  save into the first context, load the second
+ *   __vlibc_ctx_load         load a context
+ *   __vlibc_ctx_start        first frame of a makecontext() context
+ *
+ * Since getcontext() and vlibc_swapcontext_nosig() are called directly,
+ * the frame they resume into is the caller's and stays valid.
+ */
+_Static_assert(offsetof(ucontext_t, uc_mcontext) == 0, "uc_mcontext offset");
+
+int __vlibc_ucontext_mask(ucontext_t *ucp);
+void __vlibc_ctx_load(const ucontext_t *ucp) __attribute__((noreturn));
+void __vlibc_ctx_start(void);
+void __vlibc_ctx_run(ucontext_t *ucp) __attribute__((noreturn, used));
 
 #if defined(__x86_64__)
 
-/* trampoline for newly created contexts */
-static void __attribute__((noreturn)) ctx_trampoline(void)
+_Static_assert(offsetof(mcontext_t, rsp) == 48 &&
+               offsetof(mcontext_t, mxcsr) == 64 &&
+               offsetof(mcontext_t, fpcw) == 68, "mcontext_t layout");
+
+#define CTX_SAVE                                                         \
+    "mov %rbx,0(%rdi)\n"                                                 \
+    "mov %rbp,8(%rdi)\n"                                                 \
+    "mov %r12,16(%rdi)\n"                                                \
+    "mov %r13,24(%rdi)\n"                                                \
+    "mov %r14,32(%rdi)\n"                                                \
+    "mov %r15,40(%rdi)\n"                                                \
+    "lea 8(%rsp),%rax\n"                                                 \
+    "mov %rax,48(%rdi)\n"                                                \
+    "mov (%rsp),%rax\n"                                                  \
+    "mov %rax,56(%rdi)\n"                                                \
+    "stmxcsr 64(%rdi)\n"                                                 \
+    "fnstcw 68(%rdi)\n"
+
+__asm__(
+    ".pushsection .text\n"
+    ".globl getcontext\n"
+    ".type getcontext,@function\n"
+    "getcontext:\n"
+    "test %rdi,%rdi\n"
+    "jz 1f\n"
+    CTX_SAVE
+    "1: jmp __vlibc_ucontext_mask\n"
+    ".size getcontext,.-getcontext\n"
+
+    ".globl vlibc_swapcontext_nosig\n"
+    ".type vlibc_swapcontext_nosig,@function\n"
+    "vlibc_swapcontext_nosig:\n"
+    CTX_SAVE
+    "mov %rsi,%rdi\n"
+    ".size vlibc_swapcontext_nosig,.-vlibc_swapcontext_nosig\n"
+    /* fall through */
+    ".globl __vlibc_ctx_load\n"
+    ".type __vlibc_ctx_load,@function\n"
+    "__vlibc_ctx_load:\n"
+    "ldmxcsr 64(%rdi)\n"
+    "fldcw 68(%rdi)\n"
+    "mov 0(%rdi),%rbx\n"
+    "mov 8(%rdi),%rbp\n"
+    "mov 16(%rdi),%r12\n"
+    "mov 24(%rdi),%r13\n"
+    "mov 32(%rdi),%r14\n"
+    "mov 40(%rdi),%r15\n"
+    "mov 48(%rdi),%rsp\n"
+    "xor %eax,%eax\n"
+    "jmp *56(%rdi)\n"
+    ".size __vlibc_ctx_load,.-__vlibc_ctx_load\n"
+
+    ".globl __vlibc_ctx_start\n"
+    ".type __vlibc_ctx_start,@function\n"
+    "__vlibc_ctx_start:\n"
+    "xor %ebp,%ebp\n"
+    "and $-16,%rsp\n"
+    "mov %r12,%rdi\n"
+    "call __vlibc_ctx_run\n"
+    "hlt\n"
+    ".size __vlibc_ctx_start,.-__vlibc_ctx_start\n"
+    ".popsection\n");
+
+#undef CTX_SAVE
+
+static void set_entry(ucontext_t *ucp, uintptr_t sp)
+{
+    ucp->uc_mcontext.rsp = sp - 8;
+    ucp->uc_mcontext.rip = (unsigned long)__vlibc_ctx_start;
+    ucp->uc_mcontext.r12 = (unsigned long)ucp;
+}
+
+#elif defined(__aarch64__)
+
+_Static_assert(offsetof(mcontext_t, sp) == 88 &&
+               offsetof(mcontext_t, d) == 104 &&
+               offsetof(mcontext_t, fpcr) == 168, "mcontext_t layout");
+
+#define CTX_SAVE                                                         \
+    "stp x19,x20,[x0,#0]\n"                                              \
+    "stp x21,x22,[x0,#16]\n"                                             \
+    "stp x23,x24,[x0,#32]\n"                                             \
+    "stp x25,x26,[x0,#48]\n"                                             \
+    "stp x27,x28,[x0,#64]\n"                                             \
+    "mov x9,sp\n"                                                        \
+    "stp x29,x9,[x0,#80]\n"                                              \
+    "str x30,[x0,#96]\n"                                                 \
+    "stp d8,d9,[x0,#104]\n"                                              \
+    "stp d10,d11,[x0,#120]\n"                                            \
+    "stp d12,d13,[x0,#136]\n"                                            \
+    "stp d14,d15,[x0,#152]\n"                                            \
+    "mrs x9,fpcr\n"                                                      \
+    "str x9,[x0,#168]\n"
+
+__asm__(
+    ".pushsection .text\n"
+    ".globl getcontext\n"
+    ".type getcontext,%function\n"
+    "getcontext:\n"
+    "cbz x0,1f\n"
+    CTX_SAVE
+    "1: b __vlibc_ucontext_mask\n"
+    ".size getcontext,.-getcontext\n"
+
+    ".globl vlibc_swapcontext_nosig\n"
+    ".type vlibc_swapcontext_nosig,%function\n"
+    "vlibc_swapcontext_nosig:\n"
+    CTX_SAVE
+    "mov x0,x1\n"
+    ".size vlibc_swapcontext_nosig,.-vlibc_swapcontext_nosig\n"
+    /* fall through */
+    ".globl __vlibc_ctx_load\n"
+    ".type __vlibc_ctx_load,%function\n"
+    "__vlibc_ctx_load:\n"
+    "ldr x9,[x0,#168]\n"
+    "msr fpcr,x9\n"
+    "ldp d8,d9,[x0,#104]\n"
+    "ldp d10,d11,[x0,#120]\n"
+    "ldp d12,d13,[x0,#136]\n"
+    "ldp d14,d15,[x0,#152]\n"
+    "ldp x19,x20,[x0,#0]\n"
+    "ldp x21,x22,[x0,#16]\n"
+    "ldp x23,x24,[x0,#32]\n"
+    "ldp x25,x26,[x0,#48]\n"
+    "ldp x27,x28,[x0,#64]\n"
+    "ldp x29,x9,[x0,#80]\n"
+    "ldr x30,[x0,#96]\n"
+    "mov sp,x9\n"
+    "mov x0,#0\n"
+    "ret\n"
+    ".size __vlibc_ctx_load,.-__vlibc_ctx_load\n"
+
+    ".globl __vlibc_ctx_start\n"
+    ".type __vlibc_ctx_start,%function\n"
+    "__vlibc_ctx_start:\n"
+    "mov x29,#0\n"
+    "mov x0,x19\n"
+    "bl __vlibc_ctx_run\n"
+    "brk #0\n"
+    ".size __vlibc_ctx_start,.-__vlibc_ctx_start\n"
+    ".popsection\n");
+
+#undef CTX_SAVE
+
+static void set_entry(ucontext_t *ucp, uintptr_t sp)
+{
+    ucp->uc_mcontext.sp = sp;
+    ucp->uc_mcontext.pc = (unsigned long)__vlibc_ctx_start;
+    ucp->uc_mcontext.x[0] = (unsigned long)ucp;
+}
+
+#elif defined(__arm__)
+
+_Static_assert(offsetof(mcontext_t, sp) == 32 &&
+               offsetof(mcontext_t, d) == 40 &&
+               offsetof(mcontext_t, fpscr) == 104, "mcontext_t layout");
+
+/* d8-d15 and FPSCR exist only when the target has a VFP unit. */
+#ifdef __ARM_FP
+#define CTX_SAVE_FP                                                      \
+    "add r2,r0,#40\n"                                                    \
+    "vstmia r2,{d8-d15}\n"                                               \
+    "vmrs r2,fpscr\n"                                                    \
+    "str r2,[r0,#104]\n"
+#define CTX_LOAD_FP                                                      \
+    "ldr r2,[r0,#104]\n"                                                 \
+    "vmsr fpscr,r2\n"                                                    \
+    "add r2,r0,#40\n"                                                    \
+    "vldmia r2,{d8-d15}\n"
+#else
+#define CTX_SAVE_FP ""
+#define CTX_LOAD_FP ""
+#endif
+
+#define CTX_SAVE                                                         \
+    "stmia r0,{r4-r11}\n"                                                \
+    "str sp,[r0,#32]\n"                                                  \
+    "str lr,[r0,#36]\n"                                                  \
+    CTX_SAVE_FP
+
+__asm__(
+    ".pushsection .text\n"
+    ".syntax unified\n"
+    ".arm\n"
+    ".globl getcontext\n"
+    ".type getcontext,%function\n"
+    "getcontext:\n"
+    "cmp r0,#0\n"
+    "beq 1f\n"
+    CTX_SAVE
+    "1: b __vlibc_ucontext_mask\n"
+    ".size getcontext,.-getcontext\n"
+
+    ".globl vlibc_swapcontext_nosig\n"
+    ".type vlibc_swapcontext_nosig,%function\n"
+    "vlibc_swapcontext_nosig:\n"
+    CTX_SAVE
+    "mov r0,r1\n"
+    ".size vlibc_swapcontext_nosig,.-vlibc_swapcontext_nosig\n"
+    /* fall through */
+    ".globl __vlibc_ctx_load\n"
+    ".type __vlibc_ctx_load,%function\n"
+    "__vlibc_ctx_load:\n"
+    CTX_LOAD_FP
+    "ldmia r0,{r4-r11}\n"
+    "ldr sp,[r0,#32]\n"
+    "ldr lr,[r0,#36]\n"
+    "mov r0,#0\n"
+    "bx lr\n"
+    ".size __vlibc_ctx_load,.-__vlibc_ctx_load\n"
+
+    ".globl __vlibc_ctx_start\n"
+    ".type __vlibc_ctx_start,%function\n"
+    "__vlibc_ctx_start:\n"
+    "mov fp,#0\n"
+    "mov r0,r4\n"
+    "bl __vlibc_ctx_run\n"
+    "udf #0\n"
+    ".size __vlibc_ctx_start,.-__vlibc_ctx_start\n"
+    ".popsection\n");
+
+#undef CTX_SAVE
+#undef CTX_SAVE_FP
+#undef CTX_LOAD_FP
+
+static void set_entry(ucontext_t *ucp, uintptr_t sp)
 {
-    ucontext_t *uc;
-    __asm__ volatile("mov %%r12,%0" : "=r"(uc));
+    ucp->uc_mcontext.sp = sp;
+    ucp->uc_mcontext.pc = (unsigned long)__vlibc_ctx_start;
+    ucp->uc_mcontext.r[0] = (unsigned long)ucp;
+}
+
+#endif
 
+/* Second half of getcontext(): record the signal mask. */
+int __vlibc_ucontext_mask(ucontext_t *ucp)
+{
+    if (!ucp) {
+        errno = EINVAL;
+        return -1;
+    }
+    sigprocmask(SIG_SETMASK, NULL, &ucp->uc_sigmask);
+    return 0;
+}
+
+/* Run the function given to makecontext() and follow uc_link. */
+void __vlibc_ctx_run(ucontext_t *uc)
+{
     void (*fn)(void) = uc->uc_func;
     long *a = uc->uc_args;
     switch (uc->uc_argc) {
@@ -38,32 +305,7 @@ static void __attribute__((noreturn)) ctx_trampoline(void)
     if (uc->uc_link)
         setcontext(uc->uc_link);
     exit(0);
-}
-
-int getcontext(ucontext_t *ucp)
-{
-    if (!ucp) {
-        errno = EINVAL;
-        return -1;
-    }
-    sigprocmask(SIG_SETMASK, NULL, &ucp->uc_sigmask);
-    __asm__ volatile(
-        "mov %%rbx,%0\n"
-        "mov %%rbp,%1\n"
-        "mov %%r12,%2\n"
-        "mov %%r13,%3\n"
-        "mov %%r14,%4\n"
-        "mov %%r15,%5\n"
-        "mov %%rsp,%6\n"
-        "lea 1f(%%rip),%%rax\n"
-        "mov %%rax,%7\n"
-        "xor %%eax,%%eax\n"
-        "1:"
-        : "=m"(ucp->rbx), "=m"(ucp->rbp), "=m"(ucp->r12), "=m"(ucp->r13),
-          "=m"(ucp->r14), "=m"(ucp->r15), "=m"(ucp->rsp), "=m"(ucp->rip)
-        :
-        : "rax", "memory");
-    return 0;
+    __builtin_unreachable();
 }
 
 int setcontext(const ucontext_t *ucp)
@@ -73,20 +315,7 @@ int setcontext(const ucontext_t *ucp)
         return -1;
     }
     sigprocmask(SIG_SETMASK, &ucp->uc_sigmask, NULL);
-    __asm__ volatile(
-        "mov %0,%%rbx\n"
-        "mov %1,%%rbp\n"
-        "mov %2,%%r12\n"
-        "mov %3,%%r13\n"
-        "mov %4,%%r14\n"
-        "mov %5,%%r15\n"
-        "mov %6,%%rsp\n"
-        "jmp *%7\n"
-        :
-        : "m"(ucp->rbx), "m"(ucp->rbp), "m"(ucp->r12), "m"(ucp->r13),
-          "m"(ucp->r14), "m"(ucp->r15), "m"(ucp->rsp), "m"(ucp->rip)
-        : "memory");
-    __builtin_unreachable();
+    __vlibc_ctx_load(ucp);
 }
 
 void makecontext(ucontext_t *ucp, void (*func)(void), int argc, ...)
@@ -105,22 +334,26 @@ void makecontext(ucontext_t *ucp, void (*func)(void), int argc, ...)
         ucp->uc_args[i] = va_arg(ap, long);
     va_end(ap);
 
-    char *sp = (char *)ucp->uc_stack.ss_sp + ucp->uc_stack.ss_size;
-    sp = (char *)((uintptr_t)sp & ~15UL);
-    sp -= 8; /* keep 16-byte alignment */
-    ucp->rsp = (unsigned long)sp;
-    ucp->rip = (unsigned long)ctx_trampoline;
-    ucp->r12 = (unsigned long)ucp;
+    uintptr_t sp = (uintptr_t)ucp->uc_stack.ss_sp + ucp->uc_stack.ss_size;
+    set_entry(ucp, sp & ~(uintptr_t)15);
 }
 
+/*
+ * swapcontext() - save the current context in oucp and activate ucp.
+ * The signal mask is exchanged with a single sigprocmask() call before
+ * the registers are switched.
+ */
 int swapcontext(ucontext_t *oucp, const ucontext_t *ucp)
 {
-    if (getcontext(oucp) == 0)
-        return setcontext(ucp);
-    return 0;
+    if (!oucp || !ucp) {
+        errno = EINVAL;
+        return -1;
+    }
+    sigprocmask(SIG_SETMASK, &ucp->uc_sigmask, &oucp->uc_sigmask);
+    return vlibc_swapcontext_nosig(oucp, ucp);
 }
 
-#else /* !__x86_64__ */
+#elif !defined(VLIBC_HAS_SYS_UCONTEXT)
 
 #include <setjmp.h>
 #include <signal.h>
@@ -185,6 +418,64 @@ int swapcontext(ucontext_t *oucp, const ucontext_t *ucp)
     return 0;
 }
 
-#endif /* __x86_64__ */
 
-#endif /* VLIBC_HAS_SYS_UCONTEXT */
+#endif
+
+#ifndef VLIBC_HAVE_MCONTEXT
+/*
+ * Without vlibc's own register switch, for instance when the host
+ * <ucontext.h> is used, fall back to a full swapcontext().
+ */
+int vlibc_swapcontext_nosig(ucontext_t *oucp, const ucontext_t *ucp)
+{
+    return swapcontext(oucp, ucp);
+}
+#endif
+
+/*
+ * vlibc_stack_alloc() - map a stack of at least size bytes for
+ * makecontext(). One extra page below the stack is left inaccessible so
+ * an overflow faults instead of corrupting the neighbouring mapping.
+ */
+int vlibc_stack_alloc(stack_t *ss, size_t size)
+{
+    if (!ss || size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t page = (size_t)getpagesize();
+    size = (size + page - 1) & ~(page - 1);
+    if (size + page < size) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_STACK
+    flags |= MAP_STACK;
+#endif
+    char *base = mmap(NULL, size + page, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (base == MAP_FAILED)
+        return -1;
+    if (mprotect(base, page, PROT_NONE) != 0) {
+        int saved = errno;
+        munmap(base, size + page);
+        errno = saved;
+        return -1;
+    }
+    ss->ss_sp = base + page;
+    ss->ss_size = size;
+    ss->ss_flags = 0;
+    return 0;
+}
+
+/* vlibc_stack_free() - release a stack from vlibc_stack_alloc(). */
+void vlibc_stack_free(stack_t *ss)
+{
+    if (!ss || !ss->ss_sp)
+        return;
+    size_t page = (size_t)getpagesize();
+    munmap((char *)ss->ss_sp - page, ss->ss_size + page);
+    ss->ss_sp = NULL;
+    ss->ss_size = 0;
+}
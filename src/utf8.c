@@ -0,0 +1,797 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the UTF-8 functions for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "wchar.h"
+#include "string.h"
+#include "errno.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Bulk UTF-8 kernels shared by iconv, mbstowcs and wcstombs. Input is
+ * examined 16 or 32 bytes per step with GCC vector types: ASCII runs are
+ * copied, widened or narrowed a block at a time, and validation uses the
+ * lookup method of Keiser and Lemire, where three 16-entry table lookups
+ * classify every pair of adjacent bytes and a second check catches the
+ * continuation bytes owed to three- and four-byte leads. The lookups
+ * need a byte shuffle (tbl on aarch64, pshufb on x86_64), so the SSE2
+ * baseline validates non-ASCII text with the scalar decoder and an AVX2
+ * copy of the kernels is picked at startup when the CPU has it. When a
+ * block fails, the scalar decoder walks it again for the exact offset.
+ */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define UTF8_LE 1
+#else
+#define UTF8_LE 0               /* widening and narrowing stay scalar */
+#endif
+
+#if defined(__aarch64__) || defined(__SSSE3__)
+#define BASE_LOOKUP 1
+#else
+#define BASE_LOOKUP 0
+#endif
+
+typedef unsigned char v16qu __attribute__((vector_size(16)));
+typedef signed char v16qi __attribute__((vector_size(16)));
+typedef uint16_t v8hu __attribute__((vector_size(16)));
+typedef uint32_t v4su __attribute__((vector_size(16)));
+typedef uint64_t v2du __attribute__((vector_size(16)));
+
+/* element types for aligned and unaligned vector access to any data */
+typedef v16qu v16qu_a __attribute__((may_alias));
+typedef v4su v4su_a __attribute__((may_alias));
+typedef v16qu v16qu_u __attribute__((aligned(1), may_alias));
+
+#define VINLINE static inline __attribute__((always_inline))
+
+VINLINE v16qu load16(const void *p)
+{
+    return *(const v16qu_u *)p;
+}
+
+VINLINE void store16(void *p, v16qu v)
+{
+    *(v16qu_u *)p = v;
+}
+
+VINLINE int any64(v16qu v, uint64_t mask)
+{
+    v2du w = (v2du)v;
+    return ((w[0] | w[1]) & mask) != 0;
+}
+
+VINLINE int has_high(v16qu v)
+{
+    return any64(v, 0x8080808080808080ULL);
+}
+
+/* Zero-extend 16 bytes to 16-bit and 32-bit units. */
+VINLINE void widen16(uint16_t *d, v16qu v)
+{
+    const v16qu z = {0};
+    store16(d, __builtin_shuffle(v, z, (v16qu){0, 16, 1, 17, 2, 18, 3, 19,
+                                               4, 20, 5, 21, 6, 22, 7, 23}));
+    store16(d + 8, __builtin_shuffle(v, z, (v16qu){8, 24, 9, 25, 10, 26, 11,
+                                                   27, 12, 28, 13, 29, 14,
+                                                   30, 15, 31}));
+}
+
+VINLINE void widen32(uint32_t *d, v16qu v)
+{
+    const v16qu z = {0};
+    const v8hu hz = {0};
+    v8hu lo = (v8hu)__builtin_shuffle(v, z, (v16qu){0, 16, 1, 17, 2, 18, 3,
+                                                    19, 4, 20, 5, 21, 6, 22,
+                                                    7, 23});
+    v8hu hi = (v8hu)__builtin_shuffle(v, z, (v16qu){8, 24, 9, 25, 10, 26, 11,
+                                                    27, 12, 28, 13, 29, 14,
+                                                    30, 15, 31});
+    store16(d, (v16qu)__builtin_shuffle(lo, hz, (v8hu){0, 8, 1, 9, 2, 10, 3,
+                                                       11}));
+    store16(d + 4, (v16qu)__builtin_shuffle(lo, hz, (v8hu){4, 12, 5, 13, 6,
+                                                           14, 7, 15}));
+    store16(d + 8, (v16qu)__builtin_shuffle(hi, hz, (v8hu){0, 8, 1, 9, 2,
+                                                           10, 3, 11}));
+    store16(d + 12, (v16qu)__builtin_shuffle(hi, hz, (v8hu){4, 12, 5, 13, 6,
+                                                            14, 7, 15}));
+}
+
+/* Keep the low byte of each unit. */
+VINLINE v16qu narrow16(v16qu a, v16qu b)
+{
+    return __builtin_shuffle(a, b, (v16qu){0, 2, 4, 6, 8, 10, 12, 14, 16, 18,
+                                           20, 22, 24, 26, 28, 30});
+}
+
+VINLINE v16qu narrow32(v16qu a, v16qu b, v16qu c, v16qu d)
+{
+    v16qu ab = __builtin_shuffle(a, b, (v16qu){0, 1, 4, 5, 8, 9, 12, 13, 16,
+                                               17, 20, 21, 24, 25, 28, 29});
+    v16qu cd = __builtin_shuffle(c, d, (v16qu){0, 1, 4, 5, 8, 9, 12, 13, 16,
+                                               17, 20, 21, 24, 25, 28, 29});
+    return narrow16(ab, cd);
+}
+
+/*
+ * Decode one UTF-8 sequence. Returns its length, 0 when the input ends
+ * inside a sequence that is valid so far, or -1 for a malformed one.
+ * Overlong forms, surrogates and values above U+10FFFF are malformed.
+ */
+int __vlibc_utf8_decode(const unsigned char *s, size_t n, uint32_t *cp)
+{
+    unsigned c = s[0];
+    unsigned lo = 0x80, hi = 0xBF;
+    int len;
+    uint32_t v;
+
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    }
+    if (c >= 0xC2 && c <= 0xDF) {
+        len = 2;
+        v = c & 0x1F;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        len = 3;
+        v = c & 0x0F;
+        if (c == 0xE0)
+            lo = 0xA0;
+        else if (c == 0xED)
+            hi = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        len = 4;
+        v = c & 0x07;
+        if (c == 0xF0)
+            lo = 0x90;
+        else if (c == 0xF4)
+            hi = 0x8F;
+    } else {
+        return -1;
+    }
+    for (int k = 1; k < len; k++) {
+        if ((size_t)k >= n)
+            return 0;
+        unsigned b = s[k];
+        if (b < lo || b > hi)
+            return -1;
+        lo = 0x80;
+        hi = 0xBF;
+        v = (v << 6) | (b & 0x3F);
+    }
+    *cp = v;
+    return len;
+}
+
+/* Decode a sequence already known to be valid. */
+VINLINE int decode_valid(const unsigned char *s, uint32_t *cp)
+{
+    unsigned c = s[0];
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    }
+    if (c < 0xE0) {
+        *cp = ((c & 0x1F) << 6) | (s[1] & 0x3F);
+        return 2;
+    }
+    if (c < 0xF0) {
+        *cp = ((c & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        return 3;
+    }
+    *cp = ((c & 0x07) << 18) | ((s[1] & 0x3F) << 12) |
+          ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+    return 4;
+}
+
+VINLINE unsigned char *put_utf8(unsigned char *d, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *d++ = cp;
+    } else if (cp < 0x800) {
+        *d++ = 0xC0 | (cp >> 6);
+        *d++ = 0x80 | (cp & 0x3F);
+    } else if (cp < 0x10000) {
+        *d++ = 0xE0 | (cp >> 12);
+        *d++ = 0x80 | ((cp >> 6) & 0x3F);
+        *d++ = 0x80 | (cp & 0x3F);
+    } else {
+        *d++ = 0xF0 | (cp >> 18);
+        *d++ = 0x80 | ((cp >> 12) & 0x3F);
+        *d++ = 0x80 | ((cp >> 6) & 0x3F);
+        *d++ = 0x80 | (cp & 0x3F);
+    }
+    return d;
+}
+
+/* Length of the leading run of ASCII bytes. */
+VINLINE size_t ascii_len_k(const unsigned char *s, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+        if (has_high(load16(s + i) | load16(s + i + 16)))
+            break;
+    while (i < n && s[i] < 0x80)
+        i++;
+    return i;
+}
+
+/* Length of the longest valid prefix, one sequence at a time. */
+static size_t valid_scalar(const unsigned char *s, size_t n)
+{
+    size_t i = 0;
+    while (i < n) {
+        uint32_t cp;
+        int r = __vlibc_utf8_decode(s + i, n - i, &cp);
+        if (r <= 0)
+            break;
+        i += r;
+    }
+    return i;
+}
+
+/* error classes of the lookup validator */
+#define TOO_SHORT      (1 << 0)
+#define TOO_LONG       (1 << 1)
+#define OVERLONG_3     (1 << 2)
+#define TOO_LARGE      (1 << 3)
+#define SURROGATE      (1 << 4)
+#define OVERLONG_2     (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4     (1 << 6)
+#define TWO_CONTS      (1 << 7)
+#define CARRY          (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+/* indexed by the high nibble of the first byte of a pair */
+static const v16qu BYTE1_HIGH = {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+
+/* indexed by the low nibble of the first byte */
+static const v16qu BYTE1_LOW = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+/* indexed by the high nibble of the second byte */
+static const v16qu BYTE2_HIGH = {
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+        OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+};
+
+/* a lead byte in the last three positions still owes continuations */
+static const v16qu INCOMPLETE_MAX = {
+    255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 0xEF, 0xDF, 0xBF,
+};
+
+/* Non-zero lanes mark errors in block in, given the block before it. */
+VINLINE v16qu check_block(v16qu in, v16qu prev)
+{
+    v16qu p1 = __builtin_shuffle(prev, in, (v16qu){15, 16, 17, 18, 19, 20,
+                                                   21, 22, 23, 24, 25, 26,
+                                                   27, 28, 29, 30});
+    v16qu p2 = __builtin_shuffle(prev, in, (v16qu){14, 15, 16, 17, 18, 19,
+                                                   20, 21, 22, 23, 24, 25,
+                                                   26, 27, 28, 29});
+    v16qu p3 = __builtin_shuffle(prev, in, (v16qu){13, 14, 15, 16, 17, 18,
+                                                   19, 20, 21, 22, 23, 24,
+                                                   25, 26, 27, 28});
+    v16qu sc = __builtin_shuffle(BYTE1_HIGH, (v16qu)(p1 >> 4)) &
+               __builtin_shuffle(BYTE1_LOW, (v16qu)(p1 & 0x0F)) &
+               __builtin_shuffle(BYTE2_HIGH, (v16qu)(in >> 4));
+    v16qu must23 = (v16qu)((p2 >= 0xE0) | (p3 >= 0xF0));
+    return (must23 & 0x80) ^ sc;
+}
+
+/* Exact offset of the error reported for the block at offset i. */
+static size_t locate_error(const unsigned char *s, size_t n, size_t i)
+{
+    size_t start = i;
+    for (size_t k = 1; k <= 3 && k <= i; k++) {
+        if ((s[i - k] & 0xC0) != 0x80) {
+            start = i - k;
+            break;
+        }
+    }
+    return start + valid_scalar(s + start, n - start);
+}
+
+VINLINE size_t valid_k(const unsigned char *s, size_t n, int lookup)
+{
+    size_t i = 0;
+
+    if (!lookup) {
+        for (;;) {
+            i += ascii_len_k(s + i, n - i);
+            if (i == n)
+                return n;
+            do {
+                uint32_t cp;
+                int r = __vlibc_utf8_decode(s + i, n - i, &cp);
+                if (r <= 0)
+                    return i;
+                i += r;
+            } while (i < n && s[i] >= 0x80);
+        }
+    }
+
+    const v16qu zero = {0};
+    v16qu prev = zero, pend = zero, err;
+    for (; i + 32 <= n; i += 32) {
+        v16qu a = load16(s + i), b = load16(s + i + 16);
+        if (!has_high(a | b)) {
+            err = pend;
+            pend = zero;
+        } else {
+            err = check_block(a, prev) | check_block(b, a);
+            pend = (v16qu)(b > INCOMPLETE_MAX);
+        }
+        if (any64(err, ~0ULL))
+            return locate_error(s, n, i);
+        prev = b;
+    }
+    if (i + 16 <= n) {
+        v16qu a = load16(s + i);
+        if (any64(check_block(a, prev), ~0ULL))
+            return locate_error(s, n, i);
+        prev = a;
+        i += 16;
+    }
+    /* the zero padding exposes a sequence cut off by the end */
+    unsigned char tail[16] = {0};
+    memcpy(tail, s + i, n - i);
+    if (any64(check_block(load16(tail), prev), ~0ULL))
+        return locate_error(s, n, i);
+    return n;
+}
+
+/* Number of code points: every byte that is not a continuation. */
+VINLINE size_t count_k(const unsigned char *s, size_t n)
+{
+    size_t i = 0, count = 0;
+    while (i + 16 <= n) {
+        size_t end = n - i > 16 * 255 ? i + 16 * 255 : n;
+        v16qu acc = {0};
+        for (; i + 16 <= end; i += 16)
+            acc -= (v16qu)((v16qi)load16(s + i) > -65);
+        for (int k = 0; k < 16; k++)
+            count += acc[k];
+    }
+    for (; i < n; i++)
+        count += (s[i] & 0xC0) != 0x80;
+    return count;
+}
+
+/*
+ * The converters below handle the longest valid prefix of their input,
+ * advance both pointers past it and return the number of code points.
+ * Destinations must hold one unit per source byte (UTF-8 to UTF-16 or
+ * UTF-32), three bytes per UTF-16 unit or four per UTF-32 unit.
+ */
+VINLINE size_t to_utf16_k(uint16_t **dp, const unsigned char **sp, size_t n,
+                          int lookup)
+{
+    const unsigned char *s = *sp;
+    uint16_t *d = *dp;
+    size_t v = valid_k(s, n, lookup);
+    size_t i = 0, chars = 0;
+
+    while (i < v) {
+        size_t end = v;
+        if (i + 16 <= v) {
+            v16qu in = load16(s + i);
+            if (UTF8_LE && !has_high(in)) {
+                widen16(d, in);
+                d += 16;
+                i += 16;
+                chars += 16;
+                continue;
+            }
+            end = i + 16;
+        }
+        while (i < end) {
+            uint32_t cp;
+            i += decode_valid(s + i, &cp);
+            if (cp < 0x10000) {
+                *d++ = cp;
+            } else {
+                cp -= 0x10000;
+                *d++ = 0xD800 | (cp >> 10);
+                *d++ = 0xDC00 | (cp & 0x3FF);
+            }
+            chars++;
+        }
+    }
+    *sp = s + i;
+    *dp = d;
+    return chars;
+}
+
+VINLINE size_t to_utf32_k(uint32_t **dp, const unsigned char **sp, size_t n,
+                          int lookup)
+{
+    const unsigned char *s = *sp;
+    uint32_t *d = *dp;
+    size_t v = valid_k(s, n, lookup);
+    size_t i = 0;
+
+    while (i < v) {
+        size_t end = v;
+        if (i + 16 <= v) {
+            v16qu in = load16(s + i);
+            if (UTF8_LE && !has_high(in)) {
+                widen32(d, in);
+                d += 16;
+                i += 16;
+                continue;
+            }
+            end = i + 16;
+        }
+        while (i < end) {
+            uint32_t cp;
+            i += decode_valid(s + i, &cp);
+            *d++ = cp;
+        }
+    }
+    *sp = s + i;
+    size_t chars = (size_t)(d - *dp);
+    *dp = d;
+    return chars;
+}
+
+VINLINE size_t from_utf16_k(unsigned char **dp, const uint16_t **sp,
+                            size_t n)
+{
+    const uint16_t *s = *sp;
+    unsigned char *d = *dp;
+    size_t i = 0, chars = 0;
+
+    while (i < n) {
+        size_t end = n;
+        if (i + 16 <= n) {
+            v16qu a = load16(s + i), b = load16(s + i + 8);
+            if (UTF8_LE && !any64(a | b, 0xFF80FF80FF80FF80ULL)) {
+                store16(d, narrow16(a, b));
+                d += 16;
+                i += 16;
+                chars += 16;
+                continue;
+            }
+            end = i + 16;
+        }
+        while (i < end) {
+            uint32_t cp = s[i];
+            if (cp >= 0xD800 && cp <= 0xDFFF) {
+                if (cp > 0xDBFF || i + 1 >= n || s[i + 1] < 0xDC00 ||
+                    s[i + 1] > 0xDFFF)
+                    goto out;
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (s[i + 1] - 0xDC00);
+                i++;
+            }
+            d = put_utf8(d, cp);
+            i++;
+            chars++;
+        }
+    }
+out:
+    *sp = s + i;
+    *dp = d;
+    return chars;
+}
+
+VINLINE size_t from_utf32_k(unsigned char **dp, const uint32_t **sp,
+                            size_t n)
+{
+    const uint32_t *s = *sp;
+    unsigned char *d = *dp;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t end = n;
+        if (i + 16 <= n) {
+            v16qu a = load16(s + i), b = load16(s + i + 4);
+            v16qu c = load16(s + i + 8), e = load16(s + i + 12);
+            if (UTF8_LE && !any64(a | b | c | e, 0xFFFFFF80FFFFFF80ULL)) {
+                store16(d, narrow32(a, b, c, e));
+                d += 16;
+                i += 16;
+                continue;
+            }
+            end = i + 16;
+        }
+        for (; i < end; i++) {
+            uint32_t cp = s[i];
+            if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+                goto out;
+            d = put_utf8(d, cp);
+        }
+    }
+out:
+    *sp = s + i;
+    *dp = d;
+    return i;
+}
+
+/*
+ * Widen the ASCII prefix of a NUL-terminated string into at most n
+ * 32-bit units (d may be NULL to only measure it). Stops at the NUL or
+ * the first non-ASCII byte. Vector loads are aligned so they never
+ * touch a page past the terminator.
+ */
+VINLINE size_t mbs_ascii_k(uint32_t *d, const unsigned char *s, size_t n)
+{
+    size_t i = 0;
+    while (i < n && ((uintptr_t)(s + i) & 15)) {
+        if (s[i] == 0 || s[i] >= 0x80)
+            return i;
+        if (d)
+            d[i] = s[i];
+        i++;
+    }
+    while (n - i >= 16) {
+        v16qu in = *(const v16qu_a *)(s + i);
+        if (has_high(in | (v16qu)(in == 0)))
+            break;
+        if (UTF8_LE && d)
+            widen32(d + i, in);
+        else if (d)
+            for (int k = 0; k < 16; k++)
+                d[i + k] = in[k];
+        i += 16;
+    }
+    while (i < n && s[i] && s[i] < 0x80) {
+        if (d)
+            d[i] = s[i];
+        i++;
+    }
+    return i;
+}
+
+/* The same for a NUL-terminated string of 32-bit units. */
+VINLINE size_t wcs_ascii_k(unsigned char *d, const uint32_t *s, size_t n)
+{
+    size_t i = 0;
+    while (i < n && ((uintptr_t)(s + i) & 15)) {
+        if (s[i] - 1 >= 0x7F)
+            return i;
+        if (d)
+            d[i] = s[i];
+        i++;
+    }
+    while (n - i >= 16) {
+        const v4su_a *p = (const v4su_a *)(s + i);
+        v4su a = p[0];
+        if (any64((v16qu)(a - 1 >= 0x7F), ~0ULL))
+            break;
+        v4su b = p[1];
+        if (any64((v16qu)(b - 1 >= 0x7F), ~0ULL))
+            break;
+        v4su c = p[2];
+        if (any64((v16qu)(c - 1 >= 0x7F), ~0ULL))
+            break;
+        v4su e = p[3];
+        if (any64((v16qu)(e - 1 >= 0x7F), ~0ULL))
+            break;
+        if (UTF8_LE && d)
+            store16(d + i, narrow32((v16qu)a, (v16qu)b, (v16qu)c,
+                                    (v16qu)e));
+        else if (d)
+            for (int k = 0; k < 16; k++)
+                d[i + k] = s[i + k];
+        i += 16;
+    }
+    while (i < n && s[i] - 1 < 0x7F) {
+        if (d)
+            d[i] = s[i];
+        i++;
+    }
+    return i;
+}
+
+struct utf8_ops {
+    size_t (*ascii_len)(const unsigned char *, size_t);
+    size_t (*valid)(const unsigned char *, size_t);
+    size_t (*count)(const unsigned char *, size_t);
+    size_t (*to_utf16)(uint16_t **, const unsigned char **, size_t);
+    size_t (*to_utf32)(uint32_t **, const unsigned char **, size_t);
+    size_t (*from_utf16)(unsigned char **, const uint16_t **, size_t);
+    size_t (*from_utf32)(unsigned char **, const uint32_t **, size_t);
+    size_t (*mbs_ascii)(uint32_t *, const unsigned char *, size_t);
+    size_t (*wcs_ascii)(unsigned char *, const uint32_t *, size_t);
+};
+
+#define DEFINE_OPS(sfx, attr, lookup)                                       \
+    attr static size_t ascii_len_##sfx(const unsigned char *s, size_t n)  \
+    { return ascii_len_k(s, n); }                                         \
+    attr static size_t valid_##sfx(const unsigned char *s, size_t n)      \
+    { return valid_k(s, n, lookup); }                                     \
+    attr static size_t count_##sfx(const unsigned char *s, size_t n)      \
+    { return count_k(s, n); }                                             \
+    attr static size_t to_utf16_##sfx(uint16_t **d,                       \
+                                      const unsigned char **s, size_t n)  \
+    { return to_utf16_k(d, s, n, lookup); }                               \
+    attr static size_t to_utf32_##sfx(uint32_t **d,                       \
+                                      const unsigned char **s, size_t n)  \
+    { return to_utf32_k(d, s, n, lookup); }                               \
+    attr static size_t from_utf16_##sfx(unsigned char **d,                \
+                                        const uint16_t **s, size_t n)     \
+    { return from_utf16_k(d, s, n); }                                     \
+    attr static size_t from_utf32_##sfx(unsigned char **d,                \
+                                        const uint32_t **s, size_t n)     \
+    { return from_utf32_k(d, s, n); }                                     \
+    attr static size_t mbs_ascii_##sfx(uint32_t *d,                       \
+                                       const unsigned char *s, size_t n)  \
+    { return mbs_ascii_k(d, s, n); }                                      \
+    attr static size_t wcs_ascii_##sfx(unsigned char *d,                  \
+                                       const uint32_t *s, size_t n)       \
+    { return wcs_ascii_k(d, s, n); }                                      \
+    static const struct utf8_ops sfx##_ops = {                            \
+        ascii_len_##sfx, valid_##sfx, count_##sfx, to_utf16_##sfx,        \
+        to_utf32_##sfx, from_utf16_##sfx, from_utf32_##sfx,               \
+        mbs_ascii_##sfx, wcs_ascii_##sfx,                                 \
+    };
+
+/* SSE2 on x86_64, NEON on aarch64, plain scalar code elsewhere */
+DEFINE_OPS(base, , BASE_LOOKUP)
+
+#if defined(__x86_64__)
+DEFINE_OPS(avx2, __attribute__((target("avx2"))), 1)
+
+extern int __vlibc_cpu_has_avx2(void);
+#endif
+
+static const struct utf8_ops *utf8;
+
+/* Pick the kernels for this CPU. Safe to call more than once. */
+void __vlibc_utf8_init(void)
+{
+    if (__atomic_load_n(&utf8, __ATOMIC_ACQUIRE))
+        return;
+    const struct utf8_ops *ops = &base_ops;
+#if defined(__x86_64__)
+    if (__vlibc_cpu_has_avx2())
+        ops = &avx2_ops;
+#endif
+    __atomic_store_n(&utf8, ops, __ATOMIC_RELEASE);
+}
+
+static inline const struct utf8_ops *ops(void)
+{
+    const struct utf8_ops *o = __atomic_load_n(&utf8, __ATOMIC_ACQUIRE);
+    if (!o) {
+        __vlibc_utf8_init();
+        o = utf8;
+    }
+    return o;
+}
+
+size_t __vlibc_ascii_len(const unsigned char *s, size_t n)
+{
+    return ops()->ascii_len(s, n);
+}
+
+size_t __vlibc_utf8_to_utf16(uint16_t **d, const unsigned char **s,
+                             size_t n)
+{
+    return ops()->to_utf16(d, s, n);
+}
+
+size_t __vlibc_utf16_to_utf8(unsigned char **d, const uint16_t **s,
+                             size_t n)
+{
+    return ops()->from_utf16(d, s, n);
+}
+
+size_t __vlibc_mbs_ascii(uint32_t *d, const char *s, size_t n)
+{
+    return ops()->mbs_ascii(d, (const unsigned char *)s, n);
+}
+
+size_t __vlibc_wcs_ascii(char *d, const uint32_t *s, size_t n)
+{
+    return ops()->wcs_ascii((unsigned char *)d, s, n);
+}
+
+/* Length of the longest prefix of s that is valid UTF-8. */
+size_t vlibc_utf8_valid(const char *s, size_t n)
+{
+    return ops()->valid((const unsigned char *)s, n);
+}
+
+/* Number of code points in valid UTF-8. */
+size_t vlibc_utf8_count(const char *s, size_t n)
+{
+    return ops()->count((const unsigned char *)s, n);
+}
+
+/*
+ * vlibc_utf8_to_utf16() - convert n bytes of UTF-8 to native-endian
+ * UTF-16. dst must have room for n units. Returns the number of units
+ * written or -1 with errno set to EILSEQ when the input is not valid.
+ */
+size_t vlibc_utf8_to_utf16(uint16_t *dst, const char *src, size_t n)
+{
+    const unsigned char *s = (const unsigned char *)src;
+    uint16_t *d = dst;
+    ops()->to_utf16(&d, &s, n);
+    if (s != (const unsigned char *)src + n) {
+        errno = EILSEQ;
+        return (size_t)-1;
+    }
+    return (size_t)(d - dst);
+}
+
+/* Convert n bytes of UTF-8 to UTF-32; dst must have room for n units. */
+size_t vlibc_utf8_to_utf32(uint32_t *dst, const char *src, size_t n)
+{
+    const unsigned char *s = (const unsigned char *)src;
+    uint32_t *d = dst;
+    ops()->to_utf32(&d, &s, n);
+    if (s != (const unsigned char *)src + n) {
+        errno = EILSEQ;
+        return (size_t)-1;
+    }
+    return (size_t)(d - dst);
+}
+
+/*
+ * vlibc_utf16_to_utf8() - convert n native-endian UTF-16 units to UTF-8.
+ * dst must have room for 3 * n bytes. Returns the number of bytes
+ * written or -1 with errno set to EILSEQ on an unpaired surrogate.
+ */
+size_t vlibc_utf16_to_utf8(char *dst, const uint16_t *src, size_t n)
+{
+    const uint16_t *s = src;
+    unsigned char *d = (unsigned char *)dst;
+    ops()->from_utf16(&d, &s, n);
+    if (s != src + n) {
+        errno = EILSEQ;
+        return (size_t)-1;
+    }
+    return (size_t)(d - (unsigned char *)dst);
+}
+
+/* Convert n UTF-32 units to UTF-8; dst must have room for 4 * n bytes. */
+size_t vlibc_utf32_to_utf8(char *dst, const uint32_t *src, size_t n)
+{
+    const uint32_t *s = src;
+    unsigned char *d = (unsigned char *)dst;
+    ops()->from_utf32(&d, &s, n);
+    if (s != src + n) {
+        errno = EILSEQ;
+        return (size_t)-1;
+    }
+    return (size_t)(d - (unsigned char *)dst);
+}
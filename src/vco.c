@@ -0,0 +1,756 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the coroutine runtime for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "vco.h"
+#include "ucontext.h"
+#include "pthread.h"
+#include "sched.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "unistd.h"
+#include "poll.h"
+#include "io.h"
+#include "fcntl.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include "syscall.h"
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+/*
+ * Each worker thread runs a scheduler loop on its own stack and switches
+ * into coroutines with vlibc_swapcontext_nosig(). A coroutine gives up
+ * the CPU by switching back to the scheduler after recording in
+ * worker->after what should happen to it: requeue, arm an epoll watch,
+ * release a lock or retire. The scheduler carries that out only once
+ * the coroutine's registers are saved, so no other worker can resume a
+ * half switched coroutine.
+ *
+ * Run queues are spinlocked rings. The owner takes from the front and
+ * thieves from the back. Parked coroutines wait in per-descriptor lists,
+ * one for input and one for output, so a reader and a writer can share
+ * a socket. The descriptor is registered on a shared epoll instance with
+ * EPOLLONESHOT and the union of the waiters' events; whichever worker
+ * polls the event queues the matching waiters and re-arms for the rest.
+ * An eventfd in the same set wakes idle workers when work appears.
+ */
+
+#define VCO_DEFAULT_STACK (64 * 1024)
+#define VCO_POOL_MAX      4096
+#define VCO_POLL_EVERY    61
+#define VCO_EVENTS        64
+#define VCO_WAKE_TAG      UINT64_MAX   /* epoll data of the eventfd */
+#define VCO_IN_EVENTS     (EPOLLIN | EPOLLPRI)
+
+enum { CO_READY, CO_RUNNING, CO_DONE };
+enum { AFTER_NONE, AFTER_REQUEUE, AFTER_PARK_FD, AFTER_UNLOCK, AFTER_EXIT };
+
+struct vco {
+    ucontext_t ctx;
+    stack_t stack;
+    void *(*fn)(void *);
+    void *arg;
+    void *ret;
+    pthread_spinlock_t lock;    /* guards state, joiner and ext_join */
+    int state;
+    struct vco *joiner;         /* coroutine blocked in vco_join */
+    int ext_join;               /* a plain thread waits in vco_join */
+    int wait_fd;
+    unsigned wait_events;       /* EPOLL* bits being waited for */
+    int wait_err;
+    struct vco *next_in;        /* input waiters of wait_fd */
+    struct vco *next_out;       /* output waiters of wait_fd */
+    struct vco *next_wake;      /* batch queued by poll_events() */
+};
+
+/* Coroutines parked on one descriptor, indexed by fd in rt.fds. */
+struct fd_wait {
+    struct vco *in;
+    struct vco *out;
+    int owned;                  /* made non-blocking by vco_fd_attach */
+    int saved_flags;            /* file status flags before attaching */
+};
+
+struct worker {
+    pthread_t thread;
+    ucontext_t sched;
+    struct vco *current;
+    int after;
+    pthread_spinlock_t *after_lock;
+    unsigned ticks;
+    pthread_spinlock_t qlock;
+    struct vco **q;
+    size_t head, cap;
+    atomic_size_t len;
+};
+
+static struct {
+    pthread_mutex_t init_lock;
+    int ready;
+    struct worker *w;
+    int nworkers;
+    int epfd, efd;
+    size_t stack_size;
+    ucontext_t tmpl;
+    atomic_long live;
+    atomic_int sleepers;
+    atomic_int stop;
+    atomic_uint next;
+    pthread_spinlock_t pool_lock;
+    stack_t *pool;
+    size_t pool_len;
+    pthread_mutex_t join_lock;
+    pthread_cond_t join_cond;
+    pthread_mutex_t fd_lock;    /* guards fds and the waiter lists */
+    struct fd_wait *fds;
+    size_t nfds;
+} rt = { .init_lock = PTHREAD_MUTEX_INITIALIZER,
+         .join_lock = PTHREAD_MUTEX_INITIALIZER,
+         .fd_lock = PTHREAD_MUTEX_INITIALIZER };
+
+static __thread struct worker *tls_worker;
+
+/* Hook consulted by read() and write() in src/io.c. */
+extern int (*__vlibc_io_wait)(int fd, int events);
+
+/*
+ * The worker must be looked up again after every switch because the
+ * coroutine may now run on another thread. Keeping the lookup out of
+ * line stops the compiler from reusing a thread pointer read earlier.
+ */
+static __attribute__((noinline)) struct worker *self(void)
+{
+    struct worker *w = tls_worker;
+    __asm__ volatile("" ::: "memory");
+    return w;
+}
+
+static long sys_epoll_ctl(int op, int fd, struct epoll_event *ev)
+{
+    return vlibc_syscall4(SYS_epoll_ctl, rt.epfd, op, fd, (long)ev);
+}
+
+static void wake_idle(void)
+{
+    if (atomic_load(&rt.sleepers) > 0) {
+        uint64_t one = 1;
+        vlibc_syscall3(SYS_write, rt.efd, (long)&one, sizeof(one));
+    }
+}
+
+/*
+ * Append co to the back of w's run queue. Idle workers are woken when
+ * the queue already holds work they could steal or when the push comes
+ * from another thread, whose target may be asleep.
+ */
+static void q_push(struct worker *w, struct vco *co)
+{
+    pthread_spin_lock(&w->qlock);
+    size_t len = atomic_load_explicit(&w->len, memory_order_relaxed);
+    if (len == w->cap) {
+        size_t ncap = w->cap ? w->cap * 2 : 64;
+        struct vco **nq = malloc(ncap * sizeof(*nq));
+        if (!nq) {
+            /* keep the coroutine runnable rather than lose it */
+            pthread_spin_unlock(&w->qlock);
+            sched_yield();
+            q_push(w, co);
+            return;
+        }
+        for (size_t i = 0; i < len; i++)
+            nq[i] = w->q[(w->head + i) % w->cap];
+        free(w->q);
+        w->q = nq;
+        w->cap = ncap;
+        w->head = 0;
+    }
+    w->q[(w->head + len) % w->cap] = co;
+    atomic_store(&w->len, len + 1);
+    pthread_spin_unlock(&w->qlock);
+    if (len > 0 || tls_worker != w)
+        wake_idle();
+}
+
+static struct vco *q_take(struct worker *w, int back)
+{
+    if (atomic_load_explicit(&w->len, memory_order_relaxed) == 0)
+        return NULL;
+    struct vco *co = NULL;
+    pthread_spin_lock(&w->qlock);
+    size_t len = atomic_load_explicit(&w->len, memory_order_relaxed);
+    if (len) {
+        if (back) {
+            co = w->q[(w->head + len - 1) % w->cap];
+        } else {
+            co = w->q[w->head];
+            w->head = (w->head + 1) % w->cap;
+        }
+        atomic_store(&w->len, len - 1);
+    }
+    pthread_spin_unlock(&w->qlock);
+    return co;
+}
+
+/* Take work from the back of another worker's queue. */
+static struct vco *steal(struct worker *w)
+{
+    int n = rt.nworkers;
+    int start = (int)(w - rt.w);
+    for (int i = 1; i < n; i++) {
+        struct vco *co = q_take(&rt.w[(start + i) % n], 1);
+        if (co)
+            return co;
+    }
+    return NULL;
+}
+
+static int work_available(void)
+{
+    for (int i = 0; i < rt.nworkers; i++)
+        if (atomic_load(&rt.w[i].len))
+            return 1;
+    return atomic_load(&rt.stop);
+}
+
+/* Return the wait slot of fd, growing the table. Needs rt.fd_lock. */
+static struct fd_wait *fd_slot(int fd)
+{
+    if (fd < 0)
+        return NULL;
+    if ((size_t)fd >= rt.nfds) {
+        size_t n = rt.nfds ? rt.nfds : 64;
+        while (n <= (size_t)fd)
+            n *= 2;
+        struct fd_wait *t = realloc(rt.fds, n * sizeof(*t));
+        if (!t)
+            return NULL;
+        memset(t + rt.nfds, 0, (n - rt.nfds) * sizeof(*t));
+        rt.fds = t;
+        rt.nfds = n;
+    }
+    return &rt.fds[fd];
+}
+
+static void unlink_waiter(struct vco **list, struct vco *co, int out)
+{
+    for (; *list; list = out ? &(*list)->next_out : &(*list)->next_in) {
+        if (*list == co) {
+            *list = out ? co->next_out : co->next_in;
+            return;
+        }
+    }
+}
+
+/*
+ * Register fd for the events its remaining waiters need. Needs
+ * rt.fd_lock. Returns 0 or a negative errno value.
+ */
+static long fd_arm(int fd, struct fd_wait *s)
+{
+    unsigned mask = s->out ? EPOLLOUT : 0;
+    for (struct vco *c = s->in; c; c = c->next_in)
+        mask |= c->wait_events & VCO_IN_EVENTS;
+    if (!mask)
+        return 0;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = mask | EPOLLONESHOT;
+    ev.data.u64 = (uint64_t)fd;
+    long r = sys_epoll_ctl(EPOLL_CTL_MOD, fd, &ev);
+    if (r == -ENOENT)
+        r = sys_epoll_ctl(EPOLL_CTL_ADD, fd, &ev);
+    return r < 0 ? r : 0;
+}
+
+/*
+ * Move the waiters of one direction onto the *wake chain. A coroutine
+ * waiting for both directions is also dropped from the other list.
+ */
+static void take_waiters(struct fd_wait *s, int out, struct vco **wake,
+                         int err)
+{
+    struct vco *co = out ? s->out : s->in;
+    if (out)
+        s->out = NULL;
+    else
+        s->in = NULL;
+    while (co) {
+        struct vco *next = out ? co->next_out : co->next_in;
+        if (!out && (co->wait_events & EPOLLOUT))
+            unlink_waiter(&s->out, co, 1);
+        if (out && (co->wait_events & VCO_IN_EVENTS))
+            unlink_waiter(&s->in, co, 0);
+        co->wait_err = err;
+        co->next_wake = *wake;
+        *wake = co;
+        co = next;
+    }
+}
+
+/* Queue the coroutines whose descriptors became ready. */
+static void poll_events(struct worker *w, int timeout)
+{
+    struct epoll_event ev[VCO_EVENTS];
+    long n = vlibc_syscall6(SYS_epoll_pwait, rt.epfd, (long)ev, VCO_EVENTS,
+                            timeout, 0, 8);
+    struct vco *wake = NULL;
+    if (n > 0)
+        pthread_mutex_lock(&rt.fd_lock);
+    for (long i = 0; i < n; i++) {
+        if (ev[i].data.u64 == VCO_WAKE_TAG) {
+            /* left readable on shutdown so every worker sees it */
+            if (!atomic_load(&rt.stop)) {
+                uint64_t cnt;
+                vlibc_syscall3(SYS_read, rt.efd, (long)&cnt, sizeof(cnt));
+            }
+            continue;
+        }
+        int fd = (int)ev[i].data.u64;
+        if ((size_t)fd >= rt.nfds)
+            continue;
+        struct fd_wait *s = &rt.fds[fd];
+        unsigned rev = ev[i].events;
+        if (rev & (VCO_IN_EVENTS | EPOLLERR | EPOLLHUP))
+            take_waiters(s, 0, &wake, 0);
+        if (rev & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+            take_waiters(s, 1, &wake, 0);
+        long r = fd_arm(fd, s);
+        if (r < 0) {
+            take_waiters(s, 0, &wake, (int)-r);
+            take_waiters(s, 1, &wake, (int)-r);
+        }
+    }
+    if (n > 0)
+        pthread_mutex_unlock(&rt.fd_lock);
+    while (wake) {
+        struct vco *co = wake;
+        wake = co->next_wake;
+        q_push(w, co);
+    }
+}
+
+static int stack_get(stack_t *ss)
+{
+    pthread_spin_lock(&rt.pool_lock);
+    if (rt.pool_len) {
+        *ss = rt.pool[--rt.pool_len];
+        pthread_spin_unlock(&rt.pool_lock);
+        return 0;
+    }
+    pthread_spin_unlock(&rt.pool_lock);
+    return vlibc_stack_alloc(ss, rt.stack_size);
+}
+
+static void stack_put(stack_t *ss)
+{
+    pthread_spin_lock(&rt.pool_lock);
+    if (rt.pool_len < VCO_POOL_MAX) {
+        rt.pool[rt.pool_len++] = *ss;
+        pthread_spin_unlock(&rt.pool_lock);
+        return;
+    }
+    pthread_spin_unlock(&rt.pool_lock);
+    vlibc_stack_free(ss);
+}
+
+/* Mark co finished and hand it to whoever waits in vco_join(). */
+static void retire(struct worker *w, struct vco *co)
+{
+    stack_put(&co->stack);
+    pthread_spin_lock(&co->lock);
+    co->state = CO_DONE;
+    struct vco *j = co->joiner;
+    int ext = co->ext_join;
+    pthread_spin_unlock(&co->lock);
+    if (j)
+        q_push(w, j);
+    long left = atomic_fetch_sub(&rt.live, 1) - 1;
+    if (ext || left == 0) {
+        pthread_mutex_lock(&rt.join_lock);
+        pthread_cond_broadcast(&rt.join_cond);
+        pthread_mutex_unlock(&rt.join_lock);
+    }
+}
+
+/*
+ * Add co to the waiter lists of its descriptor and re-arm the epoll
+ * watch; on failure resume the coroutine at once.
+ */
+static void park_fd(struct worker *w, struct vco *co)
+{
+    int fd = co->wait_fd;
+    pthread_mutex_lock(&rt.fd_lock);
+    struct fd_wait *s = fd_slot(fd);
+    long r = -ENOMEM;
+    if (s) {
+        if (co->wait_events & VCO_IN_EVENTS) {
+            co->next_in = s->in;
+            s->in = co;
+        }
+        if (co->wait_events & EPOLLOUT) {
+            co->next_out = s->out;
+            s->out = co;
+        }
+        r = fd_arm(fd, s);
+        if (r < 0) {
+            unlink_waiter(&s->in, co, 0);
+            unlink_waiter(&s->out, co, 1);
+        }
+    }
+    pthread_mutex_unlock(&rt.fd_lock);
+    if (r < 0) {
+        co->wait_err = (int)-r;
+        q_push(w, co);
+    }
+}
+
+static void run(struct worker *w, struct vco *co)
+{
+    w->current = co;
+    w->after = AFTER_NONE;
+    co->state = CO_RUNNING;
+    vlibc_swapcontext_nosig(&w->sched, &co->ctx);
+    w->current = NULL;
+    switch (w->after) {
+    case AFTER_REQUEUE:
+        co->state = CO_READY;
+        q_push(w, co);
+        break;
+    case AFTER_PARK_FD:
+        co->state = CO_READY;
+        park_fd(w, co);
+        break;
+    case AFTER_UNLOCK:
+        co->state = CO_READY;
+        pthread_spin_unlock(w->after_lock);
+        break;
+    case AFTER_EXIT:
+        retire(w, co);
+        break;
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    tls_worker = w;
+    while (!atomic_load(&rt.stop)) {
+        struct vco *co = q_take(w, 0);
+        if (!co)
+            co = steal(w);
+        if (co) {
+            run(w, co);
+            /* busy workers still look at the event queue now and then */
+            if (++w->ticks % VCO_POLL_EVERY == 0)
+                poll_events(w, 0);
+            continue;
+        }
+        atomic_fetch_add(&rt.sleepers, 1);
+        poll_events(w, work_available() ? 0 : -1);
+        atomic_fetch_sub(&rt.sleepers, 1);
+    }
+    return NULL;
+}
+
+/* Return to the scheduler, which then performs the given action. */
+static void switch_out(int after)
+{
+    struct worker *w = self();
+    struct vco *co = w->current;
+    w->after = after;
+    vlibc_swapcontext_nosig(&co->ctx, &w->sched);
+}
+
+static void co_entry(void)
+{
+    struct vco *co = self()->current;
+    co->ret = co->fn(co->arg);
+    switch_out(AFTER_EXIT);
+}
+
+/*
+ * makecontext() needs a context filled in by getcontext(). One copy is
+ * captured here and reused for every coroutine. It is only ever resumed
+ * through makecontext(), never at this call site.
+ */
+static __attribute__((noinline)) void capture_template(void)
+{
+    getcontext(&rt.tmpl);
+}
+
+/*
+ * read() and write() park only on descriptors handed to vco_fd_attach();
+ * one the program made non-blocking itself keeps reporting EAGAIN.
+ */
+static int io_wait(int fd, int events)
+{
+    if (!vco_self())
+        return -1;
+    pthread_mutex_lock(&rt.fd_lock);
+    int owned = fd >= 0 && (size_t)fd < rt.nfds && rt.fds[fd].owned;
+    pthread_mutex_unlock(&rt.fd_lock);
+    if (!owned)
+        return -1;
+    return vco_wait_fd(fd, events);
+}
+
+int vco_init(int nworkers, size_t stack_size)
+{
+    pthread_mutex_lock(&rt.init_lock);
+    if (rt.ready) {
+        pthread_mutex_unlock(&rt.init_lock);
+        return 0;
+    }
+    if (nworkers <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = n > 0 ? (int)n : 1;
+    }
+    rt.stack_size = stack_size ? stack_size : VCO_DEFAULT_STACK;
+    rt.nworkers = nworkers;
+    rt.pool_len = 0;
+    atomic_store(&rt.live, 0);
+    atomic_store(&rt.stop, 0);
+    pthread_spin_init(&rt.pool_lock, 0);
+    pthread_cond_init(&rt.join_cond, NULL);
+    capture_template();
+
+    long ep = vlibc_syscall1(SYS_epoll_create1, EPOLL_CLOEXEC);
+    long ef = vlibc_syscall2(SYS_eventfd2, 0, O_NONBLOCK | O_CLOEXEC);
+    rt.w = calloc((size_t)nworkers, sizeof(*rt.w));
+    rt.pool = malloc(VCO_POOL_MAX * sizeof(*rt.pool));
+    if (ep < 0 || ef < 0 || !rt.w || !rt.pool)
+        goto fail;
+    rt.epfd = (int)ep;
+    rt.efd = (int)ef;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = VCO_WAKE_TAG;
+    if (sys_epoll_ctl(EPOLL_CTL_ADD, rt.efd, &ev) < 0)
+        goto fail;
+
+    int started = 0;
+    for (; started < nworkers; started++) {
+        pthread_spin_init(&rt.w[started].qlock, 0);
+        if (pthread_create(&rt.w[started].thread, NULL, worker_main,
+                           &rt.w[started]) != 0)
+            break;
+    }
+    if (started < nworkers) {
+        atomic_store(&rt.stop, 1);
+        uint64_t one = 1;
+        vlibc_syscall3(SYS_write, rt.efd, (long)&one, sizeof(one));
+        for (int i = 0; i < started; i++)
+            pthread_join(rt.w[i].thread, NULL);
+        goto fail;
+    }
+
+    __vlibc_io_wait = io_wait;
+    rt.ready = 1;
+    pthread_mutex_unlock(&rt.init_lock);
+    return 0;
+
+fail:
+    if (ep >= 0)
+        close((int)ep);
+    if (ef >= 0)
+        close((int)ef);
+    free(rt.w);
+    free(rt.pool);
+    rt.w = NULL;
+    rt.pool = NULL;
+    pthread_mutex_unlock(&rt.init_lock);
+    errno = ep < 0 ? (int)-ep : ef < 0 ? (int)-ef : EAGAIN;
+    return -1;
+}
+
+void vco_shutdown(void)
+{
+    pthread_mutex_lock(&rt.init_lock);
+    if (!rt.ready) {
+        pthread_mutex_unlock(&rt.init_lock);
+        return;
+    }
+    pthread_mutex_lock(&rt.join_lock);
+    while (atomic_load(&rt.live) > 0)
+        pthread_cond_wait(&rt.join_cond, &rt.join_lock);
+    pthread_mutex_unlock(&rt.join_lock);
+
+    __vlibc_io_wait = NULL;
+    atomic_store(&rt.stop, 1);
+    uint64_t one = 1;
+    vlibc_syscall3(SYS_write, rt.efd, (long)&one, sizeof(one));
+    for (int i = 0; i < rt.nworkers; i++) {
+        pthread_join(rt.w[i].thread, NULL);
+        free(rt.w[i].q);
+    }
+    for (size_t i = 0; i < rt.pool_len; i++)
+        vlibc_stack_free(&rt.pool[i]);
+    close(rt.epfd);
+    close(rt.efd);
+    free(rt.w);
+    free(rt.pool);
+    rt.w = NULL;
+    rt.pool = NULL;
+    rt.ready = 0;
+    pthread_mutex_unlock(&rt.init_lock);
+}
+
+vco_t *vco_spawn(void *(*fn)(void *), void *arg)
+{
+    if (!fn) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!rt.ready && vco_init(0, 0) != 0)
+        return NULL;
+    struct vco *co = calloc(1, sizeof(*co));
+    if (!co)
+        return NULL;
+    if (stack_get(&co->stack) != 0) {
+        free(co);
+        return NULL;
+    }
+    co->fn = fn;
+    co->arg = arg;
+    pthread_spin_init(&co->lock, 0);
+    co->ctx = rt.tmpl;
+    co->ctx.uc_stack = co->stack;
+    co->ctx.uc_link = NULL;
+    makecontext(&co->ctx, co_entry, 0);
+    atomic_fetch_add(&rt.live, 1);
+
+    struct worker *w = self();
+    if (!w)
+        w = &rt.w[atomic_fetch_add(&rt.next, 1) % (unsigned)rt.nworkers];
+    q_push(w, co);
+    return co;
+}
+
+vco_t *vco_self(void)
+{
+    struct worker *w = self();
+    return w ? w->current : NULL;
+}
+
+void vco_yield(void)
+{
+    if (!vco_self()) {
+        sched_yield();
+        return;
+    }
+    switch_out(AFTER_REQUEUE);
+}
+
+int vco_join(vco_t *co, void **retval)
+{
+    if (!co) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct vco *me = vco_self();
+    if (me == co) {
+        errno = EDEADLK;
+        return -1;
+    }
+    pthread_spin_lock(&co->lock);
+    if (co->state != CO_DONE) {
+        if (me) {
+            /* the scheduler drops the lock once we are switched out */
+            co->joiner = me;
+            self()->after_lock = &co->lock;
+            switch_out(AFTER_UNLOCK);
+        } else {
+            co->ext_join = 1;
+            pthread_spin_unlock(&co->lock);
+            pthread_mutex_lock(&rt.join_lock);
+            for (;;) {
+                pthread_spin_lock(&co->lock);
+                int done = co->state == CO_DONE;
+                pthread_spin_unlock(&co->lock);
+                if (done)
+                    break;
+                pthread_cond_wait(&rt.join_cond, &rt.join_lock);
+            }
+            pthread_mutex_unlock(&rt.join_lock);
+        }
+    } else {
+        pthread_spin_unlock(&co->lock);
+    }
+    /* retire() may still hold the lock for a moment */
+    pthread_spin_lock(&co->lock);
+    pthread_spin_unlock(&co->lock);
+    if (retval)
+        *retval = co->ret;
+    free(co);
+    return 0;
+}
+
+int vco_wait_fd(int fd, int events)
+{
+    struct vco *co = vco_self();
+    if (!co) {
+        errno = EPERM;
+        return -1;
+    }
+    co->wait_fd = fd;
+    co->wait_events = ((events & POLLIN) ? EPOLLIN : 0) |
+                      ((events & POLLOUT) ? EPOLLOUT : 0) |
+                      ((events & POLLPRI) ? EPOLLPRI : 0);
+    if (!co->wait_events) {
+        errno = EINVAL;
+        return -1;
+    }
+    co->wait_err = 0;
+    switch_out(AFTER_PARK_FD);
+    if (co->wait_err) {
+        errno = co->wait_err;
+        return -1;
+    }
+    return 0;
+}
+
+int vco_fd_attach(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0)
+        return -1;
+    pthread_mutex_lock(&rt.fd_lock);
+    struct fd_wait *s = fd_slot(fd);
+    if (!s) {
+        pthread_mutex_unlock(&rt.fd_lock);
+        errno = ENOMEM;
+        return -1;
+    }
+    if (!s->owned) {
+        if (!(flags & O_NONBLOCK) &&
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            pthread_mutex_unlock(&rt.fd_lock);
+            return -1;
+        }
+        s->owned = 1;
+        s->saved_flags = flags;
+    }
+    pthread_mutex_unlock(&rt.fd_lock);
+    return 0;
+}
+
+int vco_fd_detach(int fd)
+{
+    pthread_mutex_lock(&rt.fd_lock);
+    int r = 0;
+    if (fd >= 0 && (size_t)fd < rt.nfds && rt.fds[fd].owned) {
+        rt.fds[fd].owned = 0;
+        r = fcntl(fd, F_SETFL, rt.fds[fd].saved_flags);
+    }
+    pthread_mutex_unlock(&rt.fd_lock);
+    return r < 0 ? -1 : 0;
+}
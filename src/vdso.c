@@ -0,0 +1,133 @@
+/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the vDSO lookup used by the time functions for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "time.h"
+#include "errno.h"
+#include <stdint.h>
+#ifdef __linux__
+#include <elf.h>
+#endif
+
+/*
+ * The kernel maps a small shared object, the vDSO, into every Linux
+ * process and passes its address as AT_SYSINFO_EHDR in the aux vector.
+ * Its clock routines read the time from a shared page without entering
+ * the kernel. The entry points are resolved once and cached; every
+ * wrapper returns -ENOSYS when no vDSO routine is available so the
+ * caller can fall back to the system call.
+ */
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define VLIBC_HAVE_VDSO 1
+#endif
+
+#ifdef VLIBC_HAVE_VDSO
+
+extern void *__vlibc_dl_image_sym(const void *ehdr, const char *name);
+
+typedef int (*vdso_clock_gettime_fn)(int, struct timespec *);
+typedef int (*vdso_gettimeofday_fn)(struct timeval *, void *);
+typedef time_t (*vdso_time_fn)(time_t *);
+
+static vdso_clock_gettime_fn vdso_clock_gettime;
+static vdso_gettimeofday_fn vdso_gettimeofday;
+static vdso_time_fn vdso_time;
+static int vdso_ready;
+
+extern unsigned long __vlibc_auxval(unsigned long type);
+
+/* Resolve the vDSO entry points. Safe to call more than once. */
+void __vlibc_vdso_init(void)
+{
+    if (__atomic_load_n(&vdso_ready, __ATOMIC_ACQUIRE))
+        return;
+
+    const void *ehdr = (const void *)__vlibc_auxval(AT_SYSINFO_EHDR);
+    if (ehdr) {
+#ifdef __x86_64__
+        vdso_clock_gettime = (vdso_clock_gettime_fn)
+            __vlibc_dl_image_sym(ehdr, "__vdso_clock_gettime");
+        vdso_gettimeofday = (vdso_gettimeofday_fn)
+            __vlibc_dl_image_sym(ehdr, "__vdso_gettimeofday");
+        vdso_time = (vdso_time_fn)__vlibc_dl_image_sym(ehdr, "__vdso_time");
+#else
+        vdso_clock_gettime = (vdso_clock_gettime_fn)
+            __vlibc_dl_image_sym(ehdr, "__kernel_clock_gettime");
+        vdso_gettimeofday = (vdso_gettimeofday_fn)
+            __vlibc_dl_image_sym(ehdr, "__kernel_gettimeofday");
+#endif
+    }
+    __atomic_store_n(&vdso_ready, 1, __ATOMIC_RELEASE);
+}
+
+/* Call the vDSO clock_gettime. Returns 0 or a negative errno value. */
+int __vlibc_vdso_clock_gettime(int clk_id, struct timespec *ts)
+{
+    __vlibc_vdso_init();
+    if (!vdso_clock_gettime)
+        return -ENOSYS;
+    return vdso_clock_gettime(clk_id, ts);
+}
+
+/* Call the vDSO gettimeofday. Returns 0 or a negative errno value. */
+int __vlibc_vdso_gettimeofday(struct timeval *tv, void *tz)
+{
+    __vlibc_vdso_init();
+    if (!vdso_gettimeofday)
+        return -ENOSYS;
+    return vdso_gettimeofday(tv, tz);
+}
+
+/*
+ * Store the current time in *out using the vDSO. time() is derived from
+ * clock_gettime() where the vDSO has no dedicated entry.
+ */
+int __vlibc_vdso_time(time_t *out)
+{
+    __vlibc_vdso_init();
+    if (vdso_time) {
+        *out = vdso_time(NULL);
+        return 0;
+    }
+    if (vdso_clock_gettime) {
+        struct timespec ts;
+        int ret = vdso_clock_gettime(CLOCK_REALTIME, &ts);
+        if (ret == 0)
+            *out = ts.tv_sec;
+        return ret;
+    }
+    return -ENOSYS;
+}
+
+#else /* !VLIBC_HAVE_VDSO */
+
+void __vlibc_vdso_init(void)
+{
+}
+
+int __vlibc_vdso_clock_gettime(int clk_id, struct timespec *ts)
+{
+    (void)clk_id;
+    (void)ts;
+    return -ENOSYS;
+}
+
+int __vlibc_vdso_gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tv;
+    (void)tz;
+    return -ENOSYS;
+}
+
+int __vlibc_vdso_time(time_t *out)
+{
+    (void)out;
+    return -ENOSYS;
+}
+
+#endif
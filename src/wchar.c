@@ -7,6 +7,7 @@
  */
 
 #include "wchar.h"
+#include "wctype.h"
 #include "memory.h"
 #include "errno.h"
 #include "string.h"
@@ -65,23 +66,14 @@ size_t wcslen(const wchar_t *s)
     return (size_t)(p - s);
 }
 
-/* Return column width of wide character or -1 if non-printable. */
+/*
+ * Return column width of wide character or -1 if non-printable.
+ * Combining marks and format characters take no columns and East
+ * Asian wide and fullwidth characters take two.
+ */
 int wcwidth(wchar_t wc)
 {
-    if (wc == 0)
-        return 0;
-    if (wc >= 0x20 && wc < 0x7f)
-        return 1;
-    if (wc < 0x20 || wc == 0x7f)
-        return -1;
-#if defined(__FreeBSD__) || defined(__NetBSD__) || \
-    defined(__OpenBSD__) || defined(__DragonFly__)
-    extern int host_wcwidth(wchar_t) __asm("wcwidth");
-    return host_wcwidth(wc);
-#else
-    (void)wc;
-    return -1;
-#endif
+    return __vlibc_wprop((wint_t)wc)->width;
 }
 
 /* Sum of column widths of up to n wide characters. */
@@ -84,63 +84,36 @@ int wctob(wchar_t wc)
 }
 
 
-/* Check if multibyte string contains non-ASCII characters. */
-static int has_non_ascii_mb(const char *s)
-{
-    while (*s) {
-        if (((unsigned char)*s) >= 0x80)
-            return 1;
-        s++;
-    }
-    return 0;
-}
-
-/* Check if wide string contains non-ASCII characters. */
-static int has_non_ascii_wc(const wchar_t *s)
-{
-    while (*s) {
-        if ((unsigned)*s >= 0x80)
-            return 1;
-        s++;
-    }
-    return 0;
-}
+extern size_t __vlibc_mbs_ascii(uint32_t *d, const char *s, size_t n);
+extern size_t __vlibc_wcs_ascii(char *d, const uint32_t *s, size_t n);
 
-/* Convert a multibyte string to wide characters without iconv when possible. */
+/*
+ * Convert a multibyte string to wide characters without iconv when possible.
+ * The vector kernel widens ASCII 16 bytes at a time; the host converter
+ * only sees strings with other bytes before the limit.
+ */
 size_t mbstowcs(wchar_t *dst, const char *src, size_t n)
 {
-    if (has_non_ascii_mb(src))
+    if (!dst)
+        n = (size_t)-1;
+    size_t i = __vlibc_mbs_ascii((uint32_t *)dst, src, n);
+    if (i < n && src[i])
         return host_mbstowcs(dst, src, n);
-
-    size_t i = 0;
-    if (dst) {
-        for (; i < n && src[i]; i++)
-            dst[i] = (unsigned char)src[i];
-        if (i < n)
-            dst[i] = 0;
-    } else {
-        while (src[i])
-            i++;
-    }
+    if (dst && i < n)
+        dst[i] = 0;
     return i;
 }
 
 /* Convert wide character string to multibyte without iconv when possible. */
 size_t wcstombs(char *dst, const wchar_t *src, size_t n)
 {
-    if (has_non_ascii_wc(src))
+    if (!dst)
+        n = (size_t)-1;
+    size_t i = __vlibc_wcs_ascii(dst, (const uint32_t *)src, n);
+    if (i < n && src[i])
         return host_wcstombs(dst, src, n);
-
-    size_t i = 0;
-    if (dst) {
-        for (; i < n && src[i]; i++)
-            dst[i] = (char)src[i];
-        if (i < n)
-            dst[i] = 0;
-    } else {
-        while (src[i])
-            i++;
-    }
+    if (dst && i < n)
+        dst[i] = 0;
     return i;
 }
 
@@ -6,7 +6,21 @@
  * Copyright (c) 2025
  */
 
+#include <string.h>
+
 int plugin_value(void)
 {
     return 123;
 }
+
+/* Calls plugin_value() through the PLT so lazy binding is exercised. */
+int plugin_twice(void)
+{
+    return plugin_value() * 2;
+}
+
+/* Needs strlen from the C library the test program runs with. */
+size_t plugin_len(const char *s)
+{
+    return strlen(s);
+}
@@ -11,6 +11,8 @@
 #include "../include/io.h"
 #include "../include/sys/socket.h"
 #include "../include/sys/uio.h"
+#include "../include/syslog.h"
+#include <sys/un.h>
 #include "../include/sys/file.h"
 #include <netinet/in.h>
 #include "../include/arpa/inet.h"
@@ -23,6 +25,11 @@
 #include "../include/util.h"
 #include "../include/semaphore.h"
 #include "../include/sys/select.h"
+#include "../include/sys/epoll.h"
+#include "../include/sys/eventfd.h"
+#include "../include/sys/signalfd.h"
+#include "../include/sys/timerfd.h"
+#include "../include/evloop.h"
 #include "../include/poll.h"
 #include <dirent.h>
 #include "../include/vlibc.h"
@@ -53,6 +60,7 @@
 #include "../include/regex.h"
 #include "../include/ftw.h"
 #include "../include/fts.h"
+#include "../include/dirwalk.h"
 #include "../include/wordexp.h"
 #include "../include/vis.h"
 #include "../include/search.h"
@@ -77,6 +85,7 @@
 #include <openssl/evp.h>
 #include <setjmp.h>
 #include "ucontext.h"
+#include "../include/vco.h"
 #include "../include/time.h"
 #include "../include/sys/resource.h"
 #include "../include/sys/times.h"
@@ -730,6 +739,208 @@ static const char *test_sendfile_copy(void)
     return 0;
 }
 
+static const char *test_splice_tee(void)
+{
+    int a[2], b[2];
+    mu_assert("pipes", pipe(a) == 0 && pipe(b) == 0);
+    char msg[] = "spliced";
+    struct iovec iov = { msg, 7 };
+    mu_assert("vmsplice", vmsplice(a[1], &iov, 1, 0) == 7);
+    mu_assert("tee", tee(a[0], b[1], 7, 0) == 7);
+
+    const char *dst = "tmp_splice_dst";
+    int out = open(dst, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    mu_assert("open", out >= 0);
+    mu_assert("splice", splice(a[0], NULL, out, NULL, 7, SPLICE_F_MOVE) == 7);
+    char buf[8] = {0};
+    mu_assert("tee copy", read(b[0], buf, 7) == 7 && strcmp(buf, msg) == 0);
+    memset(buf, 0, sizeof(buf));
+    mu_assert("file", pread(out, buf, 7, 0) == 7 && strcmp(buf, msg) == 0);
+
+    int out2 = open("tmp_splice_dst2", O_CREAT | O_RDWR | O_TRUNC, 0644);
+    off_t off_in = 2, off_out = 0;
+    ssize_t r = copy_file_range(out, &off_in, out2, &off_out, 100, 0);
+    if (r < 0)
+        mu_assert("copy_file_range errno", errno == ENOSYS || errno == EXDEV);
+    else
+        mu_assert("copy_file_range", r == 5 && off_in == 7 && off_out == 5);
+
+    close(out2);
+    close(out);
+    close(a[0]); close(a[1]);
+    close(b[0]); close(b[1]);
+    unlink(dst);
+    unlink("tmp_splice_dst2");
+    return 0;
+}
+
+static const char *test_vlibc_copy_fd(void)
+{
+    const char *src = "tmp_copyfd_src";
+    const char *dst = "tmp_copyfd_dst";
+    size_t size = 300000;
+    char *data = malloc(size);
+    char *back = malloc(size);
+    mu_assert("alloc", data && back);
+    for (size_t i = 0; i < size; i++)
+        data[i] = (char)(i * 7 + i / 251);
+    int in = open(src, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    mu_assert("write src", in >= 0 && write(in, data, size) == (ssize_t)size);
+    lseek(in, 1000, SEEK_SET);
+
+    /* file to file: the whole rest, which advances both positions */
+    int out = open(dst, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    int method = 0;
+    ssize_t n = vlibc_copy_fd(in, out, SIZE_MAX, &method);
+    mu_assert("copy", n == (ssize_t)(size - 1000));
+    mu_assert("method", method >= VLIBC_COPY_RANGE &&
+              method <= VLIBC_COPY_BUFFER);
+    mu_assert("positions", lseek(in, 0, SEEK_CUR) == (off_t)size &&
+              lseek(out, 0, SEEK_CUR) == (off_t)(size - 1000));
+    mu_assert("read back", pread(out, back, size, 0) == (ssize_t)(size - 1000));
+    mu_assert("content", memcmp(back, data + 1000, size - 1000) == 0);
+    mu_assert("at eof", vlibc_copy_fd(in, out, 10, NULL) == 0);
+
+    /* file to pipe cannot use copy_file_range */
+    int p[2];
+    mu_assert("pipe", pipe(p) == 0);
+    lseek(in, 0, SEEK_SET);
+    mu_assert("to pipe", vlibc_copy_fd(in, p[1], 4000, &method) == 4000);
+    mu_assert("to pipe method", method != VLIBC_COPY_RANGE);
+    mu_assert("pipe data", read(p[0], back, size) == 4000 &&
+              memcmp(back, data, 4000) == 0);
+
+    /* pipe to file, stopping at end of input */
+    mu_assert("fill pipe", write(p[1], data, 3000) == 3000);
+    close(p[1]);
+    ftruncate(out, 0);
+    lseek(out, 0, SEEK_SET);
+    mu_assert("from pipe", vlibc_copy_fd(p[0], out, SIZE_MAX, &method) == 3000);
+    mu_assert("from pipe method", method == VLIBC_COPY_SPLICE ||
+              method == VLIBC_COPY_BUFFER);
+    mu_assert("pipe file", pread(out, back, size, 0) == 3000 &&
+              memcmp(back, data, 3000) == 0);
+
+    /* O_APPEND output refuses splice after input was already read */
+    close(out);
+    out = open(dst, O_WRONLY | O_APPEND | O_TRUNC);
+    lseek(in, 0, SEEK_SET);
+    mu_assert("append", vlibc_copy_fd(in, out, SIZE_MAX, NULL) ==
+              (ssize_t)size);
+    close(out);
+    out = open(dst, O_RDONLY);
+    mu_assert("append data", read(out, back, size) == (ssize_t)size &&
+              memcmp(back, data, size) == 0);
+
+    close(p[0]);
+    close(in);
+    close(out);
+    unlink(src);
+    unlink(dst);
+    free(data);
+    free(back);
+    return 0;
+}
+
+struct copy_reader {
+    int fd;
+    char *buf;
+    size_t got;
+    size_t stop;                /* close after this many bytes, 0 never */
+};
+
+/* read slowly so a non-blocking writer keeps finding the socket full */
+static void *copy_reader_run(void *arg)
+{
+    struct copy_reader *r = arg;
+    ssize_t n;
+    usleep(50000);
+    while ((n = read(r->fd, r->buf + r->got, 8192)) > 0) {
+        r->got += (size_t)n;
+        if (r->stop && r->got >= r->stop)
+            break;
+        usleep(1000);
+    }
+    if (r->stop)
+        close(r->fd);
+    return NULL;
+}
+
+static const char *test_vlibc_copy_fd_socket(void)
+{
+    size_t size = 150000;
+    char *data = malloc(size);
+    char *back = malloc(size + 8192);
+    mu_assert("alloc", data && back);
+    for (size_t i = 0; i < size; i++)
+        data[i] = (char)(i * 13 + i / 241);
+
+    /* socket to socket goes through the private pipe */
+    int in[2], out[2];
+    mu_assert("socketpair in", socketpair(AF_UNIX, SOCK_STREAM, 0, in) == 0);
+    mu_assert("socketpair out", socketpair(AF_UNIX, SOCK_STREAM, 0, out) == 0);
+    int sz = (int)size * 2, small = 4096;
+    setsockopt(in[0], SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    setsockopt(out[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    mu_assert("fill in", write(in[0], data, size) == (ssize_t)size);
+    close(in[0]);
+
+    /* a full non-blocking out must not drop what was already read */
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+    struct copy_reader r = { out[1], back, 0, 0 };
+    pthread_t t;
+    pthread_create(&t, NULL, copy_reader_run, &r);
+    int method = 0;
+    ssize_t n = vlibc_copy_fd(in[1], out[0], SIZE_MAX, &method);
+    close(out[0]);
+    pthread_join(t, NULL);
+    mu_assert("count", n == (ssize_t)size && r.got == size);
+    mu_assert("content", memcmp(back, data, size) == 0);
+    mu_assert("method", method == VLIBC_COPY_SPLICE ||
+              method == VLIBC_COPY_BUFFER);
+    close(in[1]);
+    close(out[1]);
+
+    /* bytes the reader took before going away are still counted */
+    struct sigaction ign, old;
+    memset(&ign, 0, sizeof(ign));
+    ign.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ign, &old);
+    mu_assert("socketpair in2", socketpair(AF_UNIX, SOCK_STREAM, 0, in) == 0);
+    mu_assert("socketpair out2", socketpair(AF_UNIX, SOCK_STREAM, 0, out) == 0);
+    setsockopt(in[0], SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    setsockopt(out[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    mu_assert("fill in2", write(in[0], data, size) == (ssize_t)size);
+    close(in[0]);
+    r.fd = out[1];
+    r.got = 0;
+    r.stop = 20000;
+    pthread_create(&t, NULL, copy_reader_run, &r);
+    n = vlibc_copy_fd(in[1], out[0], SIZE_MAX, NULL);
+    pthread_join(t, NULL);
+    mu_assert("partial count", n >= (ssize_t)r.got && n < (ssize_t)size);
+    mu_assert("partial content", memcmp(back, data, r.got) == 0);
+    close(in[1]);
+    close(out[0]);
+
+    /* nothing delivered at all is an error */
+    mu_assert("socketpair in3", socketpair(AF_UNIX, SOCK_STREAM, 0, in) == 0);
+    mu_assert("socketpair out3", socketpair(AF_UNIX, SOCK_STREAM, 0, out) == 0);
+    mu_assert("fill in3", write(in[0], data, 4096) == 4096);
+    close(in[0]);
+    close(out[1]);
+    errno = 0;
+    n = vlibc_copy_fd(in[1], out[0], SIZE_MAX, NULL);
+    mu_assert("closed reader", n == -1 && errno == EPIPE);
+    close(in[1]);
+    close(out[0]);
+    sigaction(SIGPIPE, &old, NULL);
+
+    free(data);
+    free(back);
+    return 0;
+}
+
 #ifdef __NetBSD__
 static const char *test_sendfile_socket(void)
 {
@@ -1107,6 +1318,164 @@ static const char *test_sendmsg_recvmsg(void)
     return 0;
 }
 
+static const char *test_sendmmsg_recvmmsg(void)
+{
+    int s1 = socket(AF_INET, SOCK_DGRAM, 0);
+    int s2 = socket(AF_INET, SOCK_DGRAM, 0);
+    mu_assert("sockets", s1 >= 0 && s2 >= 0);
+    struct sockaddr_in a = {0};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(0x7F000001);
+    mu_assert("bind", bind(s2, (struct sockaddr *)&a, sizeof(a)) == 0);
+    socklen_t alen = sizeof(a);
+    mu_assert("name", getsockname(s2, (struct sockaddr *)&a, &alen) == 0);
+    mu_assert("connect", connect(s1, (struct sockaddr *)&a, sizeof(a)) == 0);
+
+    char out[8][8];
+    struct iovec oiov[8];
+    struct mmsghdr omsg[8];
+    memset(omsg, 0, sizeof(omsg));
+    for (int i = 0; i < 8; i++) {
+        snprintf(out[i], sizeof(out[i]), "msg%d", i);
+        oiov[i].iov_base = out[i];
+        oiov[i].iov_len = strlen(out[i]) + 1;
+        omsg[i].msg_hdr.msg_iov = &oiov[i];
+        omsg[i].msg_hdr.msg_iovlen = 1;
+    }
+    mu_assert("sendmmsg", sendmmsg(s1, omsg, 8, 0) == 8);
+    mu_assert("msg_len", omsg[3].msg_len == 5);
+
+    char in[8][16];
+    struct iovec iiov[8];
+    struct mmsghdr imsg[8];
+    memset(imsg, 0, sizeof(imsg));
+    for (int i = 0; i < 8; i++) {
+        iiov[i].iov_base = in[i];
+        iiov[i].iov_len = sizeof(in[i]);
+        imsg[i].msg_hdr.msg_iov = &iiov[i];
+        imsg[i].msg_hdr.msg_iovlen = 1;
+    }
+    int got = 0;
+    while (got < 8) {
+        int n = recvmmsg(s2, imsg + got, 8 - got, MSG_WAITFORONE, NULL);
+        mu_assert("recvmmsg", n > 0);
+        got += n;
+    }
+    for (int i = 0; i < 8; i++)
+        mu_assert("content", imsg[i].msg_len == oiov[i].iov_len &&
+                  strcmp(in[i], out[i]) == 0);
+    mu_assert("empty", recvmmsg(s2, imsg, 8, MSG_DONTWAIT, NULL) == -1 &&
+              errno == EAGAIN);
+
+    /* one GSO send of 250 bytes arrives as 100 + 100 + 50 */
+    char big[250];
+    memset(big, 'g', sizeof(big));
+    ssize_t sent = vlibc_udp_send_gso(s1, big, sizeof(big), 100, NULL, 0);
+    if (sent >= 0) {
+        mu_assert("gso sent", sent == (ssize_t)sizeof(big));
+        char seg[256];
+        mu_assert("seg1", recv(s2, seg, sizeof(seg), 0) == 100);
+        mu_assert("seg2", recv(s2, seg, sizeof(seg), 0) == 100);
+        mu_assert("seg3", recv(s2, seg, sizeof(seg), 0) == 50 &&
+                  seg[49] == 'g');
+    } else {
+        mu_assert("gso errno", errno == EINVAL || errno == EIO ||
+                  errno == ENOPROTOOPT);
+    }
+
+    /* loopback completes zero-copy sends by copying */
+    if (vlibc_zerocopy_enable(s1) == 0) {
+        mu_assert("zc send", send(s1, "zc", 2, MSG_ZEROCOPY) == 2 &&
+                  send(s1, "zc", 2, MSG_ZEROCOPY) == 2);
+        unsigned lo = 99, hi = 99, seen = 0;
+        int copied = 0;
+        for (int tries = 0; tries < 1000 && seen < 2; tries++) {
+            int r = vlibc_zerocopy_reap(s1, &lo, &hi, &copied);
+            mu_assert("reap", r >= 0);
+            if (r == 1) {
+                mu_assert("range", lo == seen && hi >= lo && hi < 2);
+                seen = hi + 1;
+            } else {
+                usleep(1000);
+            }
+        }
+        mu_assert("completions", seen == 2);
+        mu_assert("drained", vlibc_zerocopy_reap(s1, &lo, &hi, &copied) == 0);
+    }
+
+    close(s1);
+    close(s2);
+    return 0;
+}
+
+static const char *test_syslog_async(void)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/vlibc_log_%d", (int)getpid());
+    unlink(path);
+    int srv = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un a;
+    memset(&a, 0, sizeof(a));
+    a.sun_family = AF_UNIX;
+    strlcpy(a.sun_path, path, sizeof(a.sun_path));
+    mu_assert("bind", bind(srv, (struct sockaddr *)&a, sizeof(a)) == 0);
+
+    struct vlibc_syslog_stats st0, st;
+    vlibc_syslog_stats(&st0);
+    openlog("tst", 0, LOG_LOCAL0);
+    struct vlibc_syslog_config cfg = { 0, VLIBC_SYSLOG_BLOCK, path };
+    mu_assert("async", vlibc_syslog_async(&cfg) == 0);
+    mu_assert("busy", vlibc_syslog_async(&cfg) == -1 && errno == EBUSY);
+
+    char *big = malloc(3001);
+    memset(big, 'x', 3000);
+    big[3000] = '\0';
+    syslog(LOG_ERR, "first %d", 1);
+    syslog(LOG_ERR, "%s", big);
+    syslog(LOG_ERR, "last");
+    mu_assert("flush", vlibc_syslog_flush() == 0);
+
+    char buf[4096];
+    ssize_t n = recv(srv, buf, sizeof(buf) - 1, 0);
+    buf[n > 0 ? n : 0] = '\0';
+    mu_assert("first", strcmp(buf, "<131>tst: first 1") == 0);
+    n = recv(srv, buf, sizeof(buf), 0);
+    mu_assert("large", n == 3010 && memcmp(buf, "<131>tst: xxx", 13) == 0);
+    n = recv(srv, buf, sizeof(buf) - 1, 0);
+    buf[n > 0 ? n : 0] = '\0';
+    mu_assert("last", strcmp(buf, "<131>tst: last") == 0);
+    vlibc_syslog_stats(&st);
+    mu_assert("stats", st.queued - st0.queued == 3 && st.sent - st0.sent == 3);
+    closelog();
+
+    /* with nobody reading, a small ring fills up and drops */
+    cfg.ring_size = 4096;
+    cfg.policy = VLIBC_SYSLOG_DROP;
+    mu_assert("async drop", vlibc_syslog_async(&cfg) == 0);
+    vlibc_syslog_stats(&st0);
+    for (int i = 0; i < 2000; i++)
+        syslog(LOG_INFO, "%s", big + 2900);
+    vlibc_syslog_stats(&st);
+    unsigned long long queued = st.queued - st0.queued;
+    mu_assert("dropped", st.dropped - st0.dropped > 0 &&
+              queued + st.dropped - st0.dropped == 2000);
+    fcntl(srv, F_SETFL, O_NONBLOCK);
+    unsigned long long got = 0;
+    for (int tries = 0; got < queued && tries < 2000; tries++) {
+        while (recv(srv, buf, sizeof(buf), 0) > 0)
+            got++;
+        if (got < queued)
+            usleep(1000);
+    }
+    mu_assert("drained", got == queued);
+    closelog();
+
+    free(big);
+    close(srv);
+    unlink(path);
+    return 0;
+}
+
 static const char *test_inet_pton_ntop(void)
 {
     struct in_addr addr;
@@ -1986,6 +2355,38 @@ static const char *test_wctype_checks(void)
     return 0;
 }
 
+static const char *test_wctype_unicode(void)
+{
+    mu_assert("cyrillic", iswalpha(0x416) && iswupper(0x416) &&
+              towlower(0x416) == 0x436 && towupper(0x436) == 0x416);
+    mu_assert("greek final sigma", towupper(0x3C2) == 0x3A3);
+    mu_assert("dotted I", towlower(0x130) == L'i');
+    mu_assert("cjk", iswalpha(0x4E2D) && !iswupper(0x4E2D) &&
+              towupper(0x4E2D) == 0x4E2D);
+    mu_assert("deseret", towlower(0x10400) == 0x10428);
+    mu_assert("devanagari sign", iswalpha(0x93F));
+    mu_assert("arabic digit", iswalnum(0x661) && !iswdigit(0x661));
+    mu_assert("ideographic space", iswspace(0x3000) && iswblank(0x3000));
+    mu_assert("no-break space", !iswspace(0xA0));
+    mu_assert("line separator", iswspace(0x2028) && iswcntrl(0x2028));
+    mu_assert("punct", iswpunct(0x201C) && iswgraph(0x201C));
+    mu_assert("symbol", iswpunct(0x20AC) && !iswalpha(0x20AC));
+    mu_assert("unassigned", !iswprint(0x378) && !iswgraph(0x378));
+    mu_assert("weof", !iswalpha((wint_t)-1) && towlower((wint_t)-1) == (wint_t)-1);
+    mu_assert("ascii ctype", !isalpha(0xC9) && !isalpha(-1));
+
+    mu_assert("width wide", wcwidth(0x4E2D) == 2 && wcwidth(0xFF21) == 2);
+    mu_assert("width emoji", wcwidth(0x1F600) == 2);
+    mu_assert("width combining", wcwidth(0x301) == 0);
+    mu_assert("width zero", wcwidth(0x200B) == 0 && wcwidth(0xAD) == 1);
+    mu_assert("width latin", wcwidth(0xE9) == 1);
+    mu_assert("width invalid", wcwidth(0x110000) == -1 &&
+              wcwidth(0x378) == -1);
+    wchar_t s[] = { 0x65E5, 0x672C, L'x', 0x301, 0 };
+    mu_assert("wcswidth", wcswidth(s, 4) == 5);
+    return 0;
+}
+
 static const char *test_wmem_ops(void)
 {
     wchar_t buf[8];
@@ -2212,6 +2613,129 @@ static const char *test_iconv_utf16_ascii(void)
     return 0;
 }
 
+static const char *iconv_check(const char *to, const char *from,
+                               const char *in, size_t n, const char *want,
+                               size_t wantlen)
+{
+    char out[32];
+    char *pin = (char *)in, *pout = out;
+    size_t inleft = n, outleft = sizeof(out);
+    iconv_t cd = iconv_open(to, from);
+    if (cd == (iconv_t)-1)
+        return "open";
+    size_t r = iconv(cd, &pin, &inleft, &pout, &outleft);
+    iconv_close(cd);
+    if (r == (size_t)-1 || inleft != 0)
+        return "convert";
+    if ((size_t)(pout - out) != wantlen || memcmp(out, want, wantlen) != 0)
+        return "output";
+    return 0;
+}
+
+static const char *test_iconv_tables(void)
+{
+    const char *e;
+    e = iconv_check("UTF-8", "KOI8-R", "\xF0\xD2\xC9\xD7\xC5\xD4", 6,
+                    "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82", 12);
+    mu_assert("koi8-r", e == 0);
+    e = iconv_check("SHIFT_JIS", "UTF-8", "\xE6\x97\xA5\xE6\x9C\xAC\xEF\xBD\xB1",
+                    9, "\x93\xFA\x96\x7B\xB1", 5);
+    mu_assert("sjis", e == 0);
+    e = iconv_check("UTF-8", "EUC-JP", "\xC6\xFC\xCB\xDC\x8E\xB1", 6,
+                    "\xE6\x97\xA5\xE6\x9C\xAC\xEF\xBD\xB1", 9);
+    mu_assert("euc-jp", e == 0);
+    e = iconv_check("GBK", "UTF-8", "\xE4\xB8\xAD\xE6\x96\x87", 6,
+                    "\xD6\xD0\xCE\xC4", 4);
+    mu_assert("gbk", e == 0);
+    e = iconv_check("euc_kr", "utf8", "\xED\x95\x9C\xEA\xB5\xAD", 6,
+                    "\xC7\xD1\xB1\xB9", 4);
+    mu_assert("euc-kr", e == 0);
+
+    /* single-byte pairs go through a direct byte table */
+    e = iconv_check("WINDOWS-1252", "LATIN9", "euro \xA4", 6, "euro \x80", 6);
+    mu_assert("direct", e == 0);
+
+    iconv_t cd = iconv_open("ISO-8859-15", "ISO-8859-1");
+    mu_assert("open", cd != (iconv_t)-1);
+    char in[] = "ab\xA4", out[8];
+    char *pin = in, *pout = out;
+    size_t inleft = 3, outleft = sizeof(out);
+    errno = 0;
+    size_t r = iconv(cd, &pin, &inleft, &pout, &outleft);
+    mu_assert("unmappable", r == (size_t)-1 && errno == EILSEQ);
+    mu_assert("stopped", pin == in + 2 && pout == out + 2 && inleft == 1);
+    iconv_close(cd);
+
+    /* a lead byte at the end of the input is incomplete */
+    cd = iconv_open("UTF-8", "SJIS");
+    pin = in;
+    in[0] = (char)0x93;
+    inleft = 1;
+    pout = out;
+    outleft = sizeof(out);
+    r = iconv(cd, &pin, &inleft, &pout, &outleft);
+    mu_assert("incomplete", r == (size_t)-1 && errno == EINVAL && inleft == 1);
+    iconv_close(cd);
+
+    mu_assert("unknown", iconv_open("UTF-8", "NO-SUCH-CHARSET") == (iconv_t)-1);
+    return 0;
+}
+
+static const char *test_utf8_bulk(void)
+{
+    char buf[200];
+    uint32_t u32[200];
+    uint16_t u16[200];
+    char back[600];
+
+    /* long ASCII runs around multibyte characters and a 4-byte one */
+    size_t n = 0;
+    for (int i = 0; i < 70; i++)
+        buf[n++] = 'a' + i % 26;
+    memcpy(buf + n, "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80", 9);
+    n += 9;
+    for (int i = 0; i < 40; i++)
+        buf[n++] = 'z';
+    mu_assert("valid", vlibc_utf8_valid(buf, n) == n);
+    mu_assert("count", vlibc_utf8_count(buf, n) == 113);
+
+    size_t u = vlibc_utf8_to_utf32(u32, buf, n);
+    mu_assert("to32", u == 113 && u32[70] == 0xE9 && u32[71] == 0x20AC &&
+              u32[72] == 0x1F600 && u32[112] == 'z');
+    mu_assert("from32", vlibc_utf32_to_utf8(back, u32, u) == n &&
+              memcmp(back, buf, n) == 0);
+    u = vlibc_utf8_to_utf16(u16, buf, n);
+    mu_assert("to16", u == 114 && u16[72] == 0xD83D && u16[73] == 0xDE00);
+    mu_assert("from16", vlibc_utf16_to_utf8(back, u16, u) == n &&
+              memcmp(back, buf, n) == 0);
+
+    /* malformed input reports the offset of the bad sequence */
+    buf[90] = (char)0xED;               /* surrogate lead */
+    buf[91] = (char)0xA0;
+    buf[92] = (char)0x80;
+    mu_assert("surrogate", vlibc_utf8_valid(buf, n) == 90);
+    errno = 0;
+    mu_assert("to32 bad", vlibc_utf8_to_utf32(u32, buf, n) == (size_t)-1 &&
+              errno == EILSEQ);
+    mu_assert("truncated", vlibc_utf8_valid(buf, 74) == 72);
+    mu_assert("overlong", vlibc_utf8_valid("\xC0\xAF", 2) == 0);
+    u16[0] = 0xDC00;
+    mu_assert("lone low", vlibc_utf16_to_utf8(back, u16, 1) == (size_t)-1);
+
+    /* iconv stops at the bad sequence with the pointers left there */
+    iconv_t cd = iconv_open("UTF-16", "UTF-8");
+    mu_assert("open", cd != (iconv_t)-1);
+    char *pin = buf, *pout = back;
+    size_t inleft = n, outleft = sizeof(back);
+    errno = 0;
+    mu_assert("iconv bad", iconv(cd, &pin, &inleft, &pout, &outleft) ==
+              (size_t)-1 && errno == EILSEQ);
+    mu_assert("iconv pos", pin == buf + 90 && inleft == n - 90 &&
+              pout == back + 2 * 85);
+    iconv_close(cd);
+    return 0;
+}
+
 static const char *test_strtok_basic(void)
 {
     char buf[] = "a,b,c";
@@ -3569,6 +4093,35 @@ static const char *test_timespec_get_basic(void)
     return 0;
 }
 
+static const char *test_clock_vdso_consistent(void)
+{
+    struct timespec raw, ts;
+    long r = vlibc_syscall(SYS_clock_gettime, CLOCK_REALTIME, (long)&raw,
+                           0, 0, 0, 0);
+    mu_assert("raw clock_gettime", r == 0);
+    mu_assert("clock_gettime", clock_gettime(CLOCK_REALTIME, &ts) == 0);
+    mu_assert("realtime close", ts.tv_sec - raw.tv_sec <= 1 &&
+              ts.tv_sec >= raw.tv_sec);
+
+    struct timeval tv;
+    mu_assert("gettimeofday", gettimeofday(&tv, NULL) == 0);
+    mu_assert("usec range", tv.tv_usec >= 0 && tv.tv_usec < 1000000);
+    mu_assert("gettimeofday close", tv.tv_sec - ts.tv_sec <= 1 &&
+              tv.tv_sec >= ts.tv_sec);
+    time_t now = time(NULL);
+    mu_assert("time close", now - ts.tv_sec <= 1 && now >= ts.tv_sec);
+
+    struct timespec a, b;
+    mu_assert("mono a", clock_gettime(CLOCK_MONOTONIC, &a) == 0);
+    mu_assert("mono b", clock_gettime(CLOCK_MONOTONIC, &b) == 0);
+    mu_assert("monotonic", b.tv_sec > a.tv_sec ||
+              (b.tv_sec == a.tv_sec && b.tv_nsec >= a.tv_nsec));
+
+    errno = 0;
+    mu_assert("bad clock", clock_gettime(12345, &ts) == -1 && errno == EINVAL);
+    return 0;
+}
+
 static const char *test_strftime_basic(void)
 {
     struct tm tm = {
@@ -3604,6 +4157,56 @@ static const char *test_strftime_extended(void)
     return 0;
 }
 
+static const char *test_strftime_compiled(void)
+{
+    struct tm tm;
+    char buf[128];
+    time_t t = -1;
+    mu_assert("gmtime neg", gmtime_r(&t, &tm) != NULL);
+    strftime(buf, sizeof(buf), "%A %F %T %j %s", &tm);
+    mu_assert("neg time", strcmp(buf, "Wednesday 1969-12-31 23:59:59 365 -1") == 0);
+
+    t = 951782400; /* 2000-02-29 00:00:00 */
+    gmtime_r(&t, &tm);
+    strftime(buf, sizeof(buf), "%c|%D|%e|%I%p|%B %h|%C%y|%%%n%t%q", &tm);
+    mu_assert("specifiers", strcmp(buf,
+        "Tue Feb 29 00:00:00 2000|02/29/00|29|12AM|February Feb|2000|%\n\t%q") == 0);
+
+    /* successive seconds reuse the unchanged fields of the last result */
+    t = 1700006398; /* 2023-11-14 23:59:58 */
+    const char *want[] = {
+        "2023-11-14 23:59:58", "2023-11-14 23:59:59", "2023-11-15 00:00:00"
+    };
+    for (int i = 0; i < 3; i++, t++) {
+        gmtime_r(&t, &tm);
+        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+        mu_assert("cached seconds", strcmp(buf, want[i]) == 0);
+    }
+
+    /* a changed zone must not be served from the cache */
+    tm.tm_zone = "CET";
+    tm.tm_gmtoff = 3600;
+    strftime(buf, sizeof(buf), "%H %Z %z", &tm);
+    mu_assert("zone cet", strcmp(buf, "00 CET +0100") == 0);
+    tm.tm_zone = "CEST";
+    tm.tm_gmtoff = 7200;
+    strftime(buf, sizeof(buf), "%H %Z %z", &tm);
+    mu_assert("zone cest", strcmp(buf, "00 CEST +0200") == 0);
+
+    vlibc_strftime_fmt *f = vlibc_strftime_compile("[%d/%b/%Y:%H:%M:%S %z] ");
+    mu_assert("compile", f != NULL);
+    tm.tm_min = 5;
+    size_t n = vlibc_strftime_exec(buf, sizeof(buf), f, &tm);
+    mu_assert("exec", n == 29 &&
+              strcmp(buf, "[15/Nov/2023:00:05:00 +0200] ") == 0);
+    tm.tm_mday = 9;
+    vlibc_strftime_exec(buf, sizeof(buf), f, &tm);
+    mu_assert("exec patch", strcmp(buf, "[09/Nov/2023:00:05:00 +0200] ") == 0);
+    mu_assert("exec small", vlibc_strftime_exec(buf, 29, f, &tm) == 0);
+    vlibc_strftime_free(f);
+    return 0;
+}
+
 static const char *test_wcsftime_basic(void)
 {
     struct tm tm = {
@@ -3764,7 +4367,8 @@ static const char *test_difftime_basic(void)
 
 static const char *test_tz_positive(void)
 {
-    setenv("TZ", "UTC+2", 1);
+    /* POSIX offsets count west of UTC */
+    setenv("TZ", "UTC-2", 1);
     tzset();
     time_t t = 0;
     struct tm tm;
@@ -3777,7 +4381,7 @@ static const char *test_tz_positive(void)
 
 static const char *test_tz_negative(void)
 {
-    setenv("TZ", "UTC-3", 1);
+    setenv("TZ", "UTC+3", 1);
     tzset();
     time_t t = 4 * 3600;
     struct tm tm;
@@ -3804,7 +4408,7 @@ static const char *test_tz_mktime_roundtrip(void)
 
 static const char *test_tz_ctime(void)
 {
-    setenv("TZ", "UTC+1", 1);
+    setenv("TZ", "UTC-1", 1);
     tzset();
     time_t t = 1700000000;
     char *s = ctime(&t);
@@ -3814,6 +4418,175 @@ static const char *test_tz_ctime(void)
     return 0;
 }
 
+static const char *test_tz_rules(void)
+{
+    struct tm tm;
+    char buf[64];
+    time_t t;
+
+    /* southern hemisphere rule: DST spans the new year */
+    setenv("TZ", "AEST-10AEDT,M10.1.0,M4.1.0/3", 1);
+    tzset();
+    t = 1704067200; /* 2024-01-01 00:00 UTC */
+    localtime_r(&t, &tm);
+    mu_assert("aedt", tm.tm_hour == 11 && tm.tm_isdst == 1 &&
+              tm.tm_gmtoff == 39600 && strcmp(tm.tm_zone, "AEDT") == 0);
+    t = 1719792000; /* 2024-07-01 */
+    localtime_r(&t, &tm);
+    mu_assert("aest", tm.tm_hour == 10 && tm.tm_isdst == 0);
+    strftime(buf, sizeof(buf), "%H:%M %Z %z", &tm);
+    mu_assert("strftime zone", strcmp(buf, "10:00 AEST +1000") == 0);
+
+    /* the US rules: 2024-03-10 07:00 UTC is 03:00 EDT */
+    setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+    tzset();
+    t = 1710053999;
+    localtime_r(&t, &tm);
+    mu_assert("before", tm.tm_hour == 1 && tm.tm_min == 59 && !tm.tm_isdst);
+    t++;
+    localtime_r(&t, &tm);
+    mu_assert("after", tm.tm_hour == 3 && tm.tm_isdst == 1 &&
+              tm.tm_gmtoff == -4 * 3600);
+
+    /* the repeated 01:30 on 2024-11-03 */
+    struct tm loc;
+    memset(&loc, 0, sizeof(loc));
+    loc.tm_year = 124;
+    loc.tm_mon = 10;
+    loc.tm_mday = 3;
+    loc.tm_hour = 1;
+    loc.tm_min = 30;
+    loc.tm_isdst = 1;
+    struct tm std = loc;
+    std.tm_isdst = 0;
+    time_t a = mktime(&loc);
+    time_t b = mktime(&std);
+    mu_assert("repeated hour", a == 1730611800 && b == a + 3600);
+    mu_assert("normalized", loc.tm_isdst == 1 && std.tm_isdst == 0 &&
+              std.tm_wday == 0);
+
+    /* out of range fields carry over */
+    memset(&loc, 0, sizeof(loc));
+    loc.tm_year = 123;
+    loc.tm_mon = 13;
+    loc.tm_mday = 1;
+    loc.tm_isdst = -1;
+    mktime(&loc);
+    mu_assert("carry", loc.tm_year == 124 && loc.tm_mon == 1 &&
+              loc.tm_mday == 1 && loc.tm_yday == 31);
+
+    /* compiled zoneinfo, when the system has it */
+    if (access("/usr/share/zoneinfo/Europe/Paris", R_OK) == 0) {
+        setenv("TZ", "Europe/Paris", 1);
+        tzset();
+        t = 1719792000;
+        localtime_r(&t, &tm);
+        mu_assert("paris summer", tm.tm_hour == 2 && tm.tm_isdst == 1 &&
+                  strcmp(tm.tm_zone, "CEST") == 0);
+        t = 946684800; /* 2000-01-01 */
+        localtime_r(&t, &tm);
+        mu_assert("paris winter", tm.tm_hour == 1 && tm.tm_isdst == 0);
+        t = 4102444800 + 180 * 86400; /* summer 2100, from the footer */
+        localtime_r(&t, &tm);
+        mu_assert("paris future", tm.tm_isdst == 1 &&
+                  tm.tm_gmtoff == 7200);
+    }
+
+    /* skipped local times take the offset from before the change */
+    static const struct {
+        const char *zone;
+        int year, mon, mday, hour, min, sec;
+        time_t want;
+    } gaps[] = {
+        { "America/New_York", 124, 2, 10, 2, 30, 0, 1710055800 },
+        { "Europe/Berlin", 124, 2, 31, 2, 30, 0, 1711848600 },
+        { "Australia/Lord_Howe", 138, 9, 3, 2, 27, 48, 2169647868 },
+        { "Australia/Lord_Howe", 81, 2, 1, 0, 2, 0, 352216920 },
+    };
+    for (size_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/usr/share/zoneinfo/%s",
+                 gaps[i].zone);
+        if (access(path, R_OK) != 0)
+            continue;
+        setenv("TZ", gaps[i].zone, 1);
+        memset(&loc, 0, sizeof(loc));
+        loc.tm_year = gaps[i].year;
+        loc.tm_mon = gaps[i].mon;
+        loc.tm_mday = gaps[i].mday;
+        loc.tm_hour = gaps[i].hour;
+        loc.tm_min = gaps[i].min;
+        loc.tm_sec = gaps[i].sec;
+        loc.tm_isdst = -1;
+        mu_assert("gap", mktime(&loc) == gaps[i].want);
+    }
+
+    /* a tm_isdst that disagrees with the zone shifts by the DST delta */
+    setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+    memset(&loc, 0, sizeof(loc));
+    loc.tm_year = 124;
+    loc.tm_mon = 2;
+    loc.tm_mday = 10;
+    loc.tm_hour = 2;
+    loc.tm_min = 30;
+    loc.tm_isdst = 1;
+    mu_assert("gap as dst", mktime(&loc) == 1710052200 &&
+              loc.tm_hour == 1 && !loc.tm_isdst);
+    loc.tm_mon = 6;
+    loc.tm_mday = 1;
+    loc.tm_hour = 12;
+    loc.tm_min = 0;
+    loc.tm_isdst = 0;
+    mu_assert("summer as std", mktime(&loc) == 1719853200 &&
+              loc.tm_hour == 13 && loc.tm_isdst);
+
+    /* far out of range times are rejected rather than searched */
+    t = (time_t)INT64_MAX;
+    mu_assert("huge", localtime_r(&t, &tm) == NULL && errno == EOVERFLOW);
+
+    unsetenv("TZ");
+    tzset();
+    return 0;
+}
+
+static int count_maps(void)
+{
+    FILE *f = fopen("/proc/self/maps", "r");
+    if (!f)
+        return -1;
+    char line[512];
+    int n = 0;
+    while (fgets(line, sizeof(line), f))
+        n += strchr(line, '\n') != NULL;
+    fclose(f);
+    return n;
+}
+
+static const char *test_tz_switch_reuse(void)
+{
+    if (access("/usr/share/zoneinfo/Europe/Paris", R_OK) != 0 ||
+        access("/usr/share/zoneinfo/Asia/Tokyo", R_OK) != 0)
+        return 0;
+    time_t t = 1719792000;
+    struct tm tm;
+    setenv("TZ", "Europe/Paris", 1);
+    tzset();
+    setenv("TZ", "Asia/Tokyo", 1);
+    tzset();
+    int before = count_maps();
+    for (int i = 0; i < 500; i++) {
+        setenv("TZ", i % 2 ? "Asia/Tokyo" : "Europe/Paris", 1);
+        localtime(&t);
+    }
+    int after = count_maps();
+    localtime_r(&t, &tm);
+    unsetenv("TZ");
+    tzset();
+    mu_assert("zones reused", before > 0 && after - before < 10);
+    mu_assert("last zone", tm.tm_hour == 9 && strcmp(tm.tm_zone, "JST") == 0);
+    return 0;
+}
+
 static const char *test_asctime_r_threadsafe(void)
 {
     time_t t1 = 1700000000;
@@ -3901,6 +4674,47 @@ static const char *test_env_init_clearenv(void)
     return 0;
 }
 
+static const char *test_getenv_index(void)
+{
+    char name[32], val[32];
+    env_init(NULL);
+    for (int i = 0; i < 300; i++) {
+        snprintf(name, sizeof(name), "IDX_%d", i);
+        snprintf(val, sizeof(val), "%d", i * 7);
+        mu_assert("setenv", setenv(name, val, 1) == 0);
+    }
+    mu_assert("lookup", strcmp(getenv("IDX_123"), "861") == 0);
+    mu_assert("missing", getenv("IDX_300") == NULL && getenv("IDX_1=") == NULL);
+
+    /* updates after the index exists */
+    mu_assert("unset", unsetenv("IDX_0") == 0 && getenv("IDX_0") == NULL);
+    mu_assert("shifted", strcmp(getenv("IDX_299"), "2093") == 0);
+    char put[] = "IDX_5=put";
+    mu_assert("putenv", putenv(put) == 0 && getenv("IDX_5") == put + 6);
+    mu_assert("overwrite putenv", setenv("IDX_5", "set", 1) == 0);
+    mu_assert("overwritten", strcmp(getenv("IDX_5"), "set") == 0);
+    mu_assert("append", setenv("IDX_NEW", "n", 0) == 0 &&
+              strcmp(getenv("IDX_NEW"), "n") == 0);
+
+    /* direct assignment of environ is noticed */
+    char **saved = environ;
+    char *mine[] = { "DUP=1", "ONLY=2", "DUP=3", NULL };
+    environ = mine;
+    mu_assert("reassigned", strcmp(getenv("DUP"), "1") == 0 &&
+              getenv("IDX_123") == NULL);
+    mu_assert("unset dup", unsetenv("DUP") == 0);
+    mu_assert("next dup", strcmp(getenv("DUP"), "3") == 0);
+    mine[0] = NULL;
+    mu_assert("truncated", getenv("ONLY") == NULL);
+    environ = saved;
+    mu_assert("restored", strcmp(getenv("IDX_123"), "861") == 0);
+
+    clearenv();
+    mu_assert("cleared", getenv("IDX_123") == NULL);
+    env_init(NULL);
+    return 0;
+}
+
 static const char *test_setenv_overwrite_loop(void)
 {
     env_init(NULL);
@@ -4770,6 +5584,53 @@ static const char *test_posix_spawn_fchdir(void)
     return 0;
 }
 
+static const char *test_posix_spawn_clone_child(void)
+{
+    extern char **__environ;
+    env_init(__environ);
+
+    /* exec failures come back as the error code with no child left */
+    char *argv0[] = {"/no/such/prog", NULL};
+    pid_t pid = 0;
+    mu_assert("missing", posix_spawn(&pid, "/no/such/prog", NULL, NULL,
+                                     argv0, __environ) == ENOENT);
+
+    /* adddup2 onto the same descriptor clears close-on-exec */
+    int p[2];
+    mu_assert("pipe2", pipe2(p, O_CLOEXEC) == 0);
+    char script[64];
+    snprintf(script, sizeof(script), "echo dup >&%d", p[1]);
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, p[1], p[1]);
+    char *argv1[] = {"/bin/sh", "-c", script, NULL};
+    int r = posix_spawn(&pid, "/bin/sh", &fa, NULL, argv1, __environ);
+    posix_spawn_file_actions_destroy(&fa);
+    mu_assert("spawn dup2", r == 0);
+    close(p[1]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    char buf[8] = {0};
+    mu_assert("inherited", read(p[0], buf, sizeof(buf) - 1) == 4 &&
+              strcmp(buf, "dup\n") == 0);
+    close(p[0]);
+
+    /* caught signals revert to their default action in the child */
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_usr1;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, &old);
+    char *argv2[] = {"/bin/sh", "-c", "kill -USR1 $$; exit 3", NULL};
+    r = posix_spawn(&pid, "/bin/sh", NULL, NULL, argv2, __environ);
+    mu_assert("spawn signal", r == 0);
+    waitpid(pid, &status, 0);
+    sigaction(SIGUSR1, &old, NULL);
+    mu_assert("default action", WIFSIGNALED(status) &&
+              WTERMSIG(status) == SIGUSR1);
+    return 0;
+}
+
 static const char *test_posix_spawn_actions_alloc_fail(void)
 {
     posix_spawn_file_actions_t fa;
@@ -5728,6 +6589,35 @@ static const char *test_pathconf_basic(void)
     return 0;
 }
 
+static const char *test_sysconf_cpus(void)
+{
+    long onln = sysconf(_SC_NPROCESSORS_ONLN);
+    long conf = sysconf(_SC_NPROCESSORS_CONF);
+    mu_assert("online", onln > 0);
+    mu_assert("configured", conf >= onln);
+
+    /* the online count ignores this process's affinity mask */
+    FILE *f = fopen("/sys/devices/system/cpu/online", "r");
+    if (!f)
+        return 0;
+    char buf[256];
+    long n = 0;
+    if (fgets(buf, sizeof(buf), f)) {
+        char *p = buf;
+        while (*p >= '0' && *p <= '9') {
+            long lo = strtol(p, &p, 10), hi = lo;
+            if (*p == '-')
+                hi = strtol(p + 1, &p, 10);
+            n += hi - lo + 1;
+            if (*p == ',')
+                p++;
+        }
+    }
+    fclose(f);
+    mu_assert("sysfs list", onln == n);
+    return 0;
+}
+
 static const char *test_dirent(void)
 {
     DIR *d = opendir("tests");
@@ -5746,6 +6636,103 @@ static const char *test_dirent(void)
     return 0;
 }
 
+static int scandir_only_f(const struct dirent *e)
+{
+    return e->d_name[0] == 'f';
+}
+
+static const char *test_dirent_native(void)
+{
+    char tmpl[] = "/tmp/direntXXXXXX";
+    char *dir = mkdtemp(tmpl);
+    mu_assert("mkdtemp", dir != NULL);
+
+    /* enough entries for several small reads */
+    char buf[256];
+    for (int i = 0; i < 600; i++) {
+        snprintf(buf, sizeof(buf), "%s/%c%03d", dir, i % 3 ? 'f' : 'x',
+                 599 - i);
+        int fd = open(buf, O_WRONLY | O_CREAT, 0600);
+        mu_assert("create", fd >= 0);
+        close(fd);
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    mu_assert("open", fd >= 0);
+    DIR *d = fdopendir(fd);
+    mu_assert("fdopendir", d != NULL);
+    mu_assert("dirfd", dirfd(d) == fd);
+    mu_assert("setdirbuf", vlibc_setdirbuf(d, 1024) == 0);
+    int count = 0;
+    long mid = 0;
+    char mid_name[32] = "";
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        if (++count == 300) {
+            mid = telldir(d);
+            e = readdir(d);
+            snprintf(mid_name, sizeof(mid_name), "%s", e->d_name);
+            count++;
+        }
+    }
+    mu_assert("count", count == 602);
+    mu_assert("setdirbuf late", vlibc_setdirbuf(d, 4096) == -1);
+    seekdir(d, mid);
+    e = readdir(d);
+    mu_assert("seekdir", e && strcmp(e->d_name, mid_name) == 0);
+    rewinddir(d);
+    count = 0;
+    while (readdir(d))
+        count++;
+    mu_assert("rewinddir", count == 602);
+    mu_assert("closedir", closedir(d) == 0);
+
+    int fdf = open(buf, O_RDONLY);
+    errno = 0;
+    mu_assert("fdopendir file", fdopendir(fdf) == NULL && errno == ENOTDIR);
+    close(fdf);
+
+    struct dirent **list;
+    int n = scandir(dir, &list, scandir_only_f, alphasort);
+    mu_assert("scandir", n == 400);
+    for (int i = 1; i < n; i++)
+        mu_assert("sorted", strcmp(list[i - 1]->d_name, list[i]->d_name) < 0);
+    mu_assert("first", strcmp(list[0]->d_name, "f000") == 0);
+    /* pieces of the shared block can be resized like other allocations */
+    char name1[16], name2[16], name3[16];
+    strcpy(name1, list[1]->d_name);
+    strcpy(name2, list[2]->d_name);
+    strcpy(name3, list[3]->d_name);
+    struct dirent *grown = realloc(list[1], 4096);
+    mu_assert("realloc entry", grown && strcmp(grown->d_name, name1) == 0);
+    free(grown);
+    list[1] = recallocarray(list[2], 1, sizeof(struct dirent) + 64);
+    mu_assert("recallocarray entry", list[1] &&
+              strcmp(list[1]->d_name, name2) == 0);
+    list[2] = NULL;
+    struct dirent **bigger = realloc(list, (size_t)(n + 100) * sizeof(*list));
+    mu_assert("realloc list", bigger && bigger[n - 1] &&
+              strcmp(bigger[3]->d_name, name3) == 0);
+    list = bigger;
+    /* entries stay valid until each one is freed, in any order */
+    free(list[0]);
+    for (int i = n - 1; i > 0; i--) {
+        if (!list[i])
+            continue;
+        mu_assert("name", list[i]->d_name[0] == 'f');
+        free(list[i]);
+    }
+    free(list);
+
+    for (int i = 0; i < 600; i++) {
+        snprintf(buf, sizeof(buf), "%s/%c%03d", dir, i % 3 ? 'f' : 'x',
+                 599 - i);
+        unlink(buf);
+    }
+    mu_assert("rmdir", rmdir(dir) == 0);
+    return 0;
+}
+
 static int walk_count;
 
 static int nftw_counter(const char *path, const struct stat *sb, int flag,
@@ -5796,6 +6783,167 @@ static const char *test_ftw_walk(void)
     return 0;
 }
 
+static int walk_types[8];
+static int walk_max_level;
+
+static int nftw_types(const char *path, const struct stat *sb, int flag,
+                      struct FTW *info)
+{
+    if (flag == FTW_F && (!S_ISREG(sb->st_mode) ||
+                          strcmp(path + info->base, "f") != 0))
+        return 1;
+    walk_types[flag]++;
+    if (info->level > walk_max_level)
+        walk_max_level = info->level;
+    return 0;
+}
+
+static const char *test_nftw_fdlimit(void)
+{
+    char tmpl[] = "/tmp/ftwXXXXXX";
+    char *dir = mkdtemp(tmpl);
+    mu_assert("mkdtemp", dir != NULL);
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", dir);
+    for (int i = 1; i <= 4; i++) {
+        size_t len = strlen(buf);
+        snprintf(buf + len, sizeof(buf) - len, "/d%d", i);
+        mu_assert("mkdir", mkdir(buf, 0700) == 0);
+    }
+    strcat(buf, "/f");
+    int fd = open(buf, O_WRONLY | O_CREAT, 0600);
+    mu_assert("file f", fd >= 0);
+    close(fd);
+    snprintf(buf, sizeof(buf), "%s/link", dir);
+    mu_assert("symlink", symlink("missing", buf) == 0);
+
+    /* two descriptors for a five level tree */
+    memset(walk_types, 0, sizeof(walk_types));
+    walk_max_level = 0;
+    mu_assert("nftw", nftw(dir, nftw_types, 2, FTW_PHYS | FTW_DEPTH) == 0);
+    mu_assert("root", walk_types[FTW_D] == 1);
+    mu_assert("post", walk_types[FTW_DP] == 5);
+    mu_assert("file", walk_types[FTW_F] == 1);
+    mu_assert("dangling", walk_types[FTW_SLN] == 1);
+    mu_assert("level", walk_max_level == 5);
+
+    memset(walk_types, 0, sizeof(walk_types));
+    mu_assert("nostat", nftw(dir, nftw_types, 1,
+                             FTW_PHYS | FTW_NOSTAT) == 0);
+    mu_assert("nostat dirs", walk_types[FTW_D] == 5);
+    mu_assert("nostat file", walk_types[FTW_F] == 1);
+    mu_assert("nostat link", walk_types[FTW_SL] == 1);
+
+    char *const paths[] = { dir, NULL };
+    FTS *fts = fts_open(paths, FTS_PHYSICAL | FTS_NOSTAT, NULL);
+    mu_assert("fts_open", fts != NULL);
+    int dirs = 0, nsok = 0;
+    FTSENT *ent;
+    while ((ent = fts_read(fts))) {
+        if (ent->fts_info == FTS_D)
+            dirs++;
+        else if (ent->fts_info == FTS_NSOK)
+            nsok++;
+    }
+    mu_assert("fts dirs", dirs == 5);
+    mu_assert("fts nsok", nsok == 2);
+    mu_assert("fts_close", fts_close(fts) == 0);
+
+    unlink(buf);
+    snprintf(buf, sizeof(buf), "%s/d1/d2/d3/d4/f", dir);
+    unlink(buf);
+    for (int i = 4; i >= 1; i--) {
+        *strrchr(buf, '/') = '\0';
+        mu_assert("rmdir", rmdir(buf) == 0);
+    }
+    rmdir(dir);
+    return 0;
+}
+
+static atomic_int pwalk_types[8];
+static char pwalk_last[32];
+
+static int pwalk_count(const char *path, const struct stat *sb, int flag,
+                       struct FTW *info)
+{
+    (void)path; (void)sb; (void)info;
+    atomic_fetch_add(&pwalk_types[flag], 1);
+    return 0;
+}
+
+static int pwalk_sorted(const struct vlibc_walkent *e, int worker, void *arg)
+{
+    (void)worker; (void)arg;
+    if (e->level != 1)
+        return 0;
+    const char *name = e->path + e->base;
+    if (strcmp(name, pwalk_last) <= 0)
+        return 2;
+    snprintf(pwalk_last, sizeof(pwalk_last), "%s", name);
+    return strcmp(name, "f40") == 0 ? 7 : 0;
+}
+
+static const char *test_nftw_parallel(void)
+{
+    char tmpl[] = "/tmp/pwalkXXXXXX";
+    char *dir = mkdtemp(tmpl);
+    mu_assert("mkdtemp", dir != NULL);
+
+    /* 8 x 8 directories holding one file each */
+    char buf[256];
+    for (int i = 0; i < 8; i++) {
+        snprintf(buf, sizeof(buf), "%s/d%d", dir, i);
+        mu_assert("mkdir", mkdir(buf, 0700) == 0);
+        for (int k = 0; k < 8; k++) {
+            snprintf(buf, sizeof(buf), "%s/d%d/e%d", dir, i, k);
+            mu_assert("mkdir", mkdir(buf, 0700) == 0);
+            strcat(buf, "/f");
+            int fd = open(buf, O_WRONLY | O_CREAT, 0600);
+            mu_assert("file", fd >= 0);
+            close(fd);
+        }
+    }
+
+    for (int i = 0; i < 8; i++)
+        atomic_store(&pwalk_types[i], 0);
+    mu_assert("nftw_parallel", nftw_parallel(dir, pwalk_count, 4,
+                                             FTW_PHYS | FTW_DEPTH, 4) == 0);
+    mu_assert("root", atomic_load(&pwalk_types[FTW_D]) == 1);
+    mu_assert("dirs", atomic_load(&pwalk_types[FTW_DP]) == 73);
+    mu_assert("files", atomic_load(&pwalk_types[FTW_F]) == 64);
+
+    /* a flat directory is listed in order by a single worker */
+    for (int i = 0; i < 8; i++) {
+        for (int k = 0; k < 8; k++) {
+            snprintf(buf, sizeof(buf), "%s/d%d/e%d/f", dir, i, k);
+            unlink(buf);
+            *strrchr(buf, '/') = '\0';
+            rmdir(buf);
+        }
+        snprintf(buf, sizeof(buf), "%s/d%d", dir, i);
+        rmdir(buf);
+    }
+    for (int i = 0; i < 64; i++) {
+        snprintf(buf, sizeof(buf), "%s/f%02d", dir, 63 - i);
+        int fd = open(buf, O_WRONLY | O_CREAT, 0600);
+        mu_assert("file", fd >= 0);
+        close(fd);
+    }
+    pwalk_last[0] = '\0';
+    mu_assert("sorted stop", vlibc_pwalk(dir, VLIBC_WALK_NOSTAT |
+                                         VLIBC_PWALK_SORTED, 3, 8,
+                                         pwalk_sorted, NULL) == 7);
+    mu_assert("stopped at f40", strcmp(pwalk_last, "f40") == 0);
+
+    for (int i = 0; i < 64; i++) {
+        snprintf(buf, sizeof(buf), "%s/f%02d", dir, i);
+        unlink(buf);
+    }
+    mu_assert("rmdir", rmdir(dir) == 0);
+    return 0;
+}
+
 static int ftw_ignore(const char *path, const struct stat *sb, int flag,
                       struct FTW *info)
 {
@@ -5944,6 +7092,49 @@ static const char *test_group_lookup(void)
     return 0;
 }
 
+static const char *test_passwd_cache_reload(void)
+{
+    char tmpl[] = "/tmp/pwcacheXXXXXX";
+    int fd = mkstemp(tmpl);
+    mu_assert("mkstemp", fd >= 0);
+    const char data[] =
+        "root:x:0:0:root:/root:/bin/sh\n"
+        "alice:x:1000:1000:Alice:/home/alice:/bin/sh\n";
+    mu_assert("write", write(fd, data, sizeof(data) - 1) == (ssize_t)(sizeof(data) - 1));
+    close(fd);
+
+    setenv("VLIBC_PASSWD", tmpl, 1);
+
+    struct passwd pwd, *res = NULL;
+    char small[8];
+    mu_assert("erange", getpwnam_r("alice", &pwd, small, sizeof(small), &res) == ERANGE && res == NULL);
+    char buf[256];
+    mu_assert("getpwnam_r", getpwnam_r("alice", &pwd, buf, sizeof(buf), &res) == 0 &&
+             res == &pwd && pwd.pw_uid == 1000);
+    mu_assert("missing", getpwnam_r("bob", &pwd, buf, sizeof(buf), &res) == 0 && res == NULL);
+
+    /* replace the file; the cached index must notice the new inode */
+    char tmpl2[] = "/tmp/pwcacheXXXXXX";
+    fd = mkstemp(tmpl2);
+    mu_assert("mkstemp2", fd >= 0);
+    const char data2[] =
+        "root:x:0:0:root:/root:/bin/sh\n"
+        "bob:x:1001:1001::/home/bob:/bin/sh\n";
+    mu_assert("write2", write(fd, data2, sizeof(data2) - 1) == (ssize_t)(sizeof(data2) - 1));
+    close(fd);
+    mu_assert("rename", rename(tmpl2, tmpl) == 0);
+
+    struct passwd *pw = getpwnam("bob");
+    mu_assert("reload", pw && pw->pw_uid == 1001 && pw->pw_gecos[0] == '\0');
+    mu_assert("gone", getpwnam("alice") == NULL);
+    pw = getpwuid(1001);
+    mu_assert("by uid", pw && strcmp(pw->pw_name, "bob") == 0);
+
+    unsetenv("VLIBC_PASSWD");
+    unlink(tmpl);
+    return 0;
+}
+
 static const char *test_passwd_enum(void)
 {
     char tmpl[] = "/tmp/pwtenumXXXXXX";
@@ -6077,6 +7268,7 @@ static const char *test_system_passwd(void)
     struct passwd *pw = getpwent();
     endpwent();
     mu_assert("system passwd", pw != NULL);
+    mu_assert("missing user", getpwnam("no_such_user_zz") == NULL);
     return 0;
 }
 
@@ -6089,6 +7281,7 @@ static const char *test_system_group(void)
     struct group *gr = getgrent();
     endgrent();
     mu_assert("system group", gr != NULL);
+    mu_assert("missing group", getgrnam("no_such_grp_zz") == NULL);
     return 0;
 }
 
@@ -6115,6 +7308,20 @@ static const char *test_getgrouplist_basic(void)
     mu_assert("g1", groups[1] == 50);
     mu_assert("g2", groups[2] == 60);
 
+    /* same size, inode and most likely the same second */
+    const char edit[] =
+        "root:x:0:\n"
+        "staff:x:50:alice,bob\n"
+        "extra:x:61:alice\n";
+    fd = open(tmpl, O_WRONLY | O_TRUNC);
+    mu_assert("reopen", fd >= 0);
+    mu_assert("rewrite", write(fd, edit, sizeof(edit) - 1) ==
+             (ssize_t)(sizeof(edit) - 1));
+    close(fd);
+    ng = 4;
+    r = getgrouplist("alice", 1000, groups, &ng);
+    mu_assert("reloaded", r >= 0 && ng == 3 && groups[2] == 61);
+
     unsetenv("VLIBC_GROUP");
     unlink(tmpl);
     return 0;
@@ -6128,7 +7335,9 @@ static const char *test_getgrouplist_overflow(void)
     const char data[] =
         "root:x:0:\n"
         "staff:x:50:alice,bob\n"
-        "extra:x:60:alice\n";
+        "extra:x:60:alice\n"
+        "again:x:60:alice\n"
+        "self:x:1000:alice\n";
     mu_assert("write", write(fd, data, sizeof(data) - 1) ==
              (ssize_t)(sizeof(data) - 1));
     close(fd);
@@ -6140,8 +7349,12 @@ static const char *test_getgrouplist_overflow(void)
     int r = getgrouplist("alice", 1000, groups, &ng);
     mu_assert("overflow", r == -1 && ng == 3);
 
-    unsetenv("VLIBC_GROUP");
     unlink(tmpl);
+    ng = 1;
+    r = getgrouplist("alice", 1000, groups, &ng);
+    mu_assert("no group file", r == 1 && ng == 1 && groups[0] == 1000);
+
+    unsetenv("VLIBC_GROUP");
     return 0;
 }
 
@@ -6566,6 +7779,92 @@ static const char *test_regex_neg_class(void)
     return 0;
 }
 
+static const char *test_regex_flags(void)
+{
+    regex_t re;
+    regmatch_t m[1];
+    mu_assert("icase comp", regcomp(&re, "hel+o", REG_ICASE) == 0);
+    mu_assert("icase match", regexec(&re, "say HeLLo", 1, m, 0) == 0);
+    mu_assert("icase offsets", m[0].rm_so == 4 && m[0].rm_eo == 9);
+    regfree(&re);
+
+    mu_assert("newline comp", regcomp(&re, "^b.*$", REG_NEWLINE) == 0);
+    mu_assert("newline match", regexec(&re, "a\nbcd\ne", 1, m, 0) == 0);
+    mu_assert("newline offsets", m[0].rm_so == 2 && m[0].rm_eo == 5);
+    regfree(&re);
+
+    mu_assert("plain comp", regcomp(&re, "^b", 0) == 0);
+    mu_assert("no line anchor", regexec(&re, "a\nb", 0, NULL, 0) == REG_NOMATCH);
+    mu_assert("notbol", regexec(&re, "bc", 0, NULL, REG_NOTBOL) == REG_NOMATCH);
+    regfree(&re);
+
+    mu_assert("nosub comp", regcomp(&re, "[0-9]+", REG_NOSUB) == 0);
+    mu_assert("nosub match", regexec(&re, "id 42", 1, m, 0) == 0);
+    regfree(&re);
+
+    mu_assert("bad bracket", regcomp(&re, "[abc", 0) == REG_EBRACK);
+    mu_assert("bad paren", regcomp(&re, "(abc", 0) == REG_EPAREN);
+    return 0;
+}
+
+static const char *test_regex_linear_time(void)
+{
+    size_t n = 100000;
+    char *s = malloc(n + 1);
+    mu_assert("alloc", s != NULL);
+    memset(s, 'a', n);
+    s[n] = '\0';
+    regex_t re;
+    regmatch_t m[2];
+    regcomp(&re, "(a*)*b", 0);
+    mu_assert("nested nomatch", regexec(&re, s, 2, m, 0) == REG_NOMATCH);
+    regfree(&re);
+    regcomp(&re, "(a|aa)*$", 0);
+    mu_assert("alt match", regexec(&re, s, 2, m, 0) == 0);
+    mu_assert("alt offsets", m[0].rm_so == 0 && m[0].rm_eo == (int)n);
+    regfree(&re);
+    free(s);
+
+    regcomp(&re, "a|ab", 0);
+    mu_assert("longest", regexec(&re, "xabc", 1, m, 0) == 0);
+    mu_assert("longest offsets", m[0].rm_so == 1 && m[0].rm_eo == 3);
+    regfree(&re);
+    return 0;
+}
+
+static const char *test_regex_prefilter(void)
+{
+    regex_t re;
+    regmatch_t m[2];
+    regcomp(&re, "needle([0-9]+)", REG_EXTENDED);
+    mu_assert("prefix match",
+              regexec(&re, "hay needle hay needle42 x", 2, m, 0) == 0);
+    mu_assert("prefix offsets", m[0].rm_so == 15 && m[0].rm_eo == 23);
+    mu_assert("prefix group", m[1].rm_so == 21 && m[1].rm_eo == 23);
+    mu_assert("prefix absent",
+              regexec(&re, "hay needle hay", 0, NULL, 0) == REG_NOMATCH);
+    regfree(&re);
+
+    regcomp(&re, "[a-z]+ disk full", REG_EXTENDED);
+    mu_assert("required match",
+              regexec(&re, "ERR: sda disk full", 1, m, 0) == 0);
+    mu_assert("required offsets", m[0].rm_so == 5 && m[0].rm_eo == 18);
+    mu_assert("required absent",
+              regexec(&re, "sda disk empty", 0, NULL, 0) == REG_NOMATCH);
+    regfree(&re);
+
+    regcomp(&re, "(cat|dog)s", REG_EXTENDED | REG_ICASE);
+    mu_assert("first set match", regexec(&re, "two DOGS", 1, m, 0) == 0);
+    mu_assert("first set offsets", m[0].rm_so == 4 && m[0].rm_eo == 8);
+    regfree(&re);
+
+    regcomp(&re, "^abc", REG_EXTENDED | REG_NEWLINE);
+    mu_assert("anchored prefix", regexec(&re, "xyz\nabc", 1, m, 0) == 0);
+    mu_assert("anchored offsets", m[0].rm_so == 4);
+    regfree(&re);
+    return 0;
+}
+
 static const char *test_math_functions(void)
 {
     mu_assert("fabs", fabs(-3.5) == 3.5);
@@ -6597,6 +7896,82 @@ static const char *test_math_functions(void)
     return 0;
 }
 
+static const char *test_math_accuracy(void)
+{
+    /* each result must lie within one ULP of the correctly rounded value */
+#define NEAR(a, b) (fabs((a) - (b)) <= 2.3e-16 * fabs(b))
+    mu_assert("sqrt", sqrt(2.0) == 1.4142135623730951);
+    mu_assert("sqrt neg", isnan(sqrt(-1.0)));
+    mu_assert("exp", NEAR(exp(1.0), 2.718281828459045));
+    mu_assert("exp big", NEAR(exp(700.0), 1.0142320547350045e304));
+    mu_assert("exp tiny", NEAR(exp(-700.0), 9.859676543759770e-305));
+    mu_assert("exp overflow", isinf(exp(710.0)));
+    mu_assert("log", NEAR(log(10.0), 2.302585092994046));
+    mu_assert("log near one", NEAR(log(1.0000001), 9.999999505838704e-08));
+    mu_assert("log zero", isinf(log(0.0)) && log(0.0) < 0.0);
+    mu_assert("pow", NEAR(pow(2.0, 0.5), 1.4142135623730951));
+    mu_assert("pow int", pow(2.0, 10.0) == 1024.0);
+    mu_assert("pow neg base", pow(-2.0, 3.0) == -8.0);
+    mu_assert("pow frac neg base", isnan(pow(-2.0, 0.5)));
+    mu_assert("pow large y", NEAR(pow(1.0000001, 1e7), 2.7182816941320818));
+    mu_assert("sin", NEAR(sin(1.0), 0.8414709848078965));
+    mu_assert("sin large", NEAR(sin(1e22), -0.8522008497671888));
+    mu_assert("cos large", NEAR(cos(1e6), 0.9367521275331447));
+    mu_assert("cos", NEAR(cos(2.0), -0.4161468365471424));
+    mu_assert("sinf", sinf(1.0f) == 0.84147098f);
+    mu_assert("cosf", cosf(1e5f) == -0.9993608f);
+    mu_assert("expf", expf(1.0f) == 2.7182817f);
+    mu_assert("logf", logf(10.0f) == 2.3025851f);
+    mu_assert("powf", powf(2.0f, 0.5f) == 1.4142135f);
+    mu_assert("sqrtf", sqrtf(2.0f) == 1.4142135f);
+#undef NEAR
+    return 0;
+}
+
+static const char *test_math_vector(void)
+{
+    /* array results agree with the scalar functions to a few ULPs */
+#define CLOSE(a, b) ((a) == (b) || fabs((a) - (b)) <= 1e-15 * fabs(b))
+    double in[11] = { 0.5, -3.25, 1.0, 20.0, 1e6, -0.0, 700.0, -745.5,
+                      1e-310, 2.0, 1e22 };
+    double out[11];
+    float fin[11], fout[11];
+    for (size_t n = 0; n <= 11; n++) {
+        for (size_t i = 0; i < 11; i++)
+            out[i] = 42.0;
+        vlibc_vexp(out, in, n);
+        for (size_t i = 0; i < n; i++)
+            mu_assert("vexp", CLOSE(out[i], exp(in[i])));
+        for (size_t i = n; i < 11; i++)
+            mu_assert("vexp overrun", out[i] == 42.0);
+    }
+    vlibc_vsin(out, in, 11);
+    for (size_t i = 0; i < 11; i++)
+        mu_assert("vsin", CLOSE(out[i], sin(in[i])));
+    vlibc_vcos(out, in, 11);
+    for (size_t i = 0; i < 11; i++)
+        mu_assert("vcos", CLOSE(out[i], cos(in[i])));
+    vlibc_vlog(out, in, 11);
+    for (size_t i = 0; i < 11; i++)
+        mu_assert("vlog", in[i] < 0.0 ? isnan(out[i]) :
+                          CLOSE(out[i], log(in[i])));
+    vlibc_vsqrt(out, in, 11);
+    mu_assert("vsqrt", out[9] == sqrt(2.0) && isnan(out[1]));
+
+    for (size_t i = 0; i < 11; i++)
+        fin[i] = (float)(in[i] * 0.01);
+    vlibc_vexpf(fout, fin, 11);
+    for (size_t i = 0; i < 11; i++)
+        mu_assert("vexpf", fout[i] == expf(fin[i]));
+    vlibc_vsinf(fout, fin, 11);
+    for (size_t i = 0; i < 11; i++)
+        mu_assert("vsinf", fout[i] == sinf(fin[i]));
+    vlibc_vpowf(fout, fin, fin, 11);
+    mu_assert("vpowf", fout[9] == powf(0.02f, 0.02f));
+#undef CLOSE
+    return 0;
+}
+
 static const char *test_complex_cabs_cexp(void)
 {
     double_complex z = {3.0, 4.0};
@@ -6725,6 +8100,354 @@ static const char *test_ucontext_args(void)
     return 0;
 }
 
+static ucontext_t uc_fast_main, uc_fast_coro, uc_fast_done;
+static volatile long fast_count;
+
+static void fast_coro(long limit)
+{
+    volatile double acc = 0.5;
+    while (fast_count < limit) {
+        fast_count++;
+        acc += 1.0;
+        vlibc_swapcontext_nosig(&uc_fast_coro, &uc_fast_main);
+    }
+    fast_count = acc == 0.5 + (double)limit ? fast_count : -1;
+}
+
+static const char *test_ucontext_nosig(void)
+{
+    stack_t ss;
+    mu_assert("stack alloc", vlibc_stack_alloc(&ss, 10000) == 0);
+    mu_assert("stack size", ss.ss_size >= 10000);
+
+    fast_count = 0;
+    getcontext(&uc_fast_coro);
+    uc_fast_coro.uc_stack = ss;
+    uc_fast_coro.uc_link = &uc_fast_done;
+    makecontext(&uc_fast_coro, (void (*)(void))fast_coro, 1, 1000L);
+
+    double kept = 3.25;
+    volatile int finished = 0;
+    getcontext(&uc_fast_done);
+    if (!finished) {
+        finished = 1;
+        for (int i = 0; i < 1000; i++)
+            vlibc_swapcontext_nosig(&uc_fast_main, &uc_fast_coro);
+        mu_assert("switches", fast_count == 1000);
+        /* one more switch lets the function return through uc_link */
+        vlibc_swapcontext_nosig(&uc_fast_main, &uc_fast_coro);
+        mu_assert("not reached", 0);
+    }
+    mu_assert("coro state", fast_count == 1000);
+    mu_assert("fp kept", kept * 2.0 == 6.5);
+
+    /* writing below the stack hits the guard page */
+    pid_t pid = fork();
+    if (pid == 0) {
+        ((volatile char *)ss.ss_sp)[-1] = 1;
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    mu_assert("guard page", WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+
+    vlibc_stack_free(&ss);
+    mu_assert("stack freed", ss.ss_sp == NULL);
+    return 0;
+}
+
+static atomic_int vco_counter;
+
+static void *vco_counting(void *arg)
+{
+    for (int i = 0; i < 20; i++) {
+        atomic_fetch_add(&vco_counter, 1);
+        vco_yield();
+    }
+    return (void *)((long)arg * 2);
+}
+
+static void *vco_parent(void *arg)
+{
+    vco_t *child = vco_spawn(vco_counting, arg);
+    void *r = NULL;
+    if (!child || vco_join(child, &r) != 0)
+        return NULL;
+    return r;
+}
+
+static int vco_pipe[2];
+
+static void *vco_reader(void *arg)
+{
+    char *buf = arg;
+    size_t got = 0;
+    while (got < 5) {
+        ssize_t r = read(vco_pipe[0], buf + got, 5 - got);
+        if (r <= 0)
+            return NULL;
+        got += (size_t)r;
+    }
+    return buf;
+}
+
+static void *vco_writer(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < 10; i++)
+        vco_yield();
+    return (void *)(long)write(vco_pipe[1], "hello", 5);
+}
+
+/* a descriptor the program made non-blocking itself is not parked on */
+static void *vco_try_read(void *arg)
+{
+    char c;
+    (void)arg;
+    return (void *)(long)(read(vco_pipe[0], &c, 1) < 0 && errno == EAGAIN);
+}
+
+static int vco_sock[2];
+
+static void *vco_sock_reader(void *arg)
+{
+    (void)arg;
+    char c = 0;
+    return (void *)(long)(read(vco_sock[0], &c, 1) == 1 && c == 'x');
+}
+
+static void *vco_sock_writer(void *arg)
+{
+    size_t left = (size_t)(long)arg;
+    char chunk[4096];
+    memset(chunk, 'y', sizeof(chunk));
+    while (left) {
+        ssize_t w = write(vco_sock[0], chunk,
+                          left < sizeof(chunk) ? left : sizeof(chunk));
+        if (w <= 0)
+            return NULL;
+        left -= (size_t)w;
+    }
+    return (void *)1;
+}
+
+static const char *test_vco_basic(void)
+{
+    vco_t *co[100];
+    void *r;
+    mu_assert("init", vco_init(3, 0) == 0);
+    mu_assert("not a coroutine", vco_self() == NULL);
+
+    atomic_store(&vco_counter, 0);
+    for (long i = 0; i < 100; i++) {
+        co[i] = vco_spawn(i % 2 ? vco_counting : vco_parent, (void *)i);
+        mu_assert("spawn", co[i] != NULL);
+    }
+    for (long i = 0; i < 100; i++) {
+        mu_assert("join", vco_join(co[i], &r) == 0);
+        mu_assert("result", (long)r == i * 2);
+    }
+    mu_assert("counter", atomic_load(&vco_counter) == 2000);
+
+    char buf[6] = {0};
+    mu_assert("pipe", pipe(vco_pipe) == 0);
+    mu_assert("attach", vco_fd_attach(vco_pipe[0]) == 0 &&
+              vco_fd_attach(vco_pipe[1]) == 0);
+    vco_t *rd = vco_spawn(vco_reader, buf);
+    vco_t *wr = vco_spawn(vco_writer, NULL);
+    mu_assert("join writer", vco_join(wr, &r) == 0 && (long)r == 5);
+    mu_assert("join reader", vco_join(rd, &r) == 0 && r == buf);
+    mu_assert("data", strcmp(buf, "hello") == 0);
+    mu_assert("detach", vco_fd_detach(vco_pipe[0]) == 0 &&
+              !(fcntl(vco_pipe[0], F_GETFL) & O_NONBLOCK));
+    fcntl(vco_pipe[0], F_SETFL, O_NONBLOCK);
+    rd = vco_spawn(vco_try_read, NULL);
+    mu_assert("own nonblock", vco_join(rd, &r) == 0 && (long)r == 1);
+    vco_fd_detach(vco_pipe[1]);
+    close(vco_pipe[0]);
+    close(vco_pipe[1]);
+
+    /* a reader and a writer parked on the same socket both resume */
+    size_t big = 4 << 20;
+    mu_assert("socketpair",
+              socketpair(AF_UNIX, SOCK_STREAM, 0, vco_sock) == 0);
+    mu_assert("attach sock", vco_fd_attach(vco_sock[0]) == 0);
+    rd = vco_spawn(vco_sock_reader, NULL);
+    wr = vco_spawn(vco_sock_writer, (void *)(long)big);
+    usleep(50000);
+    mu_assert("wake reader", write(vco_sock[1], "x", 1) == 1);
+    char *sink = malloc(65536);
+    size_t got = 0;
+    while (got < big) {
+        ssize_t n = read(vco_sock[1], sink, 65536);
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    free(sink);
+    mu_assert("drained", got == big);
+    mu_assert("join sock writer", vco_join(wr, &r) == 0 && r != NULL);
+    mu_assert("join sock reader", vco_join(rd, &r) == 0 && (long)r == 1);
+    vco_fd_detach(vco_sock[0]);
+    close(vco_sock[0]);
+    close(vco_sock[1]);
+
+    vco_shutdown();
+    return 0;
+}
+
+static const char *test_epoll_fds(void)
+{
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    mu_assert("epoll_create1", ep >= 0);
+
+    int efd = eventfd(0, EFD_NONBLOCK);
+    mu_assert("eventfd", efd >= 0);
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0x1234;
+    mu_assert("ctl add", epoll_ctl(ep, EPOLL_CTL_ADD, efd, &ev) == 0);
+    mu_assert("ctl dup", epoll_ctl(ep, EPOLL_CTL_ADD, efd, &ev) == -1 &&
+              errno == EEXIST);
+
+    struct epoll_event out[4];
+    mu_assert("idle", epoll_wait(ep, out, 4, 0) == 0);
+    mu_assert("write", eventfd_write(efd, 3) == 0);
+    mu_assert("write2", eventfd_write(efd, 4) == 0);
+    mu_assert("ready", epoll_wait(ep, out, 4, 1000) == 1);
+    mu_assert("payload", out[0].data.u64 == 0x1234 &&
+              (out[0].events & EPOLLIN));
+    eventfd_t val;
+    mu_assert("read", eventfd_read(efd, &val) == 0 && val == 7);
+    mu_assert("drained", eventfd_read(efd, &val) == -1 && errno == EAGAIN);
+
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    mu_assert("timerfd", tfd >= 0);
+    struct itimerspec its = {{0, 0}, {0, 5000000}};
+    mu_assert("settime", timerfd_settime(tfd, 0, &its, NULL) == 0);
+    struct itimerspec cur;
+    mu_assert("gettime", timerfd_gettime(tfd, &cur) == 0 &&
+              cur.it_value.tv_sec == 0 && cur.it_value.tv_nsec > 0);
+    ev.data.fd = tfd;
+    mu_assert("ctl timer", epoll_ctl(ep, EPOLL_CTL_ADD, tfd, &ev) == 0);
+    mu_assert("expiry", epoll_wait(ep, out, 4, 1000) == 1 &&
+              out[0].data.fd == tfd);
+    uint64_t ticks;
+    mu_assert("ticks", read(tfd, &ticks, sizeof(ticks)) == 8 && ticks == 1);
+
+    mu_assert("ctl del", epoll_ctl(ep, EPOLL_CTL_DEL, tfd, NULL) == 0);
+    mu_assert("ctl mod", epoll_ctl(ep, EPOLL_CTL_MOD, tfd, &ev) == -1 &&
+              errno == ENOENT);
+
+    got_signal = 0;
+    struct sigaction sa;
+    sa.sa_handler = handle_usr1;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGUSR1, &sa, NULL);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    mu_assert("block", sigprocmask(SIG_BLOCK, &mask, NULL) == 0);
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK);
+    mu_assert("signalfd", sfd >= 0);
+    ev.data.fd = sfd;
+    mu_assert("ctl signal", epoll_ctl(ep, EPOLL_CTL_ADD, sfd, &ev) == 0);
+    kill(getpid(), SIGUSR1);
+    mu_assert("signal ready", epoll_wait(ep, out, 4, 1000) == 1 &&
+              out[0].data.fd == sfd);
+    struct signalfd_siginfo si;
+    mu_assert("siginfo", read(sfd, &si, sizeof(si)) == sizeof(si) &&
+              si.ssi_signo == SIGUSR1 && si.ssi_pid == (uint32_t)getpid());
+    mu_assert("unblock", sigprocmask(SIG_UNBLOCK, &mask, NULL) == 0);
+    mu_assert("consumed", got_signal == 0);
+
+    close(sfd);
+    close(tfd);
+    close(efd);
+    close(ep);
+    return 0;
+}
+
+struct evloop_state {
+    int pipe_reads;
+    int oneshot;
+    int repeats;
+    evloop_timer_t *cancel_me;
+};
+
+static void evloop_on_pipe(evloop_t *loop, int fd, unsigned events, void *arg)
+{
+    struct evloop_state *st = arg;
+    char c;
+    if ((events & EPOLLIN) && read(fd, &c, 1) == 1)
+        st->pipe_reads++;
+    if (st->pipe_reads == 2)
+        evloop_del_fd(loop, fd);
+}
+
+static void evloop_on_oneshot(evloop_t *loop, evloop_timer_t *t, void *arg)
+{
+    struct evloop_state *st = arg;
+    (void)t;
+    st->oneshot++;
+    /* cancelling a timer that has not fired yet */
+    evloop_cancel_timer(loop, st->cancel_me);
+    st->cancel_me = NULL;
+}
+
+static void evloop_on_never(evloop_t *loop, evloop_timer_t *t, void *arg)
+{
+    (void)loop;
+    (void)t;
+    ((struct evloop_state *)arg)->oneshot += 100;
+}
+
+static void evloop_on_repeat(evloop_t *loop, evloop_timer_t *t, void *arg)
+{
+    struct evloop_state *st = arg;
+    if (++st->repeats == 3) {
+        evloop_cancel_timer(loop, t);
+        evloop_stop(loop);
+    }
+}
+
+static const char *test_evloop_basic(void)
+{
+    struct evloop_state st = {0};
+    evloop_t *loop = evloop_new();
+    mu_assert("new", loop != NULL);
+
+    int p[2];
+    mu_assert("pipe", pipe(p) == 0);
+    mu_assert("add fd", evloop_add_fd(loop, p[0], EPOLLIN, evloop_on_pipe,
+                                      &st) == 0);
+    mu_assert("add twice", evloop_add_fd(loop, p[0], EPOLLIN, evloop_on_pipe,
+                                         &st) == -1 && errno == EEXIST);
+    mu_assert("nothing yet", evloop_run_once(loop, 0) == 0);
+    write(p[1], "ab", 2);
+    mu_assert("one read", evloop_run_once(loop, 1000) == 1);
+    mu_assert("second read", evloop_run_once(loop, 1000) == 1);
+    mu_assert("removed", st.pipe_reads == 2 &&
+              evloop_del_fd(loop, p[0]) == -1 && errno == ENOENT);
+
+    st.cancel_me = evloop_add_timer(loop, 500, 0, evloop_on_never, &st);
+    mu_assert("timer", st.cancel_me != NULL);
+    mu_assert("oneshot", evloop_add_timer(loop, 5, 0, evloop_on_oneshot,
+                                          &st) != NULL);
+    mu_assert("repeat", evloop_add_timer(loop, 10, 2, evloop_on_repeat,
+                                         &st) != NULL);
+    mu_assert("run", evloop_run(loop) == 0);
+    mu_assert("fired", st.oneshot == 1 && st.repeats == 3);
+    /* everything was released, so run returns at once */
+    mu_assert("empty", evloop_run(loop) == 0);
+
+    evloop_free(loop);
+    close(p[0]);
+    close(p[1]);
+    return 0;
+}
+
 static void encode_vis(const char *src, char *dst, int flags)
 {
     while (*src) {
@@ -6819,7 +8542,45 @@ static const char *test_dlopen_basic(void)
     int (*val)(void) = dlsym(h, "plugin_value");
     mu_assert("dlsym", val != NULL);
     mu_assert("call", val() == 123);
+    /* strlen is not in the plugin; it comes from the program's libc */
+    size_t (*len)(const char *) =
+        (size_t (*)(const char *))dlsym(h, "plugin_len");
+    mu_assert("libc symbol", len && len("hello") == 5);
+    mu_assert("dlclose", dlclose(h) == 0);
+    return 0;
+}
+
+static const char *test_dlsym_global(void)
+{
+    mu_assert("before", dlsym(RTLD_DEFAULT, "plugin_value") == NULL);
+    void *h = dlopen("tests/plugin.so", RTLD_NOW | RTLD_GLOBAL);
+    mu_assert("dlopen", h != NULL);
+    int (*val)(void) = dlsym(RTLD_DEFAULT, "plugin_value");
+    mu_assert("global", val != NULL && val() == 123);
+    mu_assert("cached", dlsym(RTLD_DEFAULT, "plugin_value") == (void *)val);
+    mu_assert("same", dlsym(h, "plugin_value") == (void *)val);
+    mu_assert("missing", dlsym(h, "plugin_missing") == NULL);
+    mu_assert("undef", dlsym(h, "__cxa_finalize") == NULL);
     mu_assert("dlclose", dlclose(h) == 0);
+    mu_assert("after", dlsym(RTLD_DEFAULT, "plugin_value") == NULL);
+    return 0;
+}
+
+static const char *test_dlopen_lazy(void)
+{
+    void *h = dlopen("tests/plugin.so", RTLD_LAZY);
+    mu_assert("dlopen lazy", h != NULL);
+    int (*twice)(void) = dlsym(h, "plugin_twice");
+    mu_assert("dlsym", twice != NULL);
+    mu_assert("first call", twice() == 246);
+    mu_assert("bound call", twice() == 246);
+    mu_assert("dlclose", dlclose(h) == 0);
+
+    h = dlopen("tests/plugin.so", RTLD_NOW);
+    mu_assert("dlopen now", h != NULL);
+    twice = dlsym(h, "plugin_twice");
+    mu_assert("now call", twice && twice() == 246);
+    dlclose(h);
     return 0;
 }
 
@@ -7014,6 +8775,9 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("stdio", test_preadv_pwritev),
         REGISTER_TEST("stdio", test_readv_writev),
         REGISTER_TEST("stdio", test_sendfile_copy),
+        REGISTER_TEST("stdio", test_splice_tee),
+        REGISTER_TEST("stdio", test_vlibc_copy_fd),
+        REGISTER_TEST("stdio", test_vlibc_copy_fd_socket),
 #ifdef __NetBSD__
         REGISTER_TEST("network", test_sendfile_socket),
 #endif
@@ -7034,6 +8798,8 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("network", test_socket_addresses),
         REGISTER_TEST("network", test_sendmsg_recvmsg),
         REGISTER_TEST("network", test_udp_send_recv),
+        REGISTER_TEST("network", test_sendmmsg_recvmmsg),
+        REGISTER_TEST("network", test_syslog_async),
         REGISTER_TEST("network", test_inet_pton_ntop),
         REGISTER_TEST("network", test_inet_aton_ntoa),
         REGISTER_TEST("network", test_hosts_long_file),
@@ -7068,6 +8834,7 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("stdlib", test_widechar_width),
         REGISTER_TEST("stdlib", test_single_byte_conv),
         REGISTER_TEST("stdlib", test_wctype_checks),
+        REGISTER_TEST("stdlib", test_wctype_unicode),
         REGISTER_TEST("stdlib", test_wmem_ops),
         REGISTER_TEST("stdlib", test_wchar_search),
         REGISTER_TEST("stdio", test_wmemstream_basic),
@@ -7079,6 +8846,8 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("stdlib", test_iconv_invalid_byte),
         REGISTER_TEST("stdlib", test_iconv_iso8859_utf8),
         REGISTER_TEST("stdlib", test_iconv_utf16_ascii),
+        REGISTER_TEST("stdlib", test_utf8_bulk),
+        REGISTER_TEST("stdlib", test_iconv_tables),
         REGISTER_TEST("stdlib", test_strtok_basic),
         REGISTER_TEST("stdlib", test_strtok_r_basic),
         REGISTER_TEST("stdlib", test_strsep_basic),
@@ -7122,6 +8891,8 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("process", test_semaphore_trywait),
         REGISTER_TEST("process", test_select_pipe),
         REGISTER_TEST("process", test_poll_pipe),
+        REGISTER_TEST("process", test_epoll_fds),
+        REGISTER_TEST("process", test_evloop_basic),
         REGISTER_TEST("time", test_sleep_functions),
         REGISTER_TEST("time", test_clock_nanosleep_basic),
         REGISTER_TEST("time", test_sched_yield_basic),
@@ -7134,8 +8905,10 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("time", test_times_self),
         REGISTER_TEST("time", test_getloadavg_basic),
         REGISTER_TEST("time", test_timespec_get_basic),
+        REGISTER_TEST("time", test_clock_vdso_consistent),
         REGISTER_TEST("time", test_strftime_basic),
         REGISTER_TEST("time", test_strftime_extended),
+        REGISTER_TEST("time", test_strftime_compiled),
         REGISTER_TEST("time", test_wcsftime_basic),
         REGISTER_TEST("time", test_wcsftime_extended),
         REGISTER_TEST("time", test_strfmon_basic),
@@ -7149,7 +8922,9 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("time", test_tz_positive),
         REGISTER_TEST("time", test_tz_negative),
         REGISTER_TEST("time", test_tz_mktime_roundtrip),
+        REGISTER_TEST("time", test_tz_switch_reuse),
         REGISTER_TEST("time", test_tz_ctime),
+        REGISTER_TEST("time", test_tz_rules),
         REGISTER_TEST("locale", test_environment),
         REGISTER_TEST("locale", test_clearenv_fn),
         REGISTER_TEST("locale", test_env_init_clearenv),
@@ -7161,6 +8936,7 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("locale", test_setenv_realloc_fail_errno),
         REGISTER_TEST("locale", test_setenv_strdup_fail),
         REGISTER_TEST("locale", test_clearenv_alloc_fail),
+        REGISTER_TEST("locale", test_getenv_index),
         REGISTER_TEST("locale", test_locale_from_env),
         REGISTER_TEST("locale", test_locale_objects),
         REGISTER_TEST("locale", test_langinfo_codeset),
@@ -7192,6 +8968,7 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("process", test_posix_spawn_pgroup),
         REGISTER_TEST("process", test_posix_spawn_chdir),
         REGISTER_TEST("process", test_posix_spawn_fchdir),
+        REGISTER_TEST("process", test_posix_spawn_clone_child),
         REGISTER_TEST("process", test_posix_spawn_actions_alloc_fail),
         REGISTER_TEST("process", test_popen_fn),
         REGISTER_TEST("process", test_shell_errno),
@@ -7242,8 +9019,10 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("dirent", test_realpath_basic),
         REGISTER_TEST("dirent", test_getcwd_deep),
         REGISTER_TEST("dirent", test_pathconf_basic),
+        REGISTER_TEST("dirent", test_sysconf_cpus),
         REGISTER_TEST("process", test_passwd_lookup),
         REGISTER_TEST("process", test_group_lookup),
+        REGISTER_TEST("process", test_passwd_cache_reload),
         REGISTER_TEST("process", test_passwd_enum),
         REGISTER_TEST("process", test_passwd_long_entries),
         REGISTER_TEST("process", test_group_enum),
@@ -7265,7 +9044,10 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("stdlib", test_wordexp_malformed),
         REGISTER_TEST("stdlib", test_wordexp_unterminated_cases),
         REGISTER_TEST("dirent", test_dirent),
+        REGISTER_TEST("dirent", test_dirent_native),
         REGISTER_TEST("dirent", test_ftw_walk),
+        REGISTER_TEST("dirent", test_nftw_fdlimit),
+        REGISTER_TEST("dirent", test_nftw_parallel),
         REGISTER_TEST("ftw", test_ftw_long_path_fail),
         REGISTER_TEST("dirent", test_fts_walk),
         REGISTER_TEST("dirent", test_fts_alloc_fail),
@@ -7287,7 +9069,12 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("regex", test_regex_open_repetition),
         REGISTER_TEST("regex", test_regex_anchor_anywhere),
         REGISTER_TEST("regex", test_regex_neg_class),
+        REGISTER_TEST("regex", test_regex_flags),
+        REGISTER_TEST("regex", test_regex_linear_time),
+        REGISTER_TEST("regex", test_regex_prefilter),
         REGISTER_TEST("stdlib", test_math_functions),
+        REGISTER_TEST("stdlib", test_math_accuracy),
+        REGISTER_TEST("stdlib", test_math_vector),
         REGISTER_TEST("stdlib", test_complex_cabs_cexp),
         REGISTER_TEST("stdlib", test_abs_div_functions),
         REGISTER_TEST("stdlib", test_abs_min_values),
@@ -7297,10 +9084,14 @@ static const char *run_tests(const char *category, const char *name)
         REGISTER_TEST("stdlib", test_fenv_rounding),
         REGISTER_TEST("process", test_ucontext_basic),
         REGISTER_TEST("process", test_ucontext_args),
+        REGISTER_TEST("process", test_ucontext_nosig),
+        REGISTER_TEST("process", test_vco_basic),
         REGISTER_TEST("stdlib", test_getopt_basic),
         REGISTER_TEST("stdlib", test_getopt_missing),
         REGISTER_TEST("process", test_dlopen_basic),
         REGISTER_TEST("process", test_dladdr_basic),
+        REGISTER_TEST("process", test_dlopen_lazy),
+        REGISTER_TEST("process", test_dlsym_global),
         REGISTER_TEST("stdlib", test_getopt_long_missing),
         REGISTER_TEST("stdlib", test_getopt_long_basic),
         REGISTER_TEST("stdlib", test_getopt_long_only_missing),
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+#
+# BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+#
+# Purpose: Generates src/iconv_tables.c from the codecs shipped with
+# Python:
+#
+#     python3 tools/gen_iconv.py > src/iconv_tables.c
+#
+# The single-byte codecs in CPython's Lib/encodings are generated by its
+# Tools/unicode/gencodec.py from the mapping files under
+# https://www.unicode.org/Public/MAPPINGS/ (ISO8859/8859-N.TXT,
+# VENDORS/MICSFT/WINDOWS/CP125N.TXT, VENDORS/MISC/KOI8-R.TXT and
+# KOI8-U.TXT). GBK, EUC-JP and EUC-KR come from Modules/cjkcodecs, which
+# follow CP936.TXT, JIS0208.TXT and KSC5601.TXT from the same tree. The
+# checked in tables were built with Python 3.11.
+#
+# Copyright (c) 2025
+
+import sys
+
+ISO8859 = (1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 14, 15, 16)
+
+
+def single(codec):
+    """Code points of bytes 0x80-0xFF, 0 where the codec has none."""
+    vals = []
+    for b in range(0x80, 0x100):
+        try:
+            vals.append(ord(bytes([b]).decode(codec)))
+        except UnicodeDecodeError:
+            vals.append(0)
+    return vals
+
+
+def gbk():
+    vals = []
+    for lead in range(0x81, 0xFF):
+        for trail in range(0x40, 0xFF):
+            if trail == 0x7F:
+                vals.append(0)
+                continue
+            try:
+                vals.append(ord(bytes([lead, trail]).decode("gbk")))
+            except UnicodeDecodeError:
+                vals.append(0)
+    return vals
+
+
+def rows94(codec):
+    """A 94x94 set read through its EUC form, rows and columns 0xA1-0xFE."""
+    vals = []
+    for row in range(94):
+        for col in range(94):
+            try:
+                vals.append(ord(bytes([0xA1 + row, 0xA1 + col]).decode(codec)))
+            except UnicodeDecodeError:
+                vals.append(0)
+    return vals
+
+
+def emit(out, name, vals, comment):
+    out.append("/* %s */" % comment)
+    out.append("const uint16_t %s[%d] = {" % (name, len(vals)))
+    for i in range(0, len(vals), 8):
+        out.append("    " + ", ".join("0x%04X" % v for v in vals[i:i + 8]) + ",")
+    out.append("};")
+    out.append("")
+
+
+def main():
+    out = ["""/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Implements the iconv charset tables for vlibc. Provides wrappers and helpers used by the standard library.
+ *
+ * Copyright (c) 2025
+ */
+
+#include <stdint.h>
+
+/*
+ * Byte to code point tables for the charsets iconv converts through
+ * UCS-4, generated by tools/gen_iconv.py from the Python %d.%d codecs,
+ * which follow the Unicode mapping files. Single-byte tables cover
+ * 0x80-0xFF. Double-byte tables are indexed by lead and trail byte:
+ * GBK by (lead - 0x81) * 191 + (trail - 0x40), JIS X 0208 and KS X 1001
+ * by row * 94 + column. Zero marks an unassigned code.
+ */
+""" % sys.version_info[:2]]
+    for n in ISO8859:
+        emit(out, "__vlibc_cs_iso8859_%d" % n, single("iso8859_%d" % n),
+             "ISO-8859-%d" % n)
+    for n in range(9):
+        emit(out, "__vlibc_cs_cp125%d" % n, single("cp125%d" % n),
+             "Windows-125%d" % n)
+    emit(out, "__vlibc_cs_koi8_r", single("koi8_r"), "KOI8-R")
+    emit(out, "__vlibc_cs_koi8_u", single("koi8_u"), "KOI8-U")
+    emit(out, "__vlibc_cs_gbk", gbk(),
+         "GBK, leads 0x81-0xFE, trails 0x40-0xFE")
+    emit(out, "__vlibc_cs_jisx0208", rows94("euc_jp"), "JIS X 0208")
+    emit(out, "__vlibc_cs_ksc5601", rows94("euc_kr"), "KS X 1001")
+    sys.stdout.write("\n".join(out).rstrip("\n") + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+#
+# BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+#
+# Purpose: Generates src/wctype_tables.c from the Unicode character
+# database. Point it at a directory holding UnicodeData.txt,
+# DerivedCoreProperties.txt, PropList.txt and EastAsianWidth.txt from
+# https://www.unicode.org/Public/<version>/ucd/ and redirect the output:
+#
+#     python3 tools/gen_wctype.py ucd/ > src/wctype_tables.c
+#
+# The checked in tables were built from Unicode 14.0.0.
+#
+# Copyright (c) 2025
+
+import os
+import re
+import sys
+
+MAXCP = 0x110000
+BLOCK_BITS = 7  # must match __vlibc_wprop() in include/wctype.h
+
+# __CTYPE_* bits from include/ctype.h followed by the __WCTYPE_* ones
+UPPER, LOWER, DIGIT, SPACE, XDIGIT, CNTRL, PUNCT, BLANK = (
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80)
+ALPHA, PRINT, GRAPH = 0x100, 0x200, 0x400
+
+# no-break spaces do not separate words
+NBSP = (0x00A0, 0x2007, 0x202F)
+
+
+def ucd_lines(path):
+    """Yield the fields of each data line with comments stripped."""
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.split("#", 1)[0].strip()
+            if line:
+                yield [x.strip() for x in line.split(";")]
+
+
+def cp_range(field):
+    if ".." in field:
+        a, b = field.split("..")
+        return range(int(a, 16), int(b, 16) + 1)
+    c = int(field, 16)
+    return range(c, c + 1)
+
+
+def ucd_version(path):
+    with open(path, encoding="utf-8") as f:
+        m = re.match(r"#\s*\w+-(\d+\.\d+\.\d+)\.txt", f.readline())
+    if not m:
+        sys.exit("%s: no version in the first line" % path)
+    return m.group(1)
+
+
+def load(ucd):
+    """Return category, simple case maps and property sets per code point."""
+    cat = ["Cn"] * MAXCP
+    lower = list(range(MAXCP))
+    upper = list(range(MAXCP))
+    first = None
+    for f in ucd_lines(os.path.join(ucd, "UnicodeData.txt")):
+        c = int(f[0], 16)
+        if f[1].endswith(", First>"):
+            first = c
+            continue
+        start = first if f[1].endswith(", Last>") else c
+        first = None
+        for x in range(start, c + 1):
+            cat[x] = f[2]
+            if f[12]:
+                upper[x] = int(f[12], 16)
+            if f[13]:
+                lower[x] = int(f[13], 16)
+
+    props = {}
+    for name in ("DerivedCoreProperties.txt", "PropList.txt"):
+        for f in ucd_lines(os.path.join(ucd, name)):
+            props.setdefault(f[1], set()).update(cp_range(f[0]))
+
+    wide = set()
+    for f in ucd_lines(os.path.join(ucd, "EastAsianWidth.txt")):
+        if f[1] in ("W", "F"):
+            wide.update(cp_range(f[0]))
+    return cat, lower, upper, props, wide
+
+
+def ascii_flags(c):
+    ch = chr(c)
+    f = 0
+    if "A" <= ch <= "Z":
+        f |= UPPER | ALPHA
+    if "a" <= ch <= "z":
+        f |= LOWER | ALPHA
+    if "0" <= ch <= "9":
+        f |= DIGIT
+    if ch in " \t\n\r\v\f":
+        f |= SPACE
+    if ch in "0123456789abcdefABCDEF":
+        f |= XDIGIT
+    if c < 0x20 or c == 0x7F:
+        f |= CNTRL
+    if 0x21 <= c <= 0x7E and not ch.isalnum():
+        f |= PUNCT
+    if ch in " \t":
+        f |= BLANK
+    if 0x20 <= c < 0x7F:
+        f |= PRINT
+    if 0x21 <= c < 0x7F:
+        f |= GRAPH
+    width = 1 if 0x20 <= c < 0x7F else (0 if c == 0 else -1)
+    return f, width
+
+
+def record(c, cat, lower, upper, props, wide):
+    """Return the (flags, width, lower delta, upper delta) record of c."""
+    lo, up = lower[c], upper[c]
+    if c < 0x80:
+        f, width = ascii_flags(c)
+        return f, width, lo - c, up - c
+
+    gc = cat[c]
+    nbsp = c in NBSP
+    f = 0
+    if c in props["Uppercase"] or lo != c:
+        f |= UPPER
+    if c in props["Lowercase"] or up != c:
+        f |= LOWER
+    if gc in ("Zs", "Zl", "Zp") and not nbsp:
+        f |= SPACE
+    if gc == "Zs" and not nbsp:
+        f |= BLANK
+    if gc in ("Cc", "Zl", "Zp"):
+        f |= CNTRL
+    alpha = c in props["Alphabetic"] or gc == "Nd"
+    if alpha:
+        f |= ALPHA
+    printable = gc not in ("Cc", "Cs", "Cn", "Zl", "Zp")
+    if printable:
+        f |= PRINT
+        if gc != "Zs" or nbsp:
+            f |= GRAPH
+            if not alpha:
+                f |= PUNCT
+
+    if not printable:
+        width = -1
+    elif (gc in ("Mn", "Me") or
+          (gc == "Cf" and c != 0x00AD and
+           c not in props["Prepended_Concatenation_Mark"]) or
+          0x1160 <= c <= 0x11FF or
+          (0xD7B0 <= c <= 0xD7FF and gc == "Lo") or c == 0x200B):
+        # combining marks, format controls and Hangul medial and final jamo
+        width = 0
+    elif c in wide or (0x20000 <= c <= 0x3FFFD and gc == "Cn"):
+        width = 2
+    else:
+        width = 1
+    return f, width, lo - c, up - c
+
+
+def rows(values):
+    for i in range(0, len(values), 16):
+        yield "    " + ", ".join(str(x) for x in values[i:i + 16]) + ",\n"
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: %s UCD_DIR" % sys.argv[0])
+    ucd = sys.argv[1]
+    version = ucd_version(os.path.join(ucd, "DerivedCoreProperties.txt"))
+    tables = load(ucd)
+
+    # record 0 is what out of range code points get
+    recs = {(0, -1, 0, 0): 0}
+    index = []
+    for c in range(MAXCP):
+        r = record(c, *tables)
+        index.append(recs.setdefault(r, len(recs)))
+    if len(recs) > 256:
+        sys.exit("%d records do not fit stage 2" % len(recs))
+
+    size = 1 << BLOCK_BITS
+    blocks = {}
+    stage1 = []
+    for b in range(0, MAXCP, size):
+        stage1.append(blocks.setdefault(tuple(index[b:b + size]), len(blocks)))
+    if len(blocks) > 256:
+        sys.exit("%d blocks do not fit stage 1" % len(blocks))
+    stage2 = [x for blk in blocks for x in blk]
+
+    out = sys.stdout
+    out.write("""/*
+ * BSD 2-Clause License: Redistribution and use in source and binary forms, with or without modification, are permitted provided that the copyright notice and this permission notice appear in all copies. This software is provided "as is" without warranty.
+ *
+ * Purpose: Unicode property tables behind the wctype functions and
+ * wcwidth, generated from the Unicode %s character database.
+ * Regenerate with tools/gen_wctype.py rather than editing by hand.
+ *
+ * Copyright (c) 2025
+ */
+
+#include "wctype.h"
+
+""" % version)
+    out.write("const struct __vlibc_wprop __vlibc_wprops[%d] = {\n" % len(recs))
+    for f, width, lo, up in recs:
+        out.write("    { 0x%03x, %d, %d, %d },\n" % (f, width, lo, up))
+    out.write("};\n\n")
+    out.write("const unsigned char __vlibc_wstage1[%d] = {\n" % len(stage1))
+    out.writelines(rows(stage1))
+    out.write("};\n\n")
+    out.write("const unsigned char __vlibc_wstage2[%d] = {\n" % len(stage2))
+    out.writelines(rows(stage2))
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()